@@ -81,12 +81,18 @@ IF %ERRORLEVEL% NEQ 0 GOTO ERROR
 
 SET PATH=%PROJECT_DIR%\osrm-deps\libs\bin;%PATH%
 
+ECHO running contractor-tests.exe ...
+%Configuration%\contractor-tests.exe
+IF %ERRORLEVEL% NEQ 0 GOTO ERROR
 ECHO running engine-tests.exe ...
 %Configuration%\engine-tests.exe
 IF %ERRORLEVEL% NEQ 0 GOTO ERROR
 ECHO running extractor-tests.exe ...
 %Configuration%\extractor-tests.exe
 IF %ERRORLEVEL% NEQ 0 GOTO ERROR
+ECHO running server-tests.exe ...
+%Configuration%\server-tests.exe
+IF %ERRORLEVEL% NEQ 0 GOTO ERROR
 ECHO running util-tests.exe ...
 %Configuration%\util-tests.exe
 IF %ERRORLEVEL% NEQ 0 GOTO ERROR
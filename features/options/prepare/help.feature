@@ -18,7 +18,11 @@ Feature: osrm-prepare command line options: help
         And stdout should contain "--core"
         And stdout should contain "--level-cache"
         And stdout should contain "--segment-speed-file"
-        And stdout should contain 21 lines
+        And stdout should contain "--incremental"
+        And stdout should contain "--node-order"
+        And stdout should contain "--partition-cell-size"
+        And stdout should contain "--witness-cache"
+        And stdout should contain 38 lines
         And it should exit with code 1
 
     Scenario: osrm-prepare - Help, short
@@ -35,7 +39,11 @@ Feature: osrm-prepare command line options: help
         And stdout should contain "--core"
         And stdout should contain "--level-cache"
         And stdout should contain "--segment-speed-file"
-        And stdout should contain 21 lines
+        And stdout should contain "--incremental"
+        And stdout should contain "--node-order"
+        And stdout should contain "--partition-cell-size"
+        And stdout should contain "--witness-cache"
+        And stdout should contain 38 lines
         And it should exit with code 0
 
     Scenario: osrm-prepare - Help, long
@@ -52,5 +60,9 @@ Feature: osrm-prepare command line options: help
         And stdout should contain "--core"
         And stdout should contain "--level-cache"
         And stdout should contain "--segment-speed-file"
-        And stdout should contain 21 lines
+        And stdout should contain "--incremental"
+        And stdout should contain "--node-order"
+        And stdout should contain "--partition-cell-size"
+        And stdout should contain "--witness-cache"
+        And stdout should contain 38 lines
         And it should exit with code 0
@@ -29,7 +29,15 @@ Feature: osrm-routed command line options: help
         And stdout should contain "--max-trip-size"
         And stdout should contain "--max-table-size"
         And stdout should contain "--max-matching-size"
-        And stdout should contain 30 lines
+        And stdout should contain "--mmap-fileindex"
+        And stdout should contain "--prefetch-fileindex"
+        And stdout should contain "--mmap-dataset"
+        And stdout should contain "--keepalive-timeout"
+        And stdout should contain "--max-keepalive-requests"
+        And stdout should contain "--access-log-format"
+        And stdout should contain "--access-log-sample-rate"
+        And stdout should contain "--compression-level"
+        And stdout should contain 45 lines
         And it should exit with code 0
 
     Scenario: osrm-routed - Help, short
@@ -57,7 +65,15 @@ Feature: osrm-routed command line options: help
         And stdout should contain "--max-trip-size"
         And stdout should contain "--max-table-size"
         And stdout should contain "--max-matching-size"
-        And stdout should contain 30 lines
+        And stdout should contain "--mmap-fileindex"
+        And stdout should contain "--prefetch-fileindex"
+        And stdout should contain "--mmap-dataset"
+        And stdout should contain "--keepalive-timeout"
+        And stdout should contain "--max-keepalive-requests"
+        And stdout should contain "--access-log-format"
+        And stdout should contain "--access-log-sample-rate"
+        And stdout should contain "--compression-level"
+        And stdout should contain 45 lines
         And it should exit with code 0
 
     Scenario: osrm-routed - Help, long
@@ -85,5 +101,13 @@ Feature: osrm-routed command line options: help
         And stdout should contain "--max-table-size"
         And stdout should contain "--max-table-size"
         And stdout should contain "--max-matching-size"
-        And stdout should contain 30 lines
+        And stdout should contain "--mmap-fileindex"
+        And stdout should contain "--prefetch-fileindex"
+        And stdout should contain "--mmap-dataset"
+        And stdout should contain "--keepalive-timeout"
+        And stdout should contain "--max-keepalive-requests"
+        And stdout should contain "--access-log-format"
+        And stdout should contain "--access-log-sample-rate"
+        And stdout should contain "--compression-level"
+        And stdout should contain 45 lines
         And it should exit with code 0
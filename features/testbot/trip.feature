@@ -19,7 +19,7 @@ Feature: Basic trip planning
 
         When I plan a trip I should get
             | waypoints | trips |
-            | a,b,c,d   | dcba  |
+            | a,b,c,d   | adcb  |
 
     Scenario: Testbot - Trip planning with more than 10 nodes
         Given the node map
@@ -46,7 +46,7 @@ Feature: Basic trip planning
 
         When I plan a trip I should get
             | waypoints               | trips         |
-            | a,b,c,d,e,f,g,h,i,j,k,l | cbalkjihgfedc |
+            | a,b,c,d,e,f,g,h,i,j,k,l | alkjihgfedcba |
 
     Scenario: Testbot - Trip planning with multiple scc
         Given the node map
@@ -80,7 +80,7 @@ Feature: Basic trip planning
 
         When I plan a trip I should get
             | waypoints                       | trips              |
-            | a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p | cbalkjihgfedc,ponm |
+            | a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p | alkjihgfedcba,mpon |
 
 
 
@@ -7,8 +7,8 @@
 #include "util/percent.hpp"
 #include "contractor/query_edge.hpp"
 #include "util/xor_fast_hash.hpp"
-#include "util/xor_fast_hash_storage.hpp"
 #include "util/integer_range.hpp"
+#include "util/osrm_exception.hpp"
 #include "util/simple_logger.hpp"
 #include "util/timing_util.hpp"
 #include "util/typedefs.hpp"
@@ -22,8 +22,15 @@
 #include <tbb/parallel_sort.h>
 
 #include <algorithm>
+#include <iterator>
 #include <limits>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace osrm
@@ -66,26 +73,48 @@ class Contractor
     {
         short hop;
         bool target;
-        ContractorHeapData() : hop(0), target(false) {}
-        ContractorHeapData(short h, bool t) : hop(h), target(t) {}
+        // a path to the target that is at most this long makes the shortcut unnecessary
+        int witness_distance;
+        ContractorHeapData() : hop(0), target(false), witness_distance(0) {}
+        ContractorHeapData(short h, bool t, int w = 0) : hop(h), target(t), witness_distance(w) {}
     };
 
     using ContractorGraph = util::DynamicGraph<ContractorEdgeData>;
-    //    using ContractorHeap = util::BinaryHeap<NodeID, NodeID, int, ContractorHeapData,
-    //    ArrayStorage<NodeID, NodeID>
-    //    >;
+    // The witness searches clear the heap for every incoming edge of every node they simulate,
+    // the generation stamped array makes that free and each lookup a single array access.
     using ContractorHeap = util::BinaryHeap<NodeID,
                                             NodeID,
                                             int,
                                             ContractorHeapData,
-                                            util::XORFastHashStorage<NodeID, NodeID>>;
+                                            util::GenerationArrayStorage<NodeID, NodeID>,
+                                            4>;
     using ContractorEdge = ContractorGraph::InputEdge;
 
+    // Distance of a path from source to target that avoids the node the entry is stored for
+    struct WitnessCacheEntry
+    {
+        WitnessCacheEntry(NodeID source, NodeID target, int distance)
+            : source(source), target(target), distance(distance)
+        {
+        }
+
+        bool operator<(const WitnessCacheEntry &other) const
+        {
+            return std::tie(source, target, distance) <
+                   std::tie(other.source, other.target, other.distance);
+        }
+
+        NodeID source;
+        NodeID target;
+        int distance;
+    };
+
     struct ContractorThreadData
     {
         ContractorHeap heap;
         std::vector<ContractorEdge> inserted_edges;
         std::vector<NodeID> neighbours;
+        std::vector<WitnessCacheEntry> witnesses;
         explicit ContractorThreadData(NodeID nodes) : heap(nodes) {}
     };
 
@@ -276,7 +305,11 @@ class Contractor
 
     ~Contractor() {}
 
-    void Run(double core_factor = 1.0)
+    // With use_witness_cache the witnesses found while simulating the contraction of a node are
+    // kept and reused when its priority is updated, instead of searching for them again. The
+    // witness might not exist anymore by then, which only affects the priority but never which
+    // shortcuts are added. It needs memory for the witnesses of every node.
+    void Run(double core_factor = 1.0, bool use_witness_cache = false)
     {
         // for the preperation we can use a big grain size, which is much faster (probably cache)
         constexpr size_t InitGrainSize = 100000;
@@ -300,6 +333,10 @@ class Contractor
         is_core_node.resize(number_of_nodes, false);
 
         std::vector<RemainingNodeData> remaining_nodes(number_of_nodes);
+        if (use_witness_cache && node_levels.empty())
+        {
+            witness_cache.resize(number_of_nodes);
+        }
         // initialize priorities in parallel
         tbb::parallel_for(tbb::blocked_range<int>(0, number_of_nodes, InitGrainSize),
                           [this, &remaining_nodes](const tbb::blocked_range<int> &range)
@@ -433,6 +470,13 @@ class Contractor
                 new_edge_set.clear();
                 flushed_contractor = true;
 
+                // the cached witnesses still use the old ids
+                if (!witness_cache.empty())
+                {
+                    witness_cache.clear();
+                    witness_cache.resize(remaining_nodes.size());
+                }
+
                 // INFO: MAKE SURE THIS IS THE LAST OPERATION OF THE FLUSH!
                 // reinitialize heaps and ThreadData objects with appropriate size
                 thread_data_list.number_of_nodes = contractor_graph->GetNumberOfNodes();
@@ -506,6 +550,10 @@ class Contractor
                                   {
                                       const NodeID x = remaining_nodes[position].id;
                                       this->ContractNode<false>(data, x);
+                                      if (!witness_cache.empty())
+                                      {
+                                          std::vector<WitnessCacheEntry>().swap(witness_cache[x]);
+                                      }
                                   }
                               });
 
@@ -523,40 +571,7 @@ class Contractor
                     }
                 });
 
-            // make sure we really sort each block
-            tbb::parallel_for(
-                thread_data_list.data.range(),
-                [&](const ThreadDataContainer::EnumerableThreadData::range_type &range)
-                {
-                    for (auto &data : range)
-                        tbb::parallel_sort(data->inserted_edges.begin(),
-                                           data->inserted_edges.end());
-                });
-
-            // insert new edges
-            for (auto &data : thread_data_list.data)
-            {
-                for (const ContractorEdge &edge : data->inserted_edges)
-                {
-                    const EdgeID current_edge_ID =
-                        contractor_graph->FindEdge(edge.source, edge.target);
-                    if (current_edge_ID < contractor_graph->EndEdges(edge.source))
-                    {
-                        ContractorGraph::EdgeData &current_data =
-                            contractor_graph->GetEdgeData(current_edge_ID);
-                        if (current_data.shortcut && edge.data.forward == current_data.forward &&
-                            edge.data.backward == current_data.backward &&
-                            edge.data.distance < current_data.distance)
-                        {
-                            // found a duplicate edge with smaller weight, update it.
-                            current_data = edge.data;
-                            continue;
-                        }
-                    }
-                    contractor_graph->InsertEdge(edge.source, edge.target, edge.data);
-                }
-                data->inserted_edges.clear();
-            }
+            InsertShortcuts(thread_data_list);
 
             if (!use_cached_node_priorities)
             {
@@ -649,6 +664,393 @@ class Contractor
                                      << std::endl;
 
         thread_data_list.data.clear();
+        witness_cache.clear();
+        witness_cache.shrink_to_fit();
+    }
+
+    // Contracts most nodes inside the cells of a partition and afterwards the core of the nodes
+    // that are left, which includes the boundary nodes that have an edge into another cell.
+    // Every cell is contracted on a copy of its subgraph in a task of its own, without any barrier
+    // between the cells. The witness searches of a cell only see the cell, which can add
+    // shortcuts a search on the whole graph would have found a witness for, but never misses one.
+    // The core is contracted by Run.
+    void RunPartitioned(const std::vector<unsigned> &node_cells,
+                        double core_factor = 1.0,
+                        bool use_witness_cache = false)
+    {
+        constexpr size_t InitGrainSize = 100000;
+        constexpr size_t CellGrainSize = 1;
+
+        const NodeID number_of_nodes = contractor_graph->GetNumberOfNodes();
+        if (node_cells.size() != number_of_nodes)
+        {
+            throw util::exception("Partition does not match the graph");
+        }
+        if (!node_levels.empty())
+        {
+            throw util::exception("Partitioned contraction can not use cached node priorities");
+        }
+        if (number_of_nodes == 0)
+        {
+            Run(core_factor, use_witness_cache);
+            return;
+        }
+
+        std::vector<char> is_boundary_node(number_of_nodes, false);
+        tbb::parallel_for(tbb::blocked_range<NodeID>(0, number_of_nodes, InitGrainSize),
+                          [&](const tbb::blocked_range<NodeID> &range)
+                          {
+                              for (auto node = range.begin(), end = range.end(); node != end;
+                                   ++node)
+                              {
+                                  for (auto edge : contractor_graph->GetAdjacentEdgeRange(node))
+                                  {
+                                      const NodeID target = contractor_graph->GetTarget(edge);
+                                      if (node_cells[target] != node_cells[node])
+                                      {
+                                          is_boundary_node[node] = true;
+                                          break;
+                                      }
+                                  }
+                              }
+                          });
+
+        // the nodes of every cell are consecutive, their position in the cell is the local id
+        const unsigned number_of_cells =
+            *std::max_element(node_cells.begin(), node_cells.end()) + 1;
+        std::vector<NodeID> cell_offsets(number_of_cells + 1, 0);
+        for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+        {
+            ++cell_offsets[node_cells[node] + 1];
+        }
+        std::partial_sum(cell_offsets.begin(), cell_offsets.end(), cell_offsets.begin());
+        std::vector<NodeID> cell_nodes(number_of_nodes);
+        std::vector<NodeID> local_node_ids(number_of_nodes);
+        {
+            std::vector<NodeID> positions(cell_offsets.begin(), cell_offsets.end() - 1);
+            for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+            {
+                const NodeID position = positions[node_cells[node]]++;
+                cell_nodes[position] = node;
+                local_node_ids[node] = position - cell_offsets[node_cells[node]];
+            }
+        }
+
+        const NodeID number_of_boundary_nodes =
+            std::count(is_boundary_node.begin(), is_boundary_node.end(), true);
+        util::SimpleLogger().Write() << "Partition has " << number_of_cells << " cells and "
+                                     << number_of_boundary_nodes << " boundary nodes";
+
+        TIMER_START(cells);
+        std::vector<char> is_contracted_in_cell(number_of_nodes, false);
+        std::vector<float> cell_levels(number_of_nodes, 0);
+        std::vector<ContractorEdge> core_edges;
+        std::mutex edges_mutex;
+        tbb::parallel_for(tbb::blocked_range<unsigned>(0, number_of_cells, CellGrainSize),
+                          [&](const tbb::blocked_range<unsigned> &range)
+                          {
+                              for (auto cell = range.begin(), end = range.end(); cell != end;
+                                   ++cell)
+                              {
+                                  this->ContractCell(cell, node_cells, cell_nodes, cell_offsets,
+                                                     local_node_ids, is_boundary_node,
+                                                     is_contracted_in_cell, cell_levels,
+                                                     core_edges, edges_mutex);
+                              }
+                          });
+        TIMER_STOP(cells);
+        util::SimpleLogger().Write()
+            << "Contracting " << std::count(is_contracted_in_cell.begin(),
+                                            is_contracted_in_cell.end(), true)
+            << " nodes inside their cells took " << TIMER_SEC(cells) << " sec";
+
+        // the core consists of the nodes that are left in the cells, the edges between them and
+        // the edges between the cells
+        for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+        {
+            if (!is_boundary_node[node])
+            {
+                continue;
+            }
+            for (auto edge : contractor_graph->GetAdjacentEdgeRange(node))
+            {
+                const NodeID target = contractor_graph->GetTarget(edge);
+                if (node_cells[target] != node_cells[node])
+                {
+                    core_edges.push_back({node, target, contractor_graph->GetEdgeData(edge)});
+                }
+            }
+        }
+        contractor_graph.reset();
+        tbb::parallel_sort(core_edges.begin(), core_edges.end());
+        contractor_graph = std::make_shared<ContractorGraph>(number_of_nodes, core_edges);
+        core_edges.clear();
+        core_edges.shrink_to_fit();
+
+        // the nodes contracted in their cells are isolated in the core and are contracted right
+        // away
+        TIMER_START(core);
+        Run(core_factor, use_witness_cache);
+        TIMER_STOP(core);
+        util::SimpleLogger().Write() << "Contracting the core took " << TIMER_SEC(core) << " sec";
+
+        const float core_level = *std::max_element(cell_levels.begin(), cell_levels.end()) + 1;
+        for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+        {
+            node_levels[node] =
+                is_contracted_in_cell[node] ? cell_levels[node] : core_level + node_levels[node];
+        }
+    }
+
+    // Contracts the graph in the order of the cached node levels and reuses the shortcuts of the
+    // previous hierarchy that was built with these levels. Only nodes whose contraction can be
+    // affected by a changed edge are contracted again:
+    //  - the end points of edges whose weight changed, or that were added or removed,
+    //  - nodes whose witness searches could have reached such an end point and
+    //  - the upward cone of these nodes, i.e. all end points of shortcuts that changed on the way.
+    // Shortcuts of the previous hierarchy are never dropped, so repeated updates can accumulate
+    // superfluous shortcuts. Prepare contracts all nodes again once the hierarchy grew by more
+    // than ContractorConfig::max_incremental_growth since the last full contraction.
+    void RunIncremental(const std::vector<QueryEdge> &previous_edges)
+    {
+        constexpr size_t IndependentGrainSize = 1;
+        constexpr size_t ContractGrainSize = 1;
+        constexpr size_t DeleteGrainSize = 1;
+
+        const NodeID number_of_nodes = contractor_graph->GetNumberOfNodes();
+        if (node_levels.size() != number_of_nodes)
+        {
+            throw util::exception("Node levels do not match the graph, run a full contraction");
+        }
+
+        std::vector<HierarchyEdge> previous_originals;
+        std::vector<HierarchyEdge> previous_shortcuts;
+        std::vector<QueryEdge> previous_shortcut_edges;
+        for (const auto &edge : previous_edges)
+        {
+            if (edge.source >= number_of_nodes || edge.target >= number_of_nodes ||
+                (edge.data.shortcut && edge.data.id >= number_of_nodes))
+            {
+                throw util::exception("Previous hierarchy does not match the graph, run a full "
+                                      "contraction");
+            }
+            if (edge.data.shortcut)
+            {
+                previous_shortcut_edges.push_back(edge);
+            }
+            auto &edges = edge.data.shortcut ? previous_shortcuts : previous_originals;
+            const NodeID via = edge.data.shortcut ? edge.data.id : SPECIAL_NODEID;
+            if (edge.data.forward)
+            {
+                edges.push_back({via, edge.source, edge.target, edge.data.distance});
+            }
+            if (edge.data.backward)
+            {
+                edges.push_back({via, edge.target, edge.source, edge.data.distance});
+            }
+        }
+        tbb::parallel_sort(previous_originals.begin(), previous_originals.end());
+        tbb::parallel_sort(previous_shortcuts.begin(), previous_shortcuts.end());
+
+        tbb::parallel_sort(previous_shortcut_edges.begin(), previous_shortcut_edges.end(),
+                           [](const QueryEdge &lhs, const QueryEdge &rhs)
+                           {
+                               return lhs.data.id < rhs.data.id;
+                           });
+
+        // the shortcuts of every node are consecutive in both lists
+        std::vector<std::size_t> shortcut_offsets(number_of_nodes + 1, 0);
+        std::vector<std::size_t> shortcut_edge_offsets(number_of_nodes + 1, 0);
+        for (const auto &shortcut : previous_shortcuts)
+        {
+            ++shortcut_offsets[shortcut.via + 1];
+        }
+        for (const auto &edge : previous_shortcut_edges)
+        {
+            ++shortcut_edge_offsets[edge.data.id + 1];
+        }
+        std::partial_sum(shortcut_offsets.begin(), shortcut_offsets.end(),
+                         shortcut_offsets.begin());
+        std::partial_sum(shortcut_edge_offsets.begin(), shortcut_edge_offsets.end(),
+                         shortcut_edge_offsets.begin());
+
+        std::vector<HierarchyEdge> current_originals;
+        for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+        {
+            for (auto edge : contractor_graph->GetAdjacentEdgeRange(node))
+            {
+                const ContractorEdgeData &data = contractor_graph->GetEdgeData(edge);
+                if (data.forward)
+                {
+                    current_originals.push_back({SPECIAL_NODEID, node,
+                                                 contractor_graph->GetTarget(edge),
+                                                 static_cast<int>(data.distance)});
+                }
+            }
+        }
+        tbb::parallel_sort(current_originals.begin(), current_originals.end());
+
+        std::vector<char> is_dirty(number_of_nodes, false);
+        MarkChangedEdges(previous_originals, current_originals, is_dirty);
+        previous_originals.clear();
+        previous_originals.shrink_to_fit();
+        current_originals.clear();
+        current_originals.shrink_to_fit();
+        MarkAffectedWitnessSearches(previous_edges, is_dirty);
+
+        std::vector<NodeID> contraction_order(number_of_nodes);
+        std::iota(contraction_order.begin(), contraction_order.end(), 0);
+        tbb::parallel_sort(contraction_order.begin(), contraction_order.end(),
+                           [this](const NodeID lhs, const NodeID rhs)
+                           {
+                               return std::tie(node_levels[lhs], lhs) <
+                                      std::tie(node_levels[rhs], rhs);
+                           });
+
+        std::cout << "incrementally preprocessing " << number_of_nodes << " nodes ..."
+                  << std::flush;
+        util::Percent p(number_of_nodes);
+        ThreadDataContainer thread_data_list(number_of_nodes);
+
+        // levels of this contraction, they differ from the previous ones if a level is split up
+        std::vector<float> contraction_levels(number_of_nodes);
+        unsigned current_level = 0;
+
+        NodeID number_of_contracted_nodes = 0;
+        NodeID number_of_recontracted_nodes = 0;
+        auto level_begin = contraction_order.begin();
+        while (level_begin != contraction_order.end())
+        {
+            const float level = node_levels[*level_begin];
+            const auto level_end = std::find_if(level_begin, contraction_order.end(),
+                                                [this, level](const NodeID node)
+                                                {
+                                                    return node_levels[node] != level;
+                                                });
+            std::vector<RemainingNodeData> remaining_nodes(std::distance(level_begin, level_end));
+            for (const auto position : util::irange<std::size_t>(0, remaining_nodes.size()))
+            {
+                remaining_nodes[position].id = *(level_begin + position);
+            }
+
+            // Nodes of the same level were independent in the previous hierarchy, but new
+            // shortcuts can connect them. The levels then act as priorities to split them up and
+            // the node levels are renumbered to match the new hierarchy.
+            while (!remaining_nodes.empty())
+            {
+                tbb::parallel_for(
+                    tbb::blocked_range<std::size_t>(0, remaining_nodes.size(),
+                                                    IndependentGrainSize),
+                    [this, &remaining_nodes,
+                     &thread_data_list](const tbb::blocked_range<std::size_t> &range)
+                    {
+                        ContractorThreadData *data = thread_data_list.getThreadData();
+                        for (auto i = range.begin(), end = range.end(); i != end; ++i)
+                        {
+                            const NodeID node = remaining_nodes[i].id;
+                            remaining_nodes[i].is_independent =
+                                this->IsNodeIndependent(node_levels, data, node);
+                        }
+                    });
+
+                const auto begin_independent_nodes =
+                    stable_partition(remaining_nodes.begin(), remaining_nodes.end(),
+                                     [](RemainingNodeData node_data)
+                                     {
+                                         return !node_data.is_independent;
+                                     });
+                const auto begin_independent_nodes_idx =
+                    std::distance(remaining_nodes.begin(), begin_independent_nodes);
+                const auto end_independent_nodes_idx = remaining_nodes.size();
+
+                tbb::parallel_for(
+                    tbb::blocked_range<std::size_t>(begin_independent_nodes_idx,
+                                                    end_independent_nodes_idx, ContractGrainSize),
+                    [&](const tbb::blocked_range<std::size_t> &range)
+                    {
+                        ContractorThreadData *data = thread_data_list.getThreadData();
+                        for (auto position = range.begin(), end = range.end(); position != end;
+                             ++position)
+                        {
+                            const NodeID x = remaining_nodes[position].id;
+                            if (is_dirty[x])
+                            {
+                                const std::size_t first_inserted_edge = data->inserted_edges.size();
+                                this->ContractNode<false>(data, x);
+                                this->KeepPreviousShortcuts(data, x, first_inserted_edge,
+                                                            previous_shortcuts, shortcut_offsets);
+                            }
+                            else
+                            {
+                                this->ReuseShortcuts(data, x, previous_shortcut_edges,
+                                                     shortcut_edge_offsets);
+                            }
+                        }
+                    });
+
+                tbb::parallel_for(
+                    tbb::blocked_range<std::size_t>(begin_independent_nodes_idx,
+                                                    end_independent_nodes_idx, DeleteGrainSize),
+                    [this, &remaining_nodes,
+                     &thread_data_list](const tbb::blocked_range<std::size_t> &range)
+                    {
+                        ContractorThreadData *data = thread_data_list.getThreadData();
+                        for (auto position = range.begin(), end = range.end(); position != end;
+                             ++position)
+                        {
+                            const NodeID x = remaining_nodes[position].id;
+                            this->DeleteIncomingEdges(data, x);
+                        }
+                    });
+
+                // the upward cone: shortcuts that differ from the previous hierarchy change the
+                // adjacency of their end points
+                for (auto &data : thread_data_list.data)
+                {
+                    for (const ContractorEdge &edge : data->inserted_edges)
+                    {
+                        if (!is_dirty[edge.data.id] || !edge.data.forward)
+                        {
+                            continue;
+                        }
+                        const HierarchyEdge shortcut{edge.data.id, edge.source, edge.target,
+                                                     static_cast<int>(edge.data.distance)};
+                        if (!std::binary_search(previous_shortcuts.begin(),
+                                                previous_shortcuts.end(), shortcut))
+                        {
+                            is_dirty[edge.source] = true;
+                            is_dirty[edge.target] = true;
+                        }
+                    }
+                }
+
+                for (const auto position : util::irange<std::size_t>(begin_independent_nodes_idx,
+                                                                     end_independent_nodes_idx))
+                {
+                    const NodeID x = remaining_nodes[position].id;
+                    number_of_recontracted_nodes += is_dirty[x];
+                    contraction_levels[x] = current_level;
+                }
+                ++current_level;
+
+                InsertShortcuts(thread_data_list);
+
+                number_of_contracted_nodes +=
+                    end_independent_nodes_idx - begin_independent_nodes_idx;
+                remaining_nodes.resize(begin_independent_nodes_idx);
+            }
+
+            p.printStatus(number_of_contracted_nodes);
+            level_begin = level_end;
+        }
+
+        node_levels.swap(contraction_levels);
+        // the previous hierarchy was fully contracted
+        is_core_node.clear();
+        thread_data_list.data.clear();
+
+        util::SimpleLogger().Write() << "Contracted " << number_of_recontracted_nodes << " of "
+                                     << number_of_nodes << " nodes again";
     }
 
     inline void GetCoreMarker(std::vector<bool> &out_is_core_node)
@@ -718,6 +1120,434 @@ class Contractor
     }
 
   private:
+    // Directed edge of a hierarchy, via is the contracted node of a shortcut
+    struct HierarchyEdge
+    {
+        NodeID via;
+        NodeID from;
+        NodeID to;
+        int distance;
+
+        bool operator<(const HierarchyEdge &rhs) const
+        {
+            return std::tie(via, from, to, distance) <
+                   std::tie(rhs.via, rhs.from, rhs.to, rhs.distance);
+        }
+    };
+
+    // Contractor of a single cell, it works on a copy of the subgraph of the cell
+    explicit Contractor(std::shared_ptr<ContractorGraph> graph) : contractor_graph(std::move(graph))
+    {
+    }
+
+    // Contracts the nodes of a cell that are no boundary nodes, but leaves the most expensive
+    // ones for the core. The edges of the contracted nodes go to the final hierarchy, the edges
+    // that remain between the other nodes to the core. Both use the node ids of the whole graph.
+    void ContractCell(const unsigned cell,
+                      const std::vector<unsigned> &node_cells,
+                      const std::vector<NodeID> &cell_nodes,
+                      const std::vector<NodeID> &cell_offsets,
+                      const std::vector<NodeID> &local_node_ids,
+                      const std::vector<char> &is_boundary_node,
+                      std::vector<char> &is_contracted_in_cell,
+                      std::vector<float> &cell_levels,
+                      std::vector<ContractorEdge> &core_edges,
+                      std::mutex &edges_mutex)
+    {
+        // the last nodes of a cell would get a shortcut between almost every pair of its boundary
+        // nodes, the witness searches on the core find better paths through other cells
+        constexpr double CellContractionFactor = 0.8;
+
+        const auto global_id = [&](const NodeID local_node)
+        {
+            return cell_nodes[cell_offsets[cell] + local_node];
+        };
+        const NodeID number_of_cell_nodes = cell_offsets[cell + 1] - cell_offsets[cell];
+
+        std::vector<ContractorEdge> edges;
+        std::vector<bool> is_pinned(number_of_cell_nodes);
+        NodeID number_of_inner_nodes = 0;
+        for (const auto local_node : util::irange<NodeID>(0, number_of_cell_nodes))
+        {
+            const NodeID node = global_id(local_node);
+            is_pinned[local_node] = is_boundary_node[node];
+            number_of_inner_nodes += !is_pinned[local_node];
+            for (auto edge : contractor_graph->GetAdjacentEdgeRange(node))
+            {
+                const NodeID target = contractor_graph->GetTarget(edge);
+                if (node_cells[target] == cell)
+                {
+                    edges.push_back(
+                        {local_node, local_node_ids[target], contractor_graph->GetEdgeData(edge)});
+                }
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        Contractor cell_contractor(
+            std::make_shared<ContractorGraph>(number_of_cell_nodes, edges));
+        edges.clear();
+        std::vector<bool> is_contracted;
+        std::vector<float> levels(number_of_cell_nodes, 0);
+        cell_contractor.ContractUnpinnedNodes(
+            is_pinned, static_cast<NodeID>(number_of_inner_nodes * CellContractionFactor),
+            is_contracted, levels);
+
+        const ContractorGraph &cell_graph = *cell_contractor.contractor_graph;
+        std::vector<QueryEdge> hierarchy_edges;
+        for (const auto local_node : util::irange<NodeID>(0, number_of_cell_nodes))
+        {
+            const NodeID node = global_id(local_node);
+            for (auto edge : cell_graph.GetAdjacentEdgeRange(local_node))
+            {
+                ContractorEdgeData data = cell_graph.GetEdgeData(edge);
+                if (data.shortcut)
+                {
+                    data.id = global_id(data.id);
+                }
+                const NodeID target = global_id(cell_graph.GetTarget(edge));
+                if (is_contracted[local_node])
+                {
+                    hierarchy_edges.push_back({node, target, data});
+                }
+                else
+                {
+                    edges.push_back({node, target, data});
+                }
+            }
+            if (is_contracted[local_node])
+            {
+                is_contracted_in_cell[node] = true;
+                cell_levels[node] = levels[local_node];
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(edges_mutex);
+        core_edges.insert(core_edges.end(), edges.begin(), edges.end());
+        for (const auto &edge : hierarchy_edges)
+        {
+            external_edge_list.push_back(edge);
+        }
+    }
+
+    // Contracts nodes that are not pinned one after another in the order of their priority until
+    // max_contracted_nodes are contracted, their level is their position in this order
+    void ContractUnpinnedNodes(const std::vector<bool> &is_pinned,
+                               const NodeID max_contracted_nodes,
+                               std::vector<bool> &is_contracted,
+                               std::vector<float> &levels)
+    {
+        const NodeID number_of_nodes = contractor_graph->GetNumberOfNodes();
+        ContractorThreadData data(number_of_nodes);
+        std::vector<NodePriorityData> node_data(number_of_nodes);
+        std::vector<float> priorities(number_of_nodes, 0);
+
+        using QueueEntry = std::pair<float, NodeID>;
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+        for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+        {
+            if (!is_pinned[node])
+            {
+                priorities[node] = EvaluateNodePriority(&data, &node_data[node], node);
+                queue.emplace(priorities[node], node);
+            }
+        }
+
+        is_contracted.assign(number_of_nodes, false);
+        unsigned current_level = 0;
+        while (!queue.empty() && current_level < max_contracted_nodes)
+        {
+            const NodeID node = queue.top().second;
+            const float priority = queue.top().first;
+            queue.pop();
+            // the priority changed after the node was queued
+            if (is_contracted[node] || priority != priorities[node])
+            {
+                continue;
+            }
+
+            ContractNode<false>(&data, node);
+            DeleteIncomingEdges(&data, node);
+            InsertShortcuts(data);
+            is_contracted[node] = true;
+            levels[node] = current_level++;
+
+            std::vector<NodeID> &neighbours = data.neighbours;
+            neighbours.clear();
+            for (auto edge : contractor_graph->GetAdjacentEdgeRange(node))
+            {
+                const NodeID u = contractor_graph->GetTarget(edge);
+                if (u == node || is_pinned[u])
+                {
+                    continue;
+                }
+                neighbours.push_back(u);
+                node_data[u].depth = std::max(node_data[node].depth + 1, node_data[u].depth);
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+            for (const NodeID u : neighbours)
+            {
+                priorities[u] = EvaluateNodePriority(&data, &node_data[u], u);
+                queue.emplace(priorities[u], u);
+            }
+        }
+    }
+
+    inline void InsertShortcuts(ThreadDataContainer &thread_data_list)
+    {
+        // make sure we really sort each block
+        tbb::parallel_for(thread_data_list.data.range(),
+                          [&](const ThreadDataContainer::EnumerableThreadData::range_type &range)
+                          {
+                              for (auto &data : range)
+                                  tbb::parallel_sort(data->inserted_edges.begin(),
+                                                     data->inserted_edges.end());
+                          });
+
+        // insert new edges
+        for (auto &data : thread_data_list.data)
+        {
+            InsertShortcuts(*data);
+        }
+    }
+
+    inline void InsertShortcuts(ContractorThreadData &data)
+    {
+        for (const ContractorEdge &edge : data.inserted_edges)
+        {
+            const EdgeID current_edge_ID = contractor_graph->FindEdge(edge.source, edge.target);
+            if (current_edge_ID < contractor_graph->EndEdges(edge.source))
+            {
+                ContractorGraph::EdgeData &current_data =
+                    contractor_graph->GetEdgeData(current_edge_ID);
+                if (current_data.shortcut && edge.data.forward == current_data.forward &&
+                    edge.data.backward == current_data.backward &&
+                    edge.data.distance < current_data.distance)
+                {
+                    // found a duplicate edge with smaller weight, update it.
+                    current_data = edge.data;
+                    continue;
+                }
+            }
+            contractor_graph->InsertEdge(edge.source, edge.target, edge.data);
+        }
+        data.inserted_edges.clear();
+    }
+
+    // Marks the end points of all edges that differ between both sorted lists
+    static void MarkChangedEdges(const std::vector<HierarchyEdge> &previous_edges,
+                                 const std::vector<HierarchyEdge> &current_edges,
+                                 std::vector<char> &is_dirty)
+    {
+        std::vector<HierarchyEdge> changed_edges;
+        std::set_symmetric_difference(previous_edges.begin(), previous_edges.end(),
+                                      current_edges.begin(), current_edges.end(),
+                                      std::back_inserter(changed_edges));
+        for (const auto &edge : changed_edges)
+        {
+            is_dirty[edge.from] = true;
+            is_dirty[edge.to] = true;
+        }
+    }
+
+    // Marks every node whose witness searches in the previous hierarchy could have used a changed
+    // edge. A witness from u to w that passes the end point a of a changed edge costs at least
+    // dist(u, a) + dist(a, w), which the witness search bounds by the path u -> node -> w.
+    // The distances are computed on the previous hierarchy without regard to direction and level,
+    // which only underestimates the distances seen by the witness searches.
+    void MarkAffectedWitnessSearches(const std::vector<QueryEdge> &previous_edges,
+                                     std::vector<char> &is_dirty) const
+    {
+        const NodeID number_of_nodes = is_dirty.size();
+
+        std::vector<std::size_t> adjacency_offsets(number_of_nodes + 1, 0);
+        std::vector<int> max_in_distance(number_of_nodes, 0);
+        std::vector<int> max_out_distance(number_of_nodes, 0);
+        for (const auto &edge : previous_edges)
+        {
+            ++adjacency_offsets[edge.source + 1];
+            ++adjacency_offsets[edge.target + 1];
+            if (edge.data.backward)
+            {
+                max_in_distance[edge.source] =
+                    std::max<int>(max_in_distance[edge.source], edge.data.distance);
+            }
+            if (edge.data.forward)
+            {
+                max_out_distance[edge.source] =
+                    std::max<int>(max_out_distance[edge.source], edge.data.distance);
+            }
+        }
+        std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(),
+                         adjacency_offsets.begin());
+
+        int max_witness_distance = 0;
+        for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+        {
+            max_witness_distance =
+                std::max(max_witness_distance, max_in_distance[node] + max_out_distance[node]);
+        }
+
+        std::vector<std::pair<NodeID, int>> adjacency(adjacency_offsets.back());
+        {
+            std::vector<std::size_t> positions(adjacency_offsets.begin(),
+                                               adjacency_offsets.end() - 1);
+            for (const auto &edge : previous_edges)
+            {
+                adjacency[positions[edge.source]++] = {edge.target, edge.data.distance};
+                adjacency[positions[edge.target]++] = {edge.source, edge.data.distance};
+            }
+        }
+
+        using DistanceHeap = util::BinaryHeap<NodeID, NodeID, int, ContractorHeapData,
+                                              util::ArrayStorage<NodeID, NodeID>>;
+        DistanceHeap heap(number_of_nodes);
+        for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+        {
+            if (is_dirty[node])
+            {
+                heap.Insert(node, 0, ContractorHeapData());
+            }
+        }
+
+        // nodes further away than any witness search are never relevant
+        std::vector<int> distance_to_change(number_of_nodes, max_witness_distance + 1);
+        while (!heap.Empty())
+        {
+            const NodeID node = heap.DeleteMin();
+            const int distance = heap.GetKey(node);
+            if (distance > max_witness_distance)
+            {
+                break;
+            }
+            distance_to_change[node] = distance;
+
+            for (const auto position :
+                 util::irange(adjacency_offsets[node], adjacency_offsets[node + 1]))
+            {
+                const NodeID to = adjacency[position].first;
+                const int to_distance = distance + adjacency[position].second;
+                if (!heap.WasInserted(to))
+                {
+                    heap.Insert(to, to_distance, ContractorHeapData());
+                }
+                else if (to_distance < heap.GetKey(to))
+                {
+                    heap.DecreaseKey(to, to_distance);
+                }
+            }
+        }
+
+        // slack of the closest in- and out-neighbour, a witness can only reach a changed edge
+        // if both add up to at most zero
+        std::vector<int> min_in_slack(number_of_nodes, std::numeric_limits<int>::max());
+        std::vector<int> min_out_slack(number_of_nodes, std::numeric_limits<int>::max());
+        for (const auto &edge : previous_edges)
+        {
+            const int slack = distance_to_change[edge.target] - edge.data.distance;
+            if (edge.data.backward)
+            {
+                min_in_slack[edge.source] = std::min(min_in_slack[edge.source], slack);
+            }
+            if (edge.data.forward)
+            {
+                min_out_slack[edge.source] = std::min(min_out_slack[edge.source], slack);
+            }
+        }
+        for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+        {
+            if (min_in_slack[node] != std::numeric_limits<int>::max() &&
+                min_out_slack[node] != std::numeric_limits<int>::max() &&
+                min_in_slack[node] + min_out_slack[node] <= 0)
+            {
+                is_dirty[node] = true;
+            }
+        }
+    }
+
+    // Queues the shortcuts that node created in the previous hierarchy
+    inline void ReuseShortcuts(ContractorThreadData *data,
+                               const NodeID node,
+                               const std::vector<QueryEdge> &previous_shortcuts,
+                               const std::vector<std::size_t> &shortcut_offsets) const
+    {
+        for (const auto position :
+             util::irange(shortcut_offsets[node], shortcut_offsets[node + 1]))
+        {
+            const QueryEdge &shortcut = previous_shortcuts[position];
+            data->inserted_edges.emplace_back(shortcut.source, shortcut.target,
+                                              shortcut.data.distance, 1, node, true,
+                                              shortcut.data.forward, shortcut.data.backward);
+            data->inserted_edges.emplace_back(shortcut.target, shortcut.source,
+                                              shortcut.data.distance, 1, node, true,
+                                              shortcut.data.backward, shortcut.data.forward);
+        }
+    }
+
+    // Adds the shortcuts of the previous hierarchy that a new contraction of the node did not
+    // create, weighted by their current path through the node. Keeping them makes sure that every
+    // witness path of the previous hierarchy still exists.
+    inline void KeepPreviousShortcuts(ContractorThreadData *data,
+                                      const NodeID node,
+                                      const std::size_t first_inserted_edge,
+                                      const std::vector<HierarchyEdge> &previous_shortcuts,
+                                      const std::vector<std::size_t> &shortcut_offsets) const
+    {
+        const std::size_t last_inserted_edge = data->inserted_edges.size();
+        for (const auto position :
+             util::irange(shortcut_offsets[node], shortcut_offsets[node + 1]))
+        {
+            const HierarchyEdge &shortcut = previous_shortcuts[position];
+            const auto begin = data->inserted_edges.begin() + first_inserted_edge;
+            const auto end = data->inserted_edges.begin() + last_inserted_edge;
+            const bool was_created = std::any_of(begin, end, [&shortcut](const ContractorEdge &edge)
+                                                 {
+                                                     return (edge.source == shortcut.from &&
+                                                             edge.target == shortcut.to &&
+                                                             edge.data.forward) ||
+                                                            (edge.source == shortcut.to &&
+                                                             edge.target == shortcut.from &&
+                                                             edge.data.backward);
+                                                 });
+            if (was_created)
+            {
+                continue;
+            }
+
+            unsigned in_distance = std::numeric_limits<unsigned>::max();
+            unsigned out_distance = std::numeric_limits<unsigned>::max();
+            for (auto edge : contractor_graph->GetAdjacentEdgeRange(node))
+            {
+                const ContractorEdgeData &edge_data = contractor_graph->GetEdgeData(edge);
+                const NodeID target = contractor_graph->GetTarget(edge);
+                if (target == shortcut.from && edge_data.backward)
+                {
+                    in_distance = std::min(in_distance, edge_data.distance);
+                }
+                if (target == shortcut.to && edge_data.forward)
+                {
+                    out_distance = std::min(out_distance, edge_data.distance);
+                }
+            }
+            if (in_distance == std::numeric_limits<unsigned>::max() ||
+                out_distance == std::numeric_limits<unsigned>::max())
+            {
+                // the path through the node does not exist anymore
+                continue;
+            }
+
+            const unsigned path_distance = in_distance + out_distance;
+            data->inserted_edges.emplace_back(shortcut.from, shortcut.to, path_distance, 1, node,
+                                              true, true, false);
+            data->inserted_edges.emplace_back(shortcut.to, shortcut.from, path_distance, 1, node,
+                                              true, false, true);
+        }
+    }
+
+    // One to many search from the source in the heap to all targets in it. A target is done
+    // once it is settled or reached by a witness, a path avoiding middleNode that is not longer
+    // than the one through it. The search stops as soon as all targets are done.
     inline void Dijkstra(const int max_distance,
                          const unsigned number_of_targets,
                          const int maxNodes,
@@ -778,7 +1608,18 @@ class Contractor
                 else if (to_distance < heap.GetKey(to))
                 {
                     heap.DecreaseKey(to, to_distance);
-                    heap.GetData(to).hop = current_hop;
+                    ContractorHeapData &to_data = heap.GetData(to);
+                    to_data.hop = current_hop;
+                    // found a witness, the target does not need to be settled anymore
+                    if (to_data.target && to_distance <= to_data.witness_distance)
+                    {
+                        to_data.target = false;
+                        ++number_of_targets_found;
+                        if (number_of_targets_found >= number_of_targets)
+                        {
+                            return;
+                        }
+                    }
                 }
             }
         }
@@ -818,6 +1659,27 @@ class Contractor
         int inserted_edges_size = data->inserted_edges.size();
         std::vector<ContractorEdge> &inserted_edges = data->inserted_edges;
 
+        // witnesses found when the priority of the node was simulated the last time
+        const bool use_witness_cache = RUNSIMULATION && !witness_cache.empty();
+        std::vector<WitnessCacheEntry> &witnesses = data->witnesses;
+        witnesses.clear();
+        const auto get_cached_witness =
+            [this, use_witness_cache, node](const NodeID source, const NodeID target)
+        {
+            if (!use_witness_cache)
+            {
+                return INT_MAX;
+            }
+            const auto &cached_witnesses = witness_cache[node];
+            const auto iter = std::lower_bound(cached_witnesses.begin(), cached_witnesses.end(),
+                                               WitnessCacheEntry(source, target, INT_MIN));
+            if (iter == cached_witnesses.end() || iter->source != source || iter->target != target)
+            {
+                return INT_MAX;
+            }
+            return iter->distance;
+        };
+
         for (auto in_edge : contractor_graph->GetAdjacentEdgeRange(node))
         {
             const ContractorEdgeData &in_data = contractor_graph->GetEdgeData(in_edge);
@@ -847,21 +1709,34 @@ class Contractor
                 }
                 const NodeID target = contractor_graph->GetTarget(out_edge);
                 const int path_distance = in_data.distance + out_data.distance;
+                if (get_cached_witness(source, target) <= path_distance)
+                {
+                    continue;
+                }
                 max_distance = std::max(max_distance, path_distance);
                 if (!heap.WasInserted(target))
                 {
-                    heap.Insert(target, INT_MAX, ContractorHeapData(0, true));
+                    heap.Insert(target, INT_MAX, ContractorHeapData(0, true, path_distance));
                     ++number_of_targets;
                 }
+                else
+                {
+                    ContractorHeapData &target_data = heap.GetData(target);
+                    target_data.witness_distance =
+                        std::min(target_data.witness_distance, path_distance);
+                }
             }
 
-            if (RUNSIMULATION)
-            {
-                Dijkstra(max_distance, number_of_targets, 1000, data, node);
-            }
-            else
+            if (0 < number_of_targets)
             {
-                Dijkstra(max_distance, number_of_targets, 2000, data, node);
+                if (RUNSIMULATION)
+                {
+                    Dijkstra(max_distance, number_of_targets, 1000, data, node);
+                }
+                else
+                {
+                    Dijkstra(max_distance, number_of_targets, 2000, data, node);
+                }
             }
             for (auto out_edge : contractor_graph->GetAdjacentEdgeRange(node))
             {
@@ -872,7 +1747,17 @@ class Contractor
                 }
                 const NodeID target = contractor_graph->GetTarget(out_edge);
                 const int path_distance = in_data.distance + out_data.distance;
+                const int cached_distance = get_cached_witness(source, target);
+                if (cached_distance <= path_distance)
+                {
+                    witnesses.emplace_back(source, target, cached_distance);
+                    continue;
+                }
                 const int distance = heap.GetKey(target);
+                if (use_witness_cache && distance <= path_distance)
+                {
+                    witnesses.emplace_back(source, target, distance);
+                }
                 if (path_distance < distance)
                 {
                     if (RUNSIMULATION)
@@ -931,6 +1816,11 @@ class Contractor
             }
             inserted_edges.resize(inserted_edges_size);
         }
+        if (use_witness_cache)
+        {
+            std::sort(witnesses.begin(), witnesses.end());
+            witness_cache[node].assign(witnesses.begin(), witnesses.end());
+        }
         return true;
     }
 
@@ -1072,6 +1962,8 @@ class Contractor
     std::vector<NodeID> orig_node_id_from_new_node_id_map;
     std::vector<float> node_levels;
     std::vector<bool> is_core_node;
+    // witnesses of the last priority simulation per node, empty if not cached
+    std::vector<std::vector<WitnessCacheEntry>> witness_cache;
     util::XORFastHash fast_hash;
 };
 }
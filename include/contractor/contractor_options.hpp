@@ -10,6 +10,10 @@ namespace osrm
 namespace contractor
 {
 
+// Smaller cells make most of their nodes boundary nodes, which leaves little to contract in
+// parallel and adds shortcuts: on a 100x100 grid cells of 200 nodes add 8% edges
+const constexpr unsigned MIN_PARTITION_CELL_SIZE = 1000;
+
 enum class return_code : unsigned
 {
     ok,
@@ -19,7 +23,11 @@ enum class return_code : unsigned
 
 struct ContractorConfig
 {
-    ContractorConfig() : requested_num_threads(0) {}
+    ContractorConfig()
+        : max_incremental_growth(0.05), requested_num_threads(0), partition_cell_size(0),
+          use_witness_cache(false)
+    {
+    }
 
     boost::filesystem::path config_file_path;
     boost::filesystem::path osrm_input_path;
@@ -29,10 +37,18 @@ struct ContractorConfig
     std::string core_output_path;
     std::string graph_output_path;
     std::string edge_based_graph_path;
+    std::string node_path;
+    std::string rtree_leaf_path;
+    std::string node_renumbering_path;
 
     std::string edge_segment_lookup_path;
     std::string edge_penalty_path;
     bool use_cached_priority;
+    // Reuse the hierarchy of the last run and only contract nodes affected by changed weights
+    bool use_incremental_contraction;
+    // Contract all nodes again once the hierarchy has grown by this fraction of the edges of the
+    // last full contraction, incremental contractions never drop superfluous shortcuts
+    double max_incremental_growth;
 
     unsigned requested_num_threads;
 
@@ -44,6 +60,18 @@ struct ContractorConfig
 
     std::string segment_speed_lookup_path;
 
+    // Order of the nodes in the .hsgr: "none" keeps the order of the .ebg, "level" sorts them by
+    // contraction level and "hilbert" along a space filling curve over their coordinates
+    std::string node_order;
+
+    // Number of nodes per cell when contracting the cells of a partition in parallel, 0 contracts
+    // the whole graph at once. osrm-prepare only partitions with cells of at least
+    // MIN_PARTITION_CELL_SIZE nodes and more than one thread, with a single thread it is no faster
+    unsigned partition_cell_size;
+
+    // Reuse the witnesses of the last priority update of a node for the next one
+    bool use_witness_cache;
+
 #ifdef DEBUG_GEOMETRY
     std::string debug_geometry_path;
 #endif
@@ -11,6 +11,8 @@
 
 #include <boost/filesystem.hpp>
 
+#include <cstdint>
+#include <string>
 #include <vector>
 
 struct lua_State;
@@ -44,10 +46,32 @@ class Prepare
                        util::DeallocatingVector<extractor::EdgeBasedEdge> &edge_based_edge_list,
                        util::DeallocatingVector<QueryEdge> &contracted_edge_list,
                        std::vector<bool> &is_core_node,
-                       std::vector<float> &node_levels) const;
+                       std::vector<float> &node_levels,
+                       const std::vector<QueryEdge> &previous_hierarchy,
+                       const std::vector<unsigned> &node_cells) const;
     void WriteCoreNodeMarker(std::vector<bool> &&is_core_node) const;
-    void WriteNodeLevels(std::vector<float> &&node_levels) const;
-    void ReadNodeLevels(std::vector<float> &contraction_order) const;
+    void WriteNodeLevels(std::vector<float> &&node_levels,
+                         const std::size_t full_hierarchy_size) const;
+    std::size_t ReadNodeLevels(std::vector<float> &contraction_order) const;
+    void ReadContractedGraph(const std::vector<NodeID> &previous_node_ids,
+                             std::vector<QueryEdge> &contracted_edge_list) const;
+    void ReadNodeRenumbering(std::vector<NodeID> &node_ids) const;
+    void WriteNodeRenumbering(const std::vector<NodeID> &node_ids,
+                              const std::string &node_renumbering_path) const;
+    std::vector<std::uint64_t>
+    ComputeHilbertValues(const unsigned number_of_nodes,
+                         const std::vector<NodeID> &previous_node_ids) const;
+    std::vector<unsigned> ComputePartition(const unsigned number_of_nodes,
+                                           const std::vector<NodeID> &previous_node_ids) const;
+    std::vector<NodeID> ComputeNodeOrder(const unsigned number_of_nodes,
+                                         const std::vector<NodeID> &previous_node_ids,
+                                         std::vector<float> &node_levels) const;
+    void RenumberNodes(const std::vector<NodeID> &new_node_ids,
+                       util::DeallocatingVector<QueryEdge> &contracted_edge_list,
+                       std::vector<bool> &is_core_node) const;
+    void UpdateRTreeNodeIDs(const std::vector<NodeID> &previous_node_ids,
+                            const std::vector<NodeID> &new_node_ids,
+                            const std::string &updated_rtree_leaf_path) const;
     std::size_t
     WriteContractedGraph(unsigned number_of_edge_based_nodes,
                          const util::DeallocatingVector<QueryEdge> &contracted_edge_list);
@@ -10,6 +10,32 @@ namespace osrm
 namespace contractor
 {
 
+// The query graph keeps the data of its edges in two arrays. A search relaxes an edge with its
+// target, weight and direction alone, only unpacking a path needs the id and the shortcut flag.
+struct QueryEdgeSearchData
+{
+    NodeID target;
+    int distance : 30;
+    bool forward : 1;
+    bool backward : 1;
+};
+
+struct QueryEdgeUnpackData
+{
+    // middle node of a shortcut, original edge id otherwise
+    NodeID id : 31;
+    bool shortcut : 1;
+};
+
+// The .hsgr stores both arrays as they are, a change of their size needs a new
+// HSGR_FORMAT_VERSION. Bit-fields of different types are not packed together on Windows.
+#ifndef _MSC_VER
+static_assert(sizeof(QueryEdgeSearchData) == 8,
+              "QueryEdgeSearchData is part of the .hsgr format, bump HSGR_FORMAT_VERSION");
+static_assert(sizeof(QueryEdgeUnpackData) == 4,
+              "QueryEdgeUnpackData is part of the .hsgr format, bump HSGR_FORMAT_VERSION");
+#endif
+
 struct QueryEdge
 {
     NodeID source;
@@ -26,6 +52,12 @@ struct QueryEdge
             forward = other.forward;
             backward = other.backward;
         }
+
+        EdgeData(const QueryEdgeSearchData &search_data, const QueryEdgeUnpackData &unpack_data)
+            : id(unpack_data.id), shortcut(unpack_data.shortcut), distance(search_data.distance),
+              forward(search_data.forward), backward(search_data.backward)
+        {
+        }
         NodeID id : 31;
         bool shortcut : 1;
         int distance : 30;
@@ -0,0 +1,149 @@
+#ifndef QUERY_GRAPH_HPP
+#define QUERY_GRAPH_HPP
+
+#include "contractor/query_edge.hpp"
+#include "util/integer_range.hpp"
+#include "util/shared_memory_vector_wrapper.hpp"
+#include "util/typedefs.hpp"
+
+#include <boost/assert.hpp>
+
+namespace osrm
+{
+namespace contractor
+{
+
+/**
+ * The contracted graph as it is queried. Like util::StaticGraph it stores the edges of a node
+ * consecutively, but it splits their data into a search array with targets, weights and
+ * direction flags and an unpack array with the shortcut flags and ids. Relaxing an edge thus
+ * reads 8 instead of 12 bytes and the ids only leave memory when a path gets unpacked.
+ */
+template <bool UseSharedMemory = false> class QueryGraph
+{
+  public:
+    using NodeIterator = NodeID;
+    using EdgeIterator = NodeID;
+    using EdgeData = QueryEdge::EdgeData;
+    using EdgeRange = util::range<EdgeIterator>;
+
+    struct NodeArrayEntry
+    {
+        // index of the first edge
+        EdgeIterator first_edge;
+    };
+
+    QueryGraph(typename util::ShM<NodeArrayEntry, UseSharedMemory>::vector &nodes,
+               typename util::ShM<QueryEdgeSearchData, UseSharedMemory>::vector &search_data,
+               typename util::ShM<QueryEdgeUnpackData, UseSharedMemory>::vector &unpack_data)
+    {
+        BOOST_ASSERT(search_data.size() == unpack_data.size());
+        number_of_nodes = static_cast<decltype(number_of_nodes)>(nodes.size() - 1);
+        number_of_edges = static_cast<decltype(number_of_edges)>(search_data.size());
+
+        node_array.swap(nodes);
+        search_array.swap(search_data);
+        unpack_array.swap(unpack_data);
+    }
+
+    unsigned GetNumberOfNodes() const { return number_of_nodes; }
+
+    unsigned GetNumberOfEdges() const { return number_of_edges; }
+
+    unsigned GetOutDegree(const NodeIterator n) const { return EndEdges(n) - BeginEdges(n); }
+
+    NodeIterator GetTarget(const EdgeIterator e) const { return search_array[e].target; }
+
+    const QueryEdgeSearchData &GetSearchData(const EdgeIterator e) const
+    {
+        return search_array[e];
+    }
+
+    const QueryEdgeUnpackData &GetUnpackData(const EdgeIterator e) const
+    {
+        return unpack_array[e];
+    }
+
+    EdgeData GetEdgeData(const EdgeIterator e) const
+    {
+        return EdgeData(search_array[e], unpack_array[e]);
+    }
+
+    EdgeIterator BeginEdges(const NodeIterator n) const
+    {
+        return EdgeIterator(node_array.at(n).first_edge);
+    }
+
+    EdgeIterator EndEdges(const NodeIterator n) const
+    {
+        return EdgeIterator(node_array.at(n + 1).first_edge);
+    }
+
+    EdgeRange GetAdjacentEdgeRange(const NodeID node) const
+    {
+        return util::irange(BeginEdges(node), EndEdges(node));
+    }
+
+    // searches for a specific edge
+    EdgeIterator FindEdge(const NodeIterator from, const NodeIterator to) const
+    {
+        for (const auto i : util::irange(BeginEdges(from), EndEdges(from)))
+        {
+            if (to == search_array[i].target)
+            {
+                return i;
+            }
+        }
+        return SPECIAL_EDGEID;
+    }
+
+    // searches for a specific edge
+    EdgeIterator FindSmallestEdge(const NodeIterator from, const NodeIterator to) const
+    {
+        EdgeIterator smallest_edge = SPECIAL_EDGEID;
+        EdgeWeight smallest_weight = INVALID_EDGE_WEIGHT;
+        for (auto edge : GetAdjacentEdgeRange(from))
+        {
+            const QueryEdgeSearchData &data = search_array[edge];
+            if (data.target == to && data.distance < smallest_weight)
+            {
+                smallest_edge = edge;
+                smallest_weight = data.distance;
+            }
+        }
+        return smallest_edge;
+    }
+
+    EdgeIterator FindEdgeInEitherDirection(const NodeIterator from, const NodeIterator to) const
+    {
+        EdgeIterator tmp = FindEdge(from, to);
+        return (SPECIAL_NODEID != tmp ? tmp : FindEdge(to, from));
+    }
+
+    EdgeIterator
+    FindEdgeIndicateIfReverse(const NodeIterator from, const NodeIterator to, bool &result) const
+    {
+        EdgeIterator current_iterator = FindEdge(from, to);
+        if (SPECIAL_NODEID == current_iterator)
+        {
+            current_iterator = FindEdge(to, from);
+            if (SPECIAL_NODEID != current_iterator)
+            {
+                result = true;
+            }
+        }
+        return current_iterator;
+    }
+
+  private:
+    NodeIterator number_of_nodes;
+    EdgeIterator number_of_edges;
+
+    typename util::ShM<NodeArrayEntry, UseSharedMemory>::vector node_array;
+    typename util::ShM<QueryEdgeSearchData, UseSharedMemory>::vector search_array;
+    typename util::ShM<QueryEdgeUnpackData, UseSharedMemory>::vector unpack_array;
+};
+}
+}
+
+#endif // QUERY_GRAPH_HPP
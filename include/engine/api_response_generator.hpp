@@ -7,6 +7,7 @@
 #include "engine/internal_route_result.hpp"
 #include "engine/object_encoder.hpp"
 #include "engine/phantom_node.hpp"
+#include "engine/polyline_compressor.hpp"
 #include "engine/polyline_formatter.hpp"
 #include "engine/route_name_extraction.hpp"
 #include "engine/segment_information.hpp"
@@ -15,6 +16,7 @@
 #include "osrm/json_container.hpp"
 #include "osrm/route_parameters.hpp"
 #include "util/integer_range.hpp"
+#include "util/json_writer.hpp"
 #include "util/typedefs.hpp"
 
 #include <boost/assert.hpp>
@@ -52,31 +54,44 @@ template <typename DataFacadeT> class ApiResponseGenerator
     ApiResponseGenerator(DataFacade *facade);
 
     // This runs a full annotation, according to config.
-    // The output is tailored to the viaroute plugin.
+    // The output is tailored to the viaroute plugin. The members are written into the object
+    // that is open on the writer, either a util::json::Writer or a util::json::TreeWriter.
+    template <typename WriterT>
+    void DescribeRoute(const RouteParameters &config,
+                       const InternalRouteResult &raw_route,
+                       WriterT &writer);
+
+    // Same as above, but the members are added to json_result
     void DescribeRoute(const RouteParameters &config,
                        const InternalRouteResult &raw_route,
                        util::json::Object &json_result);
 
     // The following functions allow access to the different parts of the Describe Route
-    // functionality.
+    // functionality, each of them writes a single value.
     // For own responses, they can be used to generate only subsets of the information.
     // In the normal situation, Describe Route is the desired usecase.
 
     // generate an overview of a raw route
-    util::json::Object SummarizeRoute(const InternalRouteResult &raw_route,
-                                      const Segments &segment_list) const;
+    template <typename WriterT>
+    void SummarizeRoute(const InternalRouteResult &raw_route,
+                        const Segments &segment_list,
+                        WriterT &writer) const;
 
     // create an array containing all via-points/-indices used in the query
-    util::json::Array ListViaPoints(const InternalRouteResult &raw_route) const;
-    util::json::Array ListViaIndices(const Segments &segment_list) const;
+    template <typename WriterT>
+    void ListViaPoints(const InternalRouteResult &raw_route, WriterT &writer) const;
+    template <typename WriterT>
+    void ListViaIndices(const Segments &segment_list, WriterT &writer) const;
 
-    util::json::Value GetGeometry(const bool return_encoded, const Segments &segments) const;
+    template <typename WriterT>
+    void GetGeometry(const bool return_encoded, const Segments &segments, WriterT &writer) const;
 
     // TODO this dedicated creation seems unnecessary? Only used for route names
     std::vector<Segment> BuildRouteSegments(const Segments &segment_list) const;
 
     // adds checksum and locations
-    util::json::Object BuildHintData(const InternalRouteResult &raw_route) const;
+    template <typename WriterT>
+    void BuildHintData(const InternalRouteResult &raw_route, WriterT &writer) const;
 
   private:
     // data access to translate ids back into names
@@ -93,6 +108,16 @@ template <typename DataFacadeT>
 void ApiResponseGenerator<DataFacadeT>::DescribeRoute(const RouteParameters &config,
                                                       const InternalRouteResult &raw_route,
                                                       util::json::Object &json_result)
+{
+    util::json::TreeWriter writer(json_result);
+    DescribeRoute(config, raw_route, writer);
+}
+
+template <typename DataFacadeT>
+template <typename WriterT>
+void ApiResponseGenerator<DataFacadeT>::DescribeRoute(const RouteParameters &config,
+                                                      const InternalRouteResult &raw_route,
+                                                      WriterT &writer)
 {
     if (!raw_route.is_valid())
     {
@@ -103,19 +128,23 @@ void ApiResponseGenerator<DataFacadeT>::DescribeRoute(const RouteParameters &con
     const constexpr bool EXTRACT_ALTERNATIVE = true;
     Segments segment_list(raw_route, EXTRACT_ROUTE, config.zoom_level, ALLOW_SIMPLIFICATION,
                           facade);
-    json_result.values["route_summary"] = SummarizeRoute(raw_route, segment_list);
-    json_result.values["via_points"] = ListViaPoints(raw_route);
-    json_result.values["via_indices"] = ListViaIndices(segment_list);
+    writer.Key("route_summary");
+    SummarizeRoute(raw_route, segment_list, writer);
+    writer.Key("via_points");
+    ListViaPoints(raw_route, writer);
+    writer.Key("via_indices");
+    ListViaIndices(segment_list, writer);
 
     if (config.geometry)
     {
-        json_result.values["route_geometry"] = GetGeometry(config.compression, segment_list);
+        writer.Key("route_geometry");
+        GetGeometry(config.compression, segment_list, writer);
     }
 
     if (config.print_instructions)
     {
-        json_result.values["route_instructions"] =
-            guidance::AnnotateRoute(segment_list.Get(), facade);
+        writer.Key("route_instructions");
+        writer.Value(guidance::AnnotateRoute(segment_list.Get(), facade));
     }
 
     RouteNames route_names;
@@ -127,28 +156,27 @@ void ApiResponseGenerator<DataFacadeT>::DescribeRoute(const RouteParameters &con
 
         // Alternative Route Summaries are stored in an array to (down the line) allow multiple
         // alternatives
-        util::json::Array json_alternate_route_summary_array;
-        json_alternate_route_summary_array.values.emplace_back(
-            SummarizeRoute(raw_route, alternate_segment_list));
-        json_result.values["alternative_summaries"] = json_alternate_route_summary_array;
-        json_result.values["alternative_indices"] = ListViaIndices(alternate_segment_list);
+        writer.Key("alternative_summaries");
+        writer.BeginArray();
+        SummarizeRoute(raw_route, alternate_segment_list, writer);
+        writer.EndArray();
+        writer.Key("alternative_indices");
+        ListViaIndices(alternate_segment_list, writer);
 
         if (config.geometry)
         {
-            auto alternate_geometry_string =
-                GetGeometry(config.compression, alternate_segment_list);
-            util::json::Array json_alternate_geometries_array;
-            json_alternate_geometries_array.values.emplace_back(
-                std::move(alternate_geometry_string));
-            json_result.values["alternative_geometries"] = json_alternate_geometries_array;
+            writer.Key("alternative_geometries");
+            writer.BeginArray();
+            GetGeometry(config.compression, alternate_segment_list, writer);
+            writer.EndArray();
         }
 
         if (config.print_instructions)
         {
-            util::json::Array json_alternate_annotations_array;
-            json_alternate_annotations_array.values.emplace_back(
-                guidance::AnnotateRoute(alternate_segment_list.Get(), facade));
-            json_result.values["alternative_instructions"] = json_alternate_annotations_array;
+            writer.Key("alternative_instructions");
+            writer.BeginArray();
+            writer.Value(guidance::AnnotateRoute(alternate_segment_list.Get(), facade));
+            writer.EndArray();
         }
 
         // generate names for both the main path and the alternative route
@@ -156,94 +184,119 @@ void ApiResponseGenerator<DataFacadeT>::DescribeRoute(const RouteParameters &con
         auto alternate_segments = BuildRouteSegments(alternate_segment_list);
         route_names = extractRouteNames(path_segments, alternate_segments, facade);
 
-        util::json::Array json_alternate_names_array;
-        util::json::Array json_alternate_names;
-        json_alternate_names.values.push_back(route_names.alternative_path_name_1);
-        json_alternate_names.values.push_back(route_names.alternative_path_name_2);
-        json_alternate_names_array.values.emplace_back(std::move(json_alternate_names));
-        json_result.values["alternative_names"] = json_alternate_names_array;
-        json_result.values["found_alternative"] = util::json::True();
+        writer.Key("alternative_names");
+        writer.BeginArray();
+        writer.BeginArray();
+        writer.String(route_names.alternative_path_name_1);
+        writer.String(route_names.alternative_path_name_2);
+        writer.EndArray();
+        writer.EndArray();
+        writer.Key("found_alternative");
+        writer.Bool(true);
     }
     else
     {
-        json_result.values["found_alternative"] = util::json::False();
+        writer.Key("found_alternative");
+        writer.Bool(false);
         // generate names for the main route on its own
         auto path_segments = BuildRouteSegments(segment_list);
         std::vector<detail::Segment> alternate_segments;
         route_names = extractRouteNames(path_segments, alternate_segments, facade);
     }
 
-    util::json::Array json_route_names;
-    json_route_names.values.push_back(route_names.shortest_path_name_1);
-    json_route_names.values.push_back(route_names.shortest_path_name_2);
-    json_result.values["route_name"] = json_route_names;
+    writer.Key("route_name");
+    writer.BeginArray();
+    writer.String(route_names.shortest_path_name_1);
+    writer.String(route_names.shortest_path_name_2);
+    writer.EndArray();
 
-    json_result.values["hint_data"] = BuildHintData(raw_route);
+    writer.Key("hint_data");
+    BuildHintData(raw_route, writer);
 }
 
 template <typename DataFacadeT>
-util::json::Object
-ApiResponseGenerator<DataFacadeT>::SummarizeRoute(const InternalRouteResult &raw_route,
-                                                  const Segments &segment_list) const
+template <typename WriterT>
+void ApiResponseGenerator<DataFacadeT>::SummarizeRoute(const InternalRouteResult &raw_route,
+                                                       const Segments &segment_list,
+                                                       WriterT &writer) const
 {
-    util::json::Object json_route_summary;
+    writer.BeginObject();
     if (!raw_route.segment_end_coordinates.empty())
     {
         const auto start_name_id = raw_route.segment_end_coordinates.front().source_phantom.name_id;
-        json_route_summary.values["start_point"] = facade->get_name_for_id(start_name_id);
+        writer.Key("start_point");
+        writer.String(facade->get_name_for_id(start_name_id));
         const auto destination_name_id =
             raw_route.segment_end_coordinates.back().target_phantom.name_id;
-        json_route_summary.values["end_point"] = facade->get_name_for_id(destination_name_id);
+        writer.Key("end_point");
+        writer.String(facade->get_name_for_id(destination_name_id));
     }
-    json_route_summary.values["total_time"] = segment_list.GetDuration();
-    json_route_summary.values["total_distance"] = segment_list.GetDistance();
-    return json_route_summary;
+    writer.Key("total_time");
+    writer.Number(segment_list.GetDuration());
+    writer.Key("total_distance");
+    writer.Number(segment_list.GetDistance());
+    writer.EndObject();
 }
 
 template <typename DataFacadeT>
-util::json::Array
-ApiResponseGenerator<DataFacadeT>::ListViaPoints(const InternalRouteResult &raw_route) const
+template <typename WriterT>
+void ApiResponseGenerator<DataFacadeT>::ListViaPoints(const InternalRouteResult &raw_route,
+                                                      WriterT &writer) const
 {
-    util::json::Array json_via_points_array;
-    util::json::Array json_first_coordinate;
-    json_first_coordinate.values.emplace_back(
-        raw_route.segment_end_coordinates.front().source_phantom.location.lat /
-        COORDINATE_PRECISION);
-    json_first_coordinate.values.emplace_back(
-        raw_route.segment_end_coordinates.front().source_phantom.location.lon /
-        COORDINATE_PRECISION);
-    json_via_points_array.values.emplace_back(std::move(json_first_coordinate));
+    const auto write_location = [&writer](const util::FixedPointCoordinate &location)
+    {
+        writer.BeginArray();
+        writer.Number(location.lat / COORDINATE_PRECISION);
+        writer.Number(location.lon / COORDINATE_PRECISION);
+        writer.EndArray();
+    };
+
+    writer.BeginArray();
+    write_location(raw_route.segment_end_coordinates.front().source_phantom.location);
     for (const PhantomNodes &nodes : raw_route.segment_end_coordinates)
     {
-        std::string tmp;
-        util::json::Array json_coordinate;
-        json_coordinate.values.emplace_back(nodes.target_phantom.location.lat /
-                                            COORDINATE_PRECISION);
-        json_coordinate.values.emplace_back(nodes.target_phantom.location.lon /
-                                            COORDINATE_PRECISION);
-        json_via_points_array.values.emplace_back(std::move(json_coordinate));
+        write_location(nodes.target_phantom.location);
     }
-    return json_via_points_array;
+    writer.EndArray();
 }
 
 template <typename DataFacadeT>
-util::json::Array
-ApiResponseGenerator<DataFacadeT>::ListViaIndices(const Segments &segment_list) const
+template <typename WriterT>
+void ApiResponseGenerator<DataFacadeT>::ListViaIndices(const Segments &segment_list,
+                                                       WriterT &writer) const
 {
-    util::json::Array via_indices;
-    via_indices.values.insert(via_indices.values.end(), segment_list.GetViaIndices().begin(),
-                              segment_list.GetViaIndices().end());
-    return via_indices;
+    writer.BeginArray();
+    for (const auto via_index : segment_list.GetViaIndices())
+    {
+        writer.Number(via_index);
+    }
+    writer.EndArray();
 }
 
 template <typename DataFacadeT>
-util::json::Value ApiResponseGenerator<DataFacadeT>::GetGeometry(const bool return_encoded,
-                                                                 const Segments &segments) const
+template <typename WriterT>
+void ApiResponseGenerator<DataFacadeT>::GetGeometry(const bool return_encoded,
+                                                    const Segments &segments,
+                                                    WriterT &writer) const
 {
     if (return_encoded)
-        return polylineEncodeAsJSON(segments.Get());
-    else
-        return polylineUnencodedAsJSON(segments.Get());
+    {
+        writer.String(polylineEncode(segments.Get()));
+        return;
+    }
+
+    writer.BeginArray();
+    for (const auto &segment : segments.Get())
+    {
+        if (segment.necessary)
+        {
+            writer.BeginArray();
+            writer.Number(segment.location.lat / COORDINATE_PRECISION);
+            writer.Number(segment.location.lon / COORDINATE_PRECISION);
+            writer.EndArray();
+        }
+    }
+    writer.EndArray();
 }
 
 template <typename DataFacadeT>
@@ -268,23 +321,25 @@ ApiResponseGenerator<DataFacadeT>::BuildRouteSegments(const Segments &segment_li
 }
 
 template <typename DataFacadeT>
-util::json::Object
-ApiResponseGenerator<DataFacadeT>::BuildHintData(const InternalRouteResult &raw_route) const
+template <typename WriterT>
+void ApiResponseGenerator<DataFacadeT>::BuildHintData(const InternalRouteResult &raw_route,
+                                                      WriterT &writer) const
 {
-    util::json::Object json_hint_object;
-    json_hint_object.values["checksum"] = facade->GetCheckSum();
-    util::json::Array json_location_hint_array;
+    writer.BeginObject();
+    writer.Key("checksum");
+    writer.Number(facade->GetCheckSum());
+    writer.Key("locations");
+    writer.BeginArray();
     std::string hint;
-    for (const auto i : util::irange<std::size_t>(0, raw_route.segment_end_coordinates.size()))
+    for (const auto &phantom_nodes : raw_route.segment_end_coordinates)
     {
-        ObjectEncoder::EncodeToBase64(raw_route.segment_end_coordinates[i].source_phantom, hint);
-        json_location_hint_array.values.push_back(hint);
+        ObjectEncoder::EncodeToBase64(phantom_nodes.source_phantom, hint);
+        writer.String(hint);
     }
     ObjectEncoder::EncodeToBase64(raw_route.segment_end_coordinates.back().target_phantom, hint);
-    json_location_hint_array.values.emplace_back(std::move(hint));
-    json_hint_object.values["locations"] = json_location_hint_array;
-
-    return json_hint_object;
+    writer.String(hint);
+    writer.EndArray();
+    writer.EndObject();
 }
 
 template <typename DataFacadeT>
@@ -3,11 +3,13 @@
 
 // Exposes all data access interfaces to the algorithms via base class ptr
 
+#include "contractor/query_edge.hpp"
 #include "extractor/edge_based_node.hpp"
 #include "extractor/external_memory_node.hpp"
 #include "engine/phantom_node.hpp"
 #include "extractor/turn_instructions.hpp"
 #include "util/integer_range.hpp"
+#include "util/layered_vector.hpp"
 #include "util/osrm_exception.hpp"
 #include "util/string_util.hpp"
 #include "util/typedefs.hpp"
@@ -43,7 +45,10 @@ template <class EdgeDataT> class BaseDataFacade
 
     virtual NodeID GetTarget(const EdgeID e) const = 0;
 
-    virtual const EdgeDataT &GetEdgeData(const EdgeID e) const = 0;
+    // the part of an edge that is read while relaxing it
+    virtual const contractor::QueryEdgeSearchData &GetSearchData(const EdgeID e) const = 0;
+
+    virtual EdgeDataT GetEdgeData(const EdgeID e) const = 0;
 
     virtual EdgeID BeginEdges(const NodeID n) const = 0;
 
@@ -79,6 +84,12 @@ template <class EdgeDataT> class BaseDataFacade
                                const int bearing = 0,
                                const int bearing_range = 180) = 0;
 
+    virtual void
+    NearestPhantomNodesInRanges(const std::vector<util::FixedPointCoordinate> &input_coordinates,
+                                const std::vector<double> &max_distances,
+                                const std::vector<std::pair<int, int>> &bearings,
+                                util::LayeredVector<PhantomNodeWithDistance> &phantom_nodes) = 0;
+
     virtual std::vector<PhantomNodeWithDistance>
     NearestPhantomNodes(const util::FixedPointCoordinate &input_coordinate,
                         const unsigned max_results,
@@ -9,18 +9,22 @@
 #include "extractor/original_edge_data.hpp"
 #include "extractor/query_node.hpp"
 #include "contractor/query_edge.hpp"
+#include "contractor/query_graph.hpp"
 #include "util/shared_memory_vector_wrapper.hpp"
-#include "util/static_graph.hpp"
 #include "util/static_rtree.hpp"
 #include "util/range_table.hpp"
 #include "util/graph_loader.hpp"
+#include "util/mapped_file_reader.hpp"
 #include "util/simple_logger.hpp"
+#include "util/timing_util.hpp"
 
 #include "osrm/coordinate.hpp"
 
-#include <boost/thread.hpp>
+#include <tbb/task_group.h>
 
 #include <limits>
+#include <memory>
+#include <string>
 
 namespace osrm
 {
@@ -34,8 +38,7 @@ template <class EdgeDataT> class InternalDataFacade final : public BaseDataFacad
 
   private:
     using super = BaseDataFacade<EdgeDataT>;
-    using QueryGraph = util::StaticGraph<typename super::EdgeData>;
-    using InputEdge = typename QueryGraph::InputEdge;
+    using QueryGraph = contractor::QueryGraph<false>;
     using RTreeLeaf = typename super::RTreeLeaf;
     using InternalRTree =
         util::StaticRTree<RTreeLeaf, util::ShM<util::FixedPointCoordinate, false>::vector, false>;
@@ -59,10 +62,11 @@ template <class EdgeDataT> class InternalDataFacade final : public BaseDataFacad
     util::ShM<unsigned, false>::vector m_geometry_list;
     util::ShM<bool, false>::vector m_is_core_node;
 
-    boost::thread_specific_ptr<InternalRTree> m_static_rtree;
-    boost::thread_specific_ptr<InternalGeospatialQuery> m_geospatial_query;
+    std::unique_ptr<InternalRTree> m_static_rtree;
+    std::unique_ptr<InternalGeospatialQuery> m_geospatial_query;
     boost::filesystem::path ram_index_path;
     boost::filesystem::path file_index_path;
+    util::LeafStorage m_leaf_storage;
     util::RangeTable<16, false> m_name_table;
 
     void LoadTimestamp(const boost::filesystem::path &timestamp_path)
@@ -91,81 +95,69 @@ template <class EdgeDataT> class InternalDataFacade final : public BaseDataFacad
     void LoadGraph(const boost::filesystem::path &hsgr_path)
     {
         typename util::ShM<typename QueryGraph::NodeArrayEntry, false>::vector node_list;
-        typename util::ShM<typename QueryGraph::EdgeArrayEntry, false>::vector edge_list;
+        typename util::ShM<contractor::QueryEdgeSearchData, false>::vector search_list;
+        typename util::ShM<contractor::QueryEdgeUnpackData, false>::vector unpack_list;
 
         util::SimpleLogger().Write() << "loading graph from " << hsgr_path.string();
 
-        m_number_of_nodes = readHSGRFromStream(hsgr_path, node_list, edge_list, &m_check_sum);
+        m_number_of_nodes =
+            util::readHSGRFromStream(hsgr_path, node_list, search_list, unpack_list, &m_check_sum);
 
         BOOST_ASSERT_MSG(0 != node_list.size(), "node list empty");
-        // BOOST_ASSERT_MSG(0 != edge_list.size(), "edge list empty");
+        // BOOST_ASSERT_MSG(0 != search_list.size(), "edge list empty");
         util::SimpleLogger().Write() << "loaded " << node_list.size() << " nodes and "
-                                     << edge_list.size() << " edges";
-        m_query_graph = std::unique_ptr<QueryGraph>(new QueryGraph(node_list, edge_list));
+                                     << search_list.size() << " edges";
+        m_query_graph =
+            std::unique_ptr<QueryGraph>(new QueryGraph(node_list, search_list, unpack_list));
 
         BOOST_ASSERT_MSG(0 == node_list.size(), "node list not flushed");
-        BOOST_ASSERT_MSG(0 == edge_list.size(), "edge list not flushed");
+        BOOST_ASSERT_MSG(0 == search_list.size(), "edge list not flushed");
         util::SimpleLogger().Write() << "Data checksum is " << m_check_sum;
     }
 
-    void LoadNodeAndEdgeInformation(const boost::filesystem::path &nodes_file,
-                                    const boost::filesystem::path &edges_file)
+    void LoadNodeInformation(const boost::filesystem::path &nodes_file)
     {
-        boost::filesystem::ifstream nodes_input_stream(nodes_file, std::ios::binary);
+        util::MappedFileReader nodes_reader(nodes_file);
 
-        extractor::QueryNode current_node;
-        unsigned number_of_coordinates = 0;
-        nodes_input_stream.read((char *)&number_of_coordinates, sizeof(unsigned));
+        const unsigned number_of_coordinates = nodes_reader.Read<unsigned>();
         m_coordinate_list =
             std::make_shared<std::vector<util::FixedPointCoordinate>>(number_of_coordinates);
         for (unsigned i = 0; i < number_of_coordinates; ++i)
         {
-            nodes_input_stream.read((char *)&current_node, sizeof(extractor::QueryNode));
-            m_coordinate_list->at(i) =
+            const auto current_node = nodes_reader.Read<extractor::QueryNode>();
+            (*m_coordinate_list)[i] =
                 util::FixedPointCoordinate(current_node.lat, current_node.lon);
-            BOOST_ASSERT((std::abs(m_coordinate_list->at(i).lat) >> 30) == 0);
-            BOOST_ASSERT((std::abs(m_coordinate_list->at(i).lon) >> 30) == 0);
+            BOOST_ASSERT((std::abs((*m_coordinate_list)[i].lat) >> 30) == 0);
+            BOOST_ASSERT((std::abs((*m_coordinate_list)[i].lon) >> 30) == 0);
         }
-        nodes_input_stream.close();
+    }
+
+    void LoadEdgeInformation(const boost::filesystem::path &edges_file)
+    {
+        util::MappedFileReader edges_reader(edges_file);
 
-        boost::filesystem::ifstream edges_input_stream(edges_file, std::ios::binary);
-        unsigned number_of_edges = 0;
-        edges_input_stream.read((char *)&number_of_edges, sizeof(unsigned));
+        const unsigned number_of_edges = edges_reader.Read<unsigned>();
         m_via_node_list.resize(number_of_edges);
         m_name_ID_list.resize(number_of_edges);
         m_turn_instruction_list.resize(number_of_edges);
         m_travel_mode_list.resize(number_of_edges);
         m_edge_is_compressed.resize(number_of_edges);
 
-        unsigned compressed = 0;
-
-        extractor::OriginalEdgeData current_edge_data;
         for (unsigned i = 0; i < number_of_edges; ++i)
         {
-            edges_input_stream.read((char *)&(current_edge_data),
-                                    sizeof(extractor::OriginalEdgeData));
+            const auto current_edge_data = edges_reader.Read<extractor::OriginalEdgeData>();
             m_via_node_list[i] = current_edge_data.via_node;
             m_name_ID_list[i] = current_edge_data.name_id;
             m_turn_instruction_list[i] = current_edge_data.turn_instruction;
             m_travel_mode_list[i] = current_edge_data.travel_mode;
             m_edge_is_compressed[i] = current_edge_data.compressed_geometry;
-            if (m_edge_is_compressed[i])
-            {
-                ++compressed;
-            }
         }
-
-        edges_input_stream.close();
     }
 
     void LoadCoreInformation(const boost::filesystem::path &core_data_file)
     {
-        std::ifstream core_stream(core_data_file.string().c_str(), std::ios::binary);
-        unsigned number_of_markers;
-        core_stream.read((char *)&number_of_markers, sizeof(unsigned));
-
-        std::vector<char> unpacked_core_markers(number_of_markers);
-        core_stream.read((char *)unpacked_core_markers.data(), sizeof(char) * number_of_markers);
+        util::MappedFileReader core_reader(core_data_file);
+        const unsigned number_of_markers = core_reader.Read<unsigned>();
 
         // in this case we have nothing to do
         if (number_of_markers <= 0)
@@ -176,44 +168,32 @@ template <class EdgeDataT> class InternalDataFacade final : public BaseDataFacad
         m_is_core_node.resize(number_of_markers);
         for (auto i = 0u; i < number_of_markers; ++i)
         {
-            BOOST_ASSERT(unpacked_core_markers[i] == 0 || unpacked_core_markers[i] == 1);
-            m_is_core_node[i] = unpacked_core_markers[i] == 1;
+            const char is_core = core_reader.Read<char>();
+            BOOST_ASSERT(is_core == 0 || is_core == 1);
+            m_is_core_node[i] = is_core == 1;
         }
     }
 
     void LoadGeometries(const boost::filesystem::path &geometry_file)
     {
-        std::ifstream geometry_stream(geometry_file.string().c_str(), std::ios::binary);
-        unsigned number_of_indices = 0;
-        unsigned number_of_compressed_geometries = 0;
-
-        geometry_stream.read((char *)&number_of_indices, sizeof(unsigned));
+        util::MappedFileReader geometry_reader(geometry_file);
 
+        const unsigned number_of_indices = geometry_reader.Read<unsigned>();
         m_geometry_indices.resize(number_of_indices);
-        if (number_of_indices > 0)
-        {
-            geometry_stream.read((char *)&(m_geometry_indices[0]),
-                                 number_of_indices * sizeof(unsigned));
-        }
-
-        geometry_stream.read((char *)&number_of_compressed_geometries, sizeof(unsigned));
+        geometry_reader.Read(m_geometry_indices.data(), number_of_indices);
 
+        const unsigned number_of_compressed_geometries = geometry_reader.Read<unsigned>();
         BOOST_ASSERT(m_geometry_indices.back() == number_of_compressed_geometries);
         m_geometry_list.resize(number_of_compressed_geometries);
-
-        if (number_of_compressed_geometries > 0)
-        {
-            geometry_stream.read((char *)&(m_geometry_list[0]),
-                                 number_of_compressed_geometries * sizeof(unsigned));
-        }
-        geometry_stream.close();
+        geometry_reader.Read(m_geometry_list.data(), number_of_compressed_geometries);
     }
 
     void LoadRTree()
     {
         BOOST_ASSERT_MSG(!m_coordinate_list->empty(), "coordinates must be loaded before r-tree");
 
-        m_static_rtree.reset(new InternalRTree(ram_index_path, file_index_path, m_coordinate_list));
+        m_static_rtree.reset(new InternalRTree(ram_index_path, file_index_path, m_coordinate_list,
+                                               m_leaf_storage));
         m_geospatial_query.reset(new InternalGeospatialQuery(*m_static_rtree, m_coordinate_list));
     }
 
@@ -236,14 +216,13 @@ template <class EdgeDataT> class InternalDataFacade final : public BaseDataFacad
     }
 
   public:
-    virtual ~InternalDataFacade()
-    {
-        m_static_rtree.reset();
-        m_geospatial_query.reset();
-    }
+    virtual ~InternalDataFacade() {}
 
     explicit InternalDataFacade(
-        const std::unordered_map<std::string, boost::filesystem::path> &server_paths)
+        const std::unordered_map<std::string, boost::filesystem::path> &server_paths,
+        const util::LeafStorage leaf_storage = util::LeafStorage::Stream,
+        const bool prefetch_rtree = false)
+        : m_leaf_storage(leaf_storage)
     {
         // cache end iterator to quickly check .find against
         const auto end_it = end(server_paths);
@@ -259,23 +238,48 @@ template <class EdgeDataT> class InternalDataFacade final : public BaseDataFacad
         ram_index_path = file_for("ramindex");
         file_index_path = file_for("fileindex");
 
-        util::SimpleLogger().Write() << "loading graph data";
-        LoadGraph(file_for("hsgrdata"));
-
-        util::SimpleLogger().Write() << "loading edge information";
-        LoadNodeAndEdgeInformation(file_for("nodesdata"), file_for("edgesdata"));
-
-        util::SimpleLogger().Write() << "loading core information";
-        LoadCoreInformation(file_for("coredata"));
-
-        util::SimpleLogger().Write() << "loading geometries";
-        LoadGeometries(file_for("geometries"));
-
-        util::SimpleLogger().Write() << "loading timestamp";
-        LoadTimestamp(file_for("timestamp"));
+        // every file fills its own members, so they are loaded in parallel
+        tbb::task_group load_tasks;
+        const auto load_async =
+            [this, &load_tasks](const std::string &what,
+                                void (InternalDataFacade::*loader)(const boost::filesystem::path &),
+                                const boost::filesystem::path &path)
+        {
+            load_tasks.run([this, what, loader, path]
+                           {
+                               TIMER_START(load_file);
+                               (this->*loader)(path);
+                               TIMER_STOP(load_file);
+                               util::SimpleLogger().Write() << "loaded " << what << " in "
+                                                            << TIMER_SEC(load_file) << " sec";
+                           });
+        };
 
-        util::SimpleLogger().Write() << "loading street names";
-        LoadStreetNames(file_for("namesdata"));
+        TIMER_START(load_data);
+        load_async("graph data", &InternalDataFacade::LoadGraph, file_for("hsgrdata"));
+        load_async("node information", &InternalDataFacade::LoadNodeInformation,
+                   file_for("nodesdata"));
+        load_async("edge information", &InternalDataFacade::LoadEdgeInformation,
+                   file_for("edgesdata"));
+        load_async("core information", &InternalDataFacade::LoadCoreInformation,
+                   file_for("coredata"));
+        load_async("geometries", &InternalDataFacade::LoadGeometries, file_for("geometries"));
+        load_async("timestamp", &InternalDataFacade::LoadTimestamp, file_for("timestamp"));
+        load_async("street names", &InternalDataFacade::LoadStreetNames, file_for("namesdata"));
+        load_tasks.wait();
+        TIMER_STOP(load_data);
+        util::SimpleLogger().Write() << "loaded all data in " << TIMER_SEC(load_data) << " sec";
+
+        // built once up front, all query threads share the tree
+        LoadRTree();
+        if (prefetch_rtree)
+        {
+            TIMER_START(prefetch);
+            m_static_rtree->Prefetch();
+            TIMER_STOP(prefetch);
+            util::SimpleLogger().Write() << "prefetched r-tree in " << TIMER_SEC(prefetch)
+                                         << " sec";
+        }
     }
 
     // search graph access
@@ -290,7 +294,12 @@ template <class EdgeDataT> class InternalDataFacade final : public BaseDataFacad
 
     NodeID GetTarget(const EdgeID e) const override final { return m_query_graph->GetTarget(e); }
 
-    EdgeDataT &GetEdgeData(const EdgeID e) const override final
+    const contractor::QueryEdgeSearchData &GetSearchData(const EdgeID e) const override final
+    {
+        return m_query_graph->GetSearchData(e);
+    }
+
+    EdgeDataT GetEdgeData(const EdgeID e) const override final
     {
         return m_query_graph->GetEdgeData(e);
     }
@@ -348,28 +357,30 @@ template <class EdgeDataT> class InternalDataFacade final : public BaseDataFacad
                                const int bearing = 0,
                                const int bearing_range = 180) override final
     {
-        if (!m_static_rtree.get())
-        {
-            LoadRTree();
-            BOOST_ASSERT(m_geospatial_query.get());
-        }
-
+        BOOST_ASSERT(m_geospatial_query.get());
         return m_geospatial_query->NearestPhantomNodesInRange(input_coordinate, max_distance,
                                                               bearing, bearing_range);
     }
 
+    void
+    NearestPhantomNodesInRanges(const std::vector<util::FixedPointCoordinate> &input_coordinates,
+                                const std::vector<double> &max_distances,
+                                const std::vector<std::pair<int, int>> &bearings,
+                                util::LayeredVector<PhantomNodeWithDistance> &phantom_nodes)
+        override final
+    {
+        BOOST_ASSERT(m_geospatial_query.get());
+        m_geospatial_query->NearestPhantomNodesInRanges(input_coordinates, max_distances, bearings,
+                                                        phantom_nodes);
+    }
+
     std::vector<PhantomNodeWithDistance>
     NearestPhantomNodes(const util::FixedPointCoordinate &input_coordinate,
                         const unsigned max_results,
                         const int bearing = 0,
                         const int bearing_range = 180) override final
     {
-        if (!m_static_rtree.get())
-        {
-            LoadRTree();
-            BOOST_ASSERT(m_geospatial_query.get());
-        }
-
+        BOOST_ASSERT(m_geospatial_query.get());
         return m_geospatial_query->NearestPhantomNodes(input_coordinate, max_results, bearing,
                                                        bearing_range);
     }
@@ -379,12 +390,7 @@ template <class EdgeDataT> class InternalDataFacade final : public BaseDataFacad
         const int bearing = 0,
         const int bearing_range = 180) override final
     {
-        if (!m_static_rtree.get())
-        {
-            LoadRTree();
-            BOOST_ASSERT(m_geospatial_query.get());
-        }
-
+        BOOST_ASSERT(m_geospatial_query.get());
         return m_geospatial_query->NearestPhantomNodeWithAlternativeFromBigComponent(
             input_coordinate, bearing, bearing_range);
     }
@@ -0,0 +1,477 @@
+#ifndef MAPPED_DATAFACADE_HPP
+#define MAPPED_DATAFACADE_HPP
+
+// implements all data storage when the dataset files are memory mapped
+
+#include "engine/datafacade/datafacade_base.hpp"
+
+#include "engine/geospatial_query.hpp"
+#include "extractor/original_edge_data.hpp"
+#include "extractor/query_node.hpp"
+#include "contractor/query_edge.hpp"
+#include "contractor/query_graph.hpp"
+#include "util/fingerprint.hpp"
+#include "util/graph_loader.hpp"
+#include "util/make_unique.hpp"
+#include "util/mapped_file_reader.hpp"
+#include "util/range_table.hpp"
+#include "util/shared_memory_vector_wrapper.hpp"
+#include "util/simple_logger.hpp"
+#include "util/static_rtree.hpp"
+#include "util/timing_util.hpp"
+
+#include "osrm/coordinate.hpp"
+
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace osrm
+{
+namespace engine
+{
+namespace datafacade
+{
+
+// Coordinates of the packed QueryNode records of a mapped .nodes file. The records follow a
+// four byte count and are thus not aligned for direct access, so every coordinate is copied out.
+class MappedCoordinateList
+{
+  public:
+    MappedCoordinateList() : nodes(nullptr), number_of_nodes(0) {}
+
+    MappedCoordinateList(const char *nodes, const std::size_t number_of_nodes)
+        : nodes(nodes), number_of_nodes(number_of_nodes)
+    {
+    }
+
+    util::FixedPointCoordinate at(const std::size_t index) const
+    {
+        BOOST_ASSERT(index < number_of_nodes);
+        extractor::QueryNode node;
+        std::memcpy(&node, nodes + index * sizeof(extractor::QueryNode),
+                    sizeof(extractor::QueryNode));
+        return util::FixedPointCoordinate(node.lat, node.lon);
+    }
+
+    std::size_t size() const { return number_of_nodes; }
+
+    bool empty() const { return 0 == number_of_nodes; }
+
+  private:
+    const char *nodes;
+    std::size_t number_of_nodes;
+};
+
+template <class EdgeDataT> class MappedDataFacade final : public BaseDataFacade<EdgeDataT>
+{
+
+  private:
+    using super = BaseDataFacade<EdgeDataT>;
+    using QueryGraph = contractor::QueryGraph<true>;
+    using GraphNode = typename QueryGraph::NodeArrayEntry;
+    using GraphSearchData = contractor::QueryEdgeSearchData;
+    using GraphUnpackData = contractor::QueryEdgeUnpackData;
+    using NameIndexBlock = typename util::RangeTable<16, true>::BlockT;
+    using RTreeLeaf = typename super::RTreeLeaf;
+    using MappedRTree = util::StaticRTree<RTreeLeaf, MappedCoordinateList, true>;
+    using MappedGeospatialQuery = GeospatialQuery<MappedRTree>;
+    using RTreeNode = typename MappedRTree::TreeNode;
+
+    unsigned m_check_sum;
+    std::unique_ptr<QueryGraph> m_query_graph;
+    std::string m_timestamp;
+
+    // the readers own the mappings all of the following point into
+    std::vector<std::unique_ptr<util::MappedFileReader>> m_mapped_files;
+
+    std::shared_ptr<MappedCoordinateList> m_coordinate_list;
+    util::ShM<extractor::OriginalEdgeData, true>::vector m_edge_data_list;
+    util::ShM<char, true>::vector m_names_char_list;
+    util::ShM<unsigned, true>::vector m_geometry_indices;
+    util::ShM<unsigned, true>::vector m_geometry_list;
+    util::ShM<char, true>::vector m_is_core_node;
+    std::unique_ptr<util::RangeTable<16, true>> m_name_table;
+
+    RTreeNode *m_search_tree;
+    uint64_t m_search_tree_size;
+    std::unique_ptr<MappedRTree> m_static_rtree;
+    std::unique_ptr<MappedGeospatialQuery> m_geospatial_query;
+    boost::filesystem::path file_index_path;
+    util::LeafStorage m_leaf_storage;
+
+    util::MappedFileReader &MapFile(const boost::filesystem::path &path)
+    {
+        m_mapped_files.emplace_back(util::make_unique<util::MappedFileReader>(path, false));
+        return *m_mapped_files.back();
+    }
+
+    template <typename T>
+    static typename util::ShM<T, true>::vector MapVector(util::MappedFileReader &reader,
+                                                         const std::size_t count)
+    {
+        // the mapping is read-only, the wrappers merely lack a const flavour
+        return typename util::ShM<T, true>::vector(const_cast<T *>(reader.Map<T>(count)), count);
+    }
+
+    void LoadTimestamp(const boost::filesystem::path &timestamp_path)
+    {
+        if (boost::filesystem::exists(timestamp_path))
+        {
+            util::SimpleLogger().Write() << "Loading Timestamp";
+            boost::filesystem::ifstream timestamp_stream(timestamp_path);
+            if (!timestamp_stream)
+            {
+                util::SimpleLogger().Write(logWARNING) << timestamp_path << " not found";
+            }
+            getline(timestamp_stream, m_timestamp);
+            timestamp_stream.close();
+        }
+        if (m_timestamp.empty())
+        {
+            m_timestamp = "n/a";
+        }
+        if (25 < m_timestamp.length())
+        {
+            m_timestamp.resize(25);
+        }
+    }
+
+    void LoadGraph(const boost::filesystem::path &hsgr_path)
+    {
+        util::SimpleLogger().Write() << "mapping graph from " << hsgr_path.string();
+        util::MappedFileReader &hsgr_reader = MapFile(hsgr_path);
+
+        const auto fingerprint_loaded = hsgr_reader.Read<util::FingerPrint>();
+        if (!fingerprint_loaded.TestGraphUtil(util::FingerPrint::GetValid()))
+        {
+            util::SimpleLogger().Write(logWARNING) << ".hsgr was prepared with different build.\n"
+                                                      "Reprocess to get rid of this warning.";
+        }
+        const unsigned format_version = hsgr_reader.Read<unsigned>();
+        if (format_version != util::HSGR_FORMAT_VERSION)
+        {
+            throw util::exception(".hsgr has format version " + std::to_string(format_version) +
+                                  ", expected " + std::to_string(util::HSGR_FORMAT_VERSION) +
+                                  ". Reprocess it with osrm-prepare.");
+        }
+        m_check_sum = hsgr_reader.Read<unsigned>();
+        const unsigned number_of_nodes = hsgr_reader.Read<unsigned>();
+        const unsigned number_of_edges = hsgr_reader.Read<unsigned>();
+        BOOST_ASSERT_MSG(0 != number_of_nodes, "node list empty");
+
+        auto node_list = MapVector<GraphNode>(hsgr_reader, number_of_nodes);
+        auto search_list = MapVector<GraphSearchData>(hsgr_reader, number_of_edges);
+        auto unpack_list = MapVector<GraphUnpackData>(hsgr_reader, number_of_edges);
+        m_query_graph.reset(new QueryGraph(node_list, search_list, unpack_list));
+
+        util::SimpleLogger().Write() << "mapped " << number_of_nodes << " nodes and "
+                                     << number_of_edges << " edges";
+        util::SimpleLogger().Write() << "Data checksum is " << m_check_sum;
+    }
+
+    void LoadNodeInformation(const boost::filesystem::path &nodes_file)
+    {
+        util::MappedFileReader &nodes_reader = MapFile(nodes_file);
+        const unsigned number_of_coordinates = nodes_reader.Read<unsigned>();
+        const char *nodes = nodes_reader.Map<char>(number_of_coordinates *
+                                                   sizeof(extractor::QueryNode));
+        m_coordinate_list = std::make_shared<MappedCoordinateList>(nodes, number_of_coordinates);
+    }
+
+    void LoadEdgeInformation(const boost::filesystem::path &edges_file)
+    {
+        util::MappedFileReader &edges_reader = MapFile(edges_file);
+        const unsigned number_of_edges = edges_reader.Read<unsigned>();
+        auto edge_data_list = MapVector<extractor::OriginalEdgeData>(edges_reader, number_of_edges);
+        m_edge_data_list.swap(edge_data_list);
+    }
+
+    void LoadCoreInformation(const boost::filesystem::path &core_data_file)
+    {
+        util::MappedFileReader &core_reader = MapFile(core_data_file);
+        const unsigned number_of_markers = core_reader.Read<unsigned>();
+        auto is_core_node = MapVector<char>(core_reader, number_of_markers);
+        m_is_core_node.swap(is_core_node);
+    }
+
+    void LoadGeometries(const boost::filesystem::path &geometry_file)
+    {
+        util::MappedFileReader &geometry_reader = MapFile(geometry_file);
+
+        const unsigned number_of_indices = geometry_reader.Read<unsigned>();
+        auto geometry_indices = MapVector<unsigned>(geometry_reader, number_of_indices);
+        m_geometry_indices.swap(geometry_indices);
+
+        const unsigned number_of_compressed_geometries = geometry_reader.Read<unsigned>();
+        BOOST_ASSERT(m_geometry_indices.at(number_of_indices - 1) ==
+                     number_of_compressed_geometries);
+        auto geometry_list = MapVector<unsigned>(geometry_reader, number_of_compressed_geometries);
+        m_geometry_list.swap(geometry_list);
+    }
+
+    void LoadStreetNames(const boost::filesystem::path &names_file)
+    {
+        util::MappedFileReader &names_reader = MapFile(names_file);
+
+        const unsigned number_of_blocks = names_reader.Read<unsigned>();
+        const unsigned sum_lengths = names_reader.Read<unsigned>();
+        auto name_offsets = MapVector<unsigned>(names_reader, number_of_blocks);
+        auto name_blocks = MapVector<NameIndexBlock>(names_reader, number_of_blocks);
+        m_name_table =
+            util::make_unique<util::RangeTable<16, true>>(name_offsets, name_blocks, sum_lengths);
+
+        const unsigned number_of_chars = names_reader.Read<unsigned>();
+        BOOST_ASSERT_MSG(0 != number_of_chars, "name file broken");
+        auto names_char_list = MapVector<char>(names_reader, number_of_chars);
+        m_names_char_list.swap(names_char_list);
+        if (0 == m_names_char_list.size())
+        {
+            util::SimpleLogger().Write(logWARNING) << "list of street names is empty";
+        }
+    }
+
+    void LoadSearchTree(const boost::filesystem::path &ram_index_file)
+    {
+        util::MappedFileReader &tree_reader = MapFile(ram_index_file);
+        const uint32_t tree_size = tree_reader.Read<uint32_t>();
+        m_search_tree = const_cast<RTreeNode *>(tree_reader.Map<RTreeNode>(tree_size));
+        m_search_tree_size = tree_size;
+        if (0 == m_search_tree_size)
+        {
+            throw util::exception("ram index file is empty");
+        }
+    }
+
+    void LoadRTree()
+    {
+        BOOST_ASSERT_MSG(!m_coordinate_list->empty(), "coordinates must be loaded before r-tree");
+
+        m_static_rtree.reset(new MappedRTree(m_search_tree, m_search_tree_size, file_index_path,
+                                             m_coordinate_list, m_leaf_storage));
+        m_geospatial_query.reset(new MappedGeospatialQuery(*m_static_rtree, m_coordinate_list));
+    }
+
+  public:
+    virtual ~MappedDataFacade() {}
+
+    explicit MappedDataFacade(
+        const std::unordered_map<std::string, boost::filesystem::path> &server_paths,
+        const util::LeafStorage leaf_storage = util::LeafStorage::Stream,
+        const bool prefetch_rtree = false)
+        : m_search_tree(nullptr), m_search_tree_size(0), m_leaf_storage(leaf_storage)
+    {
+        // cache end iterator to quickly check .find against
+        const auto end_it = end(server_paths);
+
+        const auto file_for = [&server_paths, &end_it](const std::string &path)
+        {
+            const auto it = server_paths.find(path);
+            if (it == end_it || !boost::filesystem::is_regular_file(it->second))
+                throw util::exception("no valid " + path + " file given in ini file");
+            return it->second;
+        };
+
+        file_index_path = file_for("fileindex");
+
+        // mapping only reads the headers, the pages are faulted in by the first queries
+        TIMER_START(map_data);
+        LoadGraph(file_for("hsgrdata"));
+        LoadNodeInformation(file_for("nodesdata"));
+        LoadEdgeInformation(file_for("edgesdata"));
+        LoadCoreInformation(file_for("coredata"));
+        LoadGeometries(file_for("geometries"));
+        LoadTimestamp(file_for("timestamp"));
+        LoadStreetNames(file_for("namesdata"));
+        LoadSearchTree(file_for("ramindex"));
+        TIMER_STOP(map_data);
+        util::SimpleLogger().Write() << "mapped all data in " << TIMER_SEC(map_data) << " sec";
+
+        // built once up front, all query threads share the tree
+        LoadRTree();
+        if (prefetch_rtree)
+        {
+            TIMER_START(prefetch);
+            m_static_rtree->Prefetch();
+            TIMER_STOP(prefetch);
+            util::SimpleLogger().Write() << "prefetched r-tree in " << TIMER_SEC(prefetch)
+                                         << " sec";
+        }
+    }
+
+    // search graph access
+    unsigned GetNumberOfNodes() const override final { return m_query_graph->GetNumberOfNodes(); }
+
+    unsigned GetNumberOfEdges() const override final { return m_query_graph->GetNumberOfEdges(); }
+
+    unsigned GetOutDegree(const NodeID n) const override final
+    {
+        return m_query_graph->GetOutDegree(n);
+    }
+
+    NodeID GetTarget(const EdgeID e) const override final { return m_query_graph->GetTarget(e); }
+
+    const contractor::QueryEdgeSearchData &GetSearchData(const EdgeID e) const override final
+    {
+        return m_query_graph->GetSearchData(e);
+    }
+
+    EdgeDataT GetEdgeData(const EdgeID e) const override final
+    {
+        return m_query_graph->GetEdgeData(e);
+    }
+
+    EdgeID BeginEdges(const NodeID n) const override final { return m_query_graph->BeginEdges(n); }
+
+    EdgeID EndEdges(const NodeID n) const override final { return m_query_graph->EndEdges(n); }
+
+    EdgeRange GetAdjacentEdgeRange(const NodeID node) const override final
+    {
+        return m_query_graph->GetAdjacentEdgeRange(node);
+    };
+
+    // searches for a specific edge
+    EdgeID FindEdge(const NodeID from, const NodeID to) const override final
+    {
+        return m_query_graph->FindEdge(from, to);
+    }
+
+    EdgeID FindEdgeInEitherDirection(const NodeID from, const NodeID to) const override final
+    {
+        return m_query_graph->FindEdgeInEitherDirection(from, to);
+    }
+
+    EdgeID
+    FindEdgeIndicateIfReverse(const NodeID from, const NodeID to, bool &result) const override final
+    {
+        return m_query_graph->FindEdgeIndicateIfReverse(from, to, result);
+    }
+
+    // node and edge information access
+    util::FixedPointCoordinate GetCoordinateOfNode(const NodeID id) const override final
+    {
+        return m_coordinate_list->at(id);
+    };
+
+    bool EdgeIsCompressed(const unsigned id) const override final
+    {
+        return m_edge_data_list.at(id).compressed_geometry;
+    }
+
+    unsigned GetGeometryIndexForEdgeID(const unsigned id) const override final
+    {
+        return m_edge_data_list.at(id).via_node;
+    }
+
+    void GetUncompressedGeometry(const unsigned id,
+                                 std::vector<unsigned> &result_nodes) const override final
+    {
+        const unsigned begin = m_geometry_indices.at(id);
+        const unsigned end = m_geometry_indices.at(id + 1);
+
+        result_nodes.clear();
+        result_nodes.insert(result_nodes.begin(), m_geometry_list.begin() + begin,
+                            m_geometry_list.begin() + end);
+    }
+
+    extractor::TurnInstruction GetTurnInstructionForEdgeID(const unsigned id) const override final
+    {
+        return m_edge_data_list.at(id).turn_instruction;
+    }
+
+    extractor::TravelMode GetTravelModeForEdgeID(const unsigned id) const override final
+    {
+        return m_edge_data_list.at(id).travel_mode;
+    }
+
+    std::vector<PhantomNodeWithDistance>
+    NearestPhantomNodesInRange(const util::FixedPointCoordinate &input_coordinate,
+                               const float max_distance,
+                               const int bearing = 0,
+                               const int bearing_range = 180) override final
+    {
+        BOOST_ASSERT(m_geospatial_query.get());
+        return m_geospatial_query->NearestPhantomNodesInRange(input_coordinate, max_distance,
+                                                              bearing, bearing_range);
+    }
+
+    void
+    NearestPhantomNodesInRanges(const std::vector<util::FixedPointCoordinate> &input_coordinates,
+                                const std::vector<double> &max_distances,
+                                const std::vector<std::pair<int, int>> &bearings,
+                                util::LayeredVector<PhantomNodeWithDistance> &phantom_nodes)
+        override final
+    {
+        BOOST_ASSERT(m_geospatial_query.get());
+        m_geospatial_query->NearestPhantomNodesInRanges(input_coordinates, max_distances, bearings,
+                                                        phantom_nodes);
+    }
+
+    std::vector<PhantomNodeWithDistance>
+    NearestPhantomNodes(const util::FixedPointCoordinate &input_coordinate,
+                        const unsigned max_results,
+                        const int bearing = 0,
+                        const int bearing_range = 180) override final
+    {
+        BOOST_ASSERT(m_geospatial_query.get());
+        return m_geospatial_query->NearestPhantomNodes(input_coordinate, max_results, bearing,
+                                                       bearing_range);
+    }
+
+    std::pair<PhantomNode, PhantomNode> NearestPhantomNodeWithAlternativeFromBigComponent(
+        const util::FixedPointCoordinate &input_coordinate,
+        const int bearing = 0,
+        const int bearing_range = 180) override final
+    {
+        BOOST_ASSERT(m_geospatial_query.get());
+        return m_geospatial_query->NearestPhantomNodeWithAlternativeFromBigComponent(
+            input_coordinate, bearing, bearing_range);
+    }
+
+    unsigned GetCheckSum() const override final { return m_check_sum; }
+
+    unsigned GetNameIndexFromEdgeID(const unsigned id) const override final
+    {
+        return m_edge_data_list.at(id).name_id;
+    };
+
+    std::string get_name_for_id(const unsigned name_id) const override final
+    {
+        if (std::numeric_limits<unsigned>::max() == name_id)
+        {
+            return "";
+        }
+        auto range = m_name_table->GetRange(name_id);
+
+        std::string result;
+        result.reserve(range.size());
+        if (range.begin() != range.end())
+        {
+            result.resize(range.back() - range.front() + 1);
+            std::copy(m_names_char_list.begin() + range.front(),
+                      m_names_char_list.begin() + range.back() + 1, result.begin());
+        }
+        return result;
+    }
+
+    bool IsCoreNode(const NodeID id) const override final
+    {
+        if (m_is_core_node.size() > 0)
+        {
+            return 1 == m_is_core_node.at(id);
+        }
+
+        return false;
+    }
+
+    std::size_t GetCoreSize() const override final { return m_is_core_node.size(); }
+
+    std::string GetTimestamp() const override final { return m_timestamp; }
+};
+}
+}
+}
+
+#endif // MAPPED_DATAFACADE_HPP
@@ -1,8 +1,17 @@
 #ifndef SHARED_BARRIERS_HPP
 #define SHARED_BARRIERS_HPP
 
+#include "datastore/shared_memory_factory.hpp"
+#include "engine/datafacade/shared_datatype.hpp"
+#include "util/simple_logger.hpp"
+
+#include <boost/assert.hpp>
 #include <boost/interprocess/sync/named_mutex.hpp>
-#include <boost/interprocess/sync/named_condition.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
 
 namespace osrm
 {
@@ -11,31 +20,107 @@ namespace engine
 namespace datafacade
 {
 
+// Registry of running queries that lives in shared memory.
+//
+// A query registers itself with a single atomic increment of a counter that is picked by its
+// thread and by the parity of the current generation, hence the query path never blocks.
+// osrm-datastore publishes new data regions first and then calls Synchronize(), which advances
+// the generation and waits for the counters of the previous generation to drain. Once it
+// returns, no query can still be looking at the regions that were current before the update.
+// This is the grace period of RCU [1] with a counter per generation instead of a per thread flag.
+struct SharedQueryRegistry
+{
+    static constexpr unsigned NUMBER_OF_SLOTS = 64;
+    static constexpr unsigned CACHE_LINE_SIZE = 64;
+
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "counters need to be address-free in shared memory");
+
+    // one counter per cache line so that threads do not contend on the same line
+    struct alignas(CACHE_LINE_SIZE) Slot
+    {
+        std::atomic<std::uint32_t> running_queries;
+    };
+
+    // Registers a query of the calling thread and returns the ticket needed for Leave()
+    std::uint32_t Enter()
+    {
+        const std::uint32_t ticket = (generation.load() & 1) * NUMBER_OF_SLOTS + ThreadSlot();
+        slots[ticket].running_queries.fetch_add(1);
+        return ticket;
+    }
+
+    void Leave(const std::uint32_t ticket)
+    {
+        BOOST_ASSERT(ticket < 2 * NUMBER_OF_SLOTS);
+        BOOST_ASSERT_MSG(0 < slots[ticket].running_queries.load(), "invalid number of queries");
+        slots[ticket].running_queries.fetch_sub(1);
+    }
+
+    // Blocks until every query that might have seen the previously published regions finished.
+    // Two generation flips are needed: a query registered under the older parity may still
+    // use the regions that were replaced by the update before this one.
+    void Synchronize()
+    {
+        for (unsigned phase = 0; phase < 2; ++phase)
+        {
+            const std::uint32_t previous_parity = generation.fetch_add(1) & 1;
+            for (unsigned slot = 0; slot < NUMBER_OF_SLOTS; ++slot)
+            {
+                WaitForSlot(slots[previous_parity * NUMBER_OF_SLOTS + slot]);
+            }
+        }
+    }
+
+  private:
+    static unsigned ThreadSlot()
+    {
+        static std::atomic<unsigned> next_slot{0};
+        static thread_local const unsigned slot = next_slot.fetch_add(1) % NUMBER_OF_SLOTS;
+        return slot;
+    }
+
+    static void WaitForSlot(const Slot &slot)
+    {
+        const auto wait_start = std::chrono::steady_clock::now();
+        auto next_warning = std::chrono::seconds(10);
+        while (0 != slot.running_queries.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (std::chrono::steady_clock::now() - wait_start > next_warning)
+            {
+                util::SimpleLogger().Write(logWARNING)
+                    << "still waiting for running queries to finish, run osrm-springclean "
+                       "if an osrm-routed process died while answering a query";
+                next_warning *= 2;
+            }
+        }
+    }
+
+    std::atomic<std::uint32_t> generation;
+    Slot slots[2 * NUMBER_OF_SLOTS];
+};
+
 struct SharedBarriers
 {
 
-    SharedBarriers()
-        : pending_update_mutex(boost::interprocess::open_or_create, "pending_update"),
-          update_mutex(boost::interprocess::open_or_create, "update"),
-          query_mutex(boost::interprocess::open_or_create, "query"),
-          no_running_queries_condition(boost::interprocess::open_or_create, "no_running_queries"),
-          update_ongoing(false), number_of_queries(0)
+    SharedBarriers() : update_mutex(boost::interprocess::open_or_create, "update")
     {
+        // A zero-initialized region is a valid registry. The memory object is deliberately
+        // never freed since that would remove the region while other processes still use it.
+        query_registry = static_cast<SharedQueryRegistry *>(
+            datastore::SharedMemoryFactory::Get(QUERY_REGISTRY, sizeof(SharedQueryRegistry), true,
+                                                false)
+                ->Ptr());
     }
 
-    // Mutex to protect access to the boolean variable
-    boost::interprocess::named_mutex pending_update_mutex;
+    // Serializes concurrent runs of osrm-datastore
     boost::interprocess::named_mutex update_mutex;
-    boost::interprocess::named_mutex query_mutex;
-
-    // Condition that no update is running
-    boost::interprocess::named_condition no_running_queries_condition;
 
-    // Is there an ongoing update?
-    bool update_ongoing;
-    // Is there any query?
-    int number_of_queries;
+    // Queries that are currently running on any of the shared data regions
+    SharedQueryRegistry *query_registry;
 };
+
+//[1] "Read-Copy Update"; P. McKenney, J. Slingwine; 1998; Ottawa Linux Symposium
 }
 }
 }
@@ -7,17 +7,16 @@
 #include "engine/datafacade/shared_datatype.hpp"
 
 #include "engine/geospatial_query.hpp"
+#include "contractor/query_graph.hpp"
 #include "util/range_table.hpp"
-#include "util/static_graph.hpp"
 #include "util/static_rtree.hpp"
 #include "util/make_unique.hpp"
 #include "util/simple_logger.hpp"
 
-#include <boost/thread.hpp>
-
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <thread>
 
 namespace osrm
 {
@@ -32,20 +31,20 @@ template <class EdgeDataT> class SharedDataFacade final : public BaseDataFacade<
   private:
     using EdgeData = EdgeDataT;
     using super = BaseDataFacade<EdgeData>;
-    using QueryGraph = util::StaticGraph<EdgeData, true>;
+    using QueryGraph = contractor::QueryGraph<true>;
     using GraphNode = typename QueryGraph::NodeArrayEntry;
-    using GraphEdge = typename QueryGraph::EdgeArrayEntry;
+    using GraphSearchData = contractor::QueryEdgeSearchData;
+    using GraphUnpackData = contractor::QueryEdgeUnpackData;
     using NameIndexBlock = typename util::RangeTable<16, true>::BlockT;
-    using InputEdge = typename QueryGraph::InputEdge;
     using RTreeLeaf = typename super::RTreeLeaf;
     using SharedRTree =
         util::StaticRTree<RTreeLeaf, util::ShM<util::FixedPointCoordinate, true>::vector, true>;
     using SharedGeospatialQuery = GeospatialQuery<SharedRTree>;
-    using TimeStampedRTreePair = std::pair<unsigned, std::shared_ptr<SharedRTree>>;
     using RTreeNode = typename SharedRTree::TreeNode;
 
     SharedDataLayout *data_layout;
     char *shared_memory;
+    std::unique_ptr<datastore::SharedMemory> m_timestamp_memory;
     SharedDataTimestamp *data_timestamp_ptr;
 
     SharedDataType CURRENT_LAYOUT;
@@ -70,9 +69,10 @@ template <class EdgeDataT> class SharedDataFacade final : public BaseDataFacade<
     util::ShM<unsigned, true>::vector m_geometry_list;
     util::ShM<bool, true>::vector m_is_core_node;
 
-    boost::thread_specific_ptr<std::pair<unsigned, std::shared_ptr<SharedRTree>>> m_static_rtree;
-    boost::thread_specific_ptr<SharedGeospatialQuery> m_geospatial_query;
+    std::unique_ptr<SharedRTree> m_static_rtree;
+    std::unique_ptr<SharedGeospatialQuery> m_geospatial_query;
     boost::filesystem::path file_index_path;
+    util::LeafStorage m_leaf_storage;
 
     std::shared_ptr<util::RangeTable<16, true>> m_name_table;
 
@@ -99,13 +99,10 @@ template <class EdgeDataT> class SharedDataFacade final : public BaseDataFacade<
 
         RTreeNode *tree_ptr =
             data_layout->GetBlockPtr<RTreeNode>(shared_memory, SharedDataLayout::R_SEARCH_TREE);
-        m_static_rtree.reset(new TimeStampedRTreePair(
-            CURRENT_TIMESTAMP,
-            util::make_unique<SharedRTree>(
-                tree_ptr, data_layout->num_entries[SharedDataLayout::R_SEARCH_TREE],
-                file_index_path, m_coordinate_list)));
-        m_geospatial_query.reset(
-            new SharedGeospatialQuery(*m_static_rtree->second, m_coordinate_list));
+        m_static_rtree.reset(new SharedRTree(
+            tree_ptr, data_layout->num_entries[SharedDataLayout::R_SEARCH_TREE], file_index_path,
+            m_coordinate_list, m_leaf_storage));
+        m_geospatial_query.reset(new SharedGeospatialQuery(*m_static_rtree, m_coordinate_list));
     }
 
     void LoadGraph()
@@ -113,14 +110,19 @@ template <class EdgeDataT> class SharedDataFacade final : public BaseDataFacade<
         GraphNode *graph_nodes_ptr =
             data_layout->GetBlockPtr<GraphNode>(shared_memory, SharedDataLayout::GRAPH_NODE_LIST);
 
-        GraphEdge *graph_edges_ptr =
-            data_layout->GetBlockPtr<GraphEdge>(shared_memory, SharedDataLayout::GRAPH_EDGE_LIST);
+        GraphSearchData *graph_search_ptr = data_layout->GetBlockPtr<GraphSearchData>(
+            shared_memory, SharedDataLayout::GRAPH_EDGE_LIST);
+
+        GraphUnpackData *graph_unpack_ptr = data_layout->GetBlockPtr<GraphUnpackData>(
+            shared_memory, SharedDataLayout::GRAPH_EDGE_UNPACK_LIST);
 
         typename util::ShM<GraphNode, true>::vector node_list(
             graph_nodes_ptr, data_layout->num_entries[SharedDataLayout::GRAPH_NODE_LIST]);
-        typename util::ShM<GraphEdge, true>::vector edge_list(
-            graph_edges_ptr, data_layout->num_entries[SharedDataLayout::GRAPH_EDGE_LIST]);
-        m_query_graph.reset(new QueryGraph(node_list, edge_list));
+        typename util::ShM<GraphSearchData, true>::vector search_list(
+            graph_search_ptr, data_layout->num_entries[SharedDataLayout::GRAPH_EDGE_LIST]);
+        typename util::ShM<GraphUnpackData, true>::vector unpack_list(
+            graph_unpack_ptr, data_layout->num_entries[SharedDataLayout::GRAPH_EDGE_UNPACK_LIST]);
+        m_query_graph.reset(new QueryGraph(node_list, search_list, unpack_list));
     }
 
     void LoadNodeAndEdgeInformation()
@@ -223,73 +225,77 @@ template <class EdgeDataT> class SharedDataFacade final : public BaseDataFacade<
   public:
     virtual ~SharedDataFacade() {}
 
-    SharedDataFacade()
+    // Loads the regions osrm-datastore published last. The facade never changes afterwards,
+    // newer data is loaded into a new facade.
+    SharedDataFacade(const util::LeafStorage leaf_storage = util::LeafStorage::Stream,
+                     const bool prefetch_rtree = false)
+        : m_leaf_storage(leaf_storage)
     {
-        data_timestamp_ptr = (SharedDataTimestamp *)datastore::SharedMemoryFactory::Get(
-                                 CURRENT_REGIONS, sizeof(SharedDataTimestamp), false, false)
-                                 ->Ptr();
-        CURRENT_LAYOUT = LAYOUT_NONE;
-        CURRENT_DATA = DATA_NONE;
-        CURRENT_TIMESTAMP = 0;
-
-        // load data
-        CheckAndReloadFacade();
-    }
+        // attached read-only, a writeable region would be removed along with the facade
+        m_timestamp_memory.reset(datastore::SharedMemoryFactory::Get(CURRENT_REGIONS));
+        data_timestamp_ptr = static_cast<SharedDataTimestamp *>(m_timestamp_memory->Ptr());
 
-    void CheckAndReloadFacade()
-    {
-        if (CURRENT_LAYOUT != data_timestamp_ptr->layout ||
-            CURRENT_DATA != data_timestamp_ptr->data ||
-            CURRENT_TIMESTAMP != data_timestamp_ptr->timestamp)
+        // osrm-datastore makes the timestamp odd while it replaces the regions
+        do
         {
-            // release the previous shared memory segments
-            datastore::SharedMemory::Remove(CURRENT_LAYOUT);
-            datastore::SharedMemory::Remove(CURRENT_DATA);
-
+            CURRENT_TIMESTAMP = data_timestamp_ptr->timestamp;
+            if (CURRENT_TIMESTAMP % 2 != 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
             CURRENT_LAYOUT = data_timestamp_ptr->layout;
             CURRENT_DATA = data_timestamp_ptr->data;
-            CURRENT_TIMESTAMP = data_timestamp_ptr->timestamp;
-
-            m_layout_memory.reset(datastore::SharedMemoryFactory::Get(CURRENT_LAYOUT));
+        } while (CURRENT_TIMESTAMP % 2 != 0 || CURRENT_TIMESTAMP != data_timestamp_ptr->timestamp);
 
-            data_layout = (SharedDataLayout *)(m_layout_memory->Ptr());
+        m_layout_memory.reset(datastore::SharedMemoryFactory::Get(CURRENT_LAYOUT));
+        data_layout = (SharedDataLayout *)(m_layout_memory->Ptr());
 
-            m_large_memory.reset(datastore::SharedMemoryFactory::Get(CURRENT_DATA));
-            shared_memory = (char *)(m_large_memory->Ptr());
+        m_large_memory.reset(datastore::SharedMemoryFactory::Get(CURRENT_DATA));
+        shared_memory = (char *)(m_large_memory->Ptr());
 
-            const char *file_index_ptr =
-                data_layout->GetBlockPtr<char>(shared_memory, SharedDataLayout::FILE_INDEX_PATH);
-            file_index_path = boost::filesystem::path(file_index_ptr);
-            if (!boost::filesystem::exists(file_index_path))
-            {
-                util::SimpleLogger().Write(logDEBUG) << "Leaf file name "
-                                                     << file_index_path.string();
-                throw util::exception("Could not load leaf index file. "
-                                      "Is any data loaded into shared memory?");
-            }
+        const char *file_index_ptr =
+            data_layout->GetBlockPtr<char>(shared_memory, SharedDataLayout::FILE_INDEX_PATH);
+        file_index_path = boost::filesystem::path(file_index_ptr);
+        if (!boost::filesystem::exists(file_index_path))
+        {
+            util::SimpleLogger().Write(logDEBUG) << "Leaf file name " << file_index_path.string();
+            throw util::exception("Could not load leaf index file. "
+                                  "Is any data loaded into shared memory?");
+        }
 
-            LoadGraph();
-            LoadChecksum();
-            LoadNodeAndEdgeInformation();
-            LoadGeometries();
-            LoadTimestamp();
-            LoadViaNodeList();
-            LoadNames();
-            LoadCoreInformation();
+        LoadGraph();
+        LoadChecksum();
+        LoadNodeAndEdgeInformation();
+        LoadGeometries();
+        LoadTimestamp();
+        LoadViaNodeList();
+        LoadNames();
+        LoadCoreInformation();
+
+        // built once up front, all query threads share the tree
+        LoadRTree();
+        if (prefetch_rtree)
+        {
+            util::SimpleLogger().Write() << "prefetching r-tree";
+            m_static_rtree->Prefetch();
+        }
 
-            data_layout->PrintInformation();
+        data_layout->PrintInformation();
 
-            util::SimpleLogger().Write() << "number of geometries: " << m_coordinate_list->size();
-            for (unsigned i = 0; i < m_coordinate_list->size(); ++i)
+        util::SimpleLogger().Write() << "number of geometries: " << m_coordinate_list->size();
+        for (unsigned i = 0; i < m_coordinate_list->size(); ++i)
+        {
+            if (!GetCoordinateOfNode(i).IsValid())
             {
-                if (!GetCoordinateOfNode(i).IsValid())
-                {
-                    util::SimpleLogger().Write() << "coordinate " << i << " not valid";
-                }
+                util::SimpleLogger().Write() << "coordinate " << i << " not valid";
             }
         }
     }
 
+    // true once osrm-datastore published regions other than the ones of this facade
+    bool IsOutdated() const { return CURRENT_TIMESTAMP != data_timestamp_ptr->timestamp; }
+
     // search graph access
     unsigned GetNumberOfNodes() const override final { return m_query_graph->GetNumberOfNodes(); }
 
@@ -302,7 +308,12 @@ template <class EdgeDataT> class SharedDataFacade final : public BaseDataFacade<
 
     NodeID GetTarget(const EdgeID e) const override final { return m_query_graph->GetTarget(e); }
 
-    EdgeDataT &GetEdgeData(const EdgeID e) const override final
+    const contractor::QueryEdgeSearchData &GetSearchData(const EdgeID e) const override final
+    {
+        return m_query_graph->GetSearchData(e);
+    }
+
+    EdgeDataT GetEdgeData(const EdgeID e) const override final
     {
         return m_query_graph->GetEdgeData(e);
     }
@@ -376,27 +387,32 @@ template <class EdgeDataT> class SharedDataFacade final : public BaseDataFacade<
                                const int bearing = 0,
                                const int bearing_range = 180) override final
     {
-        if (!m_static_rtree.get() || CURRENT_TIMESTAMP != m_static_rtree->first)
-        {
-            LoadRTree();
-            BOOST_ASSERT(m_geospatial_query.get());
-        }
+        BOOST_ASSERT(m_geospatial_query.get());
 
         return m_geospatial_query->NearestPhantomNodesInRange(input_coordinate, max_distance,
                                                               bearing, bearing_range);
     }
 
+    void
+    NearestPhantomNodesInRanges(const std::vector<util::FixedPointCoordinate> &input_coordinates,
+                                const std::vector<double> &max_distances,
+                                const std::vector<std::pair<int, int>> &bearings,
+                                util::LayeredVector<PhantomNodeWithDistance> &phantom_nodes)
+        override final
+    {
+        BOOST_ASSERT(m_geospatial_query.get());
+
+        m_geospatial_query->NearestPhantomNodesInRanges(input_coordinates, max_distances, bearings,
+                                                        phantom_nodes);
+    }
+
     std::vector<PhantomNodeWithDistance>
     NearestPhantomNodes(const util::FixedPointCoordinate &input_coordinate,
                         const unsigned max_results,
                         const int bearing = 0,
                         const int bearing_range = 180) override final
     {
-        if (!m_static_rtree.get() || CURRENT_TIMESTAMP != m_static_rtree->first)
-        {
-            LoadRTree();
-            BOOST_ASSERT(m_geospatial_query.get());
-        }
+        BOOST_ASSERT(m_geospatial_query.get());
 
         return m_geospatial_query->NearestPhantomNodes(input_coordinate, max_results, bearing,
                                                        bearing_range);
@@ -407,11 +423,7 @@ template <class EdgeDataT> class SharedDataFacade final : public BaseDataFacade<
         const int bearing = 0,
         const int bearing_range = 180) override final
     {
-        if (!m_static_rtree.get() || CURRENT_TIMESTAMP != m_static_rtree->first)
-        {
-            LoadRTree();
-            BOOST_ASSERT(m_geospatial_query.get());
-        }
+        BOOST_ASSERT(m_geospatial_query.get());
 
         return m_geospatial_query->NearestPhantomNodeWithAlternativeFromBigComponent(
             input_coordinate, bearing, bearing_range);
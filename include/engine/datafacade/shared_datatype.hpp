@@ -7,6 +7,7 @@
 #include <cstdint>
 
 #include <array>
+#include <atomic>
 
 namespace osrm
 {
@@ -32,6 +33,7 @@ struct SharedDataLayout
         VIA_NODE_LIST,
         GRAPH_NODE_LIST,
         GRAPH_EDGE_LIST,
+        GRAPH_EDGE_UNPACK_LIST,
         COORDINATE_LIST,
         TURN_INSTRUCTION,
         TRAVEL_MODE,
@@ -67,6 +69,8 @@ struct SharedDataLayout
                                              << ": " << GetBlockSize(GRAPH_NODE_LIST);
         util::SimpleLogger().Write(logDEBUG) << "GRAPH_EDGE_LIST      "
                                              << ": " << GetBlockSize(GRAPH_EDGE_LIST);
+        util::SimpleLogger().Write(logDEBUG) << "GRAPH_EDGE_UNPACK_LIST"
+                                             << ": " << GetBlockSize(GRAPH_EDGE_UNPACK_LIST);
         util::SimpleLogger().Write(logDEBUG) << "COORDINATE_LIST      "
                                              << ": " << GetBlockSize(COORDINATE_LIST);
         util::SimpleLogger().Write(logDEBUG) << "TURN_INSTRUCTION     "
@@ -162,14 +166,17 @@ enum SharedDataType
     LAYOUT_2,
     DATA_2,
     LAYOUT_NONE,
-    DATA_NONE
+    DATA_NONE,
+    QUERY_REGISTRY
 };
 
+// Written by osrm-datastore and read by the queries of every osrm-routed process without a lock.
+// The timestamp is odd while the regions are replaced.
 struct SharedDataTimestamp
 {
-    SharedDataType layout;
-    SharedDataType data;
-    unsigned timestamp;
+    std::atomic<SharedDataType> layout;
+    std::atomic<SharedDataType> data;
+    std::atomic<unsigned> timestamp;
 };
 }
 }
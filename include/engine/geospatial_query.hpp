@@ -5,12 +5,15 @@
 #include "util/typedefs.hpp"
 #include "engine/phantom_node.hpp"
 #include "util/bearing.hpp"
+#include "util/integer_range.hpp"
+#include "util/layered_vector.hpp"
 
 #include "osrm/coordinate.hpp"
 
 #include <algorithm>
 #include <cmath>
 #include <memory>
+#include <utility>
 #include <vector>
 
 namespace osrm
@@ -54,6 +57,41 @@ template <typename RTreeT> class GeospatialQuery
         return MakePhantomNodes(input_coordinate, results);
     }
 
+    // Looks up the PhantomNodes within max_distances[i] of every input_coordinates[i], like calling
+    // NearestPhantomNodesInRange for each of them, but in one batched query. bearings holds a
+    // bearing and a range per coordinate, or is empty if they accept all directions. The
+    // phantom nodes of every coordinate are stored in a layer of phantom_nodes, its memory is
+    // reused.
+    // Does not filter by small/big component!
+    void
+    NearestPhantomNodesInRanges(const std::vector<util::FixedPointCoordinate> &input_coordinates,
+                                const std::vector<double> &max_distances,
+                                const std::vector<std::pair<int, int>> &bearings,
+                                util::LayeredVector<PhantomNodeWithDistance> &phantom_nodes)
+    {
+        BOOST_ASSERT(bearings.empty() || bearings.size() == input_coordinates.size());
+        util::LayeredVector<EdgeData> results;
+        rtree.SearchInRanges(input_coordinates, max_distances,
+                             [this, &bearings](const std::size_t index, const EdgeData &data)
+                             {
+                                 return bearings.empty()
+                                            ? std::make_pair(true, true)
+                                            : checkSegmentBearing(data, bearings[index].first,
+                                                                  bearings[index].second);
+                             },
+                             results);
+
+        phantom_nodes.clear();
+        for (const auto index : util::irange<std::size_t>(0, results.size()))
+        {
+            phantom_nodes.push_back_layer();
+            for (const auto &data : results[index])
+            {
+                phantom_nodes.push_back(MakePhantomNode(input_coordinates[index], data));
+            }
+        }
+    }
+
     // Returns max_results nearest PhantomNodes in the given bearing range.
     // Does not filter by small/big component!
     std::vector<PhantomNodeWithDistance>
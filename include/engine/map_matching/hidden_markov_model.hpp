@@ -2,11 +2,13 @@
 #define HIDDEN_MARKOV_MODEL
 
 #include "util/integer_range.hpp"
+#include "util/layered_vector.hpp"
 
 #include <boost/assert.hpp>
 
 #include <cmath>
 
+#include <algorithm>
 #include <limits>
 #include <vector>
 
@@ -47,42 +49,40 @@ struct TransitionLogProbability
     double operator()(const double d_t) const { return -log_beta - d_t / beta; }
 };
 
+// The states of all timestamps are stored in one layered vector per property, shaped like the
+// candidates lists. A model that is reset for the next trace reuses the memory of the last one.
 template <class CandidateLists> struct HiddenMarkovModel
 {
-    std::vector<std::vector<double>> viterbi;
-    std::vector<std::vector<std::pair<unsigned, unsigned>>> parents;
-    std::vector<std::vector<float>> path_lengths;
-    std::vector<std::vector<bool>> pruned;
-    std::vector<std::vector<bool>> suspicious;
+    util::LayeredVector<double> viterbi;
+    util::LayeredVector<std::pair<unsigned, unsigned>> parents;
+    util::LayeredVector<float> path_lengths;
+    util::LayeredVector<char> pruned;
+    util::LayeredVector<char> suspicious;
     std::vector<bool> breakage;
 
-    const CandidateLists &candidates_list;
-    const EmissionLogProbability &emission_log_probability;
+    const CandidateLists *candidates_list;
+    const EmissionLogProbability *emission_log_probability;
+
+    HiddenMarkovModel() : candidates_list(nullptr), emission_log_probability(nullptr) {}
 
     HiddenMarkovModel(const CandidateLists &candidates_list,
                       const EmissionLogProbability &emission_log_probability)
-        : breakage(candidates_list.size()), candidates_list(candidates_list),
-          emission_log_probability(emission_log_probability)
     {
-        viterbi.resize(candidates_list.size());
-        parents.resize(candidates_list.size());
-        path_lengths.resize(candidates_list.size());
-        suspicious.resize(candidates_list.size());
-        pruned.resize(candidates_list.size());
-        breakage.resize(candidates_list.size());
-        for (const auto i : util::irange<std::size_t>(0u, candidates_list.size()))
-        {
-            const auto &num_candidates = candidates_list[i].size();
-            // add empty vectors
-            if (num_candidates > 0)
-            {
-                viterbi[i].resize(num_candidates);
-                parents[i].resize(num_candidates);
-                path_lengths[i].resize(num_candidates);
-                suspicious[i].resize(num_candidates);
-                pruned[i].resize(num_candidates);
-            }
-        }
+        reset(candidates_list, emission_log_probability);
+    }
+
+    void reset(const CandidateLists &new_candidates_list,
+               const EmissionLogProbability &new_emission_log_probability)
+    {
+        candidates_list = &new_candidates_list;
+        emission_log_probability = &new_emission_log_probability;
+
+        viterbi.reshape(new_candidates_list);
+        parents.reshape(new_candidates_list);
+        path_lengths.reshape(new_candidates_list);
+        suspicious.reshape(new_candidates_list);
+        pruned.reshape(new_candidates_list);
+        breakage.resize(new_candidates_list.size());
 
         clear(0);
     }
@@ -105,15 +105,16 @@ template <class CandidateLists> struct HiddenMarkovModel
 
     std::size_t initialize(std::size_t initial_timestamp)
     {
-        auto num_points = candidates_list.size();
+        BOOST_ASSERT(candidates_list && emission_log_probability);
+        auto num_points = candidates_list->size();
         do
         {
             BOOST_ASSERT(initial_timestamp < num_points);
 
             for (const auto s : util::irange<std::size_t>(0u, viterbi[initial_timestamp].size()))
             {
-                viterbi[initial_timestamp][s] =
-                    emission_log_probability(candidates_list[initial_timestamp][s].distance);
+                viterbi[initial_timestamp][s] = (*emission_log_probability)(
+                    (*candidates_list)[initial_timestamp][s].distance);
                 parents[initial_timestamp][s] = std::make_pair(initial_timestamp, s);
                 pruned[initial_timestamp][s] = viterbi[initial_timestamp][s] < MINIMAL_LOG_PROB;
                 suspicious[initial_timestamp][s] = false;
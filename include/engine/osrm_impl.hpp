@@ -8,6 +8,7 @@
 #include "osrm/osrm.hpp"
 
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <string>
 
@@ -19,6 +20,7 @@ namespace util
 namespace json
 {
 struct Object;
+class Writer;
 }
 }
 
@@ -40,24 +42,37 @@ class OSRM::OSRM_impl final
 {
   private:
     using PluginMap = std::unordered_map<std::string, std::unique_ptr<plugins::BasePlugin>>;
+    using DataFacade = datafacade::BaseDataFacade<contractor::QueryEdge::EdgeData>;
+
+    // A data facade and the plugins that answer queries on it. It is never changed once it is
+    // published, new shared memory data is loaded into a new snapshot.
+    struct Snapshot
+    {
+        std::unique_ptr<DataFacade> facade;
+        PluginMap plugin_map;
+    };
+
+    class RunningQuery;
 
   public:
     OSRM_impl(LibOSRMConfig &lib_config);
     OSRM_impl(const OSRM_impl &) = delete;
+    ~OSRM_impl();
     int RunQuery(const RouteParameters &route_parameters, util::json::Object &json_result);
+    int RunQuery(const RouteParameters &route_parameters, util::json::Writer &writer);
 
   private:
-    void RegisterPlugin(plugins::BasePlugin *plugin);
-    PluginMap plugin_map;
+    std::shared_ptr<const Snapshot> LoadSnapshot(std::unique_ptr<DataFacade> facade) const;
+    // the snapshot a new query runs on, loads the shared memory data if it changed
+    std::shared_ptr<const Snapshot> GetSnapshot();
+
+    LibOSRMConfig config;
+    // only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<const Snapshot> snapshot;
     // will only be initialized if shared memory is used
     std::unique_ptr<datafacade::SharedBarriers> barrier;
-    // base class pointer to the objects
-    datafacade::BaseDataFacade<contractor::QueryEdge::EdgeData> *query_data_facade;
-
-    // decrease number of concurrent queries
-    void decrease_concurrent_query_count();
-    // increase number of concurrent queries
-    void increase_concurrent_query_count();
+    // serializes the loading of new shared memory data
+    std::mutex reload_mutex;
 };
 }
 }
@@ -5,6 +5,7 @@
 
 #include "engine/object_encoder.hpp"
 #include "engine/search_engine.hpp"
+#include "util/json_writer.hpp"
 #include "util/make_unique.hpp"
 #include "util/string_util.hpp"
 #include "osrm/json_container.hpp"
@@ -43,10 +44,25 @@ template <class DataFacadeT> class DistanceTablePlugin final : public BasePlugin
 
     Status HandleRequest(const RouteParameters &route_parameters,
                          util::json::Object &json_result) override final
+    {
+        util::json::TreeWriter writer(json_result);
+        return ComputeTable(route_parameters, writer);
+    }
+
+    Status HandleStreamingRequest(const RouteParameters &route_parameters,
+                                  util::json::Writer &writer) override final
+    {
+        return ComputeTable(route_parameters, writer);
+    }
+
+  private:
+    // writes the response into a util::json::Writer or a util::json::TreeWriter
+    template <typename WriterT>
+    Status ComputeTable(const RouteParameters &route_parameters, WriterT &writer)
     {
         if (!check_all_coordinates(route_parameters.coordinates))
         {
-            json_result.values["status_message"] = "Coordinates are invalid";
+            SetStatusMessage(writer, "Coordinates are invalid");
             return Status::Error;
         }
 
@@ -54,8 +70,7 @@ template <class DataFacadeT> class DistanceTablePlugin final : public BasePlugin
         if (input_bearings.size() > 0 &&
             route_parameters.coordinates.size() != input_bearings.size())
         {
-            json_result.values["status_message"] =
-                "Number of bearings does not match number of coordinates";
+            SetStatusMessage(writer, "Number of bearings does not match number of coordinates");
             return Status::Error;
         }
 
@@ -76,10 +91,11 @@ template <class DataFacadeT> class DistanceTablePlugin final : public BasePlugin
             (number_of_sources * number_of_destination >
              max_locations_distance_table * max_locations_distance_table))
         {
-            json_result.values["status_message"] =
+            SetStatusMessage(writer,
                 "Number of entries " + std::to_string(number_of_sources * number_of_destination) +
-                " is higher than current maximum (" +
-                std::to_string(max_locations_distance_table * max_locations_distance_table) + ")";
+                    " is higher than current maximum (" +
+                    std::to_string(max_locations_distance_table * max_locations_distance_table) +
+                    ")");
             return Status::Error;
         }
 
@@ -132,9 +148,9 @@ template <class DataFacadeT> class DistanceTablePlugin final : public BasePlugin
                 // we didn't found a fitting node, return error
                 if (!phantom_node_source_out_iter->first.is_valid(facade->GetNumberOfNodes()))
                 {
-                    json_result.values["status_message"] =
-                        std::string("Could not find a matching segment for coordinate ") +
-                        std::to_string(i);
+                    SetStatusMessage(
+                        writer, std::string("Could not find a matching segment for coordinate ") +
+                                    std::to_string(i));
                     return Status::NoSegment;
                 }
 
@@ -155,9 +171,9 @@ template <class DataFacadeT> class DistanceTablePlugin final : public BasePlugin
                 // we didn't found a fitting node, return error
                 if (!phantom_node_target_out_iter->first.is_valid(facade->GetNumberOfNodes()))
                 {
-                    json_result.values["status_message"] =
-                        std::string("Could not find a matching segment for coordinate ") +
-                        std::to_string(i);
+                    SetStatusMessage(
+                        writer, std::string("Could not find a matching segment for coordinate ") +
+                                    std::to_string(i));
                     return Status::NoSegment;
                 }
                 phantom_node_target_out_iter++;
@@ -179,43 +195,54 @@ template <class DataFacadeT> class DistanceTablePlugin final : public BasePlugin
 
         if (!result_table)
         {
-            json_result.values["status_message"] = "No distance table found";
+            SetStatusMessage(writer, "No distance table found");
             return Status::EmptyResult;
         }
 
-        util::json::Array matrix_json_array;
-        for (const auto row : util::irange<std::size_t>(0, number_of_sources))
-        {
-            util::json::Array json_row;
-            auto row_begin_iterator = result_table->begin() + (row * number_of_destination);
-            auto row_end_iterator = result_table->begin() + ((row + 1) * number_of_destination);
-            json_row.values.insert(json_row.values.end(), row_begin_iterator, row_end_iterator);
-            matrix_json_array.values.push_back(json_row);
-        }
-        json_result.values["distance_table"] = matrix_json_array;
+        WriteTable(*result_table, number_of_destination, snapped_source_phantoms,
+                   snapped_target_phantoms, writer);
+        return Status::Ok;
+    }
 
-        util::json::Array target_coord_json_array;
-        for (const auto &phantom : snapped_target_phantoms)
+    template <typename WriterT>
+    void WriteTable(const std::vector<EdgeWeight> &table,
+                    const std::size_t number_of_destinations,
+                    const std::vector<PhantomNode> &source_phantoms,
+                    const std::vector<PhantomNode> &target_phantoms,
+                    WriterT &writer) const
+    {
+        writer.Key("distance_table");
+        writer.BeginArray();
+        auto cell = table.begin();
+        for (std::size_t row = 0; row < source_phantoms.size(); ++row)
         {
-            util::json::Array json_coord;
-            json_coord.values.push_back(phantom.location.lat / COORDINATE_PRECISION);
-            json_coord.values.push_back(phantom.location.lon / COORDINATE_PRECISION);
-            target_coord_json_array.values.push_back(json_coord);
+            writer.BeginArray();
+            for (const auto row_end = cell + number_of_destinations; cell != row_end; ++cell)
+            {
+                writer.Number(*cell);
+            }
+            writer.EndArray();
         }
-        json_result.values["destination_coordinates"] = target_coord_json_array;
-        util::json::Array source_coord_json_array;
-        for (const auto &phantom : snapped_source_phantoms)
+        writer.EndArray();
+
+        const auto write_coordinates = [&writer](const std::vector<PhantomNode> &phantoms)
         {
-            util::json::Array json_coord;
-            json_coord.values.push_back(phantom.location.lat / COORDINATE_PRECISION);
-            json_coord.values.push_back(phantom.location.lon / COORDINATE_PRECISION);
-            source_coord_json_array.values.push_back(json_coord);
-        }
-        json_result.values["source_coordinates"] = source_coord_json_array;
-        return Status::Ok;
+            writer.BeginArray();
+            for (const auto &phantom : phantoms)
+            {
+                writer.BeginArray();
+                writer.Number(phantom.location.lat / COORDINATE_PRECISION);
+                writer.Number(phantom.location.lon / COORDINATE_PRECISION);
+                writer.EndArray();
+            }
+            writer.EndArray();
+        };
+        writer.Key("destination_coordinates");
+        write_coordinates(target_phantoms);
+        writer.Key("source_coordinates");
+        write_coordinates(source_phantoms);
     }
 
-  private:
     std::string descriptor_string;
     DataFacadeT *facade;
 };
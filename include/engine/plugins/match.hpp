@@ -16,6 +16,8 @@
 #include "util/json_util.hpp"
 #include "util/string_util.hpp"
 
+#include <boost/thread/tss.hpp>
+
 #include <cstdlib>
 
 #include <algorithm>
@@ -42,6 +44,19 @@ template <class DataFacadeT> class MapMatchingPlugin : public BasePlugin
                                                       double>;
     using TraceClassification = ClassifierT::ClassificationT;
 
+    // The memory of the last trace a thread matched, reused for the next one
+    struct CandidateBuffers
+    {
+        std::vector<double> sub_trace_lengths;
+        std::vector<double> max_distances;
+        std::vector<std::pair<int, int>> bearings;
+        // the phantom nodes around every coordinate
+        CandidateLists phantom_nodes;
+        // the candidates of one coordinate while they are filtered
+        std::vector<PhantomNodeWithDistance> candidates;
+        CandidateLists candidates_lists;
+    };
+
   public:
     MapMatchingPlugin(DataFacadeT *facade, const int max_locations_map_matching)
         : descriptor_string("match"), facade(facade),
@@ -77,13 +92,15 @@ template <class DataFacadeT> class MapMatchingPlugin : public BasePlugin
         return label_with_confidence;
     }
 
-    CandidateLists getCandidates(
+    void getCandidates(
         const std::vector<util::FixedPointCoordinate> &input_coords,
         const std::vector<std::pair<const int, const boost::optional<int>>> &input_bearings,
         const double gps_precision,
-        std::vector<double> &sub_trace_lengths)
+        CandidateBuffers &buffers)
     {
-        CandidateLists candidates_lists;
+        auto &sub_trace_lengths = buffers.sub_trace_lengths;
+        auto &candidates_lists = buffers.candidates_lists;
+        candidates_lists.clear();
 
         // assuming the gps_precision is the standart-diviation of normal distribution that models
         // GPS noise (in this model) this should give us the correct candidate with >0.95
@@ -91,8 +108,20 @@ template <class DataFacadeT> class MapMatchingPlugin : public BasePlugin
         double last_distance =
             util::coordinate_calculation::haversineDistance(input_coords[0], input_coords[1]);
 
-        sub_trace_lengths.resize(input_coords.size());
-        sub_trace_lengths[0] = 0;
+        // Use bearing values if supplied, otherwise fallback to 0,180 defaults
+        auto &bearings = buffers.bearings;
+        bearings.clear();
+        for (const auto &input_bearing : input_bearings)
+        {
+            bearings.emplace_back(input_bearing.first,
+                                  input_bearing.second ? *input_bearing.second : 10);
+        }
+        // the candidates of all coordinates are looked up in one batched query
+        buffers.max_distances.assign(input_coords.size(), query_radius);
+        facade->NearestPhantomNodesInRanges(input_coords, buffers.max_distances, bearings,
+                                            buffers.phantom_nodes);
+
+        sub_trace_lengths.assign(input_coords.size(), 0.);
         for (const auto current_coordinate : util::irange<std::size_t>(0, input_coords.size()))
         {
             bool allow_uturn = false;
@@ -118,15 +147,9 @@ template <class DataFacadeT> class MapMatchingPlugin : public BasePlugin
                 }
             }
 
-            // Use bearing values if supplied, otherwise fallback to 0,180 defaults
-            auto bearing = input_bearings.size() > 0 ? input_bearings[current_coordinate].first : 0;
-            auto range = input_bearings.size() > 0
-                             ? (input_bearings[current_coordinate].second
-                                    ? *input_bearings[current_coordinate].second
-                                    : 10)
-                             : 180;
-            auto candidates = facade->NearestPhantomNodesInRange(input_coords[current_coordinate],
-                                                                 query_radius, bearing, range);
+            auto &candidates = buffers.candidates;
+            candidates.assign(buffers.phantom_nodes[current_coordinate].begin(),
+                              buffers.phantom_nodes[current_coordinate].end());
 
             if (candidates.size() == 0)
             {
@@ -181,10 +204,8 @@ template <class DataFacadeT> class MapMatchingPlugin : public BasePlugin
                           return lhs.distance < rhs.distance;
                       });
 
-            candidates_lists.push_back(std::move(candidates));
+            candidates_lists.push_back_layer(candidates.begin(), candidates.end());
         }
-
-        return candidates_lists;
     }
 
     util::json::Object submatchingToJSON(const SubMatching &sub,
@@ -199,8 +220,10 @@ template <class DataFacadeT> class MapMatchingPlugin : public BasePlugin
         }
 
         auto response_generator = MakeApiResponseGenerator(facade);
+        util::json::TreeWriter subtrace_writer(subtrace);
 
-        subtrace.values["hint_data"] = response_generator.BuildHintData(raw_route);
+        subtrace_writer.Key("hint_data");
+        response_generator.BuildHintData(raw_route, subtrace_writer);
 
         if (route_parameters.geometry || route_parameters.print_instructions)
         {
@@ -215,8 +238,9 @@ template <class DataFacadeT> class MapMatchingPlugin : public BasePlugin
 
             if (route_parameters.geometry)
             {
-                subtrace.values["geometry"] =
-                    response_generator.GetGeometry(route_parameters.compression, segment_list);
+                subtrace_writer.Key("geometry");
+                response_generator.GetGeometry(route_parameters.compression, segment_list,
+                                               subtrace_writer);
             }
 
             if (route_parameters.print_instructions)
@@ -270,7 +294,6 @@ template <class DataFacadeT> class MapMatchingPlugin : public BasePlugin
             return Status::Error;
         }
 
-        std::vector<double> sub_trace_lengths;
         const auto &input_coords = route_parameters.coordinates;
         const auto &input_timestamps = route_parameters.timestamps;
         const auto &input_bearings = route_parameters.bearings;
@@ -295,8 +318,14 @@ template <class DataFacadeT> class MapMatchingPlugin : public BasePlugin
             return Status::Error;
         }
 
-        const auto candidates_lists = getCandidates(
-            input_coords, input_bearings, route_parameters.gps_precision, sub_trace_lengths);
+        if (!thread_buffers.get())
+        {
+            thread_buffers.reset(new CandidateBuffers());
+        }
+        getCandidates(input_coords, input_bearings, route_parameters.gps_precision,
+                      *thread_buffers);
+        const auto &sub_trace_lengths = thread_buffers->sub_trace_lengths;
+        const auto &candidates_lists = thread_buffers->candidates_lists;
         if (candidates_lists.size() != input_coords.size())
         {
             BOOST_ASSERT(candidates_lists.size() < input_coords.size());
@@ -379,7 +408,13 @@ template <class DataFacadeT> class MapMatchingPlugin : public BasePlugin
     DataFacadeT *facade;
     int max_locations_map_matching;
     ClassifierT classifier;
+    // static, so they stay valid when the plugin is replaced along with its data facade
+    static boost::thread_specific_ptr<CandidateBuffers> thread_buffers;
 };
+
+template <class DataFacadeT>
+boost::thread_specific_ptr<typename MapMatchingPlugin<DataFacadeT>::CandidateBuffers>
+    MapMatchingPlugin<DataFacadeT>::thread_buffers;
 }
 }
 }
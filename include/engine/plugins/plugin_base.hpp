@@ -2,6 +2,7 @@
 #define BASE_PLUGIN_HPP
 
 #include "engine/phantom_node.hpp"
+#include "util/json_writer.hpp"
 
 #include "osrm/coordinate.hpp"
 #include "osrm/json_container.hpp"
@@ -9,6 +10,7 @@
 
 #include <algorithm>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace osrm
@@ -34,6 +36,18 @@ class BasePlugin
     virtual ~BasePlugin() {}
     virtual const std::string GetDescriptor() const = 0;
     virtual Status HandleRequest(const RouteParameters &, util::json::Object &) = 0;
+
+    // Streams the members of the response into an object the caller has opened on the writer.
+    // Plugins that have not been ported to the writer build the tree and have it written out.
+    virtual Status HandleStreamingRequest(const RouteParameters &route_parameters,
+                                          util::json::Writer &writer)
+    {
+        util::json::Object json_result;
+        const auto status = HandleRequest(route_parameters, json_result);
+        writer.Members(json_result);
+        return status;
+    }
+
     virtual bool check_all_coordinates(const std::vector<util::FixedPointCoordinate> &coordinates,
                                        const unsigned min = 2) const final
     {
@@ -48,6 +62,14 @@ class BasePlugin
         return true;
     }
 
+    // Works on a util::json::Writer as well as on a util::json::TreeWriter
+    template <typename WriterT>
+    static void SetStatusMessage(WriterT &writer, const std::string &message)
+    {
+        writer.Key("status_message");
+        writer.String(message);
+    }
+
     // Decides whether to use the phantom node from a big or small component if both are found.
     // Returns true if all phantom nodes are in the same component after snapping.
     std::vector<PhantomNode> snapPhantomNodes(
@@ -9,6 +9,7 @@
 #include "util/for_each_pair.hpp"
 #include "util/integer_range.hpp"
 #include "util/json_renderer.hpp"
+#include "util/json_writer.hpp"
 #include "util/make_unique.hpp"
 #include "util/simple_logger.hpp"
 #include "util/timing_util.hpp"
@@ -50,19 +51,35 @@ template <class DataFacadeT> class ViaRoutePlugin final : public BasePlugin
 
     Status HandleRequest(const RouteParameters &route_parameters,
                          util::json::Object &json_result) override final
+    {
+        util::json::TreeWriter writer(json_result);
+        return ComputeRoute(route_parameters, writer);
+    }
+
+    Status HandleStreamingRequest(const RouteParameters &route_parameters,
+                                  util::json::Writer &writer) override final
+    {
+        return ComputeRoute(route_parameters, writer);
+    }
+
+  private:
+    // writes the response into a util::json::Writer or a util::json::TreeWriter
+    template <typename WriterT>
+    Status ComputeRoute(const RouteParameters &route_parameters, WriterT &writer)
     {
         if (max_locations_viaroute > 0 &&
             (static_cast<int>(route_parameters.coordinates.size()) > max_locations_viaroute))
         {
-            json_result.values["status_message"] =
-                "Number of entries " + std::to_string(route_parameters.coordinates.size()) +
-                " is higher than current maximum (" + std::to_string(max_locations_viaroute) + ")";
+            SetStatusMessage(writer, "Number of entries " +
+                                         std::to_string(route_parameters.coordinates.size()) +
+                                         " is higher than current maximum (" +
+                                         std::to_string(max_locations_viaroute) + ")");
             return Status::Error;
         }
 
         if (!check_all_coordinates(route_parameters.coordinates))
         {
-            json_result.values["status_message"] = "Invalid coordinates";
+            SetStatusMessage(writer, "Invalid coordinates");
             return Status::Error;
         }
 
@@ -70,8 +87,7 @@ template <class DataFacadeT> class ViaRoutePlugin final : public BasePlugin
         if (input_bearings.size() > 0 &&
             route_parameters.coordinates.size() != input_bearings.size())
         {
-            json_result.values["status_message"] =
-                "Number of bearings does not match number of coordinate";
+            SetStatusMessage(writer, "Number of bearings does not match number of coordinate");
             return Status::Error;
         }
 
@@ -99,9 +115,9 @@ template <class DataFacadeT> class ViaRoutePlugin final : public BasePlugin
             // we didn't found a fitting node, return error
             if (!phantom_node_pair_list[i].first.is_valid(facade->GetNumberOfNodes()))
             {
-                json_result.values["status_message"] =
-                    std::string("Could not find a matching segment for coordinate ") +
-                    std::to_string(i);
+                SetStatusMessage(
+                    writer, std::string("Could not find a matching segment for coordinate ") +
+                                std::to_string(i));
                 return Status::NoSegment;
             }
             BOOST_ASSERT(phantom_node_pair_list[i].first.is_valid(facade->GetNumberOfNodes()));
@@ -140,7 +156,7 @@ template <class DataFacadeT> class ViaRoutePlugin final : public BasePlugin
         bool no_route = INVALID_EDGE_WEIGHT == raw_route.shortest_path_length;
 
         auto generator = MakeApiResponseGenerator(facade);
-        generator.DescribeRoute(route_parameters, raw_route, json_result);
+        generator.DescribeRoute(route_parameters, raw_route, writer);
 
         // we can only know this after the fact, different SCC ids still
         // allow for connection in one direction.
@@ -155,13 +171,13 @@ template <class DataFacadeT> class ViaRoutePlugin final : public BasePlugin
                             });
             if (not_in_same_component)
             {
-                json_result.values["status_message"] = "Impossible route between points";
+                SetStatusMessage(writer, "Impossible route between points");
                 return Status::EmptyResult;
             }
         }
         else
         {
-            json_result.values["status_message"] = "Found route between points";
+            SetStatusMessage(writer, "Found route between points");
         }
 
         return Status::Ok;
@@ -420,7 +420,7 @@ class AlternativeRouting final
             {
                 EdgeID edgeID = facade->FindEdgeInEitherDirection(
                     packed_s_v_path[current_node], packed_s_v_path[current_node + 1]);
-                *sharing_of_via_path += facade->GetEdgeData(edgeID).distance;
+                *sharing_of_via_path += facade->GetSearchData(edgeID).distance;
             }
             else
             {
@@ -451,7 +451,7 @@ class AlternativeRouting final
             EdgeID selected_edge =
                 facade->FindEdgeInEitherDirection(partially_unpacked_via_path[current_node],
                                                   partially_unpacked_via_path[current_node + 1]);
-            *sharing_of_via_path += facade->GetEdgeData(selected_edge).distance;
+            *sharing_of_via_path += facade->GetSearchData(selected_edge).distance;
         }
 
         // Second, partially unpack v-->t in reverse order until paths deviate and note lengths
@@ -466,7 +466,7 @@ class AlternativeRouting final
             {
                 EdgeID edgeID = facade->FindEdgeInEitherDirection(
                     packed_v_t_path[via_path_index - 1], packed_v_t_path[via_path_index]);
-                *sharing_of_via_path += facade->GetEdgeData(edgeID).distance;
+                *sharing_of_via_path += facade->GetSearchData(edgeID).distance;
             }
             else
             {
@@ -495,7 +495,7 @@ class AlternativeRouting final
                 EdgeID edgeID = facade->FindEdgeInEitherDirection(
                     partially_unpacked_via_path[via_path_index - 1],
                     partially_unpacked_via_path[via_path_index]);
-                *sharing_of_via_path += facade->GetEdgeData(edgeID).distance;
+                *sharing_of_via_path += facade->GetSearchData(edgeID).distance;
             }
             else
             {
@@ -605,13 +605,13 @@ class AlternativeRouting final
 
         for (auto edge : facade->GetAdjacentEdgeRange(node))
         {
-            const EdgeData &data = facade->GetEdgeData(edge);
+            const auto &data = facade->GetSearchData(edge);
             const bool edge_is_forward_directed =
                 (is_forward_directed ? data.forward : data.backward);
             if (edge_is_forward_directed)
             {
 
-                const NodeID to = facade->GetTarget(edge);
+                const NodeID to = data.target;
                 const int edge_weight = data.distance;
 
                 BOOST_ASSERT(edge_weight > 0);
@@ -709,7 +709,7 @@ class AlternativeRouting final
         {
             const EdgeID current_edge_id =
                 facade->FindEdgeInEitherDirection(packed_s_v_path[i - 1], packed_s_v_path[i]);
-            const int length_of_current_edge = facade->GetEdgeData(current_edge_id).distance;
+            const int length_of_current_edge = facade->GetSearchData(current_edge_id).distance;
             if ((length_of_current_edge + unpacked_until_distance) >= T_threshold)
             {
                 unpack_stack.emplace(packed_s_v_path[i - 1], packed_s_v_path[i]);
@@ -733,7 +733,7 @@ class AlternativeRouting final
                 return false;
             }
 
-            const EdgeData &current_edge_data = facade->GetEdgeData(edge_in_via_path_id);
+            const EdgeData current_edge_data = facade->GetEdgeData(edge_in_via_path_id);
             const bool current_edge_is_shortcut = current_edge_data.shortcut;
             if (current_edge_is_shortcut)
             {
@@ -741,7 +741,7 @@ class AlternativeRouting final
                 const EdgeID second_segment_edge_id = facade->FindEdgeInEitherDirection(
                     via_path_middle_node_id, via_path_edge.second);
                 const int second_segment_length =
-                    facade->GetEdgeData(second_segment_edge_id).distance;
+                    facade->GetSearchData(second_segment_edge_id).distance;
                 // attention: !unpacking in reverse!
                 // Check if second segment is the one to go over treshold? if yes add second segment
                 // to stack, else push first segment to stack and add distance of second one.
@@ -772,7 +772,7 @@ class AlternativeRouting final
         {
             const EdgeID edgeID =
                 facade->FindEdgeInEitherDirection(packed_v_t_path[i], packed_v_t_path[i + 1]);
-            int length_of_current_edge = facade->GetEdgeData(edgeID).distance;
+            int length_of_current_edge = facade->GetSearchData(edgeID).distance;
             if (length_of_current_edge + unpacked_until_distance >= T_threshold)
             {
                 unpack_stack.emplace(packed_v_t_path[i], packed_v_t_path[i + 1]);
@@ -795,14 +795,14 @@ class AlternativeRouting final
                 return false;
             }
 
-            const EdgeData &current_edge_data = facade->GetEdgeData(edge_in_via_path_id);
+            const EdgeData current_edge_data = facade->GetEdgeData(edge_in_via_path_id);
             const bool IsViaEdgeShortCut = current_edge_data.shortcut;
             if (IsViaEdgeShortCut)
             {
                 const NodeID middleOfViaPath = current_edge_data.id;
                 EdgeID edgeIDOfFirstSegment =
                     facade->FindEdgeInEitherDirection(via_path_edge.first, middleOfViaPath);
-                int lengthOfFirstSegment = facade->GetEdgeData(edgeIDOfFirstSegment).distance;
+                int lengthOfFirstSegment = facade->GetSearchData(edgeIDOfFirstSegment).distance;
                 // Check if first segment is the one to go over treshold? if yes first segment to
                 // stack, else push second segment to stack and add distance of first one.
                 if (unpacked_until_distance + lengthOfFirstSegment >= T_threshold)
@@ -7,9 +7,16 @@
 
 #include <boost/assert.hpp>
 
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_sort.h>
+
+#include <algorithm>
+#include <iterator>
 #include <limits>
 #include <memory>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace osrm
@@ -24,7 +31,7 @@ class ManyToManyRouting final
     : public BasicRoutingInterface<DataFacadeT, ManyToManyRouting<DataFacadeT>>
 {
     using super = BasicRoutingInterface<DataFacadeT, ManyToManyRouting<DataFacadeT>>;
-    using QueryHeap = SearchEngineData::QueryHeap;
+    using QueryHeap = SearchEngineData::ManyToManyQueryHeap;
     SearchEngineData &engine_working_data;
 
     struct NodeBucket
@@ -36,7 +43,65 @@ class ManyToManyRouting final
         {
         }
     };
-    using SearchSpaceWithBuckets = std::unordered_map<NodeID, std::vector<NodeBucket>>;
+
+    // node settled by the backward search of a target
+    struct SettledNode
+    {
+        NodeID node;
+        NodeBucket bucket;
+        SettledNode(const NodeID node, const unsigned target_id, const EdgeWeight distance)
+            : node(node), bucket(target_id, distance)
+        {
+        }
+    };
+    using SettledNodes = std::vector<SettledNode>;
+
+    // Buckets of all backward search spaces stored in flat arrays. The buckets are grouped by
+    // node and bucket_offsets holds the prefix sums of the group sizes of the sorted nodes.
+    class SearchSpaceWithBuckets
+    {
+      public:
+        using BucketRange = std::pair<typename std::vector<NodeBucket>::const_iterator,
+                                      typename std::vector<NodeBucket>::const_iterator>;
+
+        explicit SearchSpaceWithBuckets(SettledNodes &settled_nodes)
+        {
+            tbb::parallel_sort(settled_nodes.begin(), settled_nodes.end(),
+                               [](const SettledNode &lhs, const SettledNode &rhs)
+                               {
+                                   return lhs.node < rhs.node;
+                               });
+
+            buckets.reserve(settled_nodes.size());
+            for (const auto &settled_node : settled_nodes)
+            {
+                if (nodes.empty() || nodes.back() != settled_node.node)
+                {
+                    nodes.push_back(settled_node.node);
+                    bucket_offsets.push_back(static_cast<unsigned>(buckets.size()));
+                }
+                buckets.push_back(settled_node.bucket);
+            }
+            bucket_offsets.push_back(static_cast<unsigned>(buckets.size()));
+        }
+
+        BucketRange GetBuckets(const NodeID node) const
+        {
+            const auto node_iter = std::lower_bound(nodes.begin(), nodes.end(), node);
+            if (node_iter == nodes.end() || *node_iter != node)
+            {
+                return BucketRange(buckets.end(), buckets.end());
+            }
+            const auto index = std::distance(nodes.begin(), node_iter);
+            return BucketRange(buckets.begin() + bucket_offsets[index],
+                               buckets.begin() + bucket_offsets[index + 1]);
+        }
+
+      private:
+        std::vector<NodeID> nodes;
+        std::vector<unsigned> bucket_offsets;
+        std::vector<NodeBucket> buckets;
+    };
 
   public:
     ManyToManyRouting(DataFacadeT *facade, SearchEngineData &engine_working_data)
@@ -46,6 +111,8 @@ class ManyToManyRouting final
 
     ~ManyToManyRouting() {}
 
+    // The searches of the targets and afterwards the searches of the sources run in parallel,
+    // every worker thread uses its own heap.
     std::shared_ptr<std::vector<EdgeWeight>>
     operator()(const std::vector<PhantomNode> &phantom_sources_array,
                const std::vector<PhantomNode> &phantom_targets_array) const
@@ -56,66 +123,87 @@ class ManyToManyRouting final
             std::make_shared<std::vector<EdgeWeight>>(number_of_targets * number_of_sources,
                                                       std::numeric_limits<EdgeWeight>::max());
 
-        engine_working_data.InitializeOrClearFirstThreadLocalStorage(
-            super::facade->GetNumberOfNodes());
+        const auto number_of_nodes = super::facade->GetNumberOfNodes();
 
-        QueryHeap &query_heap = *(engine_working_data.forward_heap_1);
+        tbb::enumerable_thread_specific<SettledNodes> settled_nodes_of_workers;
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, number_of_targets),
+            [&](const tbb::blocked_range<std::size_t> &range)
+            {
+                SettledNodes &settled_nodes = settled_nodes_of_workers.local();
+                for (auto target_id = range.begin(), end = range.end(); target_id != end;
+                     ++target_id)
+                {
+                    engine_working_data.InitializeOrClearManyToManyThreadLocalStorage(
+                        number_of_nodes);
+                    QueryHeap &query_heap = *(engine_working_data.many_to_many_heap);
+                    const auto &phantom = phantom_targets_array[target_id];
 
-        SearchSpaceWithBuckets search_space_with_buckets;
+                    // insert target(s) at distance 0
+                    if (SPECIAL_NODEID != phantom.forward_node_id)
+                    {
+                        query_heap.Insert(phantom.forward_node_id,
+                                          phantom.GetForwardWeightPlusOffset(),
+                                          phantom.forward_node_id);
+                    }
+                    if (SPECIAL_NODEID != phantom.reverse_node_id)
+                    {
+                        query_heap.Insert(phantom.reverse_node_id,
+                                          phantom.GetReverseWeightPlusOffset(),
+                                          phantom.reverse_node_id);
+                    }
 
-        unsigned target_id = 0;
-        for (const auto &phantom : phantom_targets_array)
-        {
-            query_heap.Clear();
-            // insert target(s) at distance 0
+                    // explore search space
+                    while (!query_heap.Empty())
+                    {
+                        BackwardRoutingStep(target_id, query_heap, settled_nodes);
+                    }
+                }
+            });
 
-            if (SPECIAL_NODEID != phantom.forward_node_id)
-            {
-                query_heap.Insert(phantom.forward_node_id, phantom.GetForwardWeightPlusOffset(),
-                                  phantom.forward_node_id);
-            }
-            if (SPECIAL_NODEID != phantom.reverse_node_id)
-            {
-                query_heap.Insert(phantom.reverse_node_id, phantom.GetReverseWeightPlusOffset(),
-                                  phantom.reverse_node_id);
-            }
+        SettledNodes settled_nodes;
+        settled_nodes_of_workers.combine_each([&settled_nodes](const SettledNodes &local)
+                                              {
+                                                  settled_nodes.insert(settled_nodes.end(),
+                                                                       local.begin(), local.end());
+                                              });
+        const SearchSpaceWithBuckets search_space_with_buckets(settled_nodes);
 
-            // explore search space
-            while (!query_heap.Empty())
+        // for each source do forward search, each one fills its own row of the table
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, number_of_sources),
+            [&](const tbb::blocked_range<std::size_t> &range)
             {
-                BackwardRoutingStep(target_id, query_heap, search_space_with_buckets);
-            }
-            ++target_id;
-        }
-
-        // for each source do forward search
-        unsigned source_id = 0;
-        for (const auto &phantom : phantom_sources_array)
-        {
-            query_heap.Clear();
-            // insert target(s) at distance 0
+                for (auto source_id = range.begin(), end = range.end(); source_id != end;
+                     ++source_id)
+                {
+                    engine_working_data.InitializeOrClearManyToManyThreadLocalStorage(
+                        number_of_nodes);
+                    QueryHeap &query_heap = *(engine_working_data.many_to_many_heap);
+                    const auto &phantom = phantom_sources_array[source_id];
 
-            if (SPECIAL_NODEID != phantom.forward_node_id)
-            {
-                query_heap.Insert(phantom.forward_node_id, -phantom.GetForwardWeightPlusOffset(),
-                                  phantom.forward_node_id);
-            }
-            if (SPECIAL_NODEID != phantom.reverse_node_id)
-            {
-                query_heap.Insert(phantom.reverse_node_id, -phantom.GetReverseWeightPlusOffset(),
-                                  phantom.reverse_node_id);
-            }
+                    if (SPECIAL_NODEID != phantom.forward_node_id)
+                    {
+                        query_heap.Insert(phantom.forward_node_id,
+                                          -phantom.GetForwardWeightPlusOffset(),
+                                          phantom.forward_node_id);
+                    }
+                    if (SPECIAL_NODEID != phantom.reverse_node_id)
+                    {
+                        query_heap.Insert(phantom.reverse_node_id,
+                                          -phantom.GetReverseWeightPlusOffset(),
+                                          phantom.reverse_node_id);
+                    }
 
-            // explore search space
-            while (!query_heap.Empty())
-            {
-                ForwardRoutingStep(source_id, number_of_targets, query_heap,
-                                   search_space_with_buckets, result_table);
-            }
+                    // explore search space
+                    while (!query_heap.Empty())
+                    {
+                        ForwardRoutingStep(source_id, number_of_targets, query_heap,
+                                           search_space_with_buckets, *result_table);
+                    }
+                }
+            });
 
-            ++source_id;
-        }
-        // BOOST_ASSERT(source_id == target_id);
         return result_table;
     }
 
@@ -123,114 +211,50 @@ class ManyToManyRouting final
                             const unsigned number_of_targets,
                             QueryHeap &query_heap,
                             const SearchSpaceWithBuckets &search_space_with_buckets,
-                            std::shared_ptr<std::vector<EdgeWeight>> result_table) const
+                            std::vector<EdgeWeight> &result_table) const
     {
         const NodeID node = query_heap.DeleteMin();
         const int source_distance = query_heap.GetKey(node);
 
-        // check if each encountered node has an entry
-        const auto bucket_iterator = search_space_with_buckets.find(node);
-        // iterate bucket if there exists one
-        if (bucket_iterator != search_space_with_buckets.end())
+        // iterate the bucket of the node, it is empty if no backward search settled it
+        const auto bucket_range = search_space_with_buckets.GetBuckets(node);
+        for (auto bucket_iter = bucket_range.first; bucket_iter != bucket_range.second;
+             ++bucket_iter)
         {
-            const std::vector<NodeBucket> &bucket_list = bucket_iterator->second;
-            for (const NodeBucket &current_bucket : bucket_list)
+            // get target id from bucket entry
+            const unsigned target_id = bucket_iter->target_id;
+            const int target_distance = bucket_iter->distance;
+            EdgeWeight &current_distance = result_table[source_id * number_of_targets + target_id];
+            // check if new distance is better
+            const EdgeWeight new_distance = source_distance + target_distance;
+            if (new_distance >= 0 && new_distance < current_distance)
             {
-                // get target id from bucket entry
-                const unsigned target_id = current_bucket.target_id;
-                const int target_distance = current_bucket.distance;
-                const EdgeWeight current_distance =
-                    (*result_table)[source_id * number_of_targets + target_id];
-                // check if new distance is better
-                const EdgeWeight new_distance = source_distance + target_distance;
-                if (new_distance >= 0 && new_distance < current_distance)
-                {
-                    (*result_table)[source_id * number_of_targets + target_id] =
-                        (source_distance + target_distance);
-                }
+                current_distance = new_distance;
             }
         }
-        if (StallAtNode<true>(node, source_distance, query_heap))
+        if (super::template StallAtNode<true>(node, source_distance, query_heap))
         {
             return;
         }
-        RelaxOutgoingEdges<true>(node, source_distance, query_heap);
+        super::template RelaxOutgoingEdges<true>(node, source_distance, query_heap);
     }
 
     void BackwardRoutingStep(const unsigned target_id,
                              QueryHeap &query_heap,
-                             SearchSpaceWithBuckets &search_space_with_buckets) const
+                             SettledNodes &settled_nodes) const
     {
         const NodeID node = query_heap.DeleteMin();
         const int target_distance = query_heap.GetKey(node);
 
         // store settled nodes in search space bucket
-        search_space_with_buckets[node].emplace_back(target_id, target_distance);
+        settled_nodes.emplace_back(node, target_id, target_distance);
 
-        if (StallAtNode<false>(node, target_distance, query_heap))
+        if (super::template StallAtNode<false>(node, target_distance, query_heap))
         {
             return;
         }
 
-        RelaxOutgoingEdges<false>(node, target_distance, query_heap);
-    }
-
-    template <bool forward_direction>
-    inline void
-    RelaxOutgoingEdges(const NodeID node, const EdgeWeight distance, QueryHeap &query_heap) const
-    {
-        for (auto edge : super::facade->GetAdjacentEdgeRange(node))
-        {
-            const auto &data = super::facade->GetEdgeData(edge);
-            const bool direction_flag = (forward_direction ? data.forward : data.backward);
-            if (direction_flag)
-            {
-                const NodeID to = super::facade->GetTarget(edge);
-                const int edge_weight = data.distance;
-
-                BOOST_ASSERT_MSG(edge_weight > 0, "edge_weight invalid");
-                const int to_distance = distance + edge_weight;
-
-                // New Node discovered -> Add to Heap + Node Info Storage
-                if (!query_heap.WasInserted(to))
-                {
-                    query_heap.Insert(to, to_distance, node);
-                }
-                // Found a shorter Path -> Update distance
-                else if (to_distance < query_heap.GetKey(to))
-                {
-                    // new parent
-                    query_heap.GetData(to).parent = node;
-                    query_heap.DecreaseKey(to, to_distance);
-                }
-            }
-        }
-    }
-
-    // Stalling
-    template <bool forward_direction>
-    inline bool
-    StallAtNode(const NodeID node, const EdgeWeight distance, QueryHeap &query_heap) const
-    {
-        for (auto edge : super::facade->GetAdjacentEdgeRange(node))
-        {
-            const auto &data = super::facade->GetEdgeData(edge);
-            const bool reverse_flag = ((!forward_direction) ? data.forward : data.backward);
-            if (reverse_flag)
-            {
-                const NodeID to = super::facade->GetTarget(edge);
-                const int edge_weight = data.distance;
-                BOOST_ASSERT_MSG(edge_weight > 0, "edge_weight invalid");
-                if (query_heap.WasInserted(to))
-                {
-                    if (query_heap.GetKey(to) + edge_weight < distance)
-                    {
-                        return true;
-                    }
-                }
-            }
-        }
-        return false;
+        super::template RelaxOutgoingEdges<false>(node, target_distance, query_heap);
     }
 };
 }
@@ -6,12 +6,14 @@
 #include "util/coordinate_calculation.hpp"
 #include "engine/map_matching/hidden_markov_model.hpp"
 #include "util/json_logger.hpp"
+#include "util/layered_vector.hpp"
 #include "util/matching_debug_info.hpp"
 
+#include <boost/thread/tss.hpp>
+
 #include <cstddef>
 
 #include <algorithm>
-#include <deque>
 #include <iomanip>
 #include <numeric>
 #include <utility>
@@ -32,11 +34,28 @@ struct SubMatching
     double confidence;
 };
 
-using CandidateList = std::vector<PhantomNodeWithDistance>;
-using CandidateLists = std::vector<CandidateList>;
+using CandidateLists = util::LayeredVector<PhantomNodeWithDistance>;
 using HMM = map_matching::HiddenMarkovModel<CandidateLists>;
 using SubMatchingList = std::vector<SubMatching>;
 
+// The memory of the last trace a thread matched, reused for the next one
+struct MapMatchingBuffers
+{
+    HMM model;
+    std::vector<unsigned> sample_times;
+    // used by the transition searches between two timestamps
+    std::vector<std::size_t> backward_targets;
+    std::vector<std::size_t> forward_targets;
+    std::vector<double> emission_probabilities;
+    std::vector<EdgeWeight> target_weights;
+    std::vector<NodeID> target_middles;
+    std::vector<NodeID> packed_path;
+    PathUnpackingBuffers unpacking;
+    std::vector<std::size_t> split_points;
+    std::vector<std::size_t> prev_unbroken_timestamps;
+    std::vector<std::pair<std::size_t, std::size_t>> reconstructed_indices;
+};
+
 constexpr static const unsigned MAX_BROKEN_STATES = 10;
 constexpr static const double MAX_SPEED = 180 / 3.6; // 180km -> m/s
 constexpr static const unsigned SUSPICIOUS_DISTANCE_DELTA = 100;
@@ -46,14 +65,17 @@ template <class DataFacadeT>
 class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<DataFacadeT>>
 {
     using super = BasicRoutingInterface<DataFacadeT, MapMatching<DataFacadeT>>;
-    using QueryHeap = SearchEngineData::QueryHeap;
+    using QueryHeap = SearchEngineData::MapMatchingQueryHeap;
     SearchEngineData &engine_working_data;
+    // static, so they stay valid when the instance is replaced along with its data facade
+    static boost::thread_specific_ptr<MapMatchingBuffers> thread_buffers;
 
-    unsigned GetMedianSampleTime(const std::vector<unsigned> &timestamps) const
+    unsigned GetMedianSampleTime(const std::vector<unsigned> &timestamps,
+                                 std::vector<unsigned> &sample_times) const
     {
         BOOST_ASSERT(timestamps.size() > 1);
 
-        std::vector<unsigned> sample_times(timestamps.size());
+        sample_times.resize(timestamps.size());
 
         std::adjacent_difference(timestamps.begin(), timestamps.end(), sample_times.begin());
 
@@ -65,6 +87,101 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
     }
 
   public:
+    // Searches the paths from a source candidate to all target candidates at once. The forward
+    // search meets the backward searches of the targets, which are kept for all sources of a
+    // timestamp and only advanced as far as a source needs them. Like in a bidirectional query
+    // every search stops as soon as it can not find a shorter path anymore.
+    void SearchTransitions(const PhantomNode &source,
+                           const std::vector<std::size_t> &targets,
+                           QueryHeap &forward_heap,
+                           SearchEngineData::MapMatchingHeapPool &reverse_heaps,
+                           std::vector<EdgeWeight> &target_weights,
+                           std::vector<NodeID> &target_middles) const
+    {
+        for (const auto target : targets)
+        {
+            target_weights[target] = INVALID_EDGE_WEIGHT;
+            target_middles[target] = SPECIAL_NODEID;
+        }
+
+        forward_heap.Clear();
+        if (SPECIAL_NODEID != source.forward_node_id)
+        {
+            forward_heap.Insert(source.forward_node_id, -source.GetForwardWeightPlusOffset(),
+                                source.forward_node_id);
+        }
+        if (SPECIAL_NODEID != source.reverse_node_id)
+        {
+            forward_heap.Insert(source.reverse_node_id, -source.GetReverseWeightPlusOffset(),
+                                source.reverse_node_id);
+        }
+        EdgeWeight min_edge_offset = std::min(0, -source.GetForwardWeightPlusOffset());
+        min_edge_offset = std::min(min_edge_offset, -source.GetReverseWeightPlusOffset());
+
+        const auto update_transition =
+            [&](const std::size_t target, const NodeID middle, const EdgeWeight weight)
+        {
+            if (weight >= 0 && weight < target_weights[target])
+            {
+                target_weights[target] = weight;
+                target_middles[target] = middle;
+            }
+        };
+
+        bool is_searching = true;
+        while (is_searching)
+        {
+            is_searching = false;
+
+            // the backward weights are not negative, the forward search is done once it can
+            // not improve the path to any of the targets
+            EdgeWeight upper_bound = 0;
+            for (const auto target : targets)
+            {
+                upper_bound = std::max(upper_bound, target_weights[target]);
+            }
+            if (!forward_heap.Empty() && forward_heap.MinKey() <= upper_bound)
+            {
+                is_searching = true;
+                const NodeID node = forward_heap.DeleteMin();
+                const EdgeWeight weight = forward_heap.GetKey(node);
+                for (const auto target : targets)
+                {
+                    QueryHeap &reverse_heap = *reverse_heaps[target];
+                    if (reverse_heap.WasInserted(node))
+                    {
+                        update_transition(target, node, weight + reverse_heap.GetKey(node));
+                    }
+                }
+                if (!super::template StallAtNode<true>(node, weight, forward_heap))
+                {
+                    super::template RelaxOutgoingEdges<true>(node, weight, forward_heap);
+                }
+            }
+
+            for (const auto target : targets)
+            {
+                QueryHeap &reverse_heap = *reverse_heaps[target];
+                if (reverse_heap.Empty() ||
+                    reverse_heap.MinKey() + min_edge_offset > target_weights[target])
+                {
+                    continue;
+                }
+                is_searching = true;
+                const NodeID node = reverse_heap.DeleteMin();
+                const EdgeWeight weight = reverse_heap.GetKey(node);
+                if (forward_heap.WasInserted(node))
+                {
+                    update_transition(target, node, forward_heap.GetKey(node) + weight);
+                }
+                if (!super::template StallAtNode<false>(node, weight, reverse_heap))
+                {
+                    super::template RelaxOutgoingEdges<false>(node, weight, reverse_heap);
+                }
+            }
+        }
+    }
+
     MapMatching(DataFacadeT *facade, SearchEngineData &engine_working_data)
         : super(facade), engine_working_data(engine_working_data)
     {
@@ -82,11 +199,17 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
 
         const bool use_timestamps = trace_timestamps.size() > 1;
 
+        if (!thread_buffers.get())
+        {
+            thread_buffers.reset(new MapMatchingBuffers());
+        }
+        MapMatchingBuffers &buffers = *thread_buffers;
+
         const auto median_sample_time = [&]()
         {
             if (use_timestamps)
             {
-                return std::max(1u, GetMedianSampleTime(trace_timestamps));
+                return std::max(1u, GetMedianSampleTime(trace_timestamps, buffers.sample_times));
             }
             else
             {
@@ -110,7 +233,8 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
         map_matching::EmissionLogProbability emission_log_probability(gps_precision);
         map_matching::TransitionLogProbability transition_log_probability(matching_beta);
 
-        HMM model(candidates_list, emission_log_probability);
+        HMM &model = buffers.model;
+        model.reset(candidates_list, emission_log_probability);
 
         std::size_t initial_timestamp = model.initialize(0);
         if (initial_timestamp == map_matching::INVALID_STATE)
@@ -121,16 +245,18 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
         util::MatchingDebugInfo matching_debug(util::json::Logger::get());
         matching_debug.initialize(candidates_list);
 
-        engine_working_data.InitializeOrClearFirstThreadLocalStorage(
-            super::facade->GetNumberOfNodes());
-
-        QueryHeap &forward_heap = *(engine_working_data.forward_heap_1);
-        QueryHeap &reverse_heap = *(engine_working_data.reverse_heap_1);
+        auto &backward_targets = buffers.backward_targets;
+        auto &forward_targets = buffers.forward_targets;
+        auto &emission_probabilities = buffers.emission_probabilities;
+        auto &target_weights = buffers.target_weights;
+        auto &target_middles = buffers.target_middles;
+        auto &packed_path = buffers.packed_path;
 
         std::size_t breakage_begin = map_matching::INVALID_STATE;
-        std::vector<std::size_t> split_points;
-        std::vector<std::size_t> prev_unbroken_timestamps;
-        prev_unbroken_timestamps.reserve(candidates_list.size());
+        auto &split_points = buffers.split_points;
+        split_points.clear();
+        auto &prev_unbroken_timestamps = buffers.prev_unbroken_timestamps;
+        prev_unbroken_timestamps.clear();
         prev_unbroken_timestamps.push_back(initial_timestamp);
         for (auto t = initial_timestamp + 1; t < candidates_list.size(); ++t)
         {
@@ -181,22 +307,74 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
             BOOST_ASSERT(!prev_unbroken_timestamps.empty());
             const std::size_t prev_unbroken_timestamp = prev_unbroken_timestamps.back();
 
-            const auto &prev_viterbi = model.viterbi[prev_unbroken_timestamp];
-            const auto &prev_pruned = model.pruned[prev_unbroken_timestamp];
-            const auto &prev_unbroken_timestamps_list = candidates_list[prev_unbroken_timestamp];
+            const auto prev_viterbi = model.viterbi[prev_unbroken_timestamp];
+            const auto prev_pruned = model.pruned[prev_unbroken_timestamp];
+            const auto prev_unbroken_timestamps_list = candidates_list[prev_unbroken_timestamp];
             const auto &prev_coordinate = trace_coordinates[prev_unbroken_timestamp];
 
-            auto &current_viterbi = model.viterbi[t];
-            auto &current_pruned = model.pruned[t];
-            auto &current_suspicious = model.suspicious[t];
-            auto &current_parents = model.parents[t];
-            auto &current_lengths = model.path_lengths[t];
-            const auto &current_timestamps_list = candidates_list[t];
+            auto current_viterbi = model.viterbi[t];
+            auto current_pruned = model.pruned[t];
+            auto current_suspicious = model.suspicious[t];
+            auto current_parents = model.parents[t];
+            auto current_lengths = model.path_lengths[t];
+            const auto current_timestamps_list = candidates_list[t];
             const auto &current_coordinate = trace_coordinates[t];
 
             const auto haversine_distance = util::coordinate_calculation::haversineDistance(
                 prev_coordinate, current_coordinate);
 
+            // A path is at least as long as the great circle between its ends. Transitions that
+            // would be pruned even then need no search at all.
+            const auto is_plausible = [&](const std::size_t s, const std::size_t s_prime)
+            {
+                const auto lower_bound_distance = util::coordinate_calculation::haversineDistance(
+                    prev_unbroken_timestamps_list[s].phantom_node.location,
+                    current_timestamps_list[s_prime].phantom_node.location);
+                return lower_bound_distance - haversine_distance < max_distance_delta;
+            };
+
+            // how likely is candidate s_prime at time t to be emitted?
+            emission_probabilities.resize(current_viterbi.size());
+            target_weights.resize(current_viterbi.size());
+            target_middles.resize(current_viterbi.size());
+            backward_targets.clear();
+            for (const auto s_prime : util::irange<std::size_t>(0u, current_viterbi.size()))
+            {
+                emission_probabilities[s_prime] =
+                    emission_log_probability(current_timestamps_list[s_prime].distance);
+                for (const auto s : util::irange<std::size_t>(0u, prev_viterbi.size()))
+                {
+                    if (!prev_pruned[s] && is_plausible(s, s_prime))
+                    {
+                        backward_targets.push_back(s_prime);
+                        break;
+                    }
+                }
+            }
+
+            // one backward search per candidate of this timestamp and one forward search per
+            // candidate of the previous one instead of a query for each pair
+            engine_working_data.InitializeOrClearMapMatchingThreadLocalStorage(
+                super::facade->GetNumberOfNodes(), current_viterbi.size());
+            QueryHeap &forward_heap = *engine_working_data.map_matching_forward_heap;
+            auto &reverse_heaps = *engine_working_data.map_matching_reverse_heaps;
+            for (const auto s_prime : backward_targets)
+            {
+                const auto &phantom = current_timestamps_list[s_prime].phantom_node;
+                if (SPECIAL_NODEID != phantom.forward_node_id)
+                {
+                    reverse_heaps[s_prime]->Insert(phantom.forward_node_id,
+                                                   phantom.GetForwardWeightPlusOffset(),
+                                                   phantom.forward_node_id);
+                }
+                if (SPECIAL_NODEID != phantom.reverse_node_id)
+                {
+                    reverse_heaps[s_prime]->Insert(phantom.reverse_node_id,
+                                                   phantom.GetReverseWeightPlusOffset(),
+                                                   phantom.reverse_node_id);
+                }
+            }
+
             // compute d_t for this timestamp and the next one
             for (const auto s : util::irange<std::size_t>(0u, prev_viterbi.size()))
             {
@@ -205,25 +383,37 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
                     continue;
                 }
 
-                for (const auto s_prime : util::irange<std::size_t>(0u, current_viterbi.size()))
+                forward_targets.clear();
+                for (const auto s_prime : backward_targets)
                 {
-                    // how likely is candidate s_prime at time t to be emitted?
-                    // FIXME this can be pre-computed
-                    const double emission_pr =
-                        emission_log_probability(candidates_list[t][s_prime].distance);
-                    double new_value = prev_viterbi[s] + emission_pr;
-                    if (current_viterbi[s_prime] > new_value)
+                    const double max_value = prev_viterbi[s] + emission_probabilities[s_prime];
+                    if (current_viterbi[s_prime] <= max_value && is_plausible(s, s_prime))
                     {
-                        continue;
+                        forward_targets.push_back(s_prime);
                     }
+                }
+                if (forward_targets.empty())
+                {
+                    continue;
+                }
 
-                    forward_heap.Clear();
-                    reverse_heap.Clear();
+                SearchTransitions(prev_unbroken_timestamps_list[s].phantom_node, forward_targets,
+                                  forward_heap, reverse_heaps, target_weights, target_middles);
+
+                for (const auto s_prime : forward_targets)
+                {
+                    if (INVALID_EDGE_WEIGHT == target_weights[s_prime])
+                    {
+                        continue;
+                    }
 
                     // get distance diff between loc1/2 and locs/s_prime
-                    const auto network_distance = super::get_network_distance(
-                        forward_heap, reverse_heap, prev_unbroken_timestamps_list[s].phantom_node,
-                        current_timestamps_list[s_prime].phantom_node);
+                    packed_path.clear();
+                    super::RetrievePackedPathFromHeap(forward_heap, *reverse_heaps[s_prime],
+                                                      target_middles[s_prime], packed_path);
+                    const auto network_distance = super::get_path_distance(
+                        packed_path, prev_unbroken_timestamps_list[s].phantom_node,
+                        current_timestamps_list[s_prime].phantom_node, buffers.unpacking);
 
                     const auto d_t = std::abs(network_distance - haversine_distance);
 
@@ -233,8 +423,9 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
                         continue;
                     }
 
+                    const double emission_pr = emission_probabilities[s_prime];
                     const double transition_pr = transition_log_probability(d_t);
-                    new_value += transition_pr;
+                    const double new_value = prev_viterbi[s] + emission_pr + transition_pr;
 
                     matching_debug.add_transition_info(prev_unbroken_timestamp, t, s, s_prime,
                                                        prev_viterbi[s], emission_pr, transition_pr,
@@ -308,7 +499,9 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
             std::size_t parent_candidate_index =
                 std::distance(model.viterbi[parent_timestamp_index].begin(), max_element_iter);
 
-            std::deque<std::pair<std::size_t, std::size_t>> reconstructed_indices;
+            // collected from the back of the matching to its front
+            auto &reconstructed_indices = buffers.reconstructed_indices;
+            reconstructed_indices.clear();
             while (parent_timestamp_index > sub_matching_begin)
             {
                 if (model.breakage[parent_timestamp_index])
@@ -316,7 +509,7 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
                     continue;
                 }
 
-                reconstructed_indices.emplace_front(parent_timestamp_index, parent_candidate_index);
+                reconstructed_indices.emplace_back(parent_timestamp_index, parent_candidate_index);
                 const auto &next = model.parents[parent_timestamp_index][parent_candidate_index];
                 // make sure we can never get stuck in this loop
                 if (parent_timestamp_index == next.first)
@@ -326,7 +519,8 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
                 parent_timestamp_index = next.first;
                 parent_candidate_index = next.second;
             }
-            reconstructed_indices.emplace_front(parent_timestamp_index, parent_candidate_index);
+            reconstructed_indices.emplace_back(parent_timestamp_index, parent_candidate_index);
+            std::reverse(reconstructed_indices.begin(), reconstructed_indices.end());
             if (reconstructed_indices.size() < 2)
             {
                 sub_matching_begin = sub_matching_end;
@@ -354,6 +548,9 @@ class MapMatching final : public BasicRoutingInterface<DataFacadeT, MapMatching<
         matching_debug.add_breakage(model.breakage);
     }
 };
+
+template <class DataFacadeT>
+boost::thread_specific_ptr<MapMatchingBuffers> MapMatching<DataFacadeT>::thread_buffers;
 }
 }
 }
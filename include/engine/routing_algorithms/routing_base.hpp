@@ -9,22 +9,26 @@
 #include <boost/assert.hpp>
 
 #include <stack>
+#include <utility>
+#include <vector>
 
 namespace osrm
 {
 namespace engine
 {
 
-SearchEngineData::SearchEngineHeapPtr SearchEngineData::forward_heap_1;
-SearchEngineData::SearchEngineHeapPtr SearchEngineData::reverse_heap_1;
-SearchEngineData::SearchEngineHeapPtr SearchEngineData::forward_heap_2;
-SearchEngineData::SearchEngineHeapPtr SearchEngineData::reverse_heap_2;
-SearchEngineData::SearchEngineHeapPtr SearchEngineData::forward_heap_3;
-SearchEngineData::SearchEngineHeapPtr SearchEngineData::reverse_heap_3;
-
 namespace routing_algorithms
 {
 
+// Memory of the path unpacking that callers unpacking many paths keep between them
+struct PathUnpackingBuffers
+{
+    // the edges that are still to be unpacked, the next one is at the back
+    std::vector<std::pair<NodeID, NodeID>> recursion_stack;
+    std::vector<unsigned> geometry;
+    std::vector<PathData> unpacked_path;
+};
+
 template <class DataFacadeT, class Derived> class BasicRoutingInterface
 {
   private:
@@ -106,11 +110,11 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
         {
             for (const auto edge : facade->GetAdjacentEdgeRange(node))
             {
-                const EdgeData &data = facade->GetEdgeData(edge);
+                const auto &data = facade->GetSearchData(edge);
                 const bool reverse_flag = ((!forward_direction) ? data.forward : data.backward);
                 if (reverse_flag)
                 {
-                    const NodeID to = facade->GetTarget(edge);
+                    const NodeID to = data.target;
                     const int edge_weight = data.distance;
 
                     BOOST_ASSERT_MSG(edge_weight > 0, "edge_weight invalid");
@@ -128,12 +132,12 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
 
         for (const auto edge : facade->GetAdjacentEdgeRange(node))
         {
-            const EdgeData &data = facade->GetEdgeData(edge);
+            const auto &data = facade->GetSearchData(edge);
             bool forward_directionFlag = (forward_direction ? data.forward : data.backward);
             if (forward_directionFlag)
             {
 
-                const NodeID to = facade->GetTarget(edge);
+                const NodeID to = data.target;
                 const int edge_weight = data.distance;
 
                 BOOST_ASSERT_MSG(edge_weight > 0, "edge_weight invalid");
@@ -155,11 +159,80 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
         }
     }
 
+    // Relaxes the edges of a node settled by a search that is not run bidirectionally
+    template <bool forward_direction, typename HeapT>
+    void RelaxOutgoingEdges(const NodeID node, const EdgeWeight distance, HeapT &query_heap) const
+    {
+        for (auto edge : facade->GetAdjacentEdgeRange(node))
+        {
+            const auto &data = facade->GetSearchData(edge);
+            const bool direction_flag = (forward_direction ? data.forward : data.backward);
+            if (direction_flag)
+            {
+                const NodeID to = data.target;
+                const int edge_weight = data.distance;
+
+                BOOST_ASSERT_MSG(edge_weight > 0, "edge_weight invalid");
+                const int to_distance = distance + edge_weight;
+
+                // New Node discovered -> Add to Heap + Node Info Storage
+                if (!query_heap.WasInserted(to))
+                {
+                    query_heap.Insert(to, to_distance, node);
+                }
+                // Found a shorter Path -> Update distance
+                else if (to_distance < query_heap.GetKey(to))
+                {
+                    // new parent
+                    query_heap.GetData(to).parent = node;
+                    query_heap.DecreaseKey(to, to_distance);
+                }
+            }
+        }
+    }
+
+    // Stalling
+    template <bool forward_direction, typename HeapT>
+    bool StallAtNode(const NodeID node, const EdgeWeight distance, HeapT &query_heap) const
+    {
+        for (auto edge : facade->GetAdjacentEdgeRange(node))
+        {
+            const auto &data = facade->GetSearchData(edge);
+            const bool reverse_flag = ((!forward_direction) ? data.forward : data.backward);
+            if (reverse_flag)
+            {
+                const NodeID to = data.target;
+                const int edge_weight = data.distance;
+                BOOST_ASSERT_MSG(edge_weight > 0, "edge_weight invalid");
+                if (query_heap.WasInserted(to))
+                {
+                    if (query_heap.GetKey(to) + edge_weight < distance)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
     template <typename RandomIter>
     void UnpackPath(RandomIter packed_path_begin,
                     RandomIter packed_path_end,
                     const PhantomNodes &phantom_node_pair,
                     std::vector<PathData> &unpacked_path) const
+    {
+        PathUnpackingBuffers buffers;
+        UnpackPath(packed_path_begin, packed_path_end, phantom_node_pair, unpacked_path, buffers);
+    }
+
+    // uses the recursion stack and the geometry of the buffers, not their unpacked path
+    template <typename RandomIter>
+    void UnpackPath(RandomIter packed_path_begin,
+                    RandomIter packed_path_end,
+                    const PhantomNodes &phantom_node_pair,
+                    std::vector<PathData> &unpacked_path,
+                    PathUnpackingBuffers &buffers) const
     {
         const bool start_traversed_in_reverse =
             (*packed_path_begin != phantom_node_pair.source_phantom.forward_node_id);
@@ -167,13 +240,15 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
             (*std::prev(packed_path_end) != phantom_node_pair.target_phantom.forward_node_id);
 
         BOOST_ASSERT(std::distance(packed_path_begin, packed_path_end) > 0);
-        std::stack<std::pair<NodeID, NodeID>> recursion_stack;
+        auto &recursion_stack = buffers.recursion_stack;
+        auto &id_vector = buffers.geometry;
+        recursion_stack.clear();
 
         // We have to push the path in reverse order onto the stack because it's LIFO.
         for (auto current = std::prev(packed_path_end); current != packed_path_begin;
              current = std::prev(current))
         {
-            recursion_stack.emplace(*std::prev(current), *current);
+            recursion_stack.emplace_back(*std::prev(current), *current);
         }
 
         std::pair<NodeID, NodeID> edge;
@@ -182,8 +257,8 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
             // edge.first         edge.second
             //     *------------------>*
             //            edge_id
-            edge = recursion_stack.top();
-            recursion_stack.pop();
+            edge = recursion_stack.back();
+            recursion_stack.pop_back();
 
             // facade->FindEdge does not suffice here in case of shortcuts.
             // The above explanation unclear? Think!
@@ -191,9 +266,9 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
             int edge_weight = std::numeric_limits<EdgeWeight>::max();
             for (const auto edge_id : facade->GetAdjacentEdgeRange(edge.first))
             {
-                const int weight = facade->GetEdgeData(edge_id).distance;
-                if ((facade->GetTarget(edge_id) == edge.second) && (weight < edge_weight) &&
-                    facade->GetEdgeData(edge_id).forward)
+                const auto &data = facade->GetSearchData(edge_id);
+                const int weight = data.distance;
+                if ((data.target == edge.second) && (weight < edge_weight) && data.forward)
                 {
                     smaller_edge_id = edge_id;
                     edge_weight = weight;
@@ -207,9 +282,9 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
             {
                 for (const auto edge_id : facade->GetAdjacentEdgeRange(edge.second))
                 {
-                    const int weight = facade->GetEdgeData(edge_id).distance;
-                    if ((facade->GetTarget(edge_id) == edge.first) && (weight < edge_weight) &&
-                        facade->GetEdgeData(edge_id).backward)
+                    const auto &data = facade->GetSearchData(edge_id);
+                    const int weight = data.distance;
+                    if ((data.target == edge.first) && (weight < edge_weight) && data.backward)
                     {
                         smaller_edge_id = edge_id;
                         edge_weight = weight;
@@ -218,13 +293,13 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
             }
             BOOST_ASSERT_MSG(edge_weight != INVALID_EDGE_WEIGHT, "edge id invalid");
 
-            const EdgeData &ed = facade->GetEdgeData(smaller_edge_id);
+            const EdgeData ed = facade->GetEdgeData(smaller_edge_id);
             if (ed.shortcut)
             { // unpack
                 const NodeID middle_node_id = ed.id;
                 // again, we need to this in reversed order
-                recursion_stack.emplace(middle_node_id, edge.second);
-                recursion_stack.emplace(edge.first, middle_node_id);
+                recursion_stack.emplace_back(middle_node_id, edge.second);
+                recursion_stack.emplace_back(edge.first, middle_node_id);
             }
             else
             {
@@ -242,7 +317,6 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
                 }
                 else
                 {
-                    std::vector<unsigned> id_vector;
                     facade->GetUncompressedGeometry(facade->GetGeometryIndexForEdgeID(ed.id),
                                                     id_vector);
 
@@ -270,7 +344,6 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
         }
         if (SPECIAL_EDGEID != phantom_node_pair.target_phantom.packed_geometry_id)
         {
-            std::vector<unsigned> id_vector;
             facade->GetUncompressedGeometry(phantom_node_pair.target_phantom.packed_geometry_id,
                                             id_vector);
             const bool is_local_path = (phantom_node_pair.source_phantom.packed_geometry_id ==
@@ -348,9 +421,9 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
             int edge_weight = std::numeric_limits<EdgeWeight>::max();
             for (const auto edge_id : facade->GetAdjacentEdgeRange(edge.first))
             {
-                const int weight = facade->GetEdgeData(edge_id).distance;
-                if ((facade->GetTarget(edge_id) == edge.second) && (weight < edge_weight) &&
-                    facade->GetEdgeData(edge_id).forward)
+                const auto &data = facade->GetSearchData(edge_id);
+                const int weight = data.distance;
+                if ((data.target == edge.second) && (weight < edge_weight) && data.forward)
                 {
                     smaller_edge_id = edge_id;
                     edge_weight = weight;
@@ -361,9 +434,9 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
             {
                 for (const auto edge_id : facade->GetAdjacentEdgeRange(edge.second))
                 {
-                    const int weight = facade->GetEdgeData(edge_id).distance;
-                    if ((facade->GetTarget(edge_id) == edge.first) && (weight < edge_weight) &&
-                        facade->GetEdgeData(edge_id).backward)
+                    const auto &data = facade->GetSearchData(edge_id);
+                    const int weight = data.distance;
+                    if ((data.target == edge.first) && (weight < edge_weight) && data.backward)
                     {
                         smaller_edge_id = edge_id;
                         edge_weight = weight;
@@ -373,7 +446,7 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
             BOOST_ASSERT_MSG(edge_weight != std::numeric_limits<EdgeWeight>::max(),
                              "edge weight invalid");
 
-            const EdgeData &ed = facade->GetEdgeData(smaller_edge_id);
+            const EdgeData ed = facade->GetEdgeData(smaller_edge_id);
             if (ed.shortcut)
             { // unpack
                 const NodeID middle_node_id = ed.id;
@@ -390,8 +463,9 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
         unpacked_path.emplace_back(t);
     }
 
-    void RetrievePackedPathFromHeap(const SearchEngineData::QueryHeap &forward_heap,
-                                    const SearchEngineData::QueryHeap &reverse_heap,
+    template <typename HeapT>
+    void RetrievePackedPathFromHeap(const HeapT &forward_heap,
+                                    const HeapT &reverse_heap,
                                     const NodeID middle_node_id,
                                     std::vector<NodeID> &packed_path) const
     {
@@ -401,7 +475,8 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
         RetrievePackedPathFromSingleHeap(reverse_heap, middle_node_id, packed_path);
     }
 
-    void RetrievePackedPathFromSingleHeap(const SearchEngineData::QueryHeap &search_heap,
+    template <typename HeapT>
+    void RetrievePackedPathFromSingleHeap(const HeapT &search_heap,
                                           const NodeID middle_node_id,
                                           std::vector<NodeID> &packed_path) const
     {
@@ -647,25 +722,44 @@ template <class DataFacadeT, class Derived> class BasicRoutingInterface
         {
             std::vector<NodeID> packed_leg;
             RetrievePackedPathFromHeap(forward_heap, reverse_heap, middle_node, packed_leg);
-            std::vector<PathData> unpacked_path;
-            PhantomNodes nodes;
-            nodes.source_phantom = source_phantom;
-            nodes.target_phantom = target_phantom;
-            UnpackPath(packed_leg.begin(), packed_leg.end(), nodes, unpacked_path);
-
-            util::FixedPointCoordinate previous_coordinate = source_phantom.location;
-            util::FixedPointCoordinate current_coordinate;
-            distance = 0;
-            for (const auto &p : unpacked_path)
-            {
-                current_coordinate = facade->GetCoordinateOfNode(p.node);
-                distance += util::coordinate_calculation::haversineDistance(previous_coordinate,
-                                                                            current_coordinate);
-                previous_coordinate = current_coordinate;
-            }
+            distance = get_path_distance(packed_leg, source_phantom, target_phantom);
+        }
+        return distance;
+    }
+
+    // length of the geometry of a packed path between two phantom nodes
+    double get_path_distance(const std::vector<NodeID> &packed_leg,
+                             const PhantomNode &source_phantom,
+                             const PhantomNode &target_phantom) const
+    {
+        PathUnpackingBuffers buffers;
+        return get_path_distance(packed_leg, source_phantom, target_phantom, buffers);
+    }
+
+    double get_path_distance(const std::vector<NodeID> &packed_leg,
+                             const PhantomNode &source_phantom,
+                             const PhantomNode &target_phantom,
+                             PathUnpackingBuffers &buffers) const
+    {
+        auto &unpacked_path = buffers.unpacked_path;
+        unpacked_path.clear();
+        PhantomNodes nodes;
+        nodes.source_phantom = source_phantom;
+        nodes.target_phantom = target_phantom;
+        UnpackPath(packed_leg.begin(), packed_leg.end(), nodes, unpacked_path, buffers);
+
+        util::FixedPointCoordinate previous_coordinate = source_phantom.location;
+        util::FixedPointCoordinate current_coordinate;
+        double distance = 0;
+        for (const auto &p : unpacked_path)
+        {
+            current_coordinate = facade->GetCoordinateOfNode(p.node);
             distance += util::coordinate_calculation::haversineDistance(previous_coordinate,
-                                                                        target_phantom.location);
+                                                                        current_coordinate);
+            previous_coordinate = current_coordinate;
         }
+        distance += util::coordinate_calculation::haversineDistance(previous_coordinate,
+                                                                    target_phantom.location);
         return distance;
     }
 };
@@ -10,6 +10,12 @@
 
 #include <boost/assert.hpp>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <utility>
+#include <vector>
+
 namespace osrm
 {
 namespace engine
@@ -17,6 +23,9 @@ namespace engine
 namespace routing_algorithms
 {
 
+// Routes with at least this many legs search their legs in parallel
+constexpr static const std::size_t MIN_LEGS_FOR_PARALLEL_SEARCH = 8;
+
 template <class DataFacadeT>
 class ShortestPathRouting final
     : public BasicRoutingInterface<DataFacadeT, ShortestPathRouting<DataFacadeT>>
@@ -24,10 +33,34 @@ class ShortestPathRouting final
     using super = BasicRoutingInterface<DataFacadeT, ShortestPathRouting<DataFacadeT>>;
     using QueryHeap = SearchEngineData::QueryHeap;
     SearchEngineData &engine_working_data;
+    const std::size_t min_legs_for_parallel_search;
+
+    // Paths of a leg from each source node, searched before the distances of the previous legs
+    // are known. Indexed by [source][target], 0 is the forward and 1 the reverse node. If a
+    // u-turn is allowed at the via, both target nodes are searched at once into [source][0].
+    struct LegPaths
+    {
+        LegPaths() : is_searched(false)
+        {
+            for (auto &distances : distance)
+            {
+                distances[0] = distances[1] = INVALID_EDGE_WEIGHT;
+            }
+        }
+
+        bool is_searched;
+        int distance[2][2];
+        std::vector<NodeID> packed_path[2][2];
+    };
 
   public:
-    ShortestPathRouting(DataFacadeT *facade, SearchEngineData &engine_working_data)
-        : super(facade), engine_working_data(engine_working_data)
+    // routes with fewer than min_legs_for_parallel_search legs are searched sequentially
+    ShortestPathRouting(DataFacadeT *facade,
+                        SearchEngineData &engine_working_data,
+                        const std::size_t min_legs_for_parallel_search =
+                            MIN_LEGS_FOR_PARALLEL_SEARCH)
+        : super(facade), engine_working_data(engine_working_data),
+          min_legs_for_parallel_search(min_legs_for_parallel_search)
     {
     }
 
@@ -117,10 +150,10 @@ class ShortestPathRouting final
 
             for (const auto edge : super::facade->GetAdjacentEdgeRange(node_id))
             {
-                const auto &data = super::facade->GetEdgeData(edge);
+                const auto &data = super::facade->GetSearchData(edge);
                 if (data.forward)
                 {
-                    auto target = super::facade->GetTarget(edge);
+                    auto target = data.target;
                     auto offset = total_distance_to_forward + data.distance -
                                   source_phantom.GetForwardWeightPlusOffset();
                     forward_heap.Insert(target, offset, target);
@@ -128,7 +161,7 @@ class ShortestPathRouting final
 
                 if (data.backward)
                 {
-                    auto target = super::facade->GetTarget(edge);
+                    auto target = data.target;
                     auto offset = data.distance + target_phantom.GetForwardWeightPlusOffset();
                     reverse_heap.Insert(target, offset, target);
                 }
@@ -155,10 +188,10 @@ class ShortestPathRouting final
 
             for (const auto edge : super::facade->GetAdjacentEdgeRange(node_id))
             {
-                const auto &data = super::facade->GetEdgeData(edge);
+                const auto &data = super::facade->GetSearchData(edge);
                 if (data.forward)
                 {
-                    auto target = super::facade->GetTarget(edge);
+                    auto target = data.target;
                     auto offset = total_distance_to_reverse + data.distance -
                                   source_phantom.GetReverseWeightPlusOffset();
                     forward_heap.Insert(target, offset, target);
@@ -166,7 +199,7 @@ class ShortestPathRouting final
 
                 if (data.backward)
                 {
-                    auto target = super::facade->GetTarget(edge);
+                    auto target = data.target;
                     auto offset = data.distance + target_phantom.GetReverseWeightPlusOffset();
                     reverse_heap.Insert(target, offset, target);
                 }
@@ -259,6 +292,167 @@ class ShortestPathRouting final
         }
     }
 
+    // Searches the legs that do not start and end on the same node in parallel. Each source
+    // node is searched on its own, so that StitchLeg can later pick the one that continues the
+    // previous legs best. Legs on a single node depend on the distances to the previous via
+    // and are left to the sequential search.
+    std::vector<LegPaths>
+    SearchLegsInParallel(const std::vector<PhantomNodes> &phantom_nodes_vector,
+                         const std::vector<bool> &uturn_indicators) const
+    {
+        std::vector<LegPaths> legs(phantom_nodes_vector.size());
+        tbb::parallel_for(
+            tbb::blocked_range<std::size_t>(0, phantom_nodes_vector.size()),
+            [&](const tbb::blocked_range<std::size_t> &range)
+            {
+                engine_working_data.InitializeOrClearSecondThreadLocalStorage(
+                    super::facade->GetNumberOfNodes());
+                QueryHeap &forward_heap = *(engine_working_data.forward_heap_2);
+                QueryHeap &reverse_heap = *(engine_working_data.reverse_heap_2);
+
+                for (auto current_leg = range.begin(); current_leg != range.end(); ++current_leg)
+                {
+                    const auto &source_phantom = phantom_nodes_vector[current_leg].source_phantom;
+                    const auto &target_phantom = phantom_nodes_vector[current_leg].target_phantom;
+                    const NodeID source_nodes[2] = {source_phantom.forward_node_id,
+                                                    source_phantom.reverse_node_id};
+                    const int source_offsets[2] = {source_phantom.GetForwardWeightPlusOffset(),
+                                                   source_phantom.GetReverseWeightPlusOffset()};
+                    const NodeID target_nodes[2] = {target_phantom.forward_node_id,
+                                                    target_phantom.reverse_node_id};
+                    const int target_offsets[2] = {target_phantom.GetForwardWeightPlusOffset(),
+                                                   target_phantom.GetReverseWeightPlusOffset()};
+
+                    const auto is_shared = [&target_nodes](const NodeID node)
+                    {
+                        return node != SPECIAL_NODEID &&
+                               (node == target_nodes[0] || node == target_nodes[1]);
+                    };
+                    if (is_shared(source_nodes[0]) || is_shared(source_nodes[1]))
+                    {
+                        continue;
+                    }
+
+                    auto &leg = legs[current_leg];
+                    const bool allow_u_turn_at_via = uturn_indicators[current_leg + 1];
+                    for (const auto source : {0, 1})
+                    {
+                        if (source_nodes[source] == SPECIAL_NODEID)
+                        {
+                            continue;
+                        }
+                        for (const auto target : {0, 1})
+                        {
+                            if (target_nodes[target] == SPECIAL_NODEID)
+                            {
+                                continue;
+                            }
+                            // with a u-turn at the via one search goes to both target nodes
+                            if (!allow_u_turn_at_via || reverse_heap.Empty())
+                            {
+                                forward_heap.Clear();
+                                reverse_heap.Clear();
+                                forward_heap.Insert(source_nodes[source], -source_offsets[source],
+                                                    source_nodes[source]);
+                            }
+                            reverse_heap.Insert(target_nodes[target], target_offsets[target],
+                                                target_nodes[target]);
+                            if (!allow_u_turn_at_via)
+                            {
+                                super::Search(forward_heap, reverse_heap,
+                                              leg.distance[source][target],
+                                              leg.packed_path[source][target]);
+                            }
+                        }
+                        if (allow_u_turn_at_via && !reverse_heap.Empty())
+                        {
+                            super::Search(forward_heap, reverse_heap, leg.distance[source][0],
+                                          leg.packed_path[source][0]);
+                        }
+                    }
+                    leg.is_searched = true;
+                }
+            });
+        return legs;
+    }
+
+    // Continues the previous legs with the paths of a leg that was searched in parallel. This
+    // computes the same as Search and SearchWithUTurn do with both source nodes in the heap.
+    void StitchLeg(LegPaths &leg,
+                   const bool allow_u_turn_at_via,
+                   const bool search_from_forward_node,
+                   const bool search_from_reverse_node,
+                   const PhantomNode &target_phantom,
+                   const int total_distance_to_forward,
+                   const int total_distance_to_reverse,
+                   int &new_total_distance_to_forward,
+                   int &new_total_distance_to_reverse,
+                   std::vector<NodeID> &leg_packed_path_forward,
+                   std::vector<NodeID> &leg_packed_path_reverse) const
+    {
+        const bool search_from[2] = {search_from_forward_node, search_from_reverse_node};
+        const int total_distance[2] = {total_distance_to_forward, total_distance_to_reverse};
+
+        // continues from the source that reaches the target of the given path index first. On a
+        // tie the shorter path wins: it is the one that does not pass through the other source
+        // node, which is also what the combined sequential search settles on.
+        const auto continue_best = [&](const std::size_t path_index, int &new_total_distance,
+                                       std::vector<NodeID> &leg_packed_path)
+        {
+            int best_source = -1;
+            for (const auto source : {0, 1})
+            {
+                if (!search_from[source] ||
+                    INVALID_EDGE_WEIGHT == leg.distance[source][path_index])
+                {
+                    continue;
+                }
+                const int distance = total_distance[source] + leg.distance[source][path_index];
+                if (distance < new_total_distance ||
+                    (distance == new_total_distance && best_source >= 0 &&
+                     leg.packed_path[source][path_index].size() <
+                         leg.packed_path[best_source][path_index].size()))
+                {
+                    new_total_distance = distance;
+                    best_source = source;
+                }
+            }
+            if (best_source >= 0)
+            {
+                leg_packed_path = std::move(leg.packed_path[best_source][path_index]);
+            }
+        };
+
+        if (allow_u_turn_at_via)
+        {
+            // as in the sequential case, the path to either target node continues to both
+            if (target_phantom.forward_node_id == SPECIAL_NODEID)
+            {
+                continue_best(0, new_total_distance_to_reverse, leg_packed_path_reverse);
+            }
+            else
+            {
+                continue_best(0, new_total_distance_to_forward, leg_packed_path_forward);
+                if (target_phantom.reverse_node_id != SPECIAL_NODEID)
+                {
+                    new_total_distance_to_reverse = new_total_distance_to_forward;
+                    leg_packed_path_reverse = leg_packed_path_forward;
+                }
+            }
+        }
+        else
+        {
+            if (target_phantom.forward_node_id != SPECIAL_NODEID)
+            {
+                continue_best(0, new_total_distance_to_forward, leg_packed_path_forward);
+            }
+            if (target_phantom.reverse_node_id != SPECIAL_NODEID)
+            {
+                continue_best(1, new_total_distance_to_reverse, leg_packed_path_reverse);
+            }
+        }
+    }
+
     void UnpackLegs(const std::vector<PhantomNodes> &phantom_nodes_vector,
                     const std::vector<NodeID> &total_packed_path,
                     const std::vector<std::size_t> &packed_leg_begin,
@@ -311,6 +505,14 @@ class ShortestPathRouting final
         std::vector<NodeID> total_packed_path_to_reverse;
         std::vector<std::size_t> packed_leg_to_reverse_begin;
 
+        // long routes search their legs up front on all cores and only stitch them together
+        // in the dynamic program below
+        std::vector<LegPaths> parallel_legs;
+        if (phantom_nodes_vector.size() >= min_legs_for_parallel_search)
+        {
+            parallel_legs = SearchLegsInParallel(phantom_nodes_vector, uturn_indicators);
+        }
+
         std::size_t current_leg = 0;
         // this implements a dynamic program that finds the shortest route through
         // a list of vias
@@ -351,7 +553,15 @@ class ShortestPathRouting final
 
             BOOST_ASSERT(search_from_forward_node || search_from_reverse_node);
 
-            if (search_to_reverse_node || search_to_forward_node)
+            if (!parallel_legs.empty() && parallel_legs[current_leg].is_searched)
+            {
+                StitchLeg(parallel_legs[current_leg], allow_u_turn_at_via, search_from_forward_node,
+                          search_from_reverse_node, target_phantom, total_distance_to_forward,
+                          total_distance_to_reverse, new_total_distance_to_forward,
+                          new_total_distance_to_reverse, packed_leg_to_forward,
+                          packed_leg_to_reverse);
+            }
+            else if (search_to_reverse_node || search_to_forward_node)
             {
                 if (allow_u_turn_at_via)
                 {
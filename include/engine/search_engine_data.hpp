@@ -6,6 +6,9 @@
 #include "util/typedefs.hpp"
 #include "util/binary_heap.hpp"
 
+#include <memory>
+#include <vector>
+
 namespace osrm
 {
 namespace engine
@@ -19,22 +22,52 @@ struct HeapData
 
 struct SearchEngineData
 {
+    // The point to point searches settle few nodes compared to the size of the graph, a hash map
+    // keeps the memory of their heaps small.
     using QueryHeap =
         util::BinaryHeap<NodeID, NodeID, int, HeapData, util::UnorderedMapStorage<NodeID, int>>;
     using SearchEngineHeapPtr = boost::thread_specific_ptr<QueryHeap>;
 
+    // The many-to-many searches reuse a single heap per thread for all sources and targets,
+    // hence a dense index pays off there.
+    using ManyToManyQueryHeap = util::
+        BinaryHeap<NodeID, NodeID, int, HeapData, util::GenerationArrayStorage<NodeID, int>, 4>;
+    using ManyToManyHeapPtr = boost::thread_specific_ptr<ManyToManyQueryHeap>;
+
+    // The map matching runs a search for every pair of consecutive timestamps, its heaps keep
+    // their memory between the searches.
+    using MapMatchingQueryHeap =
+        util::BinaryHeap<NodeID, NodeID, int, HeapData, util::GenerationHashStorage<NodeID, int>>;
+    using MapMatchingHeapPtr = boost::thread_specific_ptr<MapMatchingQueryHeap>;
+
+    using MapMatchingHeapPool = std::vector<std::unique_ptr<MapMatchingQueryHeap>>;
+    using MapMatchingHeapPoolPtr = boost::thread_specific_ptr<MapMatchingHeapPool>;
+
     static SearchEngineHeapPtr forward_heap_1;
     static SearchEngineHeapPtr reverse_heap_1;
     static SearchEngineHeapPtr forward_heap_2;
     static SearchEngineHeapPtr reverse_heap_2;
     static SearchEngineHeapPtr forward_heap_3;
     static SearchEngineHeapPtr reverse_heap_3;
+    // used by the workers of the parallel many-to-many searches
+    static ManyToManyHeapPtr many_to_many_heap;
+    // the number of nodes the many-to-many heap of a thread was built for
+    static thread_local unsigned many_to_many_heap_size;
+    // one forward search per candidate of a timestamp of the map matching and one backward
+    // search per candidate of the next timestamp
+    static MapMatchingHeapPtr map_matching_forward_heap;
+    static MapMatchingHeapPoolPtr map_matching_reverse_heaps;
 
     void InitializeOrClearFirstThreadLocalStorage(const unsigned number_of_nodes);
 
     void InitializeOrClearSecondThreadLocalStorage(const unsigned number_of_nodes);
 
     void InitializeOrClearThirdThreadLocalStorage(const unsigned number_of_nodes);
+
+    void InitializeOrClearManyToManyThreadLocalStorage(const unsigned number_of_nodes);
+
+    void InitializeOrClearMapMatchingThreadLocalStorage(const unsigned number_of_nodes,
+                                                        const std::size_t number_of_heaps);
 };
 }
 }
@@ -0,0 +1,195 @@
+#ifndef TRIP_HELD_KARP_HPP
+#define TRIP_HELD_KARP_HPP
+
+#include "util/dist_table_wrapper.hpp"
+#include "util/integer_range.hpp"
+#include "util/typedefs.hpp"
+
+#include <boost/assert.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <numeric>
+#include <vector>
+
+namespace osrm
+{
+namespace engine
+{
+namespace trip
+{
+
+// subsets of a layer are solved in parallel in chunks of this size
+constexpr std::size_t HELD_KARP_GRAIN_SIZE = 1024;
+
+// computes the shortest round trip with the dynamic program of Held and Karp in O(n^2 2^n) time
+// and O(n 2^n) memory. The trip starts at the first location, for every subset of the other
+// locations and every location of that subset the program stores the shortest path that starts
+// at the first location, visits the subset and ends at that location.
+template <typename NodeIDIterator>
+std::vector<NodeID> HeldKarpTrip(const NodeIDIterator start,
+                                 const NodeIDIterator end,
+                                 const std::size_t number_of_locations,
+                                 const util::DistTableWrapper<EdgeWeight> &dist_table)
+{
+    (void)number_of_locations; // unused
+
+    const std::vector<NodeID> locations(start, end);
+    const std::size_t component_size = locations.size();
+    BOOST_ASSERT_MSG(component_size > 0, "no locations given");
+    BOOST_ASSERT_MSG(component_size <= 32, "too many locations for the dynamic program");
+
+    if (component_size < 3)
+    {
+        return locations;
+    }
+
+    // the distances between the locations of the component in one dense block
+    std::vector<EdgeWeight> distances(component_size * component_size);
+    for (const auto from : util::irange<std::size_t>(0, component_size))
+    {
+        for (const auto to : util::irange<std::size_t>(0, component_size))
+        {
+            distances[from * component_size + to] = dist_table(locations[from], locations[to]);
+        }
+    }
+    const auto distance = [&](const std::size_t from, const std::size_t to)
+    {
+        return distances[from * component_size + to];
+    };
+
+    // bit k of a subset stands for location k + 1, the costs of a subset are stored in one row
+    const std::size_t number_of_bits = component_size - 1;
+    const std::uint32_t number_of_subsets = std::uint32_t(1) << number_of_bits;
+    std::vector<EdgeWeight> costs(static_cast<std::size_t>(number_of_subsets) * number_of_bits,
+                                  INVALID_EDGE_WEIGHT);
+    const auto cost = [&](const std::uint32_t subset, const std::size_t last) -> EdgeWeight &
+    {
+        return costs[static_cast<std::size_t>(subset) * number_of_bits + last];
+    };
+
+    // a subset only depends on the subsets with one location less, so the subsets are ordered by
+    // their size and every layer of equal sizes is solved in parallel
+    std::vector<std::uint32_t> subset_sizes(number_of_subsets, 0);
+    std::vector<std::size_t> layer_offsets(number_of_bits + 2, 0);
+    for (std::uint32_t subset = 1; subset < number_of_subsets; ++subset)
+    {
+        subset_sizes[subset] = subset_sizes[subset >> 1] + (subset & 1);
+        ++layer_offsets[subset_sizes[subset] + 1];
+    }
+    std::partial_sum(layer_offsets.begin(), layer_offsets.end(), layer_offsets.begin());
+    std::vector<std::uint32_t> subsets(number_of_subsets);
+    {
+        std::vector<std::size_t> layer_insertion(layer_offsets.begin(), layer_offsets.end() - 1);
+        for (std::uint32_t subset = 0; subset < number_of_subsets; ++subset)
+        {
+            subsets[layer_insertion[subset_sizes[subset]]++] = subset;
+        }
+    }
+
+    for (const auto last : util::irange<std::size_t>(0, number_of_bits))
+    {
+        cost(std::uint32_t(1) << last, last) = distance(0, last + 1);
+    }
+
+    const auto solve_subset = [&](const std::uint32_t subset)
+    {
+        // only the locations of the subset can be the last or the previous location
+        std::array<std::size_t, 32> members;
+        std::size_t number_of_members = 0;
+        for (const auto bit : util::irange<std::size_t>(0, number_of_bits))
+        {
+            if (0 != (subset & (std::uint32_t(1) << bit)))
+            {
+                members[number_of_members++] = bit;
+            }
+        }
+
+        for (const auto last_member : util::irange<std::size_t>(0, number_of_members))
+        {
+            const auto last = members[last_member];
+            const std::uint32_t previous_subset = subset ^ (std::uint32_t(1) << last);
+            EdgeWeight best_cost = INVALID_EDGE_WEIGHT;
+            for (const auto previous_member : util::irange<std::size_t>(0, number_of_members))
+            {
+                if (previous_member != last_member)
+                {
+                    const auto previous = members[previous_member];
+                    best_cost = std::min(best_cost, cost(previous_subset, previous) +
+                                                        distance(previous + 1, last + 1));
+                }
+            }
+            cost(subset, last) = best_cost;
+        }
+    };
+
+    for (const auto layer : util::irange<std::size_t>(2, number_of_bits + 1))
+    {
+        tbb::parallel_for(tbb::blocked_range<std::size_t>(layer_offsets[layer],
+                                                          layer_offsets[layer + 1],
+                                                          HELD_KARP_GRAIN_SIZE),
+                          [&](const tbb::blocked_range<std::size_t> &range)
+                          {
+                              for (auto index = range.begin(); index != range.end(); ++index)
+                              {
+                                  solve_subset(subsets[index]);
+                              }
+                          });
+    }
+
+    // close the trip with the cheapest way back to the first location
+    const std::uint32_t all_locations = number_of_subsets - 1;
+    EdgeWeight min_trip_cost = INVALID_EDGE_WEIGHT;
+    std::size_t current = 0;
+    for (const auto last : util::irange<std::size_t>(0, number_of_bits))
+    {
+        const EdgeWeight trip_cost = cost(all_locations, last) + distance(last + 1, 0);
+        if (trip_cost < min_trip_cost)
+        {
+            min_trip_cost = trip_cost;
+            current = last;
+        }
+    }
+    BOOST_ASSERT_MSG(min_trip_cost != INVALID_EDGE_WEIGHT, "trip has invalid edge weight");
+
+    // walk the costs back from the last location, the predecessor is the one the cost came from
+    std::vector<NodeID> route;
+    route.reserve(component_size);
+    std::uint32_t subset = all_locations;
+    while (true)
+    {
+        route.push_back(locations[current + 1]);
+        const std::uint32_t previous_subset = subset ^ (std::uint32_t(1) << current);
+        if (0 == previous_subset)
+        {
+            break;
+        }
+        const EdgeWeight current_cost = cost(subset, current);
+        std::size_t previous = 0;
+        while (0 == (previous_subset & (std::uint32_t(1) << previous)) ||
+               cost(previous_subset, previous) + distance(previous + 1, current + 1) !=
+                   current_cost)
+        {
+            ++previous;
+            BOOST_ASSERT(previous < number_of_bits);
+        }
+        subset = previous_subset;
+        current = previous;
+    }
+    route.push_back(locations[0]);
+    std::reverse(route.begin(), route.end());
+
+    BOOST_ASSERT(route.size() == component_size);
+    return route;
+}
+}
+}
+}
+
+#endif // TRIP_HELD_KARP_HPP
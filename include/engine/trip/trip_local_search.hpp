@@ -0,0 +1,222 @@
+#ifndef TRIP_LOCAL_SEARCH_HPP
+#define TRIP_LOCAL_SEARCH_HPP
+
+#include "util/dist_table_wrapper.hpp"
+#include "util/integer_range.hpp"
+#include "util/typedefs.hpp"
+
+#include <boost/assert.hpp>
+
+#include <cstddef>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace osrm
+{
+namespace engine
+{
+namespace trip
+{
+
+// number of nearest locations a location is tried to be connected to
+constexpr std::size_t LOCAL_SEARCH_NEIGHBOURS = 8;
+// longest run of consecutive locations an Or-opt move relocates
+constexpr std::size_t OR_OPT_MAX_SEGMENT_SIZE = 3;
+
+// Improves a round trip with 2-opt and Or-opt moves until no move shortens it any further. Only
+// moves that connect a location to one of its nearest neighbours are tried, so a pass over the
+// trip is linear in its size. The distances may be asymmetric, a 2-opt move reverses part of the
+// trip and is charged with the distances of the reversed direction.
+inline void LocalSearchTrip(std::vector<NodeID> &route,
+                            const util::DistTableWrapper<EdgeWeight> &dist_table)
+{
+    const std::size_t trip_size = route.size();
+    if (trip_size < 4)
+    {
+        return;
+    }
+
+    // the trip is improved on local ids, the indices of the locations in the initial route
+    std::vector<EdgeWeight> distances(trip_size * trip_size);
+    for (const auto from : util::irange<std::size_t>(0, trip_size))
+    {
+        for (const auto to : util::irange<std::size_t>(0, trip_size))
+        {
+            distances[from * trip_size + to] = dist_table(route[from], route[to]);
+        }
+    }
+    const auto distance = [&](const std::size_t from, const std::size_t to)
+    {
+        return distances[from * trip_size + to];
+    };
+
+    // neighbours are ordered by the distance of going there and back
+    const std::size_t number_of_neighbours = std::min(LOCAL_SEARCH_NEIGHBOURS, trip_size - 1);
+    std::vector<std::size_t> neighbours(trip_size * number_of_neighbours);
+    {
+        std::vector<std::size_t> others;
+        for (const auto location : util::irange<std::size_t>(0, trip_size))
+        {
+            others.resize(trip_size);
+            std::iota(others.begin(), others.end(), 0);
+            others.erase(others.begin() + location);
+            std::partial_sort(others.begin(), others.begin() + number_of_neighbours, others.end(),
+                              [&](const std::size_t lhs, const std::size_t rhs)
+                              {
+                                  return distance(location, lhs) + distance(lhs, location) <
+                                         distance(location, rhs) + distance(rhs, location);
+                              });
+            std::copy(others.begin(), others.begin() + number_of_neighbours,
+                      neighbours.begin() + location * number_of_neighbours);
+        }
+    }
+
+    std::vector<std::size_t> tour(trip_size);
+    std::iota(tour.begin(), tour.end(), 0);
+    std::vector<std::size_t> position(trip_size);
+    // length of the trip up to a position, in its direction and in the reverse direction
+    std::vector<EdgeWeight> forward_length(trip_size);
+    std::vector<EdgeWeight> backward_length(trip_size);
+    const auto update = [&]()
+    {
+        for (const auto index : util::irange<std::size_t>(0, trip_size))
+        {
+            position[tour[index]] = index;
+        }
+        forward_length[0] = backward_length[0] = 0;
+        for (const auto index : util::irange<std::size_t>(1, trip_size))
+        {
+            forward_length[index] =
+                forward_length[index - 1] + distance(tour[index - 1], tour[index]);
+            backward_length[index] =
+                backward_length[index - 1] + distance(tour[index], tour[index - 1]);
+        }
+    };
+    const auto next = [&](const std::size_t index)
+    {
+        return tour[(index + 1) % trip_size];
+    };
+    const auto previous = [&](const std::size_t index)
+    {
+        return tour[(index + trip_size - 1) % trip_size];
+    };
+
+    // replaces the edges (a, b) and (c, d) with (a, c) and (b, d), reversing the part from b to c
+    const auto try_two_opt = [&](const std::size_t first)
+    {
+        const auto a = tour[first];
+        const auto b = next(first);
+        for (const auto c : util::irange<std::size_t>(0, number_of_neighbours))
+        {
+            const auto c_location = neighbours[a * number_of_neighbours + c];
+            const auto last = position[c_location];
+            if (last <= first + 1)
+            {
+                continue;
+            }
+            const auto d = next(last);
+            const EdgeWeight delta = distance(a, c_location) + distance(b, d) -
+                                     distance(a, b) - distance(c_location, d) +
+                                     (backward_length[last] - backward_length[first + 1]) -
+                                     (forward_length[last] - forward_length[first + 1]);
+            if (delta < 0)
+            {
+                std::reverse(tour.begin() + first + 1, tour.begin() + last + 1);
+                update();
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // moves the segment_size locations starting at first between two other adjacent locations
+    const auto try_or_opt = [&](const std::size_t first, const std::size_t segment_size)
+    {
+        const auto segment_last = first + segment_size - 1;
+        const auto segment_front = tour[first];
+        const auto segment_back = tour[segment_last];
+        const auto before = previous(first);
+        const auto after = next(segment_last);
+        const EdgeWeight removal_gain = distance(before, segment_front) +
+                                        distance(segment_back, after) - distance(before, after);
+        const auto in_segment = [&](const std::size_t location)
+        {
+            return position[location] >= first && position[location] <= segment_last;
+        };
+
+        const auto move_segment = [&](const std::size_t insert_after)
+        {
+            std::vector<std::size_t> segment(tour.begin() + first,
+                                             tour.begin() + segment_last + 1);
+            tour.erase(tour.begin() + first, tour.begin() + segment_last + 1);
+            const auto insert_position =
+                std::find(tour.begin(), tour.end(), insert_after) - tour.begin() + 1;
+            tour.insert(tour.begin() + insert_position, segment.begin(), segment.end());
+            update();
+        };
+
+        for (const auto n : util::irange<std::size_t>(0, number_of_neighbours))
+        {
+            // the segment follows a neighbour of its front
+            const auto from = neighbours[segment_front * number_of_neighbours + n];
+            if (!in_segment(from) && from != before)
+            {
+                const auto to = next(position[from]);
+                if (distance(from, segment_front) + distance(segment_back, to) -
+                        distance(from, to) <
+                    removal_gain)
+                {
+                    move_segment(from);
+                    return true;
+                }
+            }
+
+            // the segment precedes a neighbour of its back
+            const auto to = neighbours[segment_back * number_of_neighbours + n];
+            if (!in_segment(to) && to != after)
+            {
+                const auto from = previous(position[to]);
+                if (distance(from, segment_front) + distance(segment_back, to) -
+                        distance(from, to) <
+                    removal_gain)
+                {
+                    move_segment(from);
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    // every applied move shortens the trip, hence the search terminates
+    update();
+    bool improved = true;
+    while (improved)
+    {
+        improved = false;
+        for (const auto first : util::irange<std::size_t>(0, trip_size))
+        {
+            improved = try_two_opt(first) || improved;
+        }
+        for (const auto segment_size :
+             util::irange<std::size_t>(1, std::min(OR_OPT_MAX_SEGMENT_SIZE, trip_size - 3) + 1))
+        {
+            for (std::size_t first = 0; first + segment_size <= trip_size; ++first)
+            {
+                improved = try_or_opt(first, segment_size) || improved;
+            }
+        }
+    }
+
+    const std::vector<NodeID> initial_route = route;
+    for (const auto index : util::irange<std::size_t>(0, trip_size))
+    {
+        route[index] = initial_route[tour[index]];
+    }
+}
+}
+}
+}
+
+#endif // TRIP_LOCAL_SEARCH_HPP
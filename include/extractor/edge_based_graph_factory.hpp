@@ -33,6 +33,8 @@ namespace osrm
 namespace extractor
 {
 
+class ScriptingEnvironment;
+
 class EdgeBasedGraphFactory
 {
   public:
@@ -49,14 +51,14 @@ class EdgeBasedGraphFactory
 
 #ifdef DEBUG_GEOMETRY
     void Run(const std::string &original_edge_data_filename,
-             lua_State *lua_state,
+             ScriptingEnvironment &scripting_environment,
              const std::string &edge_segment_lookup_filename,
              const std::string &edge_penalty_filename,
              const bool generate_edge_lookup,
              const std::string &debug_turns_path);
 #else
     void Run(const std::string &original_edge_data_filename,
-             lua_State *lua_state,
+             ScriptingEnvironment &scripting_environment,
              const std::string &edge_segment_lookup_filename,
              const std::string &edge_penalty_filename,
              const bool generate_edge_lookup);
@@ -100,19 +102,26 @@ class EdgeBasedGraphFactory
     void GenerateEdgeExpandedNodes();
 #ifdef DEBUG_GEOMETRY
     void GenerateEdgeExpandedEdges(const std::string &original_edge_data_filename,
-                                   lua_State *lua_state,
+                                   ScriptingEnvironment &scripting_environment,
                                    const std::string &edge_segment_lookup_filename,
                                    const std::string &edge_fixed_penalties_filename,
                                    const bool generate_edge_lookup,
                                    const std::string &debug_turns_path);
 #else
     void GenerateEdgeExpandedEdges(const std::string &original_edge_data_filename,
-                                   lua_State *lua_state,
+                                   ScriptingEnvironment &scripting_environment,
                                    const std::string &edge_segment_lookup_filename,
                                    const std::string &edge_fixed_penalties_filename,
                                    const bool generate_edge_lookup);
 #endif
 
+    struct EdgeExpansionBuffer;
+    void GenerateEdgeExpandedEdgesOfNodes(const NodeID begin,
+                                          const NodeID end,
+                                          lua_State *lua_state,
+                                          const bool generate_edge_lookup,
+                                          EdgeExpansionBuffer &buffer) const;
+
     void InsertEdgeBasedNode(const NodeID u, const NodeID v);
 
     void FlushVectorToStream(std::ofstream &edge_data_file,
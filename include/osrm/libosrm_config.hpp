@@ -44,6 +44,13 @@ struct LibOSRMConfig
     int max_locations_distance_table = -1;
     int max_locations_map_matching = -1;
     bool use_shared_memory = true;
+    // read r-tree leaves through a read-only memory map instead of a file stream
+    bool mmap_file_index = false;
+    // read all r-tree nodes and leaves on startup, so the first queries do not hit the disk
+    bool prefetch_file_index = false;
+    // map the dataset files read-only and query them in place instead of loading them, the
+    // pages are shared with every other process mapping the same files
+    bool mmap_dataset = false;
 };
 }
 
@@ -40,6 +40,7 @@ namespace util
 namespace json
 {
 struct Object;
+class Writer;
 }
 }
 
@@ -56,6 +57,8 @@ class OSRM
     OSRM(LibOSRMConfig &lib_config);
     ~OSRM(); // needed because we need to define it with the implementation of OSRM_impl
     int RunQuery(const RouteParameters &route_parameters, util::json::Object &json_result);
+    // Writes the members of the response into the object that is open on the writer
+    int RunQuery(const RouteParameters &route_parameters, util::json::Writer &writer);
 };
 }
 
@@ -0,0 +1,131 @@
+#ifndef ACCESS_LOG_HPP
+#define ACCESS_LOG_HPP
+
+#include <boost/asio.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace osrm
+{
+namespace server
+{
+
+namespace http
+{
+struct request;
+}
+
+enum class AccessLogFormat
+{
+    // the classic "[info] date time ip referrer agent uri" line
+    Plain,
+    // one JSON object per line, including status and duration
+    JSON
+};
+
+/**
+ * Writes one line per (sampled) request without holding up the request threads.
+ *
+ * Every request thread gets its own ring buffer that only it writes to and only the background
+ * thread reads from, so logging a request takes no lock and does no formatting or I/O. The
+ * background thread drains all rings, formats the lines with a timestamp string it renders at
+ * most once per second, and writes and flushes them in one batch under the lock of
+ * util::SimpleLogger, which may write to the same stream. Like util::SimpleLogger it writes
+ * nothing while util::LogPolicy is muted. When a ring is full the entry is dropped and counted
+ * instead of stalling the request.
+ */
+class AccessLog
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    AccessLog(std::ostream &output,
+              const AccessLogFormat format,
+              const double sample_rate,
+              const std::size_t ring_size = 4096);
+    AccessLog(const AccessLog &) = delete;
+    ~AccessLog();
+
+    // called by the request threads
+    void Log(const http::request &request,
+             const std::string &uri,
+             const int status,
+             const Clock::time_point start);
+
+  private:
+    struct Entry
+    {
+        std::time_t time;
+        boost::asio::ip::address endpoint;
+        std::string referrer;
+        std::string agent;
+        std::string uri;
+        int status;
+        std::uint32_t duration_us;
+    };
+
+    struct Ring
+    {
+        explicit Ring(const std::size_t size)
+            : entries(size), head(0), tail(0), dropped(0), credit(0.)
+        {
+        }
+
+        std::vector<Entry> entries;
+        // written by the request thread only
+        std::atomic<std::size_t> head;
+        // written by the background thread only
+        std::atomic<std::size_t> tail;
+        std::atomic<std::uint64_t> dropped;
+        // sampling state of the request thread
+        double credit;
+    };
+
+    // The ring a thread used last and the log that owns it. Logs are told apart by an id that is
+    // never reused, so a thread can not pick up the ring of a destroyed log, not even from a new
+    // log at the same address.
+    struct ThreadRing
+    {
+        std::uint64_t log_id;
+        Ring *ring;
+    };
+
+    Ring &GetThreadRing();
+    bool Drain();
+    void Run();
+    void Format(const Entry &entry);
+    const std::string &FormatTime(const std::time_t time);
+
+    std::ostream &output;
+    const AccessLogFormat format;
+    const double sample_rate;
+    const std::size_t ring_size;
+
+    const std::uint64_t id;
+    // the rings of all threads that logged a request, they live as long as the log
+    std::mutex rings_mutex;
+    std::unordered_map<std::thread::id, std::unique_ptr<Ring>> rings;
+    static boost::thread_specific_ptr<ThreadRing> thread_ring;
+
+    // background thread state
+    std::string batch;
+    std::time_t cached_time;
+    std::string cached_time_string;
+    std::atomic<bool> stopped;
+    std::thread writer;
+};
+}
+}
+
+#endif // ACCESS_LOG_HPP
@@ -34,10 +34,17 @@ namespace server
 class RequestHandler;
 
 /// Represents a single connection from a client.
+/// HTTP/1.1 clients may send further, also pipelined, requests over the same connection until
+/// it idles for keepalive_timeout seconds or max_keepalive_requests requests were answered.
+/// Replies are compressed with the given zlib level if the client accepts it, 0 disables this.
 class Connection : public std::enable_shared_from_this<Connection>
 {
   public:
-    explicit Connection(boost::asio::io_service &io_service, RequestHandler &handler);
+    explicit Connection(boost::asio::io_service &io_service,
+                        RequestHandler &handler,
+                        const unsigned keepalive_timeout,
+                        const unsigned max_keepalive_requests,
+                        const int compression_level);
     Connection(const Connection &) = delete;
     Connection() = delete;
 
@@ -49,20 +56,34 @@ class Connection : public std::enable_shared_from_this<Connection>
   private:
     void handle_read(const boost::system::error_code &e, std::size_t bytes_transferred);
 
+    /// Parse the received data and either answer a complete request or read more.
+    void process_input(char *begin, char *end);
+
+    void read_more();
+
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code &e);
 
-    std::vector<char> compress_buffers(const std::vector<char> &uncompressed_data,
-                                       const http::compression_type compression_type);
+    /// Close a connection that idled for too long.
+    void handle_timeout(const boost::system::error_code &e);
 
     boost::asio::io_service::strand strand;
     boost::asio::ip::tcp::socket TCP_socket;
+    boost::asio::deadline_timer timer;
     RequestHandler &request_handler;
     RequestParser request_parser;
     boost::array<char, 8192> incoming_data_buffer;
+    // received data that belongs to pipelined requests not parsed yet
+    char *pending_input_begin;
+    char *pending_input_end;
     http::request current_request;
     http::reply current_reply;
     std::vector<char> compressed_output;
+    const unsigned keepalive_timeout;
+    const unsigned max_keepalive_requests;
+    const int compression_level;
+    unsigned processed_requests;
+    bool keep_alive;
 };
 }
 }
@@ -0,0 +1,53 @@
+#ifndef COMPRESSOR_HPP
+#define COMPRESSOR_HPP
+
+#include "server/http/compression_type.hpp"
+
+#include <zlib.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace osrm
+{
+namespace server
+{
+namespace http
+{
+
+/// A raw deflate stream that is reset instead of set up again for every block it compresses.
+/// Blocks that are not the last one end with a sync flush, so that the encodings of consecutive
+/// blocks can be concatenated into one deflate stream.
+class Compressor
+{
+  public:
+    explicit Compressor(const int level);
+    Compressor(const Compressor &) = delete;
+    ~Compressor();
+
+    int GetLevel() const { return level; }
+
+    /// Appends the encoding of [begin, end) to output. The dictionary holds the data preceding
+    /// the block, which lets the block refer back to it as if it was compressed in one go.
+    void Deflate(const char *begin,
+                 const char *end,
+                 const char *dictionary_begin,
+                 const bool last_block,
+                 std::vector<char> &output);
+
+  private:
+    z_stream stream;
+    const int level;
+};
+
+/// Compresses the content in the requested format into output, whose capacity is kept. Uses a
+/// compressor per thread, large content is cut into blocks that are compressed in parallel.
+void compress(const std::vector<char> &content,
+              const compression_type compression,
+              const int level,
+              std::vector<char> &output);
+}
+}
+}
+
+#endif // COMPRESSOR_HPP
@@ -18,6 +18,8 @@ struct request
     std::string referrer;
     std::string agent;
     boost::asio::ip::address endpoint;
+    // whether the client wants to send further requests over the same connection
+    bool keep_alive = false;
 };
 }
 }
@@ -1,6 +1,9 @@
 #ifndef REQUEST_HANDLER_HPP
 #define REQUEST_HANDLER_HPP
 
+#include "server/access_log.hpp"
+
+#include <memory>
 #include <string>
 
 namespace osrm
@@ -31,9 +34,12 @@ class RequestHandler
 
     void handle_request(const http::request &current_request, http::reply &current_reply);
     void RegisterRoutingMachine(engine::OSRM *osrm);
+    // logs the given share of requests to stdout, a sample rate of 0 disables the access log
+    void EnableAccessLog(const AccessLogFormat format, const double sample_rate);
 
   private:
     engine::OSRM *routing_machine;
+    std::unique_ptr<AccessLog> access_log;
 };
 }
 }
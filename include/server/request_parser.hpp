@@ -22,9 +22,14 @@ class RequestParser
   public:
     RequestParser();
 
-    std::tuple<util::tribool, http::compression_type>
+    // Consumes input until a request is complete or malformed. Returns the position after the
+    // last consumed character, any input behind it belongs to the next pipelined request.
+    std::tuple<util::tribool, http::compression_type, char *>
     parse(http::request &current_request, char *begin, char *end);
 
+    // Prepares the parser for the next request on the same connection
+    void reset();
+
   private:
     util::tribool consume(http::request &current_request, const char input);
 
@@ -69,6 +74,8 @@ class RequestParser
     http::compression_type selected_compression;
     bool is_post_header;
     int content_length;
+    unsigned http_version_major;
+    unsigned http_version_minor;
 };
 }
 }
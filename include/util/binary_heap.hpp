@@ -3,6 +3,9 @@
 
 #include <boost/assert.hpp>
 
+#include <cstddef>
+#include <cstdint>
+
 #include <algorithm>
 #include <limits>
 #include <map>
@@ -32,6 +35,144 @@ template <typename NodeID, typename Key> class ArrayStorage
     std::vector<Key> positions;
 };
 
+// Dense array that is reset in constant time: every entry is stamped with the generation it
+// was written in, and clearing starts a new generation. Needs memory for all nodes per heap.
+template <typename NodeID, typename Key> class GenerationArrayStorage
+{
+  public:
+    explicit GenerationArrayStorage(size_t size) : positions(size), generation(1) {}
+
+    Key &operator[](const NodeID node)
+    {
+        Entry &entry = positions[node];
+        if (entry.generation != generation)
+        {
+            entry.generation = generation;
+            entry.index = std::numeric_limits<Key>::max();
+        }
+        return entry.index;
+    }
+
+    Key peek_index(const NodeID node) const
+    {
+        const Entry &entry = positions[node];
+        return entry.generation == generation ? entry.index : std::numeric_limits<Key>::max();
+    }
+
+    void Clear()
+    {
+        ++generation;
+        // all stamps are ambiguous after the counter wrapped around
+        if (0 == generation)
+        {
+            std::fill(positions.begin(), positions.end(), Entry());
+            generation = 1;
+        }
+    }
+
+  private:
+    struct Entry
+    {
+        Key index = std::numeric_limits<Key>::max();
+        unsigned generation = 0;
+    };
+
+    std::vector<Entry> positions;
+    unsigned generation;
+};
+
+// Open addressing hash table that is reset in constant time like GenerationArrayStorage. Needs
+// memory for the nodes of the largest search only, and as clearing keeps the table a reused
+// heap stops allocating once it has held its largest search.
+template <typename NodeID, typename Key> class GenerationHashStorage
+{
+  public:
+    explicit GenerationHashStorage(size_t)
+        : cells(std::size_t(1) << INITIAL_CAPACITY_BITS), shift(64 - INITIAL_CAPACITY_BITS),
+          number_of_entries(0), generation(1)
+    {
+    }
+
+    Key &operator[](const NodeID node)
+    {
+        std::size_t position = Find(node);
+        if (cells[position].generation != generation)
+        {
+            // at most half of the cells are in use, which keeps the probe sequences short
+            if (2 * (number_of_entries + 1) > cells.size())
+            {
+                Grow();
+                position = Find(node);
+            }
+            cells[position].node = node;
+            cells[position].index = std::numeric_limits<Key>::max();
+            cells[position].generation = generation;
+            ++number_of_entries;
+        }
+        return cells[position].index;
+    }
+
+    Key peek_index(const NodeID node) const
+    {
+        const Cell &cell = cells[Find(node)];
+        return cell.generation == generation ? cell.index : std::numeric_limits<Key>::max();
+    }
+
+    void Clear()
+    {
+        number_of_entries = 0;
+        ++generation;
+        // all stamps are ambiguous after the counter wrapped around
+        if (0 == generation)
+        {
+            std::fill(cells.begin(), cells.end(), Cell());
+            generation = 1;
+        }
+    }
+
+  private:
+    static const constexpr unsigned INITIAL_CAPACITY_BITS = 10;
+
+    struct Cell
+    {
+        NodeID node = std::numeric_limits<NodeID>::max();
+        Key index = std::numeric_limits<Key>::max();
+        unsigned generation = 0;
+    };
+
+    // fibonacci hashing, the high bits of the product select the cell
+    std::size_t Find(const NodeID node) const
+    {
+        const std::size_t mask = cells.size() - 1;
+        std::size_t position = static_cast<std::size_t>(
+            (static_cast<std::uint64_t>(node) * 11400714819323198485ull) >> shift);
+        while (cells[position].generation == generation && cells[position].node != node)
+        {
+            position = (position + 1) & mask;
+        }
+        return position;
+    }
+
+    void Grow()
+    {
+        std::vector<Cell> old_cells(cells.size() * 2);
+        old_cells.swap(cells);
+        --shift;
+        for (const Cell &cell : old_cells)
+        {
+            if (cell.generation == generation)
+            {
+                cells[Find(cell.node)] = cell;
+            }
+        }
+    }
+
+    std::vector<Cell> cells;
+    unsigned shift;
+    std::size_t number_of_entries;
+    unsigned generation;
+};
+
 template <typename NodeID, typename Key> class MapStorage
 {
   public:
@@ -84,13 +225,18 @@ template <typename NodeID, typename Key> class UnorderedMapStorage
     std::unordered_map<NodeID, Key> nodes;
 };
 
+// Heap with an index from node ids to heap positions. Arity sets the number of children per
+// heap node, a 4-ary heap is flatter and needs fewer moves per Insert and DecreaseKey.
 template <typename NodeID,
           typename Key,
           typename Weight,
           typename Data,
-          typename IndexStorage = ArrayStorage<NodeID, NodeID>>
+          typename IndexStorage = ArrayStorage<NodeID, NodeID>,
+          unsigned Arity = 2>
 class BinaryHeap
 {
+    static_assert(Arity >= 2, "a heap node needs at least two children");
+
   private:
     BinaryHeap(const BinaryHeap &right);
     void operator=(const BinaryHeap &right);
@@ -235,18 +381,26 @@ class BinaryHeap
     std::vector<HeapElement> heap;
     IndexStorage node_index;
 
+    // the root is at position 1, position 0 holds a sentinel with the minimal weight
+    static Key FirstChild(const Key key) { return Arity * (key - 1) + 2; }
+
+    static Key Parent(const Key key) { return key < 2 ? 0 : (key - 2) / Arity + 1; }
+
     void Downheap(Key key)
     {
         const Key droppingIndex = heap[key].index;
         const Weight weight = heap[key].weight;
         const Key heap_size = static_cast<Key>(heap.size());
-        Key nextKey = key << 1;
+        Key nextKey = FirstChild(key);
         while (nextKey < heap_size)
         {
-            const Key nextKeyOther = nextKey + 1;
-            if ((nextKeyOther < heap_size) && (heap[nextKey].weight > heap[nextKeyOther].weight))
+            const Key lastChild = std::min<Key>(nextKey + Arity, heap_size);
+            for (Key nextKeyOther = nextKey + 1; nextKeyOther < lastChild; ++nextKeyOther)
             {
-                nextKey = nextKeyOther;
+                if (heap[nextKey].weight > heap[nextKeyOther].weight)
+                {
+                    nextKey = nextKeyOther;
+                }
             }
             if (weight <= heap[nextKey].weight)
             {
@@ -255,7 +409,7 @@ class BinaryHeap
             heap[key] = heap[nextKey];
             inserted_nodes[heap[key].index].key = key;
             key = nextKey;
-            nextKey <<= 1;
+            nextKey = FirstChild(key);
         }
         heap[key].index = droppingIndex;
         heap[key].weight = weight;
@@ -266,14 +420,14 @@ class BinaryHeap
     {
         const Key risingIndex = heap[key].index;
         const Weight weight = heap[key].weight;
-        Key nextKey = key >> 1;
+        Key nextKey = Parent(key);
         while (heap[nextKey].weight > weight)
         {
             BOOST_ASSERT(nextKey != 0);
             heap[key] = heap[nextKey];
             inserted_nodes[heap[key].index].key = key;
             key = nextKey;
-            nextKey >>= 1;
+            nextKey = Parent(key);
         }
         heap[key].index = risingIndex;
         heap[key].weight = weight;
@@ -285,7 +439,7 @@ class BinaryHeap
 #ifndef NDEBUG
         for (std::size_t i = 2; i < heap.size(); ++i)
         {
-            BOOST_ASSERT(heap[i].weight >= heap[i >> 1].weight);
+            BOOST_ASSERT(heap[i].weight >= heap[Parent(i)].weight);
         }
 #endif
     }
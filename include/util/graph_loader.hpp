@@ -20,6 +20,7 @@
 
 #include <fstream>
 #include <ios>
+#include <string>
 #include <vector>
 
 namespace osrm
@@ -32,8 +33,8 @@ namespace util
  * The since the restrictions reference nodes using their external node id,
  * we need to renumber it to the new internal id.
 */
-unsigned loadRestrictionsFromFile(std::istream &input_stream,
-                                  std::vector<extractor::TurnRestriction> &restriction_list)
+inline unsigned loadRestrictionsFromFile(std::istream &input_stream,
+                                         std::vector<extractor::TurnRestriction> &restriction_list)
 {
     const FingerPrint fingerprint_valid = FingerPrint::GetValid();
     FingerPrint fingerprint_loaded;
@@ -62,10 +63,10 @@ unsigned loadRestrictionsFromFile(std::istream &input_stream,
  *  - list of traffic lights
  *  - nodes indexed by their internal (non-osm) id
  */
-NodeID loadNodesFromFile(std::istream &input_stream,
-                         std::vector<NodeID> &barrier_node_list,
-                         std::vector<NodeID> &traffic_light_node_list,
-                         std::vector<extractor::QueryNode> &node_array)
+inline NodeID loadNodesFromFile(std::istream &input_stream,
+                                std::vector<NodeID> &barrier_node_list,
+                                std::vector<NodeID> &traffic_light_node_list,
+                                std::vector<extractor::QueryNode> &node_array)
 {
     const FingerPrint fingerprint_valid = FingerPrint::GetValid();
     FingerPrint fingerprint_loaded;
@@ -107,8 +108,8 @@ NodeID loadNodesFromFile(std::istream &input_stream,
 /**
  * Reads a .osrm file and produces the edges.
  */
-NodeID loadEdgesFromFile(std::istream &input_stream,
-                         std::vector<extractor::NodeBasedEdge> &edge_list)
+inline NodeID loadEdgesFromFile(std::istream &input_stream,
+                                std::vector<extractor::NodeBasedEdge> &edge_list)
 {
     EdgeID m;
     input_stream.read(reinterpret_cast<char *>(&m), sizeof(unsigned));
@@ -147,10 +148,15 @@ NodeID loadEdgesFromFile(std::istream &input_stream,
     return m;
 }
 
-template <typename NodeT, typename EdgeT>
+// Version of the .hsgr layout, it is written right behind the fingerprint and has to be bumped
+// whenever the layout of the contracted graph changes.
+constexpr unsigned HSGR_FORMAT_VERSION = 2;
+
+template <typename NodeT, typename SearchT, typename UnpackT>
 unsigned readHSGRFromStream(const boost::filesystem::path &hsgr_file,
                             std::vector<NodeT> &node_list,
-                            std::vector<EdgeT> &edge_list,
+                            std::vector<SearchT> &search_list,
+                            std::vector<UnpackT> &unpack_list,
                             unsigned *check_sum)
 {
     if (!boost::filesystem::exists(hsgr_file))
@@ -173,6 +179,15 @@ unsigned readHSGRFromStream(const boost::filesystem::path &hsgr_file,
                                             "Reprocess to get rid of this warning.";
     }
 
+    unsigned format_version = 0;
+    hsgr_input_stream.read(reinterpret_cast<char *>(&format_version), sizeof(unsigned));
+    if (format_version != HSGR_FORMAT_VERSION)
+    {
+        throw exception(".hsgr has format version " + std::to_string(format_version) +
+                        ", expected " + std::to_string(HSGR_FORMAT_VERSION) +
+                        ". Reprocess it with osrm-prepare.");
+    }
+
     unsigned number_of_nodes = 0;
     unsigned number_of_edges = 0;
     hsgr_input_stream.read(reinterpret_cast<char *>(check_sum), sizeof(unsigned));
@@ -188,11 +203,14 @@ unsigned readHSGRFromStream(const boost::filesystem::path &hsgr_file,
     hsgr_input_stream.read(reinterpret_cast<char *>(&node_list[0]),
                            number_of_nodes * sizeof(NodeT));
 
-    edge_list.resize(number_of_edges);
+    search_list.resize(number_of_edges);
+    unpack_list.resize(number_of_edges);
     if (number_of_edges > 0)
     {
-        hsgr_input_stream.read(reinterpret_cast<char *>(&edge_list[0]),
-                               number_of_edges * sizeof(EdgeT));
+        hsgr_input_stream.read(reinterpret_cast<char *>(&search_list[0]),
+                               number_of_edges * sizeof(SearchT));
+        hsgr_input_stream.read(reinterpret_cast<char *>(&unpack_list[0]),
+                               number_of_edges * sizeof(UnpackT));
     }
     hsgr_input_stream.close();
 
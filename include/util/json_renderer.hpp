@@ -5,6 +5,7 @@
 #define JSON_RENDERER_HPP
 
 #include "util/cast.hpp"
+#include "util/json_writer.hpp"
 #include "util/string_util.hpp"
 
 #include "osrm/json_container.hpp"
@@ -78,17 +79,10 @@ struct ArrayRenderer : mapbox::util::static_visitor<>
 
     void operator()(const String &string) const
     {
-        out.push_back('\"');
-        const auto string_to_insert = escape_JSON(string.value);
-        out.insert(std::end(out), std::begin(string_to_insert), std::end(string_to_insert));
-        out.push_back('\"');
+        detail::appendEscaped(out, string.value.data(), string.value.data() + string.value.size());
     }
 
-    void operator()(const Number &number) const
-    {
-        const std::string number_string = cast::to_string_with_precision(number.value);
-        out.insert(out.end(), number_string.begin(), number_string.end());
-    }
+    void operator()(const Number &number) const { detail::appendNumber(out, number.value); }
 
     void operator()(const Object &object) const
     {
@@ -123,23 +117,11 @@ struct ArrayRenderer : mapbox::util::static_visitor<>
         out.push_back(']');
     }
 
-    void operator()(const True &) const
-    {
-        const std::string temp("true");
-        out.insert(out.end(), temp.begin(), temp.end());
-    }
+    void operator()(const True &) const { detail::appendLiteral(out, "true", 4); }
 
-    void operator()(const False &) const
-    {
-        const std::string temp("false");
-        out.insert(out.end(), temp.begin(), temp.end());
-    }
+    void operator()(const False &) const { detail::appendLiteral(out, "false", 5); }
 
-    void operator()(const Null &) const
-    {
-        const std::string temp("null");
-        out.insert(out.end(), temp.begin(), temp.end());
-    }
+    void operator()(const Null &) const { detail::appendLiteral(out, "null", 4); }
 
   private:
     std::vector<char> &out;
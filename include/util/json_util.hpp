@@ -48,7 +48,7 @@ template <typename T> Array make_array(const std::vector<T> &vector)
 }
 
 // template specialization needed as clang does not play nice
-template <> Array make_array(const std::vector<bool> &vector)
+template <> inline Array make_array(const std::vector<bool> &vector)
 {
     Array a;
     for (const bool v : vector)
@@ -59,7 +59,7 @@ template <> Array make_array(const std::vector<bool> &vector)
 }
 
 // Easy acces to object hierachies
-Value &get(Value &value) { return value; }
+inline Value &get(Value &value) { return value; }
 
 template <typename... Keys> Value &get(Value &value, const char *key, Keys... keys)
 {
@@ -0,0 +1,386 @@
+#ifndef JSON_WRITER_HPP
+#define JSON_WRITER_HPP
+
+#include "osrm/json_container.hpp"
+
+#include <boost/assert.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace osrm
+{
+namespace util
+{
+namespace json
+{
+
+namespace detail
+{
+
+inline void appendLiteral(std::vector<char> &out, const char *literal, const std::size_t length)
+{
+    out.insert(out.end(), literal, literal + length);
+}
+
+inline void appendUnsigned(std::vector<char> &out, std::uint64_t value)
+{
+    char digits[20];
+    char *first = digits + sizeof(digits);
+    do
+    {
+        *--first = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    out.insert(out.end(), first, digits + sizeof(digits));
+}
+
+inline void appendSigned(std::vector<char> &out, const std::int64_t value)
+{
+    if (value < 0)
+    {
+        out.push_back('-');
+        // negate in unsigned arithmetic, -INT64_MIN does not fit into int64_t
+        appendUnsigned(out, ~static_cast<std::uint64_t>(value) + 1);
+    }
+    else
+    {
+        appendUnsigned(out, static_cast<std::uint64_t>(value));
+    }
+}
+
+// Produces the same text as cast::to_string_with_precision, both use the rules of printf's %.6f,
+// but without the stream and the temporary string. Trailing zeros and a trailing dot are removed.
+inline void appendNumber(std::vector<char> &out, const double value)
+{
+    // the largest double has 309 integral digits
+    char buffer[512];
+    const int length = std::snprintf(buffer, sizeof(buffer), "%.6f", value);
+    BOOST_ASSERT(length > 0 && static_cast<std::size_t>(length) < sizeof(buffer));
+
+    const char *first = buffer;
+    const char *last = buffer + length;
+    while (last != first && *(last - 1) == '0')
+    {
+        --last;
+    }
+    while (last != first && *(last - 1) == '.')
+    {
+        --last;
+    }
+    out.insert(out.end(), first, last);
+}
+
+// Same escaping as escape_JSON, but without the temporary string
+inline void appendEscaped(std::vector<char> &out, const char *first, const char *last)
+{
+    out.push_back('\"');
+    for (; first != last; ++first)
+    {
+        switch (*first)
+        {
+        case '\\':
+            appendLiteral(out, "\\\\", 2);
+            break;
+        case '"':
+            appendLiteral(out, "\\\"", 2);
+            break;
+        case '/':
+            appendLiteral(out, "\\/", 2);
+            break;
+        case '\b':
+            appendLiteral(out, "\\b", 2);
+            break;
+        case '\f':
+            appendLiteral(out, "\\f", 2);
+            break;
+        case '\n':
+            appendLiteral(out, "\\n", 2);
+            break;
+        case '\r':
+            appendLiteral(out, "\\r", 2);
+            break;
+        case '\t':
+            appendLiteral(out, "\\t", 2);
+            break;
+        default:
+            out.push_back(*first);
+            break;
+        }
+    }
+    out.push_back('\"');
+}
+} // namespace detail
+
+// Streams a JSON document into a character buffer without building a tree of json::Values.
+//
+// Separators are inserted automatically. Inside an object every value has to be preceded by
+// a call to Key(). The buffer is appended to and never cleared, so callers can keep reusing its
+// capacity from one response to the next.
+class Writer
+{
+  public:
+    explicit Writer(std::vector<char> &out) : out(out), needs_separator(false) {}
+
+    void BeginObject()
+    {
+        Separate();
+        out.push_back('{');
+        needs_separator = false;
+    }
+
+    void EndObject()
+    {
+        out.push_back('}');
+        needs_separator = true;
+    }
+
+    void BeginArray()
+    {
+        Separate();
+        out.push_back('[');
+        needs_separator = false;
+    }
+
+    void EndArray()
+    {
+        out.push_back(']');
+        needs_separator = true;
+    }
+
+    void Key(const char *key) { Key(key, std::strlen(key)); }
+    void Key(const std::string &key) { Key(key.data(), key.size()); }
+
+    void String(const char *value) { String(value, std::strlen(value)); }
+    void String(const std::string &value) { String(value.data(), value.size()); }
+
+    void Number(const double value)
+    {
+        Separate();
+        detail::appendNumber(out, value);
+        needs_separator = true;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type Number(const T value)
+    {
+        Separate();
+        if (std::is_signed<T>::value)
+        {
+            detail::appendSigned(out, static_cast<std::int64_t>(value));
+        }
+        else
+        {
+            detail::appendUnsigned(out, static_cast<std::uint64_t>(value));
+        }
+        needs_separator = true;
+    }
+
+    void Bool(const bool value)
+    {
+        Separate();
+        if (value)
+        {
+            detail::appendLiteral(out, "true", 4);
+        }
+        else
+        {
+            detail::appendLiteral(out, "false", 5);
+        }
+        needs_separator = true;
+    }
+
+    void Null()
+    {
+        Separate();
+        detail::appendLiteral(out, "null", 4);
+        needs_separator = true;
+    }
+
+    // Writes a value that has already been built as a tree
+    void Value(const json::Value &value);
+
+    // Writes the members of the object into the object that is currently open
+    void Members(const Object &object)
+    {
+        for (const auto &member : object.values)
+        {
+            Key(member.first);
+            Value(member.second);
+        }
+    }
+
+  private:
+    void Separate()
+    {
+        if (needs_separator)
+        {
+            out.push_back(',');
+        }
+    }
+
+    void Key(const char *key, const std::size_t length)
+    {
+        Separate();
+        detail::appendEscaped(out, key, key + length);
+        out.push_back(':');
+        needs_separator = false;
+    }
+
+    void String(const char *value, const std::size_t length)
+    {
+        Separate();
+        detail::appendEscaped(out, value, value + length);
+        needs_separator = true;
+    }
+
+    std::vector<char> &out;
+    bool needs_separator;
+};
+
+namespace detail
+{
+struct WriterVisitor : mapbox::util::static_visitor<>
+{
+    explicit WriterVisitor(Writer &writer) : writer(writer) {}
+
+    void operator()(const String &string) const { writer.String(string.value); }
+
+    void operator()(const Number &number) const { writer.Number(number.value); }
+
+    void operator()(const Object &object) const
+    {
+        writer.BeginObject();
+        writer.Members(object);
+        writer.EndObject();
+    }
+
+    void operator()(const Array &array) const
+    {
+        writer.BeginArray();
+        for (const auto &value : array.values)
+        {
+            writer.Value(value);
+        }
+        writer.EndArray();
+    }
+
+    void operator()(const True &) const { writer.Bool(true); }
+
+    void operator()(const False &) const { writer.Bool(false); }
+
+    void operator()(const Null &) const { writer.Null(); }
+
+  private:
+    Writer &writer;
+};
+} // namespace detail
+
+inline void Writer::Value(const json::Value &value)
+{
+    mapbox::util::apply_visitor(detail::WriterVisitor(*this), value);
+}
+
+// Builds a tree of json::Values from the same calls as a Writer, so that a response is
+// implemented once, templated on the writer, and serves both kinds of output.
+//
+// The root is the object the caller has opened, values are added to its members.
+class TreeWriter
+{
+  public:
+    explicit TreeWriter(Object &root) : open_kinds(1, true), open_objects(1, &root) {}
+
+    void BeginObject()
+    {
+        auto &added = Add(Object());
+        open_objects.push_back(&added.get<Object>());
+        open_kinds.push_back(true);
+    }
+
+    void EndObject()
+    {
+        BOOST_ASSERT(open_kinds.size() > 1 && open_kinds.back());
+        open_objects.pop_back();
+        open_kinds.pop_back();
+    }
+
+    void BeginArray()
+    {
+        auto &added = Add(Array());
+        open_arrays.push_back(&added.get<Array>());
+        open_kinds.push_back(false);
+    }
+
+    void EndArray()
+    {
+        BOOST_ASSERT(open_kinds.size() > 1 && !open_kinds.back());
+        open_arrays.pop_back();
+        open_kinds.pop_back();
+    }
+
+    void Key(std::string key) { pending_key = std::move(key); }
+
+    void String(std::string value) { Add(json::String(std::move(value))); }
+
+    template <typename T>
+    typename std::enable_if<std::is_arithmetic<T>::value>::type Number(const T value)
+    {
+        Add(json::Number(static_cast<double>(value)));
+    }
+
+    void Bool(const bool value)
+    {
+        if (value)
+        {
+            Add(True());
+        }
+        else
+        {
+            Add(False());
+        }
+    }
+
+    void Null() { Add(json::Null()); }
+
+    void Value(json::Value value) { Add(std::move(value)); }
+
+    void Members(const Object &object)
+    {
+        for (const auto &member : object.values)
+        {
+            Key(member.first);
+            Value(member.second);
+        }
+    }
+
+  private:
+    json::Value &Add(json::Value value)
+    {
+        if (open_kinds.back())
+        {
+            auto &added = open_objects.back()->values[pending_key];
+            added = std::move(value);
+            return added;
+        }
+        auto &values = open_arrays.back()->values;
+        values.push_back(std::move(value));
+        return values.back();
+    }
+
+    // whether the innermost open value is an object, the containers of each kind are stacked
+    std::vector<bool> open_kinds;
+    std::vector<Object *> open_objects;
+    std::vector<Array *> open_arrays;
+    std::string pending_key;
+};
+
+} // namespace json
+} // namespace util
+} // namespace osrm
+
+#endif // JSON_WRITER_HPP
@@ -0,0 +1,103 @@
+#ifndef LAYERED_VECTOR_HPP
+#define LAYERED_VECTOR_HPP
+
+#include <boost/assert.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace osrm
+{
+namespace util
+{
+
+/// A vector of vectors ("layers") that stores the values of all layers in one contiguous
+/// vector. The offsets hold the index of the first value of every layer and one past the last
+/// value. Clearing keeps the memory, so a reused instance stops allocating once it has held its
+/// largest contents.
+template <typename T> class LayeredVector
+{
+  public:
+    /// The values of one layer, stays valid until layers are added or the vector is reshaped
+    template <typename ValueT> class Layer
+    {
+      public:
+        Layer(ValueT *layer_begin, ValueT *layer_end)
+            : layer_begin(layer_begin), layer_end(layer_end)
+        {
+        }
+
+        ValueT *begin() const { return layer_begin; }
+        ValueT *end() const { return layer_end; }
+        std::size_t size() const { return layer_end - layer_begin; }
+        bool empty() const { return layer_begin == layer_end; }
+
+        ValueT &operator[](const std::size_t index) const
+        {
+            BOOST_ASSERT(index < size());
+            return layer_begin[index];
+        }
+
+      private:
+        ValueT *layer_begin;
+        ValueT *layer_end;
+    };
+
+    LayeredVector() : offsets(1, 0) {}
+
+    /// number of layers
+    std::size_t size() const { return offsets.size() - 1; }
+    bool empty() const { return offsets.size() == 1; }
+
+    void clear()
+    {
+        values.clear();
+        offsets.resize(1);
+    }
+
+    template <typename IteratorT> void push_back_layer(IteratorT first, IteratorT last)
+    {
+        values.insert(values.end(), first, last);
+        offsets.push_back(values.size());
+    }
+
+    /// Adds an empty layer, the values pushed back next are added to it
+    void push_back_layer() { offsets.push_back(values.size()); }
+
+    /// Appends a value to the last layer
+    void push_back(const T &value)
+    {
+        BOOST_ASSERT(!empty());
+        values.push_back(value);
+        offsets.back() = values.size();
+    }
+
+    /// Gives this vector the layers of other, the values are left unspecified
+    template <typename OtherT> void reshape(const LayeredVector<OtherT> &other)
+    {
+        offsets = other.layer_offsets();
+        values.resize(offsets.back());
+    }
+
+    Layer<T> operator[](const std::size_t layer)
+    {
+        BOOST_ASSERT(layer < size());
+        return {values.data() + offsets[layer], values.data() + offsets[layer + 1]};
+    }
+
+    Layer<const T> operator[](const std::size_t layer) const
+    {
+        BOOST_ASSERT(layer < size());
+        return {values.data() + offsets[layer], values.data() + offsets[layer + 1]};
+    }
+
+    const std::vector<std::size_t> &layer_offsets() const { return offsets; }
+
+  private:
+    std::vector<T> values;
+    std::vector<std::size_t> offsets;
+};
+}
+}
+
+#endif // LAYERED_VECTOR_HPP
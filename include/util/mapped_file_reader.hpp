@@ -0,0 +1,126 @@
+#ifndef MAPPED_FILE_READER_HPP
+#define MAPPED_FILE_READER_HPP
+
+#include "util/osrm_exception.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace osrm
+{
+namespace util
+{
+
+// Reads a binary file sequentially through a read-only memory mapping. A read is a plain copy
+// out of the page cache without the locking and buffering of a stream, so reading records one
+// by one costs about as much as a single bulk read. The whole file is announced to the kernel
+// up front, which then reads ahead at disk speed. Readers that keep the mapping and access the
+// data in place through Map() should disable that hint, the kernel then only faults in the
+// pages that are actually touched.
+class MappedFileReader
+{
+  public:
+    explicit MappedFileReader(const boost::filesystem::path &path_,
+                              const bool sequential_access = true)
+        : path(path_), begin(nullptr), current(nullptr), end(nullptr)
+    {
+        if (!boost::filesystem::exists(path))
+        {
+            throw exception(path.string() + " not found");
+        }
+        const auto size = boost::filesystem::file_size(path);
+        if (0 == size)
+        {
+            return;
+        }
+        region.open(path);
+        begin = current = region.data();
+        end = begin + region.size();
+#ifdef __linux__
+        if (sequential_access)
+        {
+            madvise(const_cast<char *>(begin), region.size(), MADV_SEQUENTIAL);
+            madvise(const_cast<char *>(begin), region.size(), MADV_WILLNEED);
+        }
+#endif
+    }
+
+    template <typename T> T Read()
+    {
+        T value;
+        Read(&value, 1);
+        return value;
+    }
+
+    template <typename T> void Read(T *destination, const std::size_t count)
+    {
+        const std::size_t bytes = count * sizeof(T);
+        if (0 == bytes)
+        {
+            return;
+        }
+        CheckRemaining(bytes);
+        std::memcpy(destination, current, bytes);
+        current += bytes;
+    }
+
+    // Returns the next count elements in place, they stay valid as long as the reader lives
+    template <typename T> const T *Map(const std::size_t count)
+    {
+        const std::size_t bytes = count * sizeof(T);
+        if (0 == bytes)
+        {
+            return nullptr;
+        }
+        CheckRemaining(bytes);
+        if (0 != reinterpret_cast<std::uintptr_t>(current) % alignof(T))
+        {
+            throw exception(path.string() + " is not aligned for in place access");
+        }
+        const T *result = reinterpret_cast<const T *>(current);
+        current += bytes;
+        return result;
+    }
+
+    void Skip(const std::size_t bytes)
+    {
+        CheckRemaining(bytes);
+        current += bytes;
+    }
+
+    void Seek(const std::size_t offset)
+    {
+        current = begin;
+        Skip(offset);
+    }
+
+    std::size_t GetRemaining() const { return end - current; }
+
+  private:
+    void CheckRemaining(const std::size_t bytes) const
+    {
+        if (bytes > GetRemaining())
+        {
+            throw exception(path.string() + " is truncated");
+        }
+    }
+
+    boost::filesystem::path path;
+    boost::iostreams::mapped_file_source region;
+    const char *begin;
+    const char *current;
+    const char *end;
+};
+}
+}
+
+#endif // MAPPED_FILE_READER_HPP
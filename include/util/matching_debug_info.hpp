@@ -3,6 +3,8 @@
 
 #include "util/json_logger.hpp"
 #include "util/json_util.hpp"
+#include "util/integer_range.hpp"
+#include "util/layered_vector.hpp"
 #include "engine/map_matching/hidden_markov_model.hpp"
 
 #include "osrm/coordinate.hpp"
@@ -32,10 +34,10 @@ struct MatchingDebugInfo
         }
 
         json::Array states;
-        for (auto &elem : candidates_list)
+        for (const auto t : irange<std::size_t>(0, candidates_list.size()))
         {
             json::Array timestamps;
-            for (auto &elem_s : elem)
+            for (const auto &elem_s : candidates_list[t])
             {
                 json::Object state;
                 state.values["transitions"] = json::Array();
@@ -80,9 +82,9 @@ struct MatchingDebugInfo
             .values.push_back(transistion);
     }
 
-    void set_viterbi(const std::vector<std::vector<double>> &viterbi,
-                     const std::vector<std::vector<bool>> &pruned,
-                     const std::vector<std::vector<bool>> &suspicious)
+    void set_viterbi(const LayeredVector<double> &viterbi,
+                     const LayeredVector<char> &pruned,
+                     const LayeredVector<char> &suspicious)
     {
         // json logger not enabled
         if (!logger)
@@ -126,7 +126,15 @@ GenerateServerProgramOptions(const int argc,
                              int &max_locations_trip,
                              int &max_locations_viaroute,
                              int &max_locations_distance_table,
-                             int &max_locations_map_matching)
+                             int &max_locations_map_matching,
+                             bool &mmap_file_index,
+                             bool &prefetch_file_index,
+                             bool &mmap_dataset,
+                             int &keepalive_timeout,
+                             int &max_keepalive_requests,
+                             std::string &access_log_format,
+                             double &access_log_sample_rate,
+                             int &compression_level)
 {
     using boost::program_options::value;
     using boost::filesystem::path;
@@ -170,7 +178,26 @@ GenerateServerProgramOptions(const int argc,
         ("max-table-size", value<int>(&max_locations_distance_table)->default_value(100),
          "Max. locations supported in distance table query") //
         ("max-matching-size", value<int>(&max_locations_map_matching)->default_value(100),
-         "Max. locations supported in map matching query");
+         "Max. locations supported in map matching query") //
+        ("mmap-fileindex",
+         value<bool>(&mmap_file_index)->implicit_value(true)->default_value(false),
+         "Read r-tree leaves through a memory map instead of a file stream") //
+        ("prefetch-fileindex",
+         value<bool>(&prefetch_file_index)->implicit_value(true)->default_value(false),
+         "Load the r-tree nodes and leaves into memory on startup") //
+        ("mmap-dataset",
+         value<bool>(&mmap_dataset)->implicit_value(true)->default_value(false),
+         "Map the dataset files read-only instead of loading them into memory") //
+        ("keepalive-timeout", value<int>(&keepalive_timeout)->default_value(5),
+         "Seconds an idle HTTP/1.1 connection is kept open, 0 closes after each request") //
+        ("max-keepalive-requests", value<int>(&max_keepalive_requests)->default_value(512),
+         "Max. requests served over a single HTTP/1.1 connection") //
+        ("access-log-format", value<std::string>(&access_log_format)->default_value("plain"),
+         "Access log line format: plain or json") //
+        ("access-log-sample-rate", value<double>(&access_log_sample_rate)->default_value(1.),
+         "Share of requests written to the access log, 0 disables it") //
+        ("compression-level", value<int>(&compression_level)->default_value(1),
+         "zlib level of gzip/deflate compressed replies, 0 disables compression");
 
     // hidden options, will be allowed both on command line and in config
     // file, but will not be shown to the user
@@ -233,6 +260,26 @@ GenerateServerProgramOptions(const int argc,
     {
         throw exception("Number of threads must be a positive number");
     }
+    if (0 > keepalive_timeout)
+    {
+        throw exception("Keep-alive timeout must not be negative");
+    }
+    if (1 > max_keepalive_requests)
+    {
+        throw exception("Max. requests per connection must be a positive number");
+    }
+    if ("plain" != access_log_format && "json" != access_log_format)
+    {
+        throw exception("Access log format must be plain or json");
+    }
+    if (0. > access_log_sample_rate || 1. < access_log_sample_rate)
+    {
+        throw exception("Access log sample rate must be between 0 and 1");
+    }
+    if (0 > compression_level || 9 < compression_level)
+    {
+        throw exception("Compression level must be between 0 and 9");
+    }
     if (2 > max_locations_distance_table)
     {
         throw exception("Max location for distance table must be at least two");
@@ -41,7 +41,7 @@ class SimpleLogger
     SimpleLogger();
 
     virtual ~SimpleLogger();
-    std::mutex &get_mutex();
+    static std::mutex &get_mutex();
     std::ostringstream &Write(LogLevel l = logINFO) noexcept;
 
   private:
@@ -9,8 +9,10 @@
 
 #include "util/bearing.hpp"
 #include "util/integer_range.hpp"
+#include "util/layered_vector.hpp"
 #include "util/mercator.hpp"
 #include "util/osrm_exception.hpp"
+#include "util/simple_logger.hpp"
 #include "util/typedefs.hpp"
 
 #include "osrm/coordinate.hpp"
@@ -18,18 +20,25 @@
 #include <boost/assert.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 
 #include <tbb/parallel_for.h>
 #include <tbb/parallel_sort.h>
 
 #include <variant/variant.hpp>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 #include <algorithm>
 #include <array>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace osrm
@@ -37,6 +46,15 @@ namespace osrm
 namespace util
 {
 
+// Where the leaves of a StaticRTree are read from at query time
+enum class LeafStorage
+{
+    // seek and read every leaf through an ifstream (default)
+    Stream,
+    // map the leaf file read-only and hand out leaves by pointer
+    MemoryMapped
+};
+
 // Static RTree for serving nearest neighbour queries
 template <class EdgeDataT,
           class CoordinateListT = std::vector<FixedPointCoordinate>,
@@ -104,7 +122,13 @@ class StaticRTree
     uint64_t m_element_count;
     const std::string m_leaf_node_filename;
     std::shared_ptr<CoordinateListT> m_coordinate_list;
-    boost::filesystem::ifstream leaves_stream;
+    // Leaves are read through streams that a query borrows for one read, so a single tree serves
+    // concurrent queries. The tree owns the streams and closes them when it is destroyed.
+    std::mutex leaves_streams_mutex;
+    std::vector<std::unique_ptr<boost::filesystem::ifstream>> idle_leaves_streams;
+    boost::iostreams::mapped_file_source m_leaves_region;
+    const LeafNode *m_leaves = nullptr;
+    uint64_t m_number_of_leaves = 0;
 
   public:
     StaticRTree() = delete;
@@ -262,7 +286,8 @@ class StaticRTree
 
     explicit StaticRTree(const boost::filesystem::path &node_file,
                          const boost::filesystem::path &leaf_file,
-                         const std::shared_ptr<CoordinateListT> coordinate_list)
+                         const std::shared_ptr<CoordinateListT> coordinate_list,
+                         const LeafStorage leaf_storage = LeafStorage::Stream)
         : m_leaf_node_filename(leaf_file.string())
     {
         // open tree node file and load into RAM.
@@ -287,39 +312,133 @@ class StaticRTree
             tree_node_file.read((char *)&m_search_tree[0], sizeof(TreeNode) * tree_size);
         }
         tree_node_file.close();
-        // open leaf node file and store thread specific pointer
-        if (!boost::filesystem::exists(leaf_file))
-        {
-            throw exception("mem index file does not exist");
-        }
-        if (0 == boost::filesystem::file_size(leaf_file))
-        {
-            throw exception("mem index file is empty");
-        }
 
-        leaves_stream.open(leaf_file, std::ios::binary);
-        leaves_stream.read((char *)&m_element_count, sizeof(uint64_t));
+        OpenLeaves(leaf_file, leaf_storage);
     }
 
     explicit StaticRTree(TreeNode *tree_node_ptr,
                          const uint64_t number_of_nodes,
                          const boost::filesystem::path &leaf_file,
-                         std::shared_ptr<CoordinateListT> coordinate_list)
+                         std::shared_ptr<CoordinateListT> coordinate_list,
+                         const LeafStorage leaf_storage = LeafStorage::Stream)
         : m_search_tree(tree_node_ptr, number_of_nodes), m_leaf_node_filename(leaf_file.string()),
           m_coordinate_list(std::move(coordinate_list))
     {
-        // open leaf node file and store thread specific pointer
-        if (!boost::filesystem::exists(leaf_file))
+        OpenLeaves(leaf_file, leaf_storage);
+    }
+
+    bool IsMemoryMapped() const { return m_leaves != nullptr; }
+
+    // Calls the visitor for every element of the given leaf file
+    template <typename VisitorT>
+    static void VisitLeafNodeFile(const std::string &leaf_node_filename, VisitorT &&visitor)
+    {
+        boost::iostreams::mapped_file_source leaves_region(leaf_node_filename);
+        if (!leaves_region.is_open() || leaves_region.size() < sizeof(uint64_t))
         {
-            throw exception("mem index file does not exist");
+            throw exception("mem index file could not be mapped");
         }
-        if (0 == boost::filesystem::file_size(leaf_file))
+        const LeafNode *leaves =
+            reinterpret_cast<const LeafNode *>(leaves_region.data() + sizeof(uint64_t));
+        const uint64_t number_of_leaves =
+            (leaves_region.size() - sizeof(uint64_t)) / sizeof(LeafNode);
+        for (const LeafNode *leaf = leaves; leaf != leaves + number_of_leaves; ++leaf)
         {
-            throw exception("mem index file is empty");
+            for (uint32_t i = 0; i < leaf->object_count; ++i)
+            {
+                visitor(leaf->objects[i]);
+            }
+        }
+    }
+
+    // Calls the visitor for every element of the given leaf file and keeps the changes it makes,
+    // e.g. when the contractor renumbers the nodes the elements refer to. The changed leaves are
+    // written to a new file that replaces the old one by a rename, so that a server which has
+    // the old file mapped keeps reading the leaves it was started with.
+    template <typename VisitorT>
+    static void UpdateLeafNodeFile(const std::string &leaf_node_filename, VisitorT &&visitor)
+    {
+        const std::string updated_leaf_node_filename = leaf_node_filename + ".tmp";
+        WriteUpdatedLeafNodeFile(leaf_node_filename, updated_leaf_node_filename,
+                                 std::forward<VisitorT>(visitor));
+        boost::filesystem::rename(updated_leaf_node_filename, leaf_node_filename);
+    }
+
+    // Like UpdateLeafNodeFile, but leaves the changed leaves in the given file, for callers that
+    // have to replace other files together with the leaves
+    template <typename VisitorT>
+    static void WriteUpdatedLeafNodeFile(const std::string &leaf_node_filename,
+                                         const std::string &updated_leaf_node_filename,
+                                         VisitorT &&visitor)
+    {
+        boost::filesystem::ifstream leaf_node_file(leaf_node_filename, std::ios::binary);
+        uint64_t element_count = 0;
+        if (!leaf_node_file.read((char *)&element_count, sizeof(uint64_t)))
+        {
+            throw exception("mem index file could not be read");
+        }
+
+        boost::filesystem::ofstream updated_leaf_node_file(updated_leaf_node_filename,
+                                                           std::ios::binary);
+        updated_leaf_node_file.write((char *)&element_count, sizeof(uint64_t));
+        LeafNode leaf;
+        while (leaf_node_file.read((char *)&leaf, sizeof(LeafNode)))
+        {
+            for (uint32_t i = 0; i < leaf.object_count; ++i)
+            {
+                visitor(leaf.objects[i]);
+            }
+            updated_leaf_node_file.write((char *)&leaf, sizeof(LeafNode));
+        }
+        updated_leaf_node_file.flush();
+        if (!updated_leaf_node_file)
+        {
+            throw exception("could not write " + updated_leaf_node_filename);
+        }
+    }
+
+    // Touches every tree node and reads all leaves once, so that the first queries find them in
+    // memory and do not pay for the disk access. Mapped leaves are faulted in page by page, a
+    // leaf file read through streams is pulled into the page cache by a sequential pass.
+    void Prefetch() const
+    {
+        uint64_t checksum = 0;
+        for (uint64_t i = 0; i < m_search_tree.size(); ++i)
+        {
+            checksum += m_search_tree[i].child_count;
+        }
+
+        if (IsMemoryMapped())
+        {
+#ifndef _WIN32
+            // the mapping starts on a page boundary, hence no alignment fix-up is needed
+            if (0 != ::madvise(const_cast<char *>(m_leaves_region.data()),
+                               m_leaves_region.size(), MADV_WILLNEED))
+            {
+                SimpleLogger().Write(logWARNING) << "madvise on " << m_leaf_node_filename
+                                                 << " failed";
+            }
+#endif
+            const std::size_t page_size = boost::iostreams::mapped_file_source::alignment();
+            const volatile char *region = m_leaves_region.data();
+            for (std::size_t offset = 0; offset < m_leaves_region.size(); offset += page_size)
+            {
+                checksum += region[offset];
+            }
+        }
+        else
+        {
+            boost::filesystem::ifstream leaf_file(m_leaf_node_filename, std::ios::binary);
+            std::vector<char> buffer(1 << 20);
+            while (leaf_file.read(buffer.data(), buffer.size()) || leaf_file.gcount() > 0)
+            {
+                checksum += buffer[0];
+            }
         }
 
-        leaves_stream.open(leaf_file, std::ios::binary);
-        leaves_stream.read((char *)&m_element_count, sizeof(uint64_t));
+        // keeps the reads from being optimized away
+        const volatile uint64_t sink = checksum;
+        (void)sink;
     }
 
     // Override filter and terminator for the desired behaviour.
@@ -405,20 +524,225 @@ class StaticRTree
         return results;
     }
 
+    // Returns the segments within the range of every coordinate that pass the filter, ordered by
+    // distance. The filter is called with the index of the coordinate and the segment.
+    // Consecutive coordinates of a trace are close to each other, so they are searched together:
+    // a tree node is visited once for all coordinates whose range reaches it and a leaf is read
+    // once. Long sequences are cut into batches that are searched in parallel.
+    // The results hold one layer per coordinate, they are cleared first.
+    template <typename FilterT>
+    void SearchInRanges(const std::vector<FixedPointCoordinate> &input_coordinates,
+                        const std::vector<double> &max_distances,
+                        const FilterT filter,
+                        LayeredVector<EdgeDataT> &results)
+    {
+        BOOST_ASSERT(input_coordinates.size() == max_distances.size());
+        const std::size_t number_of_batches =
+            (input_coordinates.size() + RANGE_BATCH_SIZE - 1) / RANGE_BATCH_SIZE;
+        // sorted by coordinate and distance
+        std::vector<std::vector<RangeHit>> batch_hits(number_of_batches);
+
+        const auto search_batch = [&](const std::size_t batch_index)
+        {
+            RangeBatch batch;
+            batch.begin = batch_index * RANGE_BATCH_SIZE;
+            batch.end = std::min(input_coordinates.size(), batch.begin + RANGE_BATCH_SIZE);
+            batch.input_coordinates = &input_coordinates;
+            batch.max_distances = &max_distances;
+            batch.active_queries.resize(1);
+            for (const auto query : irange(batch.begin, batch.end))
+            {
+                batch.projected_coordinates.emplace_back(
+                    mercator::latToY(input_coordinates[query].lat / COORDINATE_PRECISION),
+                    input_coordinates[query].lon / COORDINATE_PRECISION);
+                batch.active_queries[0].push_back(query);
+            }
+
+            SearchRangesInNode(m_search_tree[0], 0, batch, filter);
+
+            std::sort(batch.hits.begin(), batch.hits.end(),
+                      [](const RangeHit &lhs, const RangeHit &rhs)
+                      {
+                          return lhs.query < rhs.query ||
+                                 (lhs.query == rhs.query && lhs.distance < rhs.distance);
+                      });
+            batch_hits[batch_index] = std::move(batch.hits);
+        };
+
+        if (number_of_batches > 1)
+        {
+            tbb::parallel_for(std::size_t(0), number_of_batches, search_batch);
+        }
+        else if (1 == number_of_batches)
+        {
+            search_batch(0);
+        }
+
+        results.clear();
+        for (const auto batch_index : irange<std::size_t>(0, number_of_batches))
+        {
+            auto hit = batch_hits[batch_index].begin();
+            const auto hits_end = batch_hits[batch_index].end();
+            const auto batch_begin = batch_index * RANGE_BATCH_SIZE;
+            const auto batch_end =
+                std::min(input_coordinates.size(), batch_begin + RANGE_BATCH_SIZE);
+            for (const auto query : irange(batch_begin, batch_end))
+            {
+                results.push_back_layer();
+                for (; hit != hits_end && hit->query == query; ++hit)
+                {
+                    results.push_back(hit->segment);
+                }
+            }
+        }
+    }
+
   private:
+    // coordinates of a range query that are searched in one traversal
+    static constexpr std::size_t RANGE_BATCH_SIZE = 128;
+
+    struct RangeHit
+    {
+        std::size_t query;
+        float distance;
+        EdgeDataT segment;
+    };
+
+    struct RangeBatch
+    {
+        std::size_t begin;
+        std::size_t end;
+        const std::vector<FixedPointCoordinate> *input_coordinates;
+        const std::vector<double> *max_distances;
+        std::vector<std::pair<double, double>> projected_coordinates;
+        // the queries whose range reaches the node visited on each level of the tree
+        std::vector<std::vector<std::size_t>> active_queries;
+        std::vector<RangeHit> hits;
+    };
+
+    template <typename FilterT>
+    void SearchRangesInNode(const TreeNode &tree_node,
+                            const std::size_t level,
+                            RangeBatch &batch,
+                            const FilterT &filter)
+    {
+        if (tree_node.child_is_on_disk)
+        {
+            const uint32_t leaf_id = tree_node.children[0];
+            if (IsMemoryMapped())
+            {
+                BOOST_ASSERT(leaf_id < m_number_of_leaves);
+                SearchRangesInLeaf(m_leaves[leaf_id], level, batch, filter);
+            }
+            else
+            {
+                LeafNode current_leaf_node;
+                LoadLeafFromDisk(leaf_id, current_leaf_node);
+                SearchRangesInLeaf(current_leaf_node, level, batch, filter);
+            }
+            return;
+        }
+
+        if (batch.active_queries.size() <= level + 1)
+        {
+            batch.active_queries.resize(level + 2);
+        }
+        for (uint32_t i = 0; i < tree_node.child_count; ++i)
+        {
+            const auto &child_tree_node = m_search_tree[tree_node.children[i]];
+            const auto &child_rectangle = child_tree_node.minimum_bounding_rectangle;
+
+            // deeper levels reuse their buffers, but may grow the list of levels
+            auto &child_queries = batch.active_queries[level + 1];
+            child_queries.clear();
+            for (const auto query : batch.active_queries[level])
+            {
+                if (child_rectangle.GetMinDist((*batch.input_coordinates)[query]) <=
+                    (*batch.max_distances)[query])
+                {
+                    child_queries.push_back(query);
+                }
+            }
+
+            if (!child_queries.empty())
+            {
+                SearchRangesInNode(child_tree_node, level + 1, batch, filter);
+            }
+        }
+    }
+
+    template <typename FilterT>
+    void SearchRangesInLeaf(const LeafNode &leaf_node,
+                            const std::size_t level,
+                            RangeBatch &batch,
+                            const FilterT &filter)
+    {
+        for (const auto i : irange(0u, leaf_node.object_count))
+        {
+            const auto &current_edge = leaf_node.objects[i];
+            const auto &u = m_coordinate_list->at(current_edge.u);
+            const auto &v = m_coordinate_list->at(current_edge.v);
+            for (const auto query : batch.active_queries[level])
+            {
+                const float distance =
+                    coordinate_calculation::perpendicularDistanceFromProjectedCoordinate(
+                        u, v, (*batch.input_coordinates)[query],
+                        batch.projected_coordinates[query - batch.begin]);
+                if (distance > (*batch.max_distances)[query])
+                {
+                    continue;
+                }
+
+                const auto use_segment = filter(query, current_edge);
+                if (!use_segment.first && !use_segment.second)
+                {
+                    continue;
+                }
+
+                batch.hits.push_back(RangeHit{query, distance, current_edge});
+                if (!use_segment.first)
+                {
+                    batch.hits.back().segment.forward_edge_based_node_id = SPECIAL_NODEID;
+                }
+                else if (!use_segment.second)
+                {
+                    batch.hits.back().segment.reverse_edge_based_node_id = SPECIAL_NODEID;
+                }
+            }
+        }
+    }
+
     template <typename QueueT>
     void ExploreLeafNode(const std::uint32_t leaf_id,
                          const FixedPointCoordinate &input_coordinate,
                          const std::pair<double, double> &projected_coordinate,
                          QueueT &traversal_queue)
     {
-        LeafNode current_leaf_node;
-        LoadLeafFromDisk(leaf_id, current_leaf_node);
+        if (IsMemoryMapped())
+        {
+            BOOST_ASSERT(leaf_id < m_number_of_leaves);
+            ExploreLeafObjects(m_leaves[leaf_id], input_coordinate, projected_coordinate,
+                               traversal_queue);
+        }
+        else
+        {
+            LeafNode current_leaf_node;
+            LoadLeafFromDisk(leaf_id, current_leaf_node);
+            ExploreLeafObjects(current_leaf_node, input_coordinate, projected_coordinate,
+                               traversal_queue);
+        }
+    }
 
+    template <typename QueueT>
+    void ExploreLeafObjects(const LeafNode &current_leaf_node,
+                            const FixedPointCoordinate &input_coordinate,
+                            const std::pair<double, double> &projected_coordinate,
+                            QueueT &traversal_queue)
+    {
         // current object represents a block on disk
         for (const auto i : irange(0u, current_leaf_node.object_count))
         {
-            auto &current_edge = current_leaf_node.objects[i];
+            const auto &current_edge = current_leaf_node.objects[i];
             const float current_perpendicular_distance =
                 coordinate_calculation::perpendicularDistanceFromProjectedCoordinate(
                     m_coordinate_list->at(current_edge.u), m_coordinate_list->at(current_edge.v),
@@ -426,8 +750,7 @@ class StaticRTree
             // distance must be non-negative
             BOOST_ASSERT(0.f <= current_perpendicular_distance);
 
-            traversal_queue.push(
-                QueryCandidate{current_perpendicular_distance, std::move(current_edge)});
+            traversal_queue.push(QueryCandidate{current_perpendicular_distance, current_edge});
         }
     }
 
@@ -446,21 +769,74 @@ class StaticRTree
         }
     }
 
+    void OpenLeaves(const boost::filesystem::path &leaf_file, const LeafStorage leaf_storage)
+    {
+        if (!boost::filesystem::exists(leaf_file))
+        {
+            throw exception("mem index file does not exist");
+        }
+        if (0 == boost::filesystem::file_size(leaf_file))
+        {
+            throw exception("mem index file is empty");
+        }
+
+        if (LeafStorage::Stream == leaf_storage)
+        {
+            // the streams are opened on demand, one for each concurrent leaf access
+            boost::filesystem::ifstream leaf_node_file(leaf_file, std::ios::binary);
+            leaf_node_file.read((char *)&m_element_count, sizeof(uint64_t));
+            return;
+        }
+
+        m_leaves_region.open(leaf_file);
+        if (!m_leaves_region.is_open() || m_leaves_region.size() < sizeof(uint64_t))
+        {
+            throw exception("mem index file could not be mapped");
+        }
+        std::copy(m_leaves_region.data(), m_leaves_region.data() + sizeof(uint64_t),
+                  reinterpret_cast<char *>(&m_element_count));
+        // the leaves follow the element count, which keeps them 8 byte aligned
+        static_assert(alignof(LeafNode) <= sizeof(uint64_t), "leaves in mapping are misaligned");
+        m_leaves = reinterpret_cast<const LeafNode *>(m_leaves_region.data() + sizeof(uint64_t));
+        m_number_of_leaves = (m_leaves_region.size() - sizeof(uint64_t)) / sizeof(LeafNode);
+        if (m_number_of_leaves * LEAF_NODE_SIZE < m_element_count)
+        {
+            throw exception("mem index file is truncated");
+        }
+    }
+
     inline void LoadLeafFromDisk(const uint32_t leaf_id, LeafNode &result_node)
     {
-        if (!leaves_stream.is_open())
+        std::unique_ptr<boost::filesystem::ifstream> leaves_stream;
+        {
+            std::lock_guard<std::mutex> lock(leaves_streams_mutex);
+            if (!idle_leaves_streams.empty())
+            {
+                leaves_stream = std::move(idle_leaves_streams.back());
+                idle_leaves_streams.pop_back();
+            }
+        }
+        if (!leaves_stream)
         {
-            leaves_stream.open(m_leaf_node_filename, std::ios::in | std::ios::binary);
+            leaves_stream.reset(new boost::filesystem::ifstream(m_leaf_node_filename,
+                                                                std::ios::in | std::ios::binary));
         }
-        if (!leaves_stream.good())
+        if (!leaves_stream->good())
         {
             throw exception("Could not read from leaf file.");
         }
         const uint64_t seek_pos = sizeof(uint64_t) + leaf_id * sizeof(LeafNode);
-        leaves_stream.seekg(seek_pos);
-        BOOST_ASSERT_MSG(leaves_stream.good(), "Seeking to position in leaf file failed.");
-        leaves_stream.read((char *)&result_node, sizeof(LeafNode));
-        BOOST_ASSERT_MSG(leaves_stream.good(), "Reading from leaf file failed.");
+        leaves_stream->seekg(seek_pos);
+        BOOST_ASSERT_MSG(leaves_stream->good(), "Seeking to position in leaf file failed.");
+        leaves_stream->read((char *)&result_node, sizeof(LeafNode));
+        BOOST_ASSERT_MSG(leaves_stream->good(), "Reading from leaf file failed.");
+
+        // a failed stream is closed instead of being handed to the next read
+        if (leaves_stream->good())
+        {
+            std::lock_guard<std::mutex> lock(leaves_streams_mutex);
+            idle_leaves_streams.push_back(std::move(leaves_stream));
+        }
     }
 
     template <typename CoordinateT>
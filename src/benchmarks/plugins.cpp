@@ -0,0 +1,523 @@
+#include "extractor/query_node.hpp"
+#include "server/api_grammar.hpp"
+#include "util/json_writer.hpp"
+#include "util/simple_logger.hpp"
+#include "util/string_util.hpp"
+#include "util/timing_util.hpp"
+
+#include "osrm/coordinate.hpp"
+#include "osrm/json_container.hpp"
+#include "osrm/libosrm_config.hpp"
+#include "osrm/osrm.hpp"
+#include "osrm/route_parameters.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/fusion/container/vector.hpp>
+#include <boost/program_options.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Every allocation of the process goes through here. The counter is shared by all threads, so
+// that the allocations of the worker threads a query fans out to are counted as well.
+namespace
+{
+std::atomic<std::uint64_t> allocation_count{0};
+
+void *countedAllocate(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    // malloc may return a null pointer for zero bytes, new must not
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *countedAllocateOrThrow(std::size_t size)
+{
+    if (void *pointer = countedAllocate(size))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+}
+
+void *operator new(std::size_t size) { return countedAllocateOrThrow(size); }
+void *operator new[](std::size_t size) { return countedAllocateOrThrow(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAllocate(size);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { std::free(pointer); }
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void *pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, std::size_t) noexcept { std::free(pointer); }
+#endif
+
+#ifdef __cpp_aligned_new
+namespace
+{
+void *countedAllocateAligned(std::size_t size, const std::align_val_t alignment)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void *pointer = nullptr;
+#ifdef _WIN32
+    pointer = _aligned_malloc(size == 0 ? 1 : size, static_cast<std::size_t>(alignment));
+#else
+    if (posix_memalign(&pointer, static_cast<std::size_t>(alignment), size == 0 ? 1 : size) != 0)
+    {
+        pointer = nullptr;
+    }
+#endif
+    return pointer;
+}
+
+void *countedAllocateAlignedOrThrow(std::size_t size, const std::align_val_t alignment)
+{
+    if (void *pointer = countedAllocateAligned(size, alignment))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void freeAligned(void *pointer)
+{
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return countedAllocateAlignedOrThrow(size, alignment);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return countedAllocateAlignedOrThrow(size, alignment);
+}
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return countedAllocateAligned(size, alignment);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return countedAllocateAligned(size, alignment);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete[](void *pointer, std::align_val_t) noexcept { freeAligned(pointer); }
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept
+{
+    freeAligned(pointer);
+}
+void operator delete[](void *pointer, std::size_t, std::align_val_t) noexcept
+{
+    freeAligned(pointer);
+}
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    freeAligned(pointer);
+}
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept
+{
+    freeAligned(pointer);
+}
+#endif
+
+namespace osrm
+{
+namespace benchmarks
+{
+
+// Choosen by a fair W20 dice roll (this value is completely arbitrary)
+constexpr unsigned RANDOM_SEED = 13;
+constexpr unsigned TABLE_SIZE = 10;
+constexpr unsigned TRIP_SIZE = 6;
+constexpr unsigned MATCH_SAMPLE_INTERVAL = 5;
+
+struct Workload
+{
+    std::string service;
+    std::vector<RouteParameters> queries;
+};
+
+struct QueryMeasurement
+{
+    double milliseconds;
+    bool is_ok;
+};
+
+std::vector<util::FixedPointCoordinate> loadCoordinates(const boost::filesystem::path &nodes_file)
+{
+    boost::filesystem::ifstream nodes_input_stream(nodes_file, std::ios::binary);
+
+    extractor::QueryNode current_node;
+    unsigned coordinate_count = 0;
+    nodes_input_stream.read((char *)&coordinate_count, sizeof(unsigned));
+    std::vector<util::FixedPointCoordinate> coordinates(coordinate_count);
+    for (unsigned i = 0; i < coordinate_count; ++i)
+    {
+        nodes_input_stream.read((char *)&current_node, sizeof(extractor::QueryNode));
+        coordinates[i] = util::FixedPointCoordinate(current_node.lat, current_node.lon);
+    }
+    return coordinates;
+}
+
+void addCoordinate(RouteParameters &parameters, const util::FixedPointCoordinate &coordinate)
+{
+    parameters.AddCoordinate(boost::fusion::vector<double, double>(
+        coordinate.lat / COORDINATE_PRECISION, coordinate.lon / COORDINATE_PRECISION));
+}
+
+// Builds queries of every plugin between random nodes of the data set
+std::vector<Workload> generateWorkloads(OSRM &routing_machine,
+                                        const std::vector<util::FixedPointCoordinate> &coordinates,
+                                        const unsigned number_of_queries,
+                                        const unsigned match_size)
+{
+    std::mt19937 mt_rand(RANDOM_SEED);
+    std::uniform_int_distribution<std::size_t> node_udist(0, coordinates.size() - 1);
+    const auto random_query = [&](const std::string &service, const unsigned size)
+    {
+        RouteParameters parameters;
+        parameters.service = service;
+        for (unsigned i = 0; i < size; ++i)
+        {
+            addCoordinate(parameters, coordinates[node_udist(mt_rand)]);
+        }
+        return parameters;
+    };
+
+    std::vector<Workload> workloads = {{"viaroute", {}}, {"table", {}}, {"nearest", {}},
+                                       {"match", {}},    {"trip", {}}};
+    for (unsigned i = 0; i < number_of_queries; ++i)
+    {
+        workloads[0].queries.push_back(random_query("viaroute", 2));
+        workloads[1].queries.push_back(random_query("table", TABLE_SIZE));
+        workloads[2].queries.push_back(random_query("nearest", 1));
+        workloads[4].queries.push_back(random_query("trip", TRIP_SIZE));
+    }
+
+    // traces for map matching are sampled from the geometry of random routes
+    for (unsigned attempt = 0;
+         workloads[3].queries.size() < number_of_queries && attempt < 10 * number_of_queries;
+         ++attempt)
+    {
+        auto route_query = random_query("viaroute", 2);
+        route_query.alternate_route = false;
+        route_query.compression = false;
+        util::json::Object json_result;
+        if (routing_machine.RunQuery(route_query, json_result) != 200 ||
+            json_result.values.count("route_geometry") == 0)
+        {
+            continue;
+        }
+
+        const auto &geometry = json_result.values["route_geometry"].get<util::json::Array>();
+        RouteParameters match_query;
+        match_query.service = "match";
+        for (std::size_t index = 0;
+             index < geometry.values.size() && match_query.coordinates.size() < match_size;
+             index += MATCH_SAMPLE_INTERVAL)
+        {
+            const auto &location = geometry.values[index].get<util::json::Array>();
+            match_query.AddCoordinate(boost::fusion::vector<double, double>(
+                location.values[0].get<util::json::Number>().value,
+                location.values[1].get<util::json::Number>().value));
+        }
+        if (match_query.coordinates.size() > 1)
+        {
+            workloads[3].queries.push_back(std::move(match_query));
+        }
+    }
+
+    return workloads;
+}
+
+// Parses one request per line, either a request URI or a line of the osrm-routed log
+std::vector<Workload> readQueryLog(const boost::filesystem::path &log_file)
+{
+    using APIGrammarParser = server::APIGrammar<std::string::iterator, RouteParameters>;
+
+    std::map<std::string, Workload> workloads;
+    boost::filesystem::ifstream log_stream(log_file);
+    std::string line;
+    std::string request_string;
+    unsigned number_of_invalid_lines = 0;
+    while (std::getline(log_stream, line))
+    {
+        // either a bare URI or a log line that ends with it, the user agent may contain slashes
+        const auto uri_begin = line.compare(0, 1, "/") == 0 ? 0 : line.rfind(" /");
+        if (uri_begin == std::string::npos)
+        {
+            ++number_of_invalid_lines;
+            continue;
+        }
+        util::URIDecode(line.substr(line.find('/', uri_begin)), request_string);
+
+        RouteParameters parameters;
+        APIGrammarParser api_parser(&parameters);
+        auto api_iterator = request_string.begin();
+        const bool result =
+            boost::spirit::qi::parse(api_iterator, request_string.end(), api_parser);
+        if (!result || api_iterator != request_string.end())
+        {
+            ++number_of_invalid_lines;
+            continue;
+        }
+        auto &workload = workloads[parameters.service];
+        workload.service = parameters.service;
+        workload.queries.push_back(std::move(parameters));
+    }
+
+    if (number_of_invalid_lines > 0)
+    {
+        util::SimpleLogger().Write(logWARNING) << "skipped " << number_of_invalid_lines
+                                               << " lines that are no valid queries";
+    }
+
+    std::vector<Workload> result;
+    for (auto &service_and_workload : workloads)
+    {
+        result.push_back(std::move(service_and_workload.second));
+    }
+    return result;
+}
+
+// Replays the workload on the given number of threads and reports latency percentiles,
+// throughput and allocations per query
+void benchmarkWorkload(OSRM &routing_machine, const Workload &workload, const unsigned threads)
+{
+    std::vector<QueryMeasurement> measurements(workload.queries.size());
+    std::atomic<std::size_t> next_query{0};
+
+    const auto run_queries = [&]()
+    {
+        // responses are rendered like osrm-routed does, into a buffer that is reused
+        std::vector<char> response;
+        for (auto index = next_query.fetch_add(1); index < workload.queries.size();
+             index = next_query.fetch_add(1))
+        {
+            response.clear();
+            const auto query_start = std::chrono::steady_clock::now();
+
+            util::json::Writer writer(response);
+            writer.BeginObject();
+            const int return_code = routing_machine.RunQuery(workload.queries[index], writer);
+            writer.EndObject();
+
+            const std::chrono::duration<double, std::milli> query_duration =
+                std::chrono::steady_clock::now() - query_start;
+            measurements[index] = {query_duration.count(), return_code == 200};
+        }
+    };
+
+    // all allocations of the run are counted, including the ones of the threads that the
+    // queries hand work to, so the per query number is an average over the run
+    const auto allocations_before = allocation_count.load();
+    TIMER_START(workload);
+    std::vector<std::thread> workers;
+    for (unsigned thread = 1; thread < threads; ++thread)
+    {
+        workers.emplace_back(run_queries);
+    }
+    run_queries();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    TIMER_STOP(workload);
+    const auto total_allocations = allocation_count.load() - allocations_before;
+
+    std::vector<double> latencies;
+    latencies.reserve(measurements.size());
+    std::size_t number_of_failed_queries = 0;
+    for (const auto &measurement : measurements)
+    {
+        latencies.push_back(measurement.milliseconds);
+        number_of_failed_queries += measurement.is_ok ? 0 : 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](const double fraction)
+    {
+        return latencies[static_cast<std::size_t>(fraction * (latencies.size() - 1))];
+    };
+
+    std::cout << std::left << std::setw(10) << workload.service << std::right << std::setw(3)
+              << threads << " threads: " << std::fixed << std::setprecision(3)
+              << "p50 " << percentile(0.5) << "ms, p99 " << percentile(0.99) << "ms, "
+              << std::setprecision(1) << workload.queries.size() / TIMER_SEC(workload)
+              << " queries/s, " << static_cast<double>(total_allocations) / latencies.size()
+              << " allocations/query";
+    if (number_of_failed_queries > 0)
+    {
+        std::cout << ", " << number_of_failed_queries << " without result";
+    }
+    std::cout << std::endl;
+}
+
+// The map matching keeps its memory per thread between the traces. Replays the traces twice on
+// one thread and reports the allocations of the first replay, which starts with the memory the
+// runs before left, and of the second one, whose traces have all been matched by this thread.
+void benchmarkMatchAllocations(OSRM &routing_machine, const Workload &workload)
+{
+    std::size_t number_of_coordinates = 0;
+    for (const auto &query : workload.queries)
+    {
+        number_of_coordinates += query.coordinates.size();
+    }
+
+    std::vector<char> response;
+    for (const auto replay : {"first", "second"})
+    {
+        const auto allocations_before = allocation_count.load();
+        for (const auto &query : workload.queries)
+        {
+            response.clear();
+            util::json::Writer writer(response);
+            writer.BeginObject();
+            routing_machine.RunQuery(query, writer);
+            writer.EndObject();
+        }
+        const auto total_allocations = allocation_count.load() - allocations_before;
+        std::cout << "match " << replay << " replay: " << std::fixed << std::setprecision(1)
+                  << static_cast<double>(total_allocations) / workload.queries.size()
+                  << " allocations/query, "
+                  << static_cast<double>(total_allocations) / number_of_coordinates
+                  << " allocations/coordinate" << std::endl;
+    }
+}
+}
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        osrm::util::LogPolicy::GetInstance().Unmute();
+
+        boost::filesystem::path base_path;
+        boost::filesystem::path log_path;
+        unsigned number_of_queries = 1000;
+        unsigned match_size = 50;
+        unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::string> services;
+
+        boost::program_options::options_description options("Options");
+        options.add_options()("help,h", "Show this help message")(
+            "base,b", boost::program_options::value<boost::filesystem::path>(&base_path),
+            "Base path to the prepared .osrm data set")(
+            "log,l", boost::program_options::value<boost::filesystem::path>(&log_path),
+            "Replay the request URIs in this file, one per line, instead of random queries")(
+            "queries,q",
+            boost::program_options::value<unsigned>(&number_of_queries)->default_value(1000),
+            "Number of random queries per plugin")(
+            "match-size,m",
+            boost::program_options::value<unsigned>(&match_size)->default_value(50),
+            "Largest number of coordinates of the random map matching traces")(
+            "threads,t",
+            boost::program_options::value<unsigned>(&max_threads)->default_value(max_threads),
+            "Largest number of threads, the runs double the thread count up to it")(
+            "service,s", boost::program_options::value<std::vector<std::string>>(&services),
+            "Only benchmark these plugins (viaroute, table, nearest, match, trip)");
+
+        boost::program_options::positional_options_description positional_options;
+        positional_options.add("base", 1);
+
+        boost::program_options::variables_map option_variables;
+        boost::program_options::store(boost::program_options::command_line_parser(argc, argv)
+                                          .options(options)
+                                          .positional(positional_options)
+                                          .run(),
+                                      option_variables);
+        boost::program_options::notify(option_variables);
+
+        if (option_variables.count("help") || !option_variables.count("base"))
+        {
+            std::cout << "./plugins-bench file.osrm [options]\n" << options;
+            return option_variables.count("help") ? 0 : 1;
+        }
+
+        osrm::LibOSRMConfig lib_config;
+        lib_config.server_paths["base"] = base_path;
+        lib_config.use_shared_memory = false;
+        osrm::OSRM routing_machine(lib_config);
+
+        std::vector<osrm::benchmarks::Workload> workloads;
+        if (option_variables.count("log"))
+        {
+            workloads = osrm::benchmarks::readQueryLog(log_path);
+        }
+        else
+        {
+            // the engine derives the paths of the data files from a copy of the config
+            const auto coordinates =
+                osrm::benchmarks::loadCoordinates(base_path.string() + ".nodes");
+            if (coordinates.empty())
+            {
+                std::cout << "data set has no nodes" << std::endl;
+                return 1;
+            }
+            workloads = osrm::benchmarks::generateWorkloads(routing_machine, coordinates,
+                                                            number_of_queries, match_size);
+        }
+
+        std::vector<unsigned> thread_counts;
+        for (unsigned threads = 1; threads < max_threads; threads *= 2)
+        {
+            thread_counts.push_back(threads);
+        }
+        thread_counts.push_back(std::max(1u, max_threads));
+
+        for (const auto &workload : workloads)
+        {
+            if (workload.queries.empty() ||
+                (!services.empty() &&
+                 std::find(services.begin(), services.end(), workload.service) == services.end()))
+            {
+                continue;
+            }
+            std::cout << "## " << workload.service << " (" << workload.queries.size()
+                      << " queries)" << std::endl;
+            for (const auto threads : thread_counts)
+            {
+                osrm::benchmarks::benchmarkWorkload(routing_machine, workload, threads);
+            }
+            if (workload.service == "match")
+            {
+                osrm::benchmarks::benchmarkMatchAllocations(routing_machine, workload);
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "caught exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
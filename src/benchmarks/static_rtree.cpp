@@ -2,6 +2,8 @@
 #include "util/static_rtree.hpp"
 #include "extractor/edge_based_node.hpp"
 #include "engine/geospatial_query.hpp"
+#include "util/integer_range.hpp"
+#include "util/layered_vector.hpp"
 #include "util/timing_util.hpp"
 
 #include "osrm/coordinate.hpp"
@@ -68,6 +70,65 @@ void benchmarkQuery(const std::vector<FixedPointCoordinate> &queries,
               << ")" << std::endl;
 }
 
+// traces are random walks with GPS like sampling, starting at random nodes of the dataset
+void benchmarkTraces(BenchQuery &geo_query,
+                     const std::vector<FixedPointCoordinate> &coordinates,
+                     unsigned num_traces)
+{
+    constexpr unsigned TRACE_LENGTH = 100;
+    // the search radius of /match for a GPS precision of about 17m
+    constexpr double MAX_DISTANCE = 50;
+
+    std::mt19937 mt_rand(RANDOM_SEED);
+    std::uniform_int_distribution<std::size_t> start_udist(0, coordinates.size() - 1);
+    // about 30m in each direction
+    std::uniform_int_distribution<> step_udist(-300, 300);
+    std::vector<std::vector<FixedPointCoordinate>> traces(num_traces);
+    for (auto &trace : traces)
+    {
+        FixedPointCoordinate position = coordinates[start_udist(mt_rand)];
+        for (unsigned i = 0; i < TRACE_LENGTH; ++i)
+        {
+            position.lat += step_udist(mt_rand);
+            position.lon += step_udist(mt_rand);
+            trace.push_back(position);
+        }
+    }
+    const std::vector<double> max_distances(TRACE_LENGTH, MAX_DISTANCE);
+
+    std::cout << "Running trace queries with " << num_traces << " traces of " << TRACE_LENGTH
+              << " coordinates" << std::endl;
+
+    std::size_t single_results = 0;
+    TIMER_START(single);
+    for (const auto &trace : traces)
+    {
+        for (const auto &q : trace)
+        {
+            single_results += geo_query.NearestPhantomNodesInRange(q, MAX_DISTANCE).size();
+        }
+    }
+    TIMER_STOP(single);
+
+    std::size_t batched_results = 0;
+    util::LayeredVector<engine::PhantomNodeWithDistance> phantom_nodes;
+    TIMER_START(batched);
+    for (const auto &trace : traces)
+    {
+        geo_query.NearestPhantomNodesInRanges(trace, max_distances, {}, phantom_nodes);
+        for (const auto index : util::irange<std::size_t>(0, phantom_nodes.size()))
+        {
+            batched_results += phantom_nodes[index].size();
+        }
+    }
+    TIMER_STOP(batched);
+
+    std::cout << "  max distance 50 per coordinate: " << TIMER_MSEC(single) / num_traces
+              << " ms/trace, " << single_results << " results" << std::endl;
+    std::cout << "  max distance 50 batched: " << TIMER_MSEC(batched) / num_traces
+              << " ms/trace, " << batched_results << " results" << std::endl;
+}
+
 void benchmark(BenchStaticRTree &rtree, BenchQuery &geo_query, unsigned num_queries)
 {
     std::mt19937 mt_rand(RANDOM_SEED);
@@ -116,7 +177,7 @@ int main(int argc, char **argv)
 {
     if (argc < 4)
     {
-        std::cout << "./rtree-bench file.ramIndex file.fileIndx file.nodes"
+        std::cout << "./rtree-bench file.ramIndex file.fileIndx file.nodes [stream|mmap|both]"
                   << "\n";
         return 1;
     }
@@ -124,13 +185,41 @@ int main(int argc, char **argv)
     const char *ram_path = argv[1];
     const char *file_path = argv[2];
     const char *nodes_path = argv[3];
+    const std::string mode = argc > 4 ? argv[4] : "both";
+
+    if (mode != "stream" && mode != "mmap" && mode != "both")
+    {
+        std::cout << "unknown leaf storage mode " << mode << "\n";
+        return 1;
+    }
 
     auto coords = osrm::benchmarks::loadCoordinates(nodes_path);
 
-    osrm::benchmarks::BenchStaticRTree rtree(ram_path, file_path, coords);
-    osrm::benchmarks::BenchQuery query(rtree, coords);
+    if (mode != "mmap")
+    {
+        std::cout << "## stream leaf storage" << std::endl;
+        osrm::benchmarks::BenchStaticRTree rtree(ram_path, file_path, coords);
+        osrm::benchmarks::BenchQuery query(rtree, coords);
+
+        osrm::benchmarks::benchmark(rtree, query, 10000);
+        osrm::benchmarks::benchmarkTraces(query, *coords, 100);
+    }
 
-    osrm::benchmarks::benchmark(rtree, query, 10000);
+    if (mode != "stream")
+    {
+        std::cout << "## memory mapped leaf storage" << std::endl;
+        osrm::benchmarks::BenchStaticRTree rtree(ram_path, file_path, coords,
+                                                 osrm::util::LeafStorage::MemoryMapped);
+        osrm::benchmarks::BenchQuery query(rtree, coords);
+
+        TIMER_START(prefetch);
+        rtree.Prefetch();
+        TIMER_STOP(prefetch);
+        std::cout << "Prefetching leaves took " << TIMER_MSEC(prefetch) << "ms" << std::endl;
+
+        osrm::benchmarks::benchmark(rtree, query, 10000);
+        osrm::benchmarks::benchmarkTraces(query, *coords, 100);
+    }
 
     return 0;
 }
@@ -0,0 +1,204 @@
+#include "engine/trip/trip_brute_force.hpp"
+#include "engine/trip/trip_farthest_insertion.hpp"
+#include "engine/trip/trip_held_karp.hpp"
+#include "engine/trip/trip_local_search.hpp"
+#include "util/dist_table_wrapper.hpp"
+#include "util/integer_range.hpp"
+#include "util/timing_util.hpp"
+#include "util/typedefs.hpp"
+
+#include <cmath>
+
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace osrm
+{
+namespace benchmarks
+{
+
+// Choosen by a fair W20 dice roll (this value is completely arbitrary)
+constexpr unsigned RANDOM_SEED = 13;
+// largest trips that are still solved exactly by the respective solver
+constexpr std::size_t BRUTE_FORCE_MAX_SIZE = 10;
+constexpr std::size_t HELD_KARP_MAX_SIZE = 20;
+
+using DistTable = util::DistTableWrapper<EdgeWeight>;
+
+// Stops spread over 10km x 10km, driven through at about 36km/h on roads that are 20% longer in
+// one direction than in the other at most, like the durations of a table query.
+DistTable randomTable(const std::size_t size, std::mt19937 &mt_rand)
+{
+    std::uniform_real_distribution<> position_udist(0., 10000.);
+    std::uniform_real_distribution<> detour_udist(1.2, 1.44);
+    std::vector<std::pair<double, double>> stops(size);
+    for (auto &stop : stops)
+    {
+        stop = std::make_pair(position_udist(mt_rand), position_udist(mt_rand));
+    }
+
+    std::vector<EdgeWeight> table(size * size, 0);
+    for (const auto from : util::irange<std::size_t>(0, size))
+    {
+        for (const auto to : util::irange<std::size_t>(0, size))
+        {
+            if (from != to)
+            {
+                const double meters = std::hypot(stops[from].first - stops[to].first,
+                                                 stops[from].second - stops[to].second);
+                // deciseconds at 10 m/s
+                table[from * size + to] = static_cast<EdgeWeight>(meters * detour_udist(mt_rand));
+            }
+        }
+    }
+    return DistTable(std::move(table), size);
+}
+
+EdgeWeight tripLength(const std::vector<NodeID> &trip, const DistTable &table)
+{
+    EdgeWeight length = 0;
+    for (const auto index : util::irange<std::size_t>(0, trip.size()))
+    {
+        length += table(trip[index], trip[(index + 1) % trip.size()]);
+    }
+    return length;
+}
+
+struct SolverResult
+{
+    double milliseconds = 0;
+    double length = 0;
+};
+
+template <typename SolverT>
+void runSolver(const std::vector<DistTable> &tables,
+               std::vector<EdgeWeight> &lengths,
+               SolverResult &result,
+               SolverT solver)
+{
+    lengths.clear();
+    TIMER_START(solve);
+    for (const auto &table : tables)
+    {
+        std::vector<NodeID> locations(table.GetNumberOfNodes());
+        std::iota(locations.begin(), locations.end(), 0);
+        const auto trip = solver(locations, table);
+        BOOST_ASSERT(trip.size() == locations.size());
+        lengths.push_back(tripLength(trip, table));
+    }
+    TIMER_STOP(solve);
+    result.milliseconds = TIMER_MSEC(solve) / tables.size();
+    result.length = std::accumulate(lengths.begin(), lengths.end(), 0.) / tables.size();
+}
+
+// the average excess of the trips over the reference lengths
+double excess(const std::vector<EdgeWeight> &lengths, const std::vector<EdgeWeight> &reference)
+{
+    double sum = 0;
+    for (const auto index : util::irange<std::size_t>(0, lengths.size()))
+    {
+        sum += static_cast<double>(lengths[index]) / reference[index] - 1.;
+    }
+    return 100. * sum / lengths.size();
+}
+
+void benchmark(const std::size_t size, const unsigned number_of_trips)
+{
+    std::mt19937 mt_rand(RANDOM_SEED);
+    std::vector<DistTable> tables;
+    for (unsigned i = 0; i < number_of_trips; ++i)
+    {
+        tables.push_back(randomTable(size, mt_rand));
+    }
+
+    std::vector<EdgeWeight> brute_force_lengths, held_karp_lengths, insertion_lengths,
+        local_search_lengths;
+    SolverResult brute_force, held_karp, insertion, local_search;
+    if (size <= BRUTE_FORCE_MAX_SIZE)
+    {
+        runSolver(tables, brute_force_lengths, brute_force,
+                  [](const std::vector<NodeID> &locations, const DistTable &table)
+                  {
+                      return engine::trip::BruteForceTrip(locations.begin(), locations.end(),
+                                                          locations.size(), table);
+                  });
+    }
+    if (size <= HELD_KARP_MAX_SIZE)
+    {
+        runSolver(tables, held_karp_lengths, held_karp,
+                  [](const std::vector<NodeID> &locations, const DistTable &table)
+                  {
+                      return engine::trip::HeldKarpTrip(locations.begin(), locations.end(),
+                                                        locations.size(), table);
+                  });
+    }
+    runSolver(tables, insertion_lengths, insertion,
+              [](const std::vector<NodeID> &locations, const DistTable &table)
+              {
+                  return engine::trip::FarthestInsertionTrip(locations.begin(), locations.end(),
+                                                             locations.size(), table);
+              });
+    runSolver(tables, local_search_lengths, local_search,
+              [](const std::vector<NodeID> &locations, const DistTable &table)
+              {
+                  auto trip = engine::trip::FarthestInsertionTrip(
+                      locations.begin(), locations.end(), locations.size(), table);
+                  engine::trip::LocalSearchTrip(trip, table);
+                  return trip;
+              });
+
+    // quality is relative to the optimum where it is known, to farthest insertion otherwise
+    const auto &reference = size <= HELD_KARP_MAX_SIZE ? held_karp_lengths : insertion_lengths;
+    std::cout << std::setw(5) << size;
+    if (size <= BRUTE_FORCE_MAX_SIZE)
+    {
+        std::cout << std::setw(14) << brute_force.milliseconds << std::setw(9)
+                  << excess(brute_force_lengths, reference) << "%";
+    }
+    else
+    {
+        std::cout << std::setw(24) << "-";
+    }
+    if (size <= HELD_KARP_MAX_SIZE)
+    {
+        std::cout << std::setw(14) << held_karp.milliseconds << std::setw(9)
+                  << excess(held_karp_lengths, reference) << "%";
+    }
+    else
+    {
+        std::cout << std::setw(24) << "-";
+    }
+    std::cout << std::setw(14) << insertion.milliseconds << std::setw(9)
+              << excess(insertion_lengths, reference) << "%";
+    std::cout << std::setw(14) << local_search.milliseconds << std::setw(9)
+              << excess(local_search_lengths, reference) << "%" << std::endl;
+}
+}
+}
+
+int main()
+{
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Time per trip in ms and excess over the optimum (farthest insertion above "
+              << osrm::benchmarks::HELD_KARP_MAX_SIZE << " locations)\n";
+    std::cout << " size   brute force [ms]/[%]     held-karp [ms]/[%]"
+              << "  farthest ins. [ms]/[%]  + local search [ms]/[%]\n";
+
+    for (const std::size_t size : {5, 8, 10})
+    {
+        osrm::benchmarks::benchmark(size, 20);
+    }
+    for (const std::size_t size : {12, 15, 18, 20})
+    {
+        osrm::benchmarks::benchmark(size, 5);
+    }
+    for (const std::size_t size : {30, 50, 100})
+    {
+        osrm::benchmarks::benchmark(size, 20);
+    }
+
+    return 0;
+}
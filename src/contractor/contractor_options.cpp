@@ -43,7 +43,33 @@ ContractorOptions::ParseArguments(int argc, char *argv[], ContractorConfig &cont
         "Lookup file containing nodeA,nodeB,speed data to adjust edge weights")(
         "level-cache,o", boost::program_options::value<bool>(&contractor_config.use_cached_priority)
                              ->default_value(false),
-        "Use .level file to retain the contaction level for each node from the last run.");
+        "Use .level file to retain the contaction level for each node from the last run.")(
+        "incremental",
+        boost::program_options::value<bool>(&contractor_config.use_incremental_contraction)
+            ->default_value(false),
+        "Update the .hsgr of the last run, which needs its .level file, and only contract the "
+        "nodes again that are affected by changed edge weights.")(
+        "incremental-growth",
+        boost::program_options::value<double>(&contractor_config.max_incremental_growth)
+            ->default_value(0.05),
+        "Contract all nodes again instead of incrementally once the hierarchy has more edges than "
+        "this fraction above the last full contraction.")(
+        "node-order",
+        boost::program_options::value<std::string>(&contractor_config.node_order)
+            ->default_value("none"),
+        "Renumber the nodes of the hierarchy for fewer cache misses at query time: none, level or "
+        "hilbert")(
+        "partition-cell-size",
+        boost::program_options::value<unsigned>(&contractor_config.partition_cell_size)
+            ->default_value(0),
+        "Cut the graph along a space filling curve into cells of this many nodes, at least 1000, "
+        "contract the cells in parallel and the nodes on their boundaries afterwards. Needs more "
+        "than one thread, 0 disables it.")(
+        "witness-cache",
+        boost::program_options::value<bool>(&contractor_config.use_witness_cache)
+            ->default_value(false),
+        "Keep the witnesses found for the priority of a node to update it faster later on. Needs "
+        "memory for the witnesses of every node.");
 
 #ifdef DEBUG_GEOMETRY
     config_options.add_options()(
@@ -119,6 +145,10 @@ void ContractorOptions::GenerateOutputFilesNames(ContractorConfig &contractor_co
     contractor_config.core_output_path = contractor_config.osrm_input_path.string() + ".core";
     contractor_config.graph_output_path = contractor_config.osrm_input_path.string() + ".hsgr";
     contractor_config.edge_based_graph_path = contractor_config.osrm_input_path.string() + ".ebg";
+    contractor_config.node_path = contractor_config.osrm_input_path.string() + ".nodes";
+    contractor_config.rtree_leaf_path = contractor_config.osrm_input_path.string() + ".fileIndex";
+    contractor_config.node_renumbering_path =
+        contractor_config.osrm_input_path.string() + ".node_renumbering";
     contractor_config.edge_segment_lookup_path =
         contractor_config.osrm_input_path.string() + ".edge_segment_lookup";
     contractor_config.edge_penalty_path =
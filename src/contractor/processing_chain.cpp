@@ -2,46 +2,49 @@
 #include "contractor/contractor.hpp"
 
 #include "extractor/edge_based_edge.hpp"
+#include "extractor/edge_based_node.hpp"
+#include "extractor/query_node.hpp"
 
 #include "util/deallocating_vector.hpp"
 
 #include "contractor/crc32_processor.hpp"
+#include "contractor/query_graph.hpp"
 #include "util/graph_loader.hpp"
+#include "util/hilbert_value.hpp"
 #include "util/integer_range.hpp"
 #include "util/lua_util.hpp"
+#include "util/mercator.hpp"
 #include "util/osrm_exception.hpp"
 #include "util/simple_logger.hpp"
+#include "util/static_rtree.hpp"
 #include "util/string_util.hpp"
 #include "util/timing_util.hpp"
 #include "util/typedefs.hpp"
 
-#include <fast-cpp-csv-parser/csv.h>
-
 #include <boost/filesystem/fstream.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <boost/program_options.hpp>
+#include <boost/spirit/include/qi.hpp>
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <tbb/parallel_sort.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <vector>
 
 #include "util/debug_geometry.hpp"
 
-namespace std
-{
-
-template <> struct hash<std::pair<OSMNodeID, OSMNodeID>>
-{
-    std::size_t operator()(const std::pair<OSMNodeID, OSMNodeID> &k) const
-    {
-        return OSMNodeID_to_uint64_t(k.first) ^ (OSMNodeID_to_uint64_t(k.second) << 12);
-    }
-};
-}
-
 namespace osrm
 {
 namespace contractor
@@ -65,6 +68,29 @@ int Prepare::Run()
         throw util::exception("Core factor must be between 0.0 to 1.0 (inclusive)");
     }
 
+    if (config.node_order != "none" && config.node_order != "level" &&
+        config.node_order != "hilbert")
+    {
+        throw util::exception("Node order must be one of none, level or hilbert");
+    }
+
+    if (config.use_incremental_contraction &&
+        (!boost::filesystem::exists(config.level_output_path) ||
+         !boost::filesystem::exists(config.graph_output_path)))
+    {
+        throw util::exception("Incremental contraction needs the .level and .hsgr files of the "
+                              "last run");
+    }
+    if (config.use_incremental_contraction && config.core_factor != 1.0)
+    {
+        throw util::exception("Incremental contraction needs a fully contracted hierarchy");
+    }
+    if (config.partition_cell_size > 0 &&
+        (config.use_cached_priority || config.use_incremental_contraction))
+    {
+        throw util::exception("Partitioned contraction can not use the levels of the last run");
+    }
+
     TIMER_START(preparing);
 
     // Create a new lua state
@@ -77,27 +103,117 @@ int Prepare::Run()
         config.edge_based_graph_path, edge_based_edge_list, config.edge_segment_lookup_path,
         config.edge_penalty_path, config.segment_speed_lookup_path);
 
+    // the .hsgr, .core and r-tree of the last run may use renumbered node ids
+    std::vector<NodeID> previous_node_ids;
+    if (boost::filesystem::exists(config.node_renumbering_path))
+    {
+        ReadNodeRenumbering(previous_node_ids);
+        if (previous_node_ids.size() != max_edge_id + 1)
+        {
+            throw util::exception(".node_renumbering does not match the edge based graph");
+        }
+    }
+
     // Contracting the edge-expanded graph
 
     TIMER_START(contraction);
     std::vector<bool> is_core_node;
     std::vector<float> node_levels;
-    if (config.use_cached_priority)
+    std::size_t full_hierarchy_size = 0;
+    if (config.use_cached_priority || config.use_incremental_contraction)
+    {
+        full_hierarchy_size = ReadNodeLevels(node_levels);
+    }
+    std::vector<QueryEdge> previous_hierarchy;
+    if (config.use_incremental_contraction)
     {
-        ReadNodeLevels(node_levels);
+        ReadContractedGraph(previous_node_ids, previous_hierarchy);
+        // the .level files of older versions do not know the size of the last full contraction
+        if (full_hierarchy_size == 0)
+        {
+            full_hierarchy_size = previous_hierarchy.size();
+        }
+        // incremental contractions keep the shortcuts that became superfluous, contracting all
+        // nodes again drops them
+        if (previous_hierarchy.size() >
+            (1. + config.max_incremental_growth) * full_hierarchy_size)
+        {
+            util::SimpleLogger().Write() << "The hierarchy grew from " << full_hierarchy_size
+                                         << " to " << previous_hierarchy.size()
+                                         << " edges since the last full contraction, "
+                                            "contracting all nodes again";
+            previous_hierarchy.clear();
+            previous_hierarchy.shrink_to_fit();
+            node_levels.clear();
+        }
+    }
+    std::vector<unsigned> node_cells;
+    // a single cell would only contract the graph in two phases instead of one
+    if (config.partition_cell_size > 0 && max_edge_id + 1 <= config.partition_cell_size)
+    {
+        util::SimpleLogger().Write() << "The graph fits into one cell of the partition, "
+                                        "contracting it as a whole";
+    }
+    else if (config.partition_cell_size > 0)
+    {
+        node_cells = ComputePartition(max_edge_id + 1, previous_node_ids);
     }
     util::DeallocatingVector<QueryEdge> contracted_edge_list;
     ContractGraph(max_edge_id, edge_based_edge_list, contracted_edge_list, is_core_node,
-                  node_levels);
+                  node_levels, previous_hierarchy, node_cells);
     TIMER_STOP(contraction);
 
     util::SimpleLogger().Write() << "Contraction took " << TIMER_SEC(contraction) << " sec";
 
+    std::vector<NodeID> new_node_ids;
+    if (config.node_order != "none")
+    {
+        TIMER_START(renumbering);
+        new_node_ids = ComputeNodeOrder(max_edge_id + 1, previous_node_ids, node_levels);
+        RenumberNodes(new_node_ids, contracted_edge_list, is_core_node);
+        TIMER_STOP(renumbering);
+        util::SimpleLogger().Write() << "Renumbering nodes by " << config.node_order << " took "
+                                     << TIMER_SEC(renumbering) << " sec";
+    }
+
     std::size_t number_of_used_edges = WriteContractedGraph(max_edge_id, contracted_edge_list);
     WriteCoreNodeMarker(std::move(is_core_node));
+    if (previous_hierarchy.empty())
+    {
+        full_hierarchy_size = number_of_used_edges;
+    }
+    else
+    {
+        util::SimpleLogger().Write() << "Incremental contraction grew the hierarchy from "
+                                     << previous_hierarchy.size() << " to "
+                                     << number_of_used_edges << " edges, "
+                                     << full_hierarchy_size << " after the last full contraction";
+    }
+    // levels keep the order of the .ebg, which is what the next run reads
     if (!config.use_cached_priority)
     {
-        WriteNodeLevels(std::move(node_levels));
+        WriteNodeLevels(std::move(node_levels), full_hierarchy_size);
+    }
+
+    // The r-tree leaves are only valid with the .node_renumbering that describes their ids. Both
+    // are written completely before either of them is replaced, the leaves last.
+    if (!previous_node_ids.empty() || !new_node_ids.empty())
+    {
+        const std::string updated_rtree_leaf_path = config.rtree_leaf_path + ".tmp";
+        UpdateRTreeNodeIDs(previous_node_ids, new_node_ids, updated_rtree_leaf_path);
+        if (new_node_ids.empty())
+        {
+            boost::filesystem::remove(config.node_renumbering_path);
+        }
+        else
+        {
+            const std::string updated_node_renumbering_path =
+                config.node_renumbering_path + ".tmp";
+            WriteNodeRenumbering(new_node_ids, updated_node_renumbering_path);
+            boost::filesystem::rename(updated_node_renumbering_path,
+                                      config.node_renumbering_path);
+        }
+        boost::filesystem::rename(updated_rtree_leaf_path, config.rtree_leaf_path);
     }
 
     TIMER_STOP(preparing);
@@ -112,6 +228,160 @@ int Prepare::Run()
     return 0;
 }
 
+namespace
+{
+// Speed of a segment between two OSM nodes, position is the line in the speed file
+struct SegmentSpeed
+{
+    OSMNodeID from;
+    OSMNodeID to;
+    unsigned speed;
+    unsigned position;
+};
+
+bool operator<(const SegmentSpeed &lhs, const SegmentSpeed &rhs)
+{
+    return std::tie(lhs.from, lhs.to, lhs.position) < std::tie(rhs.from, rhs.to, rhs.position);
+}
+
+// number of bytes of the speed file that are parsed by a single task
+constexpr std::size_t SPEED_FILE_BYTES_PER_TASK = 1 << 20;
+// number of edges that are read and updated at once
+constexpr std::size_t EDGES_PER_BATCH = 1 << 20;
+
+void ParseSegmentSpeeds(const char *begin, const char *end, std::vector<SegmentSpeed> &speeds)
+{
+    namespace qi = boost::spirit::qi;
+
+    while (begin != end)
+    {
+        const char *line_end = std::find(begin, end, '\n');
+        const char *next_line = line_end == end ? end : line_end + 1;
+        if (line_end != begin && *(line_end - 1) == '\r')
+        {
+            --line_end;
+        }
+
+        std::uint64_t from_node_id{};
+        std::uint64_t to_node_id{};
+        unsigned speed{};
+        const char *parsed_end = begin;
+        const bool parsed = qi::phrase_parse(
+            parsed_end, line_end, qi::ulong_long >> ',' >> qi::ulong_long >> ',' >> qi::uint_,
+            qi::blank, from_node_id, to_node_id, speed);
+        if (!parsed || parsed_end != line_end)
+        {
+            if (std::all_of(begin, line_end, [](const char c)
+                            {
+                                return c == ' ' || c == '\t';
+                            }))
+            {
+                begin = next_line;
+                continue;
+            }
+            throw util::exception("Segment speed file contains an invalid line: " +
+                                  std::string(begin, line_end));
+        }
+        speeds.push_back({OSMNodeID(from_node_id), OSMNodeID(to_node_id), speed, 0});
+        begin = next_line;
+    }
+}
+
+// Parses the lines "from_node,to_node,speed" of the speed file in parallel chunks. Returns one
+// entry per segment sorted by node ids, of duplicate segments the last line wins.
+std::vector<SegmentSpeed> LoadSegmentSpeeds(const std::string &segment_speed_filename)
+{
+    std::vector<SegmentSpeed> segment_speeds;
+    if (0 == boost::filesystem::file_size(segment_speed_filename))
+    {
+        return segment_speeds;
+    }
+
+    const boost::iostreams::mapped_file_source speed_file(segment_speed_filename);
+    const char *const file_begin = speed_file.data();
+    const char *const file_end = file_begin + speed_file.size();
+
+    // chunks start after the line break that follows their nominal start
+    const std::size_t number_of_chunks =
+        (speed_file.size() + SPEED_FILE_BYTES_PER_TASK - 1) / SPEED_FILE_BYTES_PER_TASK;
+    std::vector<const char *> chunk_begins(number_of_chunks + 1, file_end);
+    chunk_begins.front() = file_begin;
+    for (std::size_t chunk = 1; chunk < number_of_chunks; ++chunk)
+    {
+        const char *line_break =
+            std::find(file_begin + chunk * SPEED_FILE_BYTES_PER_TASK, file_end, '\n');
+        chunk_begins[chunk] = std::max(chunk_begins[chunk - 1], std::min(line_break + 1, file_end));
+    }
+
+    std::vector<std::vector<SegmentSpeed>> chunk_speeds(number_of_chunks);
+    tbb::parallel_for(std::size_t(0), number_of_chunks, [&](const std::size_t chunk)
+                      {
+                          ParseSegmentSpeeds(chunk_begins[chunk], chunk_begins[chunk + 1],
+                                             chunk_speeds[chunk]);
+                      });
+
+    for (auto &speeds : chunk_speeds)
+    {
+        segment_speeds.insert(segment_speeds.end(), speeds.begin(), speeds.end());
+        std::vector<SegmentSpeed>().swap(speeds);
+    }
+    for (const auto position : util::irange<std::size_t>(0, segment_speeds.size()))
+    {
+        segment_speeds[position].position = static_cast<unsigned>(position);
+    }
+
+    tbb::parallel_sort(segment_speeds.begin(), segment_speeds.end());
+
+    // keep the last line of every segment
+    const auto last = std::unique(segment_speeds.rbegin(), segment_speeds.rend(),
+                                  [](const SegmentSpeed &lhs, const SegmentSpeed &rhs)
+                                  {
+                                      return lhs.from == rhs.from && lhs.to == rhs.to;
+                                  });
+    segment_speeds.erase(segment_speeds.begin(), last.base());
+
+    return segment_speeds;
+}
+
+const SegmentSpeed *FindSegmentSpeed(const std::vector<SegmentSpeed> &segment_speeds,
+                                     const OSMNodeID from,
+                                     const OSMNodeID to)
+{
+    const auto iter = std::lower_bound(segment_speeds.begin(), segment_speeds.end(),
+                                       SegmentSpeed{from, to, 0, 0});
+    if (iter == segment_speeds.end() || iter->from != from || iter->to != to)
+    {
+        return nullptr;
+    }
+    return &*iter;
+}
+
+template <typename T> T ReadUnaligned(const char *position)
+{
+    T value;
+    std::memcpy(&value, position, sizeof(T));
+    return value;
+}
+
+// Inverts a renumbering of the nodes, an empty renumbering keeps all ids
+std::vector<NodeID> InvertNodeIDs(const std::vector<NodeID> &node_ids)
+{
+    std::vector<NodeID> inverse(node_ids.size());
+    for (const auto node : util::irange<std::size_t>(0, node_ids.size()))
+    {
+        inverse[node_ids[node]] = static_cast<NodeID>(node);
+    }
+    return inverse;
+}
+
+using EdgeBasedNodeRTree = util::StaticRTree<extractor::EdgeBasedNode>;
+
+// Size of the record of an edge in .edge_segment_lookup:
+// unsigned node count, first OSMNodeID and then for every segment its target OSMNodeID,
+// its length as double and its weight as int.
+constexpr std::size_t SEGMENT_RECORD_SIZE = sizeof(OSMNodeID) + sizeof(double) + sizeof(int);
+}
+
 std::size_t Prepare::LoadEdgeExpandedGraph(
     std::string const &edge_based_graph_filename,
     util::DeallocatingVector<extractor::EdgeBasedEdge> &edge_based_edge_list,
@@ -124,18 +394,26 @@ std::size_t Prepare::LoadEdgeExpandedGraph(
 
     const bool update_edge_weights = segment_speed_filename != "";
 
-    boost::filesystem::ifstream edge_segment_input_stream;
-    boost::filesystem::ifstream edge_fixed_penalties_input_stream;
+    boost::iostreams::mapped_file_source edge_segment_region;
+    boost::iostreams::mapped_file_source edge_fixed_penalties_region;
 
     if (update_edge_weights)
     {
-        edge_segment_input_stream.open(edge_segment_lookup_filename, std::ios::binary);
-        edge_fixed_penalties_input_stream.open(edge_penalty_filename, std::ios::binary);
-        if (!edge_segment_input_stream || !edge_fixed_penalties_input_stream)
+        if (!boost::filesystem::exists(edge_segment_lookup_filename) ||
+            !boost::filesystem::exists(edge_penalty_filename))
         {
             throw util::exception("Could not load .edge_segment_lookup or .edge_penalties, did you "
                                   "run osrm-extract with '--generate-edge-lookup'?");
         }
+        // mapping an empty file fails, such files do not contain edges anyway
+        if (0 != boost::filesystem::file_size(edge_segment_lookup_filename))
+        {
+            edge_segment_region.open(edge_segment_lookup_filename);
+        }
+        if (0 != boost::filesystem::file_size(edge_penalty_filename))
+        {
+            edge_fixed_penalties_region.open(edge_penalty_filename);
+        }
     }
 
     const util::FingerPrint fingerprint_valid = util::FingerPrint::GetValid();
@@ -152,101 +430,164 @@ std::size_t Prepare::LoadEdgeExpandedGraph(
     util::SimpleLogger().Write() << "Reading " << number_of_edges
                                  << " edges from the edge based graph";
 
-    std::unordered_map<std::pair<OSMNodeID, OSMNodeID>, unsigned> segment_speed_lookup;
+    std::vector<SegmentSpeed> segment_speeds;
 
     if (update_edge_weights)
     {
         util::SimpleLogger().Write()
             << "Segment speed data supplied, will update edge weights from "
             << segment_speed_filename;
-        io::CSVReader<3> csv_in(segment_speed_filename);
-        csv_in.set_header("from_node", "to_node", "speed");
-        uint64_t from_node_id{};
-        uint64_t to_node_id{};
-        unsigned speed{};
-        while (csv_in.read_row(from_node_id, to_node_id, speed))
+        TIMER_START(load_speeds);
+        segment_speeds = LoadSegmentSpeeds(segment_speed_filename);
+        TIMER_STOP(load_speeds);
+        util::SimpleLogger().Write() << "Loaded speeds of " << segment_speeds.size()
+                                     << " segments in " << TIMER_SEC(load_speeds) << "s";
+
+        if (edge_fixed_penalties_region.size() != number_of_edges * sizeof(unsigned))
         {
-            segment_speed_lookup[std::make_pair(OSMNodeID(from_node_id), OSMNodeID(to_node_id))] =
-                speed;
+            throw util::exception(".edge_penalties does not match the edge based graph");
         }
     }
 
     util::DEBUG_GEOMETRY_START(config);
 
-    // TODO: can we read this in bulk?  util::DeallocatingVector isn't necessarily
-    // all stored contiguously
-    for (; number_of_edges > 0; --number_of_edges)
+    const char *const segment_begin = edge_segment_region.data();
+    const char *const segment_end = segment_begin + edge_segment_region.size();
+    const char *next_segment_record = segment_begin;
+    const unsigned *const fixed_penalties =
+        reinterpret_cast<const unsigned *>(edge_fixed_penalties_region.data());
+
+    const auto update_edge_weight = [&](extractor::EdgeBasedEdge &edge,
+                                        const char *segment_record, const std::size_t edge_index)
+    {
+        int new_weight = 0;
+
+        const unsigned num_osm_nodes = ReadUnaligned<unsigned>(segment_record);
+        OSMNodeID previous_osm_node_id =
+            ReadUnaligned<OSMNodeID>(segment_record + sizeof(unsigned));
+        const char *segment = segment_record + sizeof(unsigned) + sizeof(OSMNodeID);
+        for (unsigned segment_index = 1; segment_index < num_osm_nodes;
+             ++segment_index, segment += SEGMENT_RECORD_SIZE)
+        {
+            const OSMNodeID this_osm_node_id = ReadUnaligned<OSMNodeID>(segment);
+            const double segment_length = ReadUnaligned<double>(segment + sizeof(OSMNodeID));
+            const int segment_weight =
+                ReadUnaligned<int>(segment + sizeof(OSMNodeID) + sizeof(double));
+
+            const SegmentSpeed *segment_speed =
+                FindSegmentSpeed(segment_speeds, previous_osm_node_id, this_osm_node_id);
+            if (segment_speed)
+            {
+                // This sets the segment weight using the same formula as the
+                // EdgeBasedGraphFactory for consistency.  The *why* of this formula
+                // is lost in the annals of time.
+                int new_segment_weight =
+                    std::max(1, static_cast<int>(std::floor(
+                                    (segment_length * 10.) / (segment_speed->speed / 3.6) + .5)));
+                new_weight += new_segment_weight;
+
+                util::DEBUG_GEOMETRY_EDGE(new_segment_weight, segment_length,
+                                          previous_osm_node_id, this_osm_node_id);
+            }
+            else
+            {
+                // If no lookup found, use the original weight value for this segment
+                new_weight += segment_weight;
+
+                util::DEBUG_GEOMETRY_EDGE(segment_weight, segment_length, previous_osm_node_id,
+                                          this_osm_node_id);
+            }
+
+            previous_osm_node_id = this_osm_node_id;
+        }
+
+        edge.weight = fixed_penalties[edge_index] + new_weight;
+    };
+
+    TIMER_START(load_edges);
+    std::vector<extractor::EdgeBasedEdge> edge_batch;
+    std::vector<const char *> segment_records;
+    for (std::size_t batch_begin = 0; batch_begin < number_of_edges;
+         batch_begin += EDGES_PER_BATCH)
     {
-        extractor::EdgeBasedEdge inbuffer;
-        input_stream.read((char *)&inbuffer, sizeof(extractor::EdgeBasedEdge));
+        const std::size_t batch_size = std::min(EDGES_PER_BATCH, number_of_edges - batch_begin);
+        edge_batch.resize(batch_size);
+        input_stream.read(reinterpret_cast<char *>(edge_batch.data()),
+                          batch_size * sizeof(extractor::EdgeBasedEdge));
+        if (static_cast<std::size_t>(input_stream.gcount()) !=
+            batch_size * sizeof(extractor::EdgeBasedEdge))
+        {
+            throw util::exception("Edge based graph " + edge_based_graph_filename +
+                                  " is truncated");
+        }
 
         if (update_edge_weights)
         {
-            // Processing-time edge updates
-            unsigned fixed_penalty;
-            edge_fixed_penalties_input_stream.read(reinterpret_cast<char *>(&fixed_penalty),
-                                                   sizeof(fixed_penalty));
-
-            int new_weight = 0;
-
-            unsigned num_osm_nodes = 0;
-            edge_segment_input_stream.read(reinterpret_cast<char *>(&num_osm_nodes),
-                                           sizeof(num_osm_nodes));
-            OSMNodeID previous_osm_node_id;
-            edge_segment_input_stream.read(reinterpret_cast<char *>(&previous_osm_node_id),
-                                           sizeof(previous_osm_node_id));
-            OSMNodeID this_osm_node_id;
-            double segment_length;
-            int segment_weight;
-            --num_osm_nodes;
-            for (; num_osm_nodes != 0; --num_osm_nodes)
+            // records have a variable size, hence find them before updating in parallel
+            segment_records.resize(batch_size);
+            for (auto &segment_record : segment_records)
             {
-                edge_segment_input_stream.read(reinterpret_cast<char *>(&this_osm_node_id),
-                                               sizeof(this_osm_node_id));
-                edge_segment_input_stream.read(reinterpret_cast<char *>(&segment_length),
-                                               sizeof(segment_length));
-                edge_segment_input_stream.read(reinterpret_cast<char *>(&segment_weight),
-                                               sizeof(segment_weight));
-
-                auto speed_iter = segment_speed_lookup.find(
-                    std::make_pair(previous_osm_node_id, this_osm_node_id));
-                if (speed_iter != segment_speed_lookup.end())
+                if (segment_end - next_segment_record <
+                    static_cast<std::ptrdiff_t>(sizeof(unsigned) + sizeof(OSMNodeID)))
                 {
-                    // This sets the segment weight using the same formula as the
-                    // EdgeBasedGraphFactory for consistency.  The *why* of this formula
-                    // is lost in the annals of time.
-                    int new_segment_weight =
-                        std::max(1, static_cast<int>(std::floor(
-                                        (segment_length * 10.) / (speed_iter->second / 3.6) + .5)));
-                    new_weight += new_segment_weight;
-
-                    util::DEBUG_GEOMETRY_EDGE(new_segment_weight, segment_length,
-                                              previous_osm_node_id, this_osm_node_id);
+                    throw util::exception(".edge_segment_lookup does not match the edge based "
+                                          "graph");
                 }
-                else
+                const unsigned num_osm_nodes = ReadUnaligned<unsigned>(next_segment_record);
+                const std::size_t record_size = sizeof(unsigned) + sizeof(OSMNodeID) +
+                                                (num_osm_nodes - 1) * SEGMENT_RECORD_SIZE;
+                if (0 == num_osm_nodes ||
+                    static_cast<std::size_t>(segment_end - next_segment_record) < record_size)
                 {
-                    // If no lookup found, use the original weight value for this segment
-                    new_weight += segment_weight;
-
-                    util::DEBUG_GEOMETRY_EDGE(segment_weight, segment_length, previous_osm_node_id,
-                                              this_osm_node_id);
+                    throw util::exception(".edge_segment_lookup does not match the edge based "
+                                          "graph");
                 }
-
-                previous_osm_node_id = this_osm_node_id;
+                segment_record = next_segment_record;
+                next_segment_record += record_size;
             }
 
-            inbuffer.weight = fixed_penalty + new_weight;
+#ifdef DEBUG_GEOMETRY
+            // the debug geometry is written to a single stream
+            for (const auto edge_index : util::irange<std::size_t>(0, batch_size))
+            {
+                update_edge_weight(edge_batch[edge_index], segment_records[edge_index],
+                                   batch_begin + edge_index);
+            }
+#else
+            tbb::parallel_for(tbb::blocked_range<std::size_t>(0, batch_size),
+                              [&](const tbb::blocked_range<std::size_t> &range)
+                              {
+                                  for (auto edge_index = range.begin(), end = range.end();
+                                       edge_index != end; ++edge_index)
+                                  {
+                                      update_edge_weight(edge_batch[edge_index],
+                                                         segment_records[edge_index],
+                                                         batch_begin + edge_index);
+                                  }
+                              });
+#endif
         }
 
-        edge_based_edge_list.emplace_back(std::move(inbuffer));
+        for (const auto edge_index : util::irange<std::size_t>(0, batch_size))
+        {
+            edge_based_edge_list[batch_begin + edge_index] = edge_batch[edge_index];
+        }
     }
+    TIMER_STOP(load_edges);
 
     util::DEBUG_GEOMETRY_STOP();
     util::SimpleLogger().Write() << "Done reading edges";
+    if (update_edge_weights)
+    {
+        util::SimpleLogger().Write() << "Updated weights of " << number_of_edges << " edges in "
+                                     << TIMER_SEC(load_edges) << "s, "
+                                     << number_of_edges / std::max(TIMER_SEC(load_edges), 1e-3)
+                                     << " edges/sec";
+    }
     return max_edge_id;
 }
 
-void Prepare::ReadNodeLevels(std::vector<float> &node_levels) const
+std::size_t Prepare::ReadNodeLevels(std::vector<float> &node_levels) const
 {
     boost::filesystem::ifstream order_input_stream(config.level_output_path, std::ios::binary);
 
@@ -254,9 +595,277 @@ void Prepare::ReadNodeLevels(std::vector<float> &node_levels) const
     order_input_stream.read((char *)&level_size, sizeof(unsigned));
     node_levels.resize(level_size);
     order_input_stream.read((char *)node_levels.data(), sizeof(float) * node_levels.size());
+
+    // appended by newer versions, zero if the file ends with the levels
+    unsigned full_hierarchy_size = 0;
+    if (!order_input_stream.read((char *)&full_hierarchy_size, sizeof(unsigned)))
+    {
+        full_hierarchy_size = 0;
+    }
+    return full_hierarchy_size;
+}
+
+void Prepare::ReadContractedGraph(const std::vector<NodeID> &previous_node_ids,
+                                  std::vector<QueryEdge> &contracted_edge_list) const
+{
+    boost::filesystem::ifstream core_marker_input_stream(config.core_output_path,
+                                                         std::ios::binary);
+    unsigned number_of_core_markers = 0;
+    core_marker_input_stream.read((char *)&number_of_core_markers, sizeof(unsigned));
+    if (!core_marker_input_stream || number_of_core_markers != 0)
+    {
+        throw util::exception("Incremental contraction needs a fully contracted hierarchy");
+    }
+
+    std::vector<QueryGraph<>::NodeArrayEntry> node_list;
+    std::vector<QueryEdgeSearchData> search_list;
+    std::vector<QueryEdgeUnpackData> unpack_list;
+    unsigned check_sum = 0;
+    util::readHSGRFromStream(config.graph_output_path, node_list, search_list, unpack_list,
+                             &check_sum);
+
+    // the contractor works on the node ids of the .ebg
+    const auto original_node_ids = InvertNodeIDs(previous_node_ids);
+    const auto original_id = [&original_node_ids](const NodeID node)
+    {
+        return original_node_ids.empty() ? node : original_node_ids[node];
+    };
+
+    contracted_edge_list.reserve(search_list.size());
+    for (const auto node : util::irange<std::size_t>(0, node_list.size() - 1))
+    {
+        for (const auto edge :
+             util::irange(node_list[node].first_edge, node_list[node + 1].first_edge))
+        {
+            EdgeData data(search_list[edge], unpack_list[edge]);
+            if (data.shortcut)
+            {
+                data.id = original_id(data.id);
+            }
+            contracted_edge_list.emplace_back(original_id(node),
+                                              original_id(search_list[edge].target), data);
+        }
+    }
+}
+
+void Prepare::ReadNodeRenumbering(std::vector<NodeID> &node_ids) const
+{
+    boost::filesystem::ifstream renumbering_input_stream(config.node_renumbering_path,
+                                                         std::ios::binary);
+
+    unsigned number_of_nodes = 0;
+    renumbering_input_stream.read((char *)&number_of_nodes, sizeof(unsigned));
+    node_ids.resize(number_of_nodes);
+    renumbering_input_stream.read((char *)node_ids.data(), sizeof(NodeID) * node_ids.size());
+}
+
+void Prepare::WriteNodeRenumbering(const std::vector<NodeID> &node_ids,
+                                   const std::string &node_renumbering_path) const
+{
+    boost::filesystem::ofstream renumbering_output_stream(node_renumbering_path,
+                                                          std::ios::binary);
+
+    const unsigned number_of_nodes = node_ids.size();
+    renumbering_output_stream.write((char *)&number_of_nodes, sizeof(unsigned));
+    renumbering_output_stream.write((char *)node_ids.data(), sizeof(NodeID) * node_ids.size());
+    renumbering_output_stream.flush();
+    if (!renumbering_output_stream)
+    {
+        throw util::exception("could not write " + node_renumbering_path);
+    }
+}
+
+// Position of every node along a Hilbert curve over the centroids of its segments
+std::vector<std::uint64_t>
+Prepare::ComputeHilbertValues(const unsigned number_of_nodes,
+                              const std::vector<NodeID> &previous_node_ids) const
+{
+    boost::filesystem::ifstream nodes_input_stream(config.node_path, std::ios::binary);
+    unsigned number_of_coordinates = 0;
+    nodes_input_stream.read((char *)&number_of_coordinates, sizeof(unsigned));
+    std::vector<extractor::QueryNode> coordinates(number_of_coordinates);
+    nodes_input_stream.read((char *)coordinates.data(),
+                            sizeof(extractor::QueryNode) * coordinates.size());
+    if (!nodes_input_stream)
+    {
+        throw util::exception("Could not read the coordinates from " + config.node_path);
+    }
+
+    // nodes the r-tree does not know are not snapped to and go last
+    std::vector<std::uint64_t> hilbert_values(number_of_nodes,
+                                              std::numeric_limits<std::uint64_t>::max());
+    const auto original_node_ids = InvertNodeIDs(previous_node_ids);
+    const util::HilbertCode get_hilbert_number{};
+    EdgeBasedNodeRTree::VisitLeafNodeFile(
+        config.rtree_leaf_path, [&](const extractor::EdgeBasedNode &segment)
+        {
+            if (segment.u >= coordinates.size() || segment.v >= coordinates.size())
+            {
+                throw util::exception(".fileIndex does not match " + config.node_path);
+            }
+            // same projection as for building the r-tree
+            util::FixedPointCoordinate centroid = extractor::EdgeBasedNode::Centroid(
+                util::FixedPointCoordinate(coordinates[segment.u].lat, coordinates[segment.u].lon),
+                util::FixedPointCoordinate(coordinates[segment.v].lat, coordinates[segment.v].lon));
+            centroid.lat = COORDINATE_PRECISION *
+                           util::mercator::latToY(centroid.lat / COORDINATE_PRECISION);
+            const std::uint64_t hilbert_value = get_hilbert_number(centroid);
+
+            // a node consists of several segments, its first one along the curve counts
+            for (auto node :
+                 {segment.forward_edge_based_node_id, segment.reverse_edge_based_node_id})
+            {
+                if (SPECIAL_NODEID == node)
+                {
+                    continue;
+                }
+                node = original_node_ids.empty() ? node : original_node_ids[node];
+                if (node < number_of_nodes)
+                {
+                    hilbert_values[node] = std::min(hilbert_values[node], hilbert_value);
+                }
+            }
+        });
+
+    return hilbert_values;
+}
+
+// Cuts the nodes into cells of consecutive nodes along the Hilbert curve
+std::vector<unsigned> Prepare::ComputePartition(const unsigned number_of_nodes,
+                                                const std::vector<NodeID> &previous_node_ids) const
+{
+    BOOST_ASSERT(config.partition_cell_size > 0);
+
+    std::vector<NodeID> order(number_of_nodes);
+    std::iota(order.begin(), order.end(), 0);
+    const auto hilbert_values = ComputeHilbertValues(number_of_nodes, previous_node_ids);
+    tbb::parallel_sort(order.begin(), order.end(),
+                       [&hilbert_values](const NodeID lhs, const NodeID rhs)
+                       {
+                           return std::tie(hilbert_values[lhs], lhs) <
+                                  std::tie(hilbert_values[rhs], rhs);
+                       });
+
+    std::vector<unsigned> node_cells(number_of_nodes);
+    for (const auto position : util::irange(0u, number_of_nodes))
+    {
+        node_cells[order[position]] = position / config.partition_cell_size;
+    }
+    return node_cells;
+}
+
+/**
+ \brief Computes the new id of every node so that nodes settled by the same queries are close
+ in memory. Returns the new ids indexed by the node ids of the .ebg.
+ */
+std::vector<NodeID> Prepare::ComputeNodeOrder(const unsigned number_of_nodes,
+                                              const std::vector<NodeID> &previous_node_ids,
+                                              std::vector<float> &node_levels) const
+{
+    std::vector<NodeID> order(number_of_nodes);
+    std::iota(order.begin(), order.end(), 0);
+
+    if (config.node_order == "level")
+    {
+        // cached priorities are handed over to the contractor, but the file still has them
+        if (node_levels.size() != number_of_nodes)
+        {
+            ReadNodeLevels(node_levels);
+        }
+        if (node_levels.size() != number_of_nodes)
+        {
+            throw util::exception("Node levels do not match the graph, run a full contraction");
+        }
+
+        // the top of the hierarchy is settled by almost every query, hence it comes first
+        tbb::parallel_sort(order.begin(), order.end(),
+                           [&node_levels](const NodeID lhs, const NodeID rhs)
+                           {
+                               return std::make_tuple(-node_levels[lhs], lhs) <
+                                      std::make_tuple(-node_levels[rhs], rhs);
+                           });
+    }
+    else
+    {
+        BOOST_ASSERT(config.node_order == "hilbert");
+
+        const auto hilbert_values = ComputeHilbertValues(number_of_nodes, previous_node_ids);
+        tbb::parallel_sort(order.begin(), order.end(),
+                           [&hilbert_values](const NodeID lhs, const NodeID rhs)
+                           {
+                               return std::tie(hilbert_values[lhs], lhs) <
+                                      std::tie(hilbert_values[rhs], rhs);
+                           });
+    }
+
+    std::vector<NodeID> new_node_ids(number_of_nodes);
+    for (const auto position : util::irange(0u, number_of_nodes))
+    {
+        new_node_ids[order[position]] = position;
+    }
+    return new_node_ids;
 }
 
-void Prepare::WriteNodeLevels(std::vector<float> &&in_node_levels) const
+void Prepare::RenumberNodes(const std::vector<NodeID> &new_node_ids,
+                            util::DeallocatingVector<QueryEdge> &contracted_edge_list,
+                            std::vector<bool> &is_core_node) const
+{
+    for (auto &edge : contracted_edge_list)
+    {
+        edge.source = new_node_ids[edge.source];
+        edge.target = new_node_ids[edge.target];
+        // shortcuts store their middle node, original edges an index into .edges
+        if (edge.data.shortcut)
+        {
+            edge.data.id = new_node_ids[edge.data.id];
+        }
+    }
+
+    if (!is_core_node.empty())
+    {
+        std::vector<bool> renumbered_is_core_node(is_core_node.size());
+        for (const auto node : util::irange<std::size_t>(0, is_core_node.size()))
+        {
+            renumbered_is_core_node[new_node_ids[node]] = is_core_node[node];
+        }
+        is_core_node.swap(renumbered_is_core_node);
+    }
+}
+
+// The r-tree is written by osrm-extract with the node ids of the .ebg and rewritten with the ids
+// of the current .hsgr. The ids of the last run are undone first.
+void Prepare::UpdateRTreeNodeIDs(const std::vector<NodeID> &previous_node_ids,
+                                 const std::vector<NodeID> &new_node_ids,
+                                 const std::string &updated_rtree_leaf_path) const
+{
+    const auto original_node_ids = InvertNodeIDs(previous_node_ids);
+    const auto renumber = [&original_node_ids, &new_node_ids](NodeID &node)
+    {
+        if (SPECIAL_NODEID == node)
+        {
+            return;
+        }
+        if (!original_node_ids.empty())
+        {
+            node = original_node_ids[node];
+        }
+        if (!new_node_ids.empty())
+        {
+            node = new_node_ids[node];
+        }
+    };
+
+    EdgeBasedNodeRTree::WriteUpdatedLeafNodeFile(
+        config.rtree_leaf_path, updated_rtree_leaf_path,
+        [&renumber](extractor::EdgeBasedNode &segment)
+        {
+            renumber(segment.forward_edge_based_node_id);
+            renumber(segment.reverse_edge_based_node_id);
+        });
+}
+
+void Prepare::WriteNodeLevels(std::vector<float> &&in_node_levels,
+                              const std::size_t full_hierarchy_size) const
 {
     std::vector<float> node_levels(std::move(in_node_levels));
 
@@ -265,6 +874,8 @@ void Prepare::WriteNodeLevels(std::vector<float> &&in_node_levels) const
     unsigned level_size = node_levels.size();
     order_output_stream.write((char *)&level_size, sizeof(unsigned));
     order_output_stream.write((char *)node_levels.data(), sizeof(float) * node_levels.size());
+    const unsigned hierarchy_size = full_hierarchy_size;
+    order_output_stream.write((char *)&hierarchy_size, sizeof(unsigned));
 }
 
 void Prepare::WriteCoreNodeMarker(std::vector<bool> &&in_is_core_node) const
@@ -297,6 +908,7 @@ Prepare::WriteContractedGraph(unsigned max_node_id,
     const util::FingerPrint fingerprint = util::FingerPrint::GetValid();
     boost::filesystem::ofstream hsgr_output_stream(config.graph_output_path, std::ios::binary);
     hsgr_output_stream.write((char *)&fingerprint, sizeof(util::FingerPrint));
+    hsgr_output_stream.write((char *)&util::HSGR_FORMAT_VERSION, sizeof(unsigned));
     const unsigned max_used_node_id = [&contracted_edge_list]
     {
         unsigned tmp_max = 0;
@@ -314,14 +926,14 @@ Prepare::WriteContractedGraph(unsigned max_node_id,
     util::SimpleLogger().Write(logDEBUG) << "contracted graph has " << (max_used_node_id + 1)
                                          << " nodes";
 
-    std::vector<util::StaticGraph<EdgeData>::NodeArrayEntry> node_array;
+    std::vector<QueryGraph<>::NodeArrayEntry> node_array;
     // make sure we have at least one sentinel
     node_array.resize(max_node_id + 2);
 
     util::SimpleLogger().Write() << "Building node array";
-    util::StaticGraph<EdgeData>::EdgeIterator edge = 0;
-    util::StaticGraph<EdgeData>::EdgeIterator position = 0;
-    util::StaticGraph<EdgeData>::EdgeIterator last_edge;
+    QueryGraph<>::EdgeIterator edge = 0;
+    QueryGraph<>::EdgeIterator position = 0;
+    QueryGraph<>::EdgeIterator last_edge;
 
     // initializing 'first_edge'-field of nodes:
     for (const auto node : util::irange(0u, max_used_node_id + 1))
@@ -359,31 +971,31 @@ Prepare::WriteContractedGraph(unsigned max_node_id,
     if (node_array_size > 0)
     {
         hsgr_output_stream.write((char *)&node_array[0],
-                                 sizeof(util::StaticGraph<EdgeData>::NodeArrayEntry) *
-                                     node_array_size);
+                                 sizeof(QueryGraph<>::NodeArrayEntry) * node_array_size);
     }
 
-    // serialize all edges
+    // serialize all edges, first the data the searches relax and then the data to unpack them
     util::SimpleLogger().Write() << "Building edge array";
     int number_of_used_edges = 0;
 
-    util::StaticGraph<EdgeData>::EdgeArrayEntry current_edge;
     for (const auto edge : util::irange<std::size_t>(0, contracted_edge_list.size()))
     {
         // no eigen loops
         BOOST_ASSERT(contracted_edge_list[edge].source != contracted_edge_list[edge].target);
-        current_edge.target = contracted_edge_list[edge].target;
-        current_edge.data = contracted_edge_list[edge].data;
+        const QueryEdgeSearchData current_edge = {contracted_edge_list[edge].target,
+                                                  contracted_edge_list[edge].data.distance,
+                                                  contracted_edge_list[edge].data.forward,
+                                                  contracted_edge_list[edge].data.backward};
 
         // every target needs to be valid
         BOOST_ASSERT(current_edge.target <= max_used_node_id);
 #ifndef NDEBUG
-        if (current_edge.data.distance <= 0)
+        if (current_edge.distance <= 0)
         {
             util::SimpleLogger().Write(logWARNING)
                 << "Edge: " << edge << ",source: " << contracted_edge_list[edge].source
                 << ", target: " << contracted_edge_list[edge].target
-                << ", dist: " << current_edge.data.distance;
+                << ", dist: " << current_edge.distance;
 
             util::SimpleLogger().Write(logWARNING) << "Failed at adjacency list of node "
                                                    << contracted_edge_list[edge].source << "/"
@@ -391,12 +1003,17 @@ Prepare::WriteContractedGraph(unsigned max_node_id,
             return 1;
         }
 #endif
-        hsgr_output_stream.write((char *)&current_edge,
-                                 sizeof(util::StaticGraph<EdgeData>::EdgeArrayEntry));
+        hsgr_output_stream.write((char *)&current_edge, sizeof(QueryEdgeSearchData));
 
         ++number_of_used_edges;
     }
 
+    for (const auto &edge : contracted_edge_list)
+    {
+        const QueryEdgeUnpackData current_edge = {edge.data.id, edge.data.shortcut};
+        hsgr_output_stream.write((char *)&current_edge, sizeof(QueryEdgeUnpackData));
+    }
+
     return number_of_used_edges;
 }
 
@@ -408,13 +1025,27 @@ void Prepare::ContractGraph(
     util::DeallocatingVector<extractor::EdgeBasedEdge> &edge_based_edge_list,
     util::DeallocatingVector<QueryEdge> &contracted_edge_list,
     std::vector<bool> &is_core_node,
-    std::vector<float> &inout_node_levels) const
+    std::vector<float> &inout_node_levels,
+    const std::vector<QueryEdge> &previous_hierarchy,
+    const std::vector<unsigned> &node_cells) const
 {
     std::vector<float> node_levels;
     node_levels.swap(inout_node_levels);
 
     Contractor contractor(max_edge_id + 1, edge_based_edge_list, std::move(node_levels));
-    contractor.Run(config.core_factor);
+    // empty if the hierarchy grew too much and all nodes are contracted again
+    if (!previous_hierarchy.empty())
+    {
+        contractor.RunIncremental(previous_hierarchy);
+    }
+    else if (!node_cells.empty())
+    {
+        contractor.RunPartitioned(node_cells, config.core_factor, config.use_witness_cache);
+    }
+    else
+    {
+        contractor.Run(config.core_factor, config.use_witness_cache);
+    }
     contractor.GetEdges(contracted_edge_list);
     contractor.GetCoreMarker(is_core_node);
     contractor.GetNodeLevels(inout_node_levels);
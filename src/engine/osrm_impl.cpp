@@ -9,21 +9,23 @@
 #include "engine/plugins/match.hpp"
 #include "engine/datafacade/datafacade_base.hpp"
 #include "engine/datafacade/internal_datafacade.hpp"
+#include "engine/datafacade/mapped_datafacade.hpp"
 #include "engine/datafacade/shared_barriers.hpp"
 #include "engine/datafacade/shared_datafacade.hpp"
+#include "util/json_writer.hpp"
 #include "util/make_unique.hpp"
 #include "util/routed_options.hpp"
 #include "util/simple_logger.hpp"
 
 #include <boost/assert.hpp>
-#include <boost/interprocess/sync/named_condition.hpp>
-#include <boost/interprocess/sync/scoped_lock.hpp>
 
 #include "osrm/libosrm_config.hpp"
 #include "osrm/osrm.hpp"
 #include "osrm/route_parameters.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <fstream>
 #include <utility>
 #include <vector>
@@ -33,47 +35,126 @@ namespace osrm
 namespace engine
 {
 
-OSRM::OSRM_impl::OSRM_impl(LibOSRMConfig &lib_config)
+// Registers a query with osrm-datastore and pins the snapshot it runs on. Both are released when
+// the query returns or throws.
+class OSRM::OSRM_impl::RunningQuery
 {
+  public:
+    explicit RunningQuery(OSRM_impl &impl)
+        : registry(impl.barrier ? impl.barrier->query_registry : nullptr),
+          // register before looking at the current regions, an update waits for us from here on
+          ticket(registry ? registry->Enter() : 0), snapshot(impl.GetSnapshot())
+    {
+    }
+
+    RunningQuery(const RunningQuery &) = delete;
+
+    ~RunningQuery()
+    {
+        snapshot.reset();
+        if (registry)
+        {
+            registry->Leave(ticket);
+        }
+    }
+
+    const Snapshot &operator*() const { return *snapshot; }
+
+  private:
+    datafacade::SharedQueryRegistry *registry;
+    std::uint32_t ticket;
+    std::shared_ptr<const Snapshot> snapshot;
+};
+
+OSRM::OSRM_impl::OSRM_impl(LibOSRMConfig &lib_config) : config(lib_config)
+{
+    const auto leaf_storage = lib_config.mmap_file_index ? util::LeafStorage::MemoryMapped
+                                                         : util::LeafStorage::Stream;
+    std::unique_ptr<DataFacade> facade;
     if (lib_config.use_shared_memory)
     {
         barrier = util::make_unique<datafacade::SharedBarriers>();
-        query_data_facade = new datafacade::SharedDataFacade<contractor::QueryEdge::EdgeData>();
+        facade = util::make_unique<datafacade::SharedDataFacade<contractor::QueryEdge::EdgeData>>(
+            leaf_storage, lib_config.prefetch_file_index);
+    }
+    else if (lib_config.mmap_dataset)
+    {
+        util::populate_base_path(config.server_paths);
+        facade = util::make_unique<datafacade::MappedDataFacade<contractor::QueryEdge::EdgeData>>(
+            config.server_paths, leaf_storage, lib_config.prefetch_file_index);
     }
     else
     {
         // populate base path
-        util::populate_base_path(lib_config.server_paths);
-        query_data_facade = new datafacade::InternalDataFacade<contractor::QueryEdge::EdgeData>(
-            lib_config.server_paths);
+        util::populate_base_path(config.server_paths);
+        facade =
+            util::make_unique<datafacade::InternalDataFacade<contractor::QueryEdge::EdgeData>>(
+                config.server_paths, leaf_storage, lib_config.prefetch_file_index);
     }
+    std::atomic_store(&snapshot, LoadSnapshot(std::move(facade)));
+}
 
-    using DataFacade = datafacade::BaseDataFacade<contractor::QueryEdge::EdgeData>;
+OSRM::OSRM_impl::~OSRM_impl() {}
+
+std::shared_ptr<const OSRM::OSRM_impl::Snapshot>
+OSRM::OSRM_impl::LoadSnapshot(std::unique_ptr<DataFacade> facade) const
+{
+    auto next_snapshot = std::make_shared<Snapshot>();
+    next_snapshot->facade = std::move(facade);
+    DataFacade *query_data_facade = next_snapshot->facade.get();
 
     // The following plugins handle all requests.
-    RegisterPlugin(new plugins::DistanceTablePlugin<DataFacade>(
-        query_data_facade, lib_config.max_locations_distance_table));
-    RegisterPlugin(new plugins::HelloWorldPlugin());
-    RegisterPlugin(new plugins::NearestPlugin<DataFacade>(query_data_facade));
-    RegisterPlugin(new plugins::MapMatchingPlugin<DataFacade>(
-        query_data_facade, lib_config.max_locations_map_matching));
-    RegisterPlugin(new plugins::TimestampPlugin<DataFacade>(query_data_facade));
-    RegisterPlugin(new plugins::ViaRoutePlugin<DataFacade>(query_data_facade,
-                                                           lib_config.max_locations_viaroute));
-    RegisterPlugin(
-        new plugins::RoundTripPlugin<DataFacade>(query_data_facade, lib_config.max_locations_trip));
+    std::vector<std::unique_ptr<plugins::BasePlugin>> plugins;
+    plugins.emplace_back(new plugins::DistanceTablePlugin<DataFacade>(
+        query_data_facade, config.max_locations_distance_table));
+    plugins.emplace_back(new plugins::HelloWorldPlugin());
+    plugins.emplace_back(new plugins::NearestPlugin<DataFacade>(query_data_facade));
+    plugins.emplace_back(new plugins::MapMatchingPlugin<DataFacade>(
+        query_data_facade, config.max_locations_map_matching));
+    plugins.emplace_back(new plugins::TimestampPlugin<DataFacade>(query_data_facade));
+    plugins.emplace_back(
+        new plugins::ViaRoutePlugin<DataFacade>(query_data_facade, config.max_locations_viaroute));
+    plugins.emplace_back(
+        new plugins::RoundTripPlugin<DataFacade>(query_data_facade, config.max_locations_trip));
+
+    for (auto &plugin_ptr : plugins)
+    {
+        util::SimpleLogger().Write() << "loaded plugin: " << plugin_ptr->GetDescriptor();
+        next_snapshot->plugin_map[plugin_ptr->GetDescriptor()] = std::move(plugin_ptr);
+    }
+    return std::move(next_snapshot);
 }
 
-void OSRM::OSRM_impl::RegisterPlugin(plugins::BasePlugin *raw_plugin_ptr)
+std::shared_ptr<const OSRM::OSRM_impl::Snapshot> OSRM::OSRM_impl::GetSnapshot()
 {
-    std::unique_ptr<plugins::BasePlugin> plugin_ptr(raw_plugin_ptr);
-    util::SimpleLogger().Write() << "loaded plugin: " << plugin_ptr->GetDescriptor();
-    plugin_map[plugin_ptr->GetDescriptor()] = std::move(plugin_ptr);
+    using SharedFacade = datafacade::SharedDataFacade<contractor::QueryEdge::EdgeData>;
+
+    auto current_snapshot = std::atomic_load(&snapshot);
+    if (!barrier || !static_cast<SharedFacade &>(*current_snapshot->facade).IsOutdated())
+    {
+        return current_snapshot;
+    }
+
+    // Only queries that see new data wait here, the others keep running on their snapshot. The
+    // previous snapshot is freed once the last query using it finished.
+    std::lock_guard<std::mutex> reload_lock(reload_mutex);
+    current_snapshot = std::atomic_load(&snapshot);
+    if (static_cast<SharedFacade &>(*current_snapshot->facade).IsOutdated())
+    {
+        const auto leaf_storage = config.mmap_file_index ? util::LeafStorage::MemoryMapped
+                                                         : util::LeafStorage::Stream;
+        current_snapshot = LoadSnapshot(
+            util::make_unique<SharedFacade>(leaf_storage, config.prefetch_file_index));
+        std::atomic_store(&snapshot, current_snapshot);
+    }
+    return current_snapshot;
 }
 
 int OSRM::OSRM_impl::RunQuery(const RouteParameters &route_parameters,
                               util::json::Object &json_result)
 {
+    const RunningQuery query(*this);
+    const auto &plugin_map = (*query).plugin_map;
     const auto &plugin_iterator = plugin_map.find(route_parameters.service);
 
     if (plugin_map.end() == plugin_iterator)
@@ -82,59 +163,25 @@ int OSRM::OSRM_impl::RunQuery(const RouteParameters &route_parameters,
         return 400;
     }
 
-    increase_concurrent_query_count();
-    auto return_code = plugin_iterator->second->HandleRequest(route_parameters, json_result);
-    decrease_concurrent_query_count();
-    return static_cast<int>(return_code);
+    return static_cast<int>(plugin_iterator->second->HandleRequest(route_parameters, json_result));
 }
 
-// decrease number of concurrent queries
-void OSRM::OSRM_impl::decrease_concurrent_query_count()
+int OSRM::OSRM_impl::RunQuery(const RouteParameters &route_parameters,
+                              util::json::Writer &writer)
 {
-    if (!barrier)
-    {
-        return;
-    }
-    // lock query
-    boost::interprocess::scoped_lock<boost::interprocess::named_mutex> query_lock(
-        barrier->query_mutex);
-
-    // decrement query count
-    --(barrier->number_of_queries);
-    BOOST_ASSERT_MSG(0 <= barrier->number_of_queries, "invalid number of queries");
-
-    // notify all processes that were waiting for this condition
-    if (0 == barrier->number_of_queries)
-    {
-        barrier->no_running_queries_condition.notify_all();
-    }
-}
+    const RunningQuery query(*this);
+    const auto &plugin_map = (*query).plugin_map;
+    const auto &plugin_iterator = plugin_map.find(route_parameters.service);
 
-// increase number of concurrent queries
-void OSRM::OSRM_impl::increase_concurrent_query_count()
-{
-    if (!barrier)
+    if (plugin_map.end() == plugin_iterator)
     {
-        return;
+        writer.Key("status_message");
+        writer.String("Service not found");
+        return 400;
     }
 
-    // lock update pending
-    boost::interprocess::scoped_lock<boost::interprocess::named_mutex> pending_lock(
-        barrier->pending_update_mutex);
-
-    // lock query
-    boost::interprocess::scoped_lock<boost::interprocess::named_mutex> query_lock(
-        barrier->query_mutex);
-
-    // unlock update pending
-    pending_lock.unlock();
-
-    // increment query count
-    ++(barrier->number_of_queries);
-
-    (static_cast<datafacade::SharedDataFacade<contractor::QueryEdge::EdgeData> *>(
-         query_data_facade))
-        ->CheckAndReloadFacade();
+    return static_cast<int>(
+        plugin_iterator->second->HandleStreamingRequest(route_parameters, writer));
 }
 
 // proxy code for compilation firewall
@@ -147,5 +194,10 @@ int OSRM::RunQuery(const RouteParameters &route_parameters, util::json::Object &
 {
     return OSRM_pimpl_->RunQuery(route_parameters, json_result);
 }
+
+int OSRM::RunQuery(const RouteParameters &route_parameters, util::json::Writer &writer)
+{
+    return OSRM_pimpl_->RunQuery(route_parameters, writer);
+}
 }
 }
@@ -1,12 +1,26 @@
 #include "engine/search_engine_data.hpp"
 
 #include "util/binary_heap.hpp"
+#include "util/integer_range.hpp"
+
+#include <algorithm>
 
 namespace osrm
 {
 namespace engine
 {
 
+SearchEngineData::SearchEngineHeapPtr SearchEngineData::forward_heap_1;
+SearchEngineData::SearchEngineHeapPtr SearchEngineData::reverse_heap_1;
+SearchEngineData::SearchEngineHeapPtr SearchEngineData::forward_heap_2;
+SearchEngineData::SearchEngineHeapPtr SearchEngineData::reverse_heap_2;
+SearchEngineData::SearchEngineHeapPtr SearchEngineData::forward_heap_3;
+SearchEngineData::SearchEngineHeapPtr SearchEngineData::reverse_heap_3;
+SearchEngineData::ManyToManyHeapPtr SearchEngineData::many_to_many_heap;
+thread_local unsigned SearchEngineData::many_to_many_heap_size = 0;
+SearchEngineData::MapMatchingHeapPtr SearchEngineData::map_matching_forward_heap;
+SearchEngineData::MapMatchingHeapPoolPtr SearchEngineData::map_matching_reverse_heaps;
+
 void SearchEngineData::InitializeOrClearFirstThreadLocalStorage(const unsigned number_of_nodes)
 {
     if (forward_heap_1.get())
@@ -69,5 +83,47 @@ void SearchEngineData::InitializeOrClearThirdThreadLocalStorage(const unsigned n
         reverse_heap_3.reset(new QueryHeap(number_of_nodes));
     }
 }
+
+void SearchEngineData::InitializeOrClearManyToManyThreadLocalStorage(const unsigned number_of_nodes)
+{
+    // the dense index of a heap built for a smaller dataset can not hold all node ids
+    if (many_to_many_heap.get() && number_of_nodes <= many_to_many_heap_size)
+    {
+        many_to_many_heap->Clear();
+    }
+    else
+    {
+        many_to_many_heap.reset(new ManyToManyQueryHeap(number_of_nodes));
+        many_to_many_heap_size = number_of_nodes;
+    }
+}
+
+void SearchEngineData::InitializeOrClearMapMatchingThreadLocalStorage(
+    const unsigned number_of_nodes, const std::size_t number_of_heaps)
+{
+    if (map_matching_forward_heap.get())
+    {
+        map_matching_forward_heap->Clear();
+    }
+    else
+    {
+        map_matching_forward_heap.reset(new MapMatchingQueryHeap(number_of_nodes));
+    }
+
+    if (!map_matching_reverse_heaps.get())
+    {
+        map_matching_reverse_heaps.reset(new MapMatchingHeapPool());
+    }
+
+    auto &heaps = *map_matching_reverse_heaps;
+    for (const auto index : util::irange<std::size_t>(0, std::min(heaps.size(), number_of_heaps)))
+    {
+        heaps[index]->Clear();
+    }
+    while (heaps.size() < number_of_heaps)
+    {
+        heaps.emplace_back(new MapMatchingQueryHeap(number_of_nodes));
+    }
+}
 }
 }
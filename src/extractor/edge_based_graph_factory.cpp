@@ -1,5 +1,6 @@
 #include "extractor/edge_based_edge.hpp"
 #include "extractor/edge_based_graph_factory.hpp"
+#include "extractor/scripting_environment.hpp"
 #include "util/coordinate_calculation.hpp"
 #include "util/percent.hpp"
 #include "util/compute_angle.hpp"
@@ -13,6 +14,9 @@
 
 #include <boost/assert.hpp>
 
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
 #include <fstream>
 #include <iomanip>
 #include <limits>
@@ -213,14 +217,14 @@ void EdgeBasedGraphFactory::FlushVectorToStream(
 
 #ifdef DEBUG_GEOMETRY
 void EdgeBasedGraphFactory::Run(const std::string &original_edge_data_filename,
-                                lua_State *lua_state,
+                                ScriptingEnvironment &scripting_environment,
                                 const std::string &edge_segment_lookup_filename,
                                 const std::string &edge_penalty_filename,
                                 const bool generate_edge_lookup,
                                 const std::string &debug_turns_path)
 #else
 void EdgeBasedGraphFactory::Run(const std::string &original_edge_data_filename,
-                                lua_State *lua_state,
+                                ScriptingEnvironment &scripting_environment,
                                 const std::string &edge_segment_lookup_filename,
                                 const std::string &edge_penalty_filename,
                                 const bool generate_edge_lookup)
@@ -236,11 +240,13 @@ void EdgeBasedGraphFactory::Run(const std::string &original_edge_data_filename,
 
     TIMER_START(generate_edges);
 #ifdef DEBUG_GEOMETRY
-    GenerateEdgeExpandedEdges(original_edge_data_filename, lua_state, edge_segment_lookup_filename,
-                              edge_penalty_filename, generate_edge_lookup, debug_turns_path);
+    GenerateEdgeExpandedEdges(original_edge_data_filename, scripting_environment,
+                              edge_segment_lookup_filename, edge_penalty_filename,
+                              generate_edge_lookup, debug_turns_path);
 #else
-    GenerateEdgeExpandedEdges(original_edge_data_filename, lua_state, edge_segment_lookup_filename,
-                              edge_penalty_filename, generate_edge_lookup);
+    GenerateEdgeExpandedEdges(original_edge_data_filename, scripting_environment,
+                              edge_segment_lookup_filename, edge_penalty_filename,
+                              generate_edge_lookup);
 #endif
 
     TIMER_STOP(generate_edges);
@@ -326,11 +332,43 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedNodes()
                                  << " nodes in edge-expanded graph";
 }
 
+// Turns of a block of consecutive node-based nodes in the order of the serial expansion. The
+// ids of the edge-based edges are assigned when the blocks are merged.
+struct EdgeBasedGraphFactory::EdgeExpansionBuffer
+{
+    std::vector<EdgeBasedEdge> edges;
+    std::vector<OriginalEdgeData> original_edge_data;
+    std::vector<unsigned> fixed_penalties;
+    std::vector<char> segment_lookup;
+
+    unsigned node_based_edge_counter = 0;
+    unsigned restricted_turns_counter = 0;
+    unsigned skipped_uturns_counter = 0;
+    unsigned skipped_barrier_turns_counter = 0;
+    unsigned compressed = 0;
+};
+
+namespace
+{
+// number of node-based nodes whose turns are expanded by a single task
+constexpr NodeID NODES_PER_BLOCK = 1024;
+// number of blocks that are expanded before their results are merged, bounds the memory
+constexpr NodeID BLOCKS_PER_BATCH = 256;
+
+template <typename T> void AppendBytes(std::vector<char> &bytes, const T &value)
+{
+    const char *value_begin = reinterpret_cast<const char *>(&value);
+    bytes.insert(bytes.end(), value_begin, value_begin + sizeof(T));
+}
+}
+
 /// Actually it also generates OriginalEdgeData and serializes them...
+/// The turns are expanded in parallel for blocks of nodes, every thread with its own lua state.
+/// Merging the blocks in node order keeps the output identical to a serial expansion.
 #ifdef DEBUG_GEOMETRY
 void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
     const std::string &original_edge_data_filename,
-    lua_State *lua_state,
+    ScriptingEnvironment &scripting_environment,
     const std::string &edge_segment_lookup_filename,
     const std::string &edge_fixed_penalties_filename,
     const bool generate_edge_lookup,
@@ -338,7 +376,7 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
 #else
 void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
     const std::string &original_edge_data_filename,
-    lua_State *lua_state,
+    ScriptingEnvironment &scripting_environment,
     const std::string &edge_segment_lookup_filename,
     const std::string &edge_fixed_penalties_filename,
     const bool generate_edge_lookup)
@@ -362,9 +400,6 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
     // writes a dummy value that is updated later
     edge_data_file.write((char *)&original_edges_counter, sizeof(unsigned));
 
-    std::vector<OriginalEdgeData> original_edge_data_vector;
-    original_edge_data_vector.reserve(1024 * 1024);
-
     // Loop over all turns and generate new set of edges.
     // Three nested loop look super-linear, but we are dealing with a (kind of)
     // linear number of turns only.
@@ -373,15 +408,98 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
     unsigned skipped_barrier_turns_counter = 0;
     unsigned compressed = 0;
 
-    util::Percent progress(m_node_based_graph->GetNumberOfNodes());
-
 #ifdef DEBUG_GEOMETRY
     util::DEBUG_TURNS_START(debug_turns_path);
 #endif
 
-    for (const auto node_u : util::irange(0u, m_node_based_graph->GetNumberOfNodes()))
+    const NodeID number_of_nodes = m_node_based_graph->GetNumberOfNodes();
+    const NodeID number_of_blocks = (number_of_nodes + NODES_PER_BLOCK - 1) / NODES_PER_BLOCK;
+    std::vector<EdgeExpansionBuffer> buffers;
+
+    for (NodeID first_block = 0; first_block < number_of_blocks; first_block += BLOCKS_PER_BATCH)
+    {
+        const NodeID last_block = std::min(first_block + BLOCKS_PER_BATCH, number_of_blocks);
+        buffers.clear();
+        buffers.resize(last_block - first_block);
+
+        const auto expand_block = [&](const NodeID block)
+        {
+            lua_State *lua_state = speed_profile.has_turn_penalty_function
+                                       ? scripting_environment.GetLuaState()
+                                       : nullptr;
+            GenerateEdgeExpandedEdgesOfNodes(
+                block * NODES_PER_BLOCK, std::min(number_of_nodes, (block + 1) * NODES_PER_BLOCK),
+                lua_state, generate_edge_lookup, buffers[block - first_block]);
+        };
+#ifdef DEBUG_GEOMETRY
+        // the turn debug output is written to a single stream
+        for (NodeID block = first_block; block < last_block; ++block)
+        {
+            expand_block(block);
+        }
+#else
+        tbb::parallel_for(first_block, last_block, expand_block);
+#endif
+
+        for (auto &buffer : buffers)
+        {
+            for (const auto &edge : buffer.edges)
+            {
+                // NOTE: potential overflow here if we hit 2^32 routable edges
+                BOOST_ASSERT(m_edge_based_edge_list.size() <= std::numeric_limits<NodeID>::max());
+                m_edge_based_edge_list.emplace_back(edge.source, edge.target,
+                                                    m_edge_based_edge_list.size(),
+                                                    static_cast<EdgeWeight>(edge.weight), true,
+                                                    false);
+            }
+            original_edges_counter += static_cast<unsigned>(buffer.original_edge_data.size());
+            FlushVectorToStream(edge_data_file, buffer.original_edge_data);
+
+            if (generate_edge_lookup)
+            {
+                edge_penalty_file.write(
+                    reinterpret_cast<const char *>(buffer.fixed_penalties.data()),
+                    buffer.fixed_penalties.size() * sizeof(unsigned));
+                edge_segment_file.write(buffer.segment_lookup.data(),
+                                        buffer.segment_lookup.size());
+            }
+
+            node_based_edge_counter += buffer.node_based_edge_counter;
+            restricted_turns_counter += buffer.restricted_turns_counter;
+            skipped_uturns_counter += buffer.skipped_uturns_counter;
+            skipped_barrier_turns_counter += buffer.skipped_barrier_turns_counter;
+            compressed += buffer.compressed;
+        }
+    }
+
+    util::DEBUG_TURNS_STOP();
+
+    edge_data_file.seekp(std::ios::beg);
+    edge_data_file.write((char *)&original_edges_counter, sizeof(unsigned));
+    edge_data_file.close();
+
+    util::SimpleLogger().Write() << "Generated " << m_edge_based_node_list.size()
+                                 << " edge based nodes";
+    util::SimpleLogger().Write() << "Node-based graph contains " << node_based_edge_counter
+                                 << " edges";
+    util::SimpleLogger().Write() << "Edge-expanded graph ...";
+    util::SimpleLogger().Write() << "  contains " << m_edge_based_edge_list.size() << " edges";
+    util::SimpleLogger().Write() << "  skips " << restricted_turns_counter << " turns, "
+                                                                              "defined by "
+                                 << m_restriction_map->size() << " restrictions";
+    util::SimpleLogger().Write() << "  skips " << skipped_uturns_counter << " U turns";
+    util::SimpleLogger().Write() << "  skips " << skipped_barrier_turns_counter
+                                 << " turns over barriers";
+}
+
+void EdgeBasedGraphFactory::GenerateEdgeExpandedEdgesOfNodes(const NodeID begin,
+                                                             const NodeID end,
+                                                             lua_State *lua_state,
+                                                             const bool generate_edge_lookup,
+                                                             EdgeExpansionBuffer &buffer) const
+{
+    for (const auto node_u : util::irange(begin, end))
     {
-        // progress.printStatus(node_u);
         for (const EdgeID e1 : m_node_based_graph->GetAdjacentEdgeRange(node_u))
         {
             if (m_node_based_graph->GetEdgeData(e1).reversed)
@@ -389,7 +507,7 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
                 continue;
             }
 
-            ++node_based_edge_counter;
+            ++buffer.node_based_edge_counter;
             const NodeID node_v = m_node_based_graph->GetTarget(e1);
             const NodeID only_restriction_to_node =
                 m_restriction_map->CheckForEmanatingIsOnlyTurn(node_u, node_v);
@@ -407,7 +525,7 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
                     (node_w != only_restriction_to_node))
                 {
                     // We are at an only_-restriction but not at the right turn.
-                    ++restricted_turns_counter;
+                    ++buffer.restricted_turns_counter;
                     continue;
                 }
 
@@ -415,7 +533,7 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
                 {
                     if (node_u != node_w)
                     {
-                        ++skipped_barrier_turns_counter;
+                        ++buffer.skipped_barrier_turns_counter;
                         continue;
                     }
                 }
@@ -423,7 +541,7 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
                 {
                     if ((node_u == node_w) && (m_node_based_graph->GetOutDegree(node_v) > 1))
                     {
-                        ++skipped_uturns_counter;
+                        ++buffer.skipped_uturns_counter;
                         continue;
                     }
                 }
@@ -435,7 +553,7 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
                     (node_w != only_restriction_to_node))
                 {
                     // We are at an only_-restriction but not at the right turn.
-                    ++restricted_turns_counter;
+                    ++buffer.restricted_turns_counter;
                     continue;
                 }
 
@@ -490,30 +608,20 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
 
                 if (edge_is_compressed)
                 {
-                    ++compressed;
+                    ++buffer.compressed;
                 }
 
-                original_edge_data_vector.emplace_back(
+                buffer.original_edge_data.emplace_back(
                     (edge_is_compressed ? m_compressed_edge_container.GetPositionForID(e1)
                                         : node_v),
                     edge_data1.name_id, turn_instruction, edge_is_compressed,
                     edge_data2.travel_mode);
 
-                ++original_edges_counter;
-
-                if (original_edge_data_vector.size() > 1024 * 1024 * 10)
-                {
-                    FlushVectorToStream(edge_data_file, original_edge_data_vector);
-                }
-
                 BOOST_ASSERT(SPECIAL_NODEID != edge_data1.edge_id);
                 BOOST_ASSERT(SPECIAL_NODEID != edge_data2.edge_id);
 
-                // NOTE: potential overflow here if we hit 2^32 routable edges
-                BOOST_ASSERT(m_edge_based_edge_list.size() <= std::numeric_limits<NodeID>::max());
-                m_edge_based_edge_list.emplace_back(edge_data1.edge_id, edge_data2.edge_id,
-                                                    m_edge_based_edge_list.size(), distance, true,
-                                                    false);
+                buffer.edges.emplace_back(edge_data1.edge_id, edge_data2.edge_id, SPECIAL_EDGEID,
+                                          distance, true, false);
 
                 // Here is where we write out the mapping between the edge-expanded edges, and
                 // the node-based edges that are originally used to calculate the `distance`
@@ -529,9 +637,7 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
                 // updates to the edge-expanded-edge based directly on its ID.
                 if (generate_edge_lookup)
                 {
-                    unsigned fixed_penalty = distance - edge_data1.distance;
-                    edge_penalty_file.write(reinterpret_cast<const char *>(&fixed_penalty),
-                                            sizeof(fixed_penalty));
+                    buffer.fixed_penalties.push_back(distance - edge_data1.distance);
                     if (edge_is_compressed)
                     {
                         const auto node_based_edges =
@@ -539,11 +645,9 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
                         NodeID previous = node_u;
 
                         const unsigned node_count = node_based_edges.size() + 1;
-                        edge_segment_file.write(reinterpret_cast<const char *>(&node_count),
-                                                sizeof(node_count));
+                        AppendBytes(buffer.segment_lookup, node_count);
                         const QueryNode &first_node = m_node_info_list[previous];
-                        edge_segment_file.write(reinterpret_cast<const char *>(&first_node.node_id),
-                                                sizeof(first_node.node_id));
+                        AppendBytes(buffer.segment_lookup, first_node.node_id);
 
                         for (auto target_node : node_based_edges)
                         {
@@ -553,13 +657,9 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
                                 util::coordinate_calculation::greatCircleDistance(
                                     from.lat, from.lon, to.lat, to.lon);
 
-                            edge_segment_file.write(reinterpret_cast<const char *>(&to.node_id),
-                                                    sizeof(to.node_id));
-                            edge_segment_file.write(reinterpret_cast<const char *>(&segment_length),
-                                                    sizeof(segment_length));
-                            edge_segment_file.write(
-                                reinterpret_cast<const char *>(&target_node.second),
-                                sizeof(target_node.second));
+                            AppendBytes(buffer.segment_lookup, to.node_id);
+                            AppendBytes(buffer.segment_lookup, segment_length);
+                            AppendBytes(buffer.segment_lookup, target_node.second);
                             previous = target_node.first;
                         }
                     }
@@ -571,43 +671,16 @@ void EdgeBasedGraphFactory::GenerateEdgeExpandedEdges(
                         const double segment_length =
                             util::coordinate_calculation::greatCircleDistance(from.lat, from.lon,
                                                                               to.lat, to.lon);
-                        edge_segment_file.write(reinterpret_cast<const char *>(&node_count),
-                                                sizeof(node_count));
-                        edge_segment_file.write(reinterpret_cast<const char *>(&from.node_id),
-                                                sizeof(from.node_id));
-                        edge_segment_file.write(reinterpret_cast<const char *>(&to.node_id),
-                                                sizeof(to.node_id));
-                        edge_segment_file.write(reinterpret_cast<const char *>(&segment_length),
-                                                sizeof(segment_length));
-                        edge_segment_file.write(
-                            reinterpret_cast<const char *>(&edge_data1.distance),
-                            sizeof(edge_data1.distance));
+                        AppendBytes(buffer.segment_lookup, node_count);
+                        AppendBytes(buffer.segment_lookup, from.node_id);
+                        AppendBytes(buffer.segment_lookup, to.node_id);
+                        AppendBytes(buffer.segment_lookup, segment_length);
+                        AppendBytes(buffer.segment_lookup, edge_data1.distance);
                     }
                 }
             }
         }
     }
-
-    util::DEBUG_TURNS_STOP();
-
-    FlushVectorToStream(edge_data_file, original_edge_data_vector);
-
-    edge_data_file.seekp(std::ios::beg);
-    edge_data_file.write((char *)&original_edges_counter, sizeof(unsigned));
-    edge_data_file.close();
-
-    util::SimpleLogger().Write() << "Generated " << m_edge_based_node_list.size()
-                                 << " edge based nodes";
-    util::SimpleLogger().Write() << "Node-based graph contains " << node_based_edge_counter
-                                 << " edges";
-    util::SimpleLogger().Write() << "Edge-expanded graph ...";
-    util::SimpleLogger().Write() << "  contains " << m_edge_based_edge_list.size() << " edges";
-    util::SimpleLogger().Write() << "  skips " << restricted_turns_counter << " turns, "
-                                                                              "defined by "
-                                 << m_restriction_map->size() << " restrictions";
-    util::SimpleLogger().Write() << "  skips " << skipped_uturns_counter << " U turns";
-    util::SimpleLogger().Write() << "  skips " << skipped_barrier_turns_counter
-                                 << " turns over barriers";
 }
 
 int EdgeBasedGraphFactory::GetTurnPenalty(double angle, lua_State *lua_state) const
@@ -73,16 +73,16 @@ namespace extractor
  */
 int extractor::run()
 {
+    // the parsing and the expansion of turns both run in parallel
+    const unsigned recommended_num_threads = tbb::task_scheduler_init::default_num_threads();
+    const auto number_of_threads = std::min(recommended_num_threads, config.requested_num_threads);
+    tbb::task_scheduler_init init(number_of_threads);
+
     try
     {
         util::LogPolicy::GetInstance().Unmute();
         TIMER_START(extracting);
 
-        const unsigned recommended_num_threads = tbb::task_scheduler_init::default_num_threads();
-        const auto number_of_threads =
-            std::min(recommended_num_threads, config.requested_num_threads);
-        tbb::task_scheduler_init init(number_of_threads);
-
         util::SimpleLogger().Write() << "Input file: " << config.input_path.filename().string();
         util::SimpleLogger().Write() << "Profile: " << config.profile_path.filename().string();
         util::SimpleLogger().Write() << "Threads: " << number_of_threads;
@@ -513,7 +513,9 @@ extractor::BuildEdgeExpandedGraph(std::vector<QueryNode> &internal_to_external_n
 
     compressed_edge_container.SerializeInternalVector(config.geometry_output_path);
 
-    edge_based_graph_factory.Run(config.edge_output_path, lua_state,
+    // the turn function is evaluated by many threads, each of which needs its own lua state
+    ScriptingEnvironment scripting_environment(config.profile_path.string());
+    edge_based_graph_factory.Run(config.edge_output_path, scripting_environment,
                                  config.edge_segment_lookup_path, config.edge_penalty_path,
                                  config.generate_edge_lookup
 #ifdef DEBUG_GEOMETRY
@@ -583,6 +585,8 @@ void extractor::BuildRTree(std::vector<EdgeBasedNode> node_based_edge_list,
     util::StaticRTree<EdgeBasedNode> rtree(node_based_edge_list, config.rtree_nodes_output_path,
                                            config.rtree_leafs_output_path,
                                            internal_to_external_node_map);
+    // the new r-tree uses the node ids of the new .ebg, a renumbering by osrm-prepare is void
+    boost::filesystem::remove(config.output_file_name + ".node_renumbering");
 
     TIMER_STOP(construction);
     util::SimpleLogger().Write() << "finished r-tree construction in " << TIMER_SEC(construction)
@@ -0,0 +1,227 @@
+#include "server/access_log.hpp"
+#include "server/http/request.hpp"
+
+#include "util/simple_logger.hpp"
+#include "util/string_util.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace osrm
+{
+namespace server
+{
+
+namespace
+{
+constexpr auto DRAIN_INTERVAL = std::chrono::milliseconds(10);
+std::atomic<std::uint64_t> next_log_id(0);
+}
+
+boost::thread_specific_ptr<AccessLog::ThreadRing> AccessLog::thread_ring;
+
+AccessLog::AccessLog(std::ostream &output,
+                     const AccessLogFormat format,
+                     const double sample_rate,
+                     const std::size_t ring_size)
+    : output(output), format(format), sample_rate(std::min(1., std::max(0., sample_rate))),
+      ring_size(std::max<std::size_t>(1, ring_size)), id(next_log_id++), cached_time(-1),
+      stopped(false), writer(&AccessLog::Run, this)
+{
+}
+
+AccessLog::~AccessLog()
+{
+    stopped = true;
+    writer.join();
+}
+
+void AccessLog::Log(const http::request &request,
+                    const std::string &uri,
+                    const int status,
+                    const Clock::time_point start)
+{
+    Ring &ring = GetThreadRing();
+
+    // deterministic sampling, every 1/sample_rate-th request of a thread is logged
+    ring.credit += sample_rate;
+    if (ring.credit < 1.)
+    {
+        return;
+    }
+    ring.credit -= 1.;
+
+    const std::size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == ring.entries.size())
+    {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // the slots keep their string capacities, so this does not allocate once warmed up
+    Entry &entry = ring.entries[head % ring.entries.size()];
+    entry.time = std::time(nullptr);
+    entry.endpoint = request.endpoint;
+    entry.referrer.assign(request.referrer);
+    entry.agent.assign(request.agent);
+    entry.uri.assign(uri);
+    entry.status = status;
+    entry.duration_us = static_cast<std::uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+AccessLog::Ring &AccessLog::GetThreadRing()
+{
+    ThreadRing *cached = thread_ring.get();
+    if (nullptr == cached)
+    {
+        cached = new ThreadRing{id, nullptr};
+        thread_ring.reset(cached);
+    }
+    if (nullptr == cached->ring || id != cached->log_id)
+    {
+        // the only lock a request thread takes, on its first request and when it logs to more
+        // than one log
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        auto &ring = rings[std::this_thread::get_id()];
+        if (!ring)
+        {
+            ring.reset(new Ring(ring_size));
+        }
+        cached->log_id = id;
+        cached->ring = ring.get();
+    }
+    return *cached->ring;
+}
+
+void AccessLog::Run()
+{
+    while (!stopped)
+    {
+        if (!Drain())
+        {
+            std::this_thread::sleep_for(DRAIN_INTERVAL);
+        }
+    }
+    // write what was logged before shutdown
+    Drain();
+}
+
+bool AccessLog::Drain()
+{
+    std::vector<Ring *> current_rings;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        current_rings.reserve(rings.size());
+        for (const auto &ring : rings)
+        {
+            current_rings.push_back(ring.second.get());
+        }
+    }
+
+    // a muted log still empties the rings, the request threads would drop entries otherwise
+    const bool is_mute = util::LogPolicy::GetInstance().IsMute();
+    batch.clear();
+    bool has_entries = false;
+    std::uint64_t dropped = 0;
+    for (Ring *ring : current_rings)
+    {
+        const std::size_t head = ring->head.load(std::memory_order_acquire);
+        const std::size_t tail = ring->tail.load(std::memory_order_relaxed);
+        has_entries = has_entries || tail != head;
+        if (!is_mute)
+        {
+            for (std::size_t position = tail; position != head; ++position)
+            {
+                Format(ring->entries[position % ring->entries.size()]);
+            }
+        }
+        ring->tail.store(head, std::memory_order_release);
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+    }
+
+    if (!has_entries && 0 == dropped)
+    {
+        return false;
+    }
+    if (is_mute)
+    {
+        return true;
+    }
+    {
+        // the output is shared with util::SimpleLogger, so lines must not interleave with its own
+        std::lock_guard<std::mutex> lock(util::SimpleLogger::get_mutex());
+        output << batch;
+        output.flush();
+    }
+    if (0 != dropped)
+    {
+        util::SimpleLogger().Write(logWARNING) << "access log dropped " << dropped
+                                               << " entries, its buffers were full";
+    }
+    return true;
+}
+
+void AccessLog::Format(const Entry &entry)
+{
+    const std::string &time_string = FormatTime(entry.time);
+    const std::string endpoint = entry.endpoint.to_string();
+    if (AccessLogFormat::Plain == format)
+    {
+        batch += "[info] ";
+        batch += time_string;
+        batch += ' ';
+        batch += endpoint;
+        batch += ' ';
+        batch += entry.referrer;
+        batch += entry.referrer.empty() ? "- " : " ";
+        batch += entry.agent;
+        batch += entry.agent.empty() ? "- " : " ";
+        batch += entry.uri;
+        batch += '\n';
+        return;
+    }
+
+    char duration[32];
+    std::snprintf(duration, sizeof(duration), "%.3f", entry.duration_us / 1000.);
+    batch += "{\"time\":\"";
+    batch += time_string;
+    batch += "\",\"ip\":\"";
+    batch += endpoint;
+    batch += "\",\"referrer\":\"";
+    batch += util::escape_JSON(entry.referrer);
+    batch += "\",\"agent\":\"";
+    batch += util::escape_JSON(entry.agent);
+    batch += "\",\"uri\":\"";
+    batch += util::escape_JSON(entry.uri);
+    batch += "\",\"status\":";
+    batch += std::to_string(entry.status);
+    batch += ",\"duration_ms\":";
+    batch += duration;
+    batch += "}\n";
+}
+
+const std::string &AccessLog::FormatTime(const std::time_t time)
+{
+    // all entries of the same second share one rendered timestamp
+    if (time != cached_time)
+    {
+        struct tm time_stamp;
+#ifdef _WIN32
+        localtime_s(&time_stamp, &time);
+#else
+        localtime_r(&time, &time_stamp);
+#endif
+        const char *pattern =
+            AccessLogFormat::Plain == format ? "%d-%m-%Y %H:%M:%S" : "%Y-%m-%dT%H:%M:%S%z";
+        char buffer[32];
+        const std::size_t length = std::strftime(buffer, sizeof(buffer), pattern, &time_stamp);
+        cached_time_string.assign(buffer, length);
+        cached_time = time;
+    }
+    return cached_time_string;
+}
+}
+}
@@ -1,13 +1,13 @@
 #include "server/connection.hpp"
+#include "server/http/compressor.hpp"
 #include "server/request_handler.hpp"
 #include "server/request_parser.hpp"
 
 #include <boost/assert.hpp>
 #include <boost/bind.hpp>
-#include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/filter/gzip.hpp>
 
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace osrm
@@ -15,16 +15,39 @@ namespace osrm
 namespace server
 {
 
-Connection::Connection(boost::asio::io_service &io_service, RequestHandler &handler)
-    : strand(io_service), TCP_socket(io_service), request_handler(handler)
+namespace
+{
+// a reply this small fits into a single packet, compressing it would only cost time
+constexpr std::size_t MIN_COMPRESSED_SIZE = 1024;
+}
+
+Connection::Connection(boost::asio::io_service &io_service,
+                       RequestHandler &handler,
+                       const unsigned keepalive_timeout,
+                       const unsigned max_keepalive_requests,
+                       const int compression_level)
+    : strand(io_service), TCP_socket(io_service), timer(io_service), request_handler(handler),
+      pending_input_begin(nullptr), pending_input_end(nullptr),
+      keepalive_timeout(keepalive_timeout), max_keepalive_requests(max_keepalive_requests),
+      compression_level(compression_level), processed_requests(0), keep_alive(false)
 {
 }
 
 boost::asio::ip::tcp::socket &Connection::socket() { return TCP_socket; }
 
 /// Start the first asynchronous operation for the connection.
-void Connection::start()
+void Connection::start() { read_more(); }
+
+void Connection::read_more()
 {
+    // only connections that were kept alive can idle, the first request is not timed
+    if (processed_requests > 0)
+    {
+        timer.expires_from_now(boost::posix_time::seconds(keepalive_timeout));
+        timer.async_wait(strand.wrap(boost::bind(&Connection::handle_timeout,
+                                                 this->shared_from_this(),
+                                                 boost::asio::placeholders::error)));
+    }
     TCP_socket.async_read_some(
         boost::asio::buffer(incoming_data_buffer),
         strand.wrap(boost::bind(&Connection::handle_read, this->shared_from_this(),
@@ -38,31 +61,52 @@ void Connection::handle_read(const boost::system::error_code &error, std::size_t
     {
         return;
     }
+    // cancels the idle timeout, a timeout handler that is already queued sees the new expiry
+    timer.expires_at(boost::posix_time::pos_infin);
+
+    process_input(incoming_data_buffer.data(), incoming_data_buffer.data() + bytes_transferred);
+}
 
+void Connection::process_input(char *begin, char *end)
+{
     // no error detected, let's parse the request
     http::compression_type compression_type(http::no_compression);
     util::tribool result;
-    std::tie(result, compression_type) =
-        request_parser.parse(current_request, incoming_data_buffer.data(),
-                             incoming_data_buffer.data() + bytes_transferred);
+    char *parsed_end;
+    std::tie(result, compression_type, parsed_end) =
+        request_parser.parse(current_request, begin, end);
+    pending_input_begin = parsed_end;
+    pending_input_end = end;
 
     // the request has been parsed
     if (result == util::tribool::yes)
     {
+        ++processed_requests;
+        keep_alive = current_request.keep_alive && keepalive_timeout > 0 &&
+                     processed_requests < max_keepalive_requests;
+
         current_request.endpoint = TCP_socket.remote_endpoint().address();
         request_handler.handle_request(current_request, current_reply);
+        current_reply.headers.emplace_back("Connection", keep_alive ? "keep-alive" : "close");
 
         // Header compression_header;
         std::vector<boost::asio::const_buffer> output_buffer;
 
-        // compress the result w/ gzip/deflate if requested
+        if (0 == compression_level || current_reply.content.size() < MIN_COMPRESSED_SIZE)
+        {
+            compression_type = http::no_compression;
+        }
+
+        // compress the result w/ gzip/deflate if requested, the output buffer is kept between
+        // requests just like the content buffer
         switch (compression_type)
         {
         case http::deflate_rfc1951:
             // use deflate for compression
             current_reply.headers.insert(current_reply.headers.begin(),
                                          {"Content-Encoding", "deflate"});
-            compressed_output = compress_buffers(current_reply.content, compression_type);
+            http::compress(current_reply.content, compression_type, compression_level,
+                           compressed_output);
             current_reply.set_size(static_cast<unsigned>(compressed_output.size()));
             output_buffer = current_reply.headers_to_buffers();
             output_buffer.push_back(boost::asio::buffer(compressed_output));
@@ -71,7 +115,8 @@ void Connection::handle_read(const boost::system::error_code &error, std::size_t
             // use gzip for compression
             current_reply.headers.insert(current_reply.headers.begin(),
                                          {"Content-Encoding", "gzip"});
-            compressed_output = compress_buffers(current_reply.content, compression_type);
+            http::compress(current_reply.content, compression_type, compression_level,
+                           compressed_output);
             current_reply.set_size(static_cast<unsigned>(compressed_output.size()));
             output_buffer = current_reply.headers_to_buffers();
             output_buffer.push_back(boost::asio::buffer(compressed_output));
@@ -89,8 +134,10 @@ void Connection::handle_read(const boost::system::error_code &error, std::size_t
                                     boost::asio::placeholders::error)));
     }
     else if (result == util::tribool::no)
-    { // request is not parseable
+    { // request is not parseable, the start of the next request can't be found either
+        keep_alive = false;
         current_reply = http::reply::stock_reply(http::reply::bad_request);
+        current_reply.headers.emplace_back("Connection", "close");
 
         boost::asio::async_write(
             TCP_socket, current_reply.to_buffers(),
@@ -100,47 +147,58 @@ void Connection::handle_read(const boost::system::error_code &error, std::size_t
     else
     {
         // we don't have a result yet, so continue reading
-        TCP_socket.async_read_some(
-            boost::asio::buffer(incoming_data_buffer),
-            strand.wrap(boost::bind(&Connection::handle_read, this->shared_from_this(),
-                                    boost::asio::placeholders::error,
-                                    boost::asio::placeholders::bytes_transferred)));
+        read_more();
     }
 }
 
 /// Handle completion of a write operation.
 void Connection::handle_write(const boost::system::error_code &error)
 {
-    if (!error)
+    if (error)
+    {
+        return;
+    }
+
+    if (!keep_alive)
     {
         // Initiate graceful connection closure.
         boost::system::error_code ignore_error;
         TCP_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignore_error);
+        return;
     }
-}
 
-std::vector<char> Connection::compress_buffers(const std::vector<char> &uncompressed_data,
-                                               const http::compression_type compression_type)
-{
-    boost::iostreams::gzip_params compression_parameters;
+    current_request = http::request();
+    // hand the response buffer on to the next request, so its capacity is only allocated once
+    std::vector<char> content = std::move(current_reply.content);
+    content.clear();
+    current_reply = http::reply();
+    current_reply.content = std::move(content);
+    request_parser.reset();
 
-    // there's a trade-off between speed and size. speed wins
-    compression_parameters.level = boost::iostreams::zlib::best_speed;
-    // check which compression flavor is used
-    if (http::deflate_rfc1951 == compression_type)
+    // answer pipelined requests in order before reading from the socket again
+    if (pending_input_begin != pending_input_end)
+    {
+        process_input(pending_input_begin, pending_input_end);
+    }
+    else
     {
-        compression_parameters.noheader = true;
+        read_more();
     }
+}
 
-    std::vector<char> compressed_data;
-    // plug data into boost's compression stream
-    boost::iostreams::filtering_ostream gzip_stream;
-    gzip_stream.push(boost::iostreams::gzip_compressor(compression_parameters));
-    gzip_stream.push(boost::iostreams::back_inserter(compressed_data));
-    gzip_stream.write(&uncompressed_data[0], uncompressed_data.size());
-    boost::iostreams::close(gzip_stream);
+void Connection::handle_timeout(const boost::system::error_code &error)
+{
+    // the timer was canceled or re-armed by a read that completed in the meantime
+    if (error == boost::asio::error::operation_aborted ||
+        timer.expires_at() > boost::asio::deadline_timer::traits_type::now())
+    {
+        return;
+    }
 
-    return compressed_data;
+    // aborts the pending read, which releases the connection
+    boost::system::error_code ignore_error;
+    TCP_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignore_error);
+    TCP_socket.close(ignore_error);
 }
 }
 }
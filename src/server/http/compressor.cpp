@@ -0,0 +1,164 @@
+#include "server/http/compressor.hpp"
+
+#include "util/integer_range.hpp"
+#include "util/osrm_exception.hpp"
+
+#include <boost/assert.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace osrm
+{
+namespace server
+{
+namespace http
+{
+
+namespace
+{
+// content is compressed in parallel once it spans at least two blocks
+constexpr std::size_t BLOCK_SIZE = 128 * 1024;
+// deflate refers back at most this far, a longer dictionary is of no use
+constexpr std::size_t DICTIONARY_SIZE = 32 * 1024;
+
+boost::thread_specific_ptr<Compressor> thread_compressor;
+
+Compressor &GetThreadCompressor(const int level)
+{
+    if (!thread_compressor.get() || thread_compressor->GetLevel() != level)
+    {
+        thread_compressor.reset(new Compressor(level));
+    }
+    return *thread_compressor;
+}
+
+void AppendLittleEndian(const std::uint32_t value, std::vector<char> &output)
+{
+    for (unsigned shift = 0; shift < 32; shift += 8)
+    {
+        output.push_back(static_cast<char>((value >> shift) & 0xff));
+    }
+}
+}
+
+Compressor::Compressor(const int level) : level(level)
+{
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    // negative window bits select raw deflate, headers are written by compress()
+    if (Z_OK != deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY))
+    {
+        throw util::exception("could not initialize zlib");
+    }
+}
+
+Compressor::~Compressor() { deflateEnd(&stream); }
+
+void Compressor::Deflate(const char *begin,
+                         const char *end,
+                         const char *dictionary_begin,
+                         const bool last_block,
+                         std::vector<char> &output)
+{
+    deflateReset(&stream);
+    if (dictionary_begin != begin)
+    {
+        deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(dictionary_begin),
+                             static_cast<uInt>(begin - dictionary_begin));
+    }
+
+    const std::size_t input_size = end - begin;
+    // a sync flush adds an empty stored block of at most 5 bytes to the bound of deflate
+    const std::size_t bound = deflateBound(&stream, static_cast<uLong>(input_size)) + 8;
+    const std::size_t output_begin = output.size();
+    output.resize(output_begin + bound);
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(begin));
+    stream.avail_in = static_cast<uInt>(input_size);
+    stream.next_out = reinterpret_cast<Bytef *>(output.data() + output_begin);
+    stream.avail_out = static_cast<uInt>(bound);
+    const int result = deflate(&stream, last_block ? Z_FINISH : Z_SYNC_FLUSH);
+    if ((last_block ? Z_STREAM_END : Z_OK) != result || 0 != stream.avail_in)
+    {
+        throw util::exception("zlib could not compress the reply");
+    }
+    output.resize(output_begin + bound - stream.avail_out);
+}
+
+void compress(const std::vector<char> &content,
+              const compression_type compression,
+              const int level,
+              std::vector<char> &output)
+{
+    BOOST_ASSERT(no_compression != compression);
+    output.clear();
+
+    if (gzip_rfc1952 == compression)
+    {
+        // magic number, deflate, no flags, no modification time, no extra flags, unix
+        const char header[] = {'\x1f', '\x8b', '\x08', '\x00', '\x00',
+                               '\x00', '\x00', '\x00', '\x00', '\x03'};
+        output.insert(output.end(), header, header + sizeof(header));
+    }
+
+    const char *data = content.data();
+    const std::size_t number_of_blocks =
+        std::max<std::size_t>(1, (content.size() + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    uLong checksum = crc32(0L, Z_NULL, 0);
+    if (1 == number_of_blocks)
+    {
+        GetThreadCompressor(level).Deflate(data, data + content.size(), data, true, output);
+        if (gzip_rfc1952 == compression)
+        {
+            checksum = crc32(checksum, reinterpret_cast<const Bytef *>(data),
+                             static_cast<uInt>(content.size()));
+        }
+    }
+    else
+    {
+        // every block is primed with the data before it, which keeps the compression ratio
+        std::vector<std::vector<char>> blocks(number_of_blocks);
+        std::vector<uLong> block_checksums(number_of_blocks);
+        tbb::parallel_for(std::size_t(0), number_of_blocks, [&](const std::size_t block)
+                          {
+                              const std::size_t begin = block * BLOCK_SIZE;
+                              const std::size_t end =
+                                  std::min(content.size(), begin + BLOCK_SIZE);
+                              const std::size_t dictionary_begin =
+                                  begin - std::min(begin, DICTIONARY_SIZE);
+                              GetThreadCompressor(level).Deflate(
+                                  data + begin, data + end, data + dictionary_begin,
+                                  block + 1 == number_of_blocks, blocks[block]);
+                              if (gzip_rfc1952 == compression)
+                              {
+                                  block_checksums[block] =
+                                      crc32(crc32(0L, Z_NULL, 0),
+                                            reinterpret_cast<const Bytef *>(data + begin),
+                                            static_cast<uInt>(end - begin));
+                              }
+                          });
+
+        for (const auto block : util::irange<std::size_t>(0, number_of_blocks))
+        {
+            output.insert(output.end(), blocks[block].begin(), blocks[block].end());
+            const std::size_t block_size =
+                std::min(content.size(), (block + 1) * BLOCK_SIZE) - block * BLOCK_SIZE;
+            checksum = crc32_combine(checksum, block_checksums[block],
+                                     static_cast<z_off_t>(block_size));
+        }
+    }
+
+    if (gzip_rfc1952 == compression)
+    {
+        AppendLittleEndian(static_cast<std::uint32_t>(checksum), output);
+        AppendLittleEndian(static_cast<std::uint32_t>(content.size()), output);
+    }
+}
+}
+}
+}
@@ -15,9 +15,9 @@ const char internal_server_error_html[] =
     "{\"status\": 500,\"status_message\":\"Internal Server Error\"}";
 const char seperators[] = {':', ' '};
 const char crlf[] = {'\r', '\n'};
-const std::string http_ok_string = "HTTP/1.0 200 OK\r\n";
-const std::string http_bad_request_string = "HTTP/1.0 400 Bad Request\r\n";
-const std::string http_internal_server_error_string = "HTTP/1.0 500 Internal Server Error\r\n";
+const std::string http_ok_string = "HTTP/1.1 200 OK\r\n";
+const std::string http_bad_request_string = "HTTP/1.1 400 Bad Request\r\n";
+const std::string http_internal_server_error_string = "HTTP/1.1 500 Internal Server Error\r\n";
 
 void reply::set_size(const std::size_t size)
 {
@@ -5,6 +5,7 @@
 #include "server/http/request.hpp"
 
 #include "util/json_renderer.hpp"
+#include "util/json_writer.hpp"
 #include "util/simple_logger.hpp"
 #include "util/string_util.hpp"
 #include "util/xml_renderer.hpp"
@@ -14,8 +15,6 @@
 #include "osrm/json_container.hpp"
 #include "osrm/osrm.hpp"
 
-#include <ctime>
-
 #include <algorithm>
 #include <iostream>
 #include <string>
@@ -30,40 +29,16 @@ RequestHandler::RequestHandler() : routing_machine(nullptr) {}
 void RequestHandler::handle_request(const http::request &current_request,
                                     http::reply &current_reply)
 {
+    const auto start = AccessLog::Clock::now();
     util::json::Object json_result;
+    bool is_rendered = false;
+    std::string request_string;
 
     // parse command
     try
     {
-        std::string request_string;
         util::URIDecode(current_request.uri, request_string);
 
-        // deactivated as GCC apparently does not implement that, not even in 4.9
-        // std::time_t t = std::time(nullptr);
-        // util::SimpleLogger().Write() << std::put_time(std::localtime(&t), "%m-%d-%Y %H:%M:%S") <<
-        //     " " << current_request.endpoint.to_string() << " " <<
-        //     current_request.referrer << ( 0 == current_request.referrer.length() ? "- " :" ") <<
-        //     current_request.agent << ( 0 == current_request.agent.length() ? "- " :" ") <<
-        //     request;
-
-        time_t ltime;
-        struct tm *time_stamp;
-
-        ltime = time(nullptr);
-        time_stamp = localtime(&ltime);
-
-        // log timestamp
-        util::SimpleLogger().Write()
-            << (time_stamp->tm_mday < 10 ? "0" : "") << time_stamp->tm_mday << "-"
-            << (time_stamp->tm_mon + 1 < 10 ? "0" : "") << (time_stamp->tm_mon + 1) << "-"
-            << 1900 + time_stamp->tm_year << " " << (time_stamp->tm_hour < 10 ? "0" : "")
-            << time_stamp->tm_hour << ":" << (time_stamp->tm_min < 10 ? "0" : "")
-            << time_stamp->tm_min << ":" << (time_stamp->tm_sec < 10 ? "0" : "")
-            << time_stamp->tm_sec << " " << current_request.endpoint.to_string() << " "
-            << current_request.referrer << (0 == current_request.referrer.length() ? "- " : " ")
-            << current_request.agent << (0 == current_request.agent.length() ? "- " : " ")
-            << request_string;
-
         engine::RouteParameters route_parameters;
         APIGrammarParser api_parser(&route_parameters);
 
@@ -84,19 +59,42 @@ void RequestHandler::handle_request(const http::request &current_request,
                                              json_p.end());
             }
 
-            const int return_code = routing_machine->RunQuery(route_parameters, json_result);
-            json_result.values["status"] = return_code;
-            // 4xx bad request return code
-            if (return_code / 100 == 4)
-            {
-                current_reply.status = http::reply::bad_request;
-                current_reply.content.clear();
-                route_parameters.output_format.clear();
+            if ("gpx" == route_parameters.output_format)
+            { // the gpx renderer needs the route as a tree
+                const int return_code = routing_machine->RunQuery(route_parameters, json_result);
+                json_result.values["status"] = return_code;
+                // 4xx bad request return code
+                if (return_code / 100 == 4)
+                {
+                    current_reply.status = http::reply::bad_request;
+                    current_reply.content.clear();
+                    route_parameters.output_format.clear();
+                }
+                else
+                {
+                    // 2xx valid request
+                    BOOST_ASSERT(return_code / 100 == 2);
+                }
             }
             else
-            {
-                // 2xx valid request
-                BOOST_ASSERT(return_code / 100 == 2);
+            { // json is written straight into the reply, whose buffer is kept between requests
+                util::json::Writer writer(current_reply.content);
+                writer.BeginObject();
+                const int return_code = routing_machine->RunQuery(route_parameters, writer);
+                writer.Key("status");
+                writer.Number(return_code);
+                writer.EndObject();
+                is_rendered = true;
+                // 4xx bad request return code
+                if (return_code / 100 == 4)
+                {
+                    current_reply.status = http::reply::bad_request;
+                }
+                else
+                {
+                    // 2xx valid request
+                    BOOST_ASSERT(return_code / 100 == 2);
+                }
             }
         }
         else
@@ -127,14 +125,20 @@ void RequestHandler::handle_request(const http::request &current_request,
         }
         else if (route_parameters.jsonp_parameter.empty())
         { // json file
-            util::json::render(current_reply.content, json_result);
+            if (!is_rendered)
+            {
+                util::json::render(current_reply.content, json_result);
+            }
             current_reply.headers.emplace_back("Content-Type", "application/json; charset=UTF-8");
             current_reply.headers.emplace_back("Content-Disposition",
                                                "inline; filename=\"response.json\"");
         }
         else
         { // jsonp
-            util::json::render(current_reply.content, json_result);
+            if (!is_rendered)
+            {
+                util::json::render(current_reply.content, json_result);
+            }
             current_reply.headers.emplace_back("Content-Type", "text/javascript; charset=UTF-8");
             current_reply.headers.emplace_back("Content-Disposition",
                                                "inline; filename=\"response.js\"");
@@ -151,8 +155,25 @@ void RequestHandler::handle_request(const http::request &current_request,
         util::SimpleLogger().Write(logWARNING) << "[server error] code: " << e.what()
                                                << ", uri: " << current_request.uri;
     }
+
+    if (access_log)
+    {
+        access_log->Log(current_request, request_string, current_reply.status, start);
+    }
 }
 
 void RequestHandler::RegisterRoutingMachine(OSRM *osrm) { routing_machine = osrm; }
+
+void RequestHandler::EnableAccessLog(const AccessLogFormat format, const double sample_rate)
+{
+    if (sample_rate > 0.)
+    {
+        access_log.reset(new AccessLog(std::cout, format, sample_rate));
+    }
+    else
+    {
+        access_log.reset();
+    }
+}
 }
 }
@@ -17,11 +17,23 @@ namespace server
 
 RequestParser::RequestParser()
     : state(internal_state::method_start), current_header({"", ""}),
-      selected_compression(http::no_compression), is_post_header(false), content_length(0)
+      selected_compression(http::no_compression), is_post_header(false), content_length(0),
+      http_version_major(0), http_version_minor(0)
 {
 }
 
-std::tuple<util::tribool, http::compression_type>
+void RequestParser::reset()
+{
+    state = internal_state::method_start;
+    current_header.clear();
+    selected_compression = http::no_compression;
+    is_post_header = false;
+    content_length = 0;
+    http_version_major = 0;
+    http_version_minor = 0;
+}
+
+std::tuple<util::tribool, http::compression_type, char *>
 RequestParser::parse(http::request &current_request, char *begin, char *end)
 {
     while (begin != end)
@@ -29,16 +41,10 @@ RequestParser::parse(http::request &current_request, char *begin, char *end)
         util::tribool result = consume(current_request, *begin++);
         if (result != util::tribool::indeterminate)
         {
-            return std::make_tuple(result, selected_compression);
+            return std::make_tuple(result, selected_compression, begin);
         }
     }
-    util::tribool result = util::tribool::indeterminate;
-
-    if (state == internal_state::post_request && content_length <= 0)
-    {
-        result = util::tribool::yes;
-    }
-    return std::make_tuple(result, selected_compression);
+    return std::make_tuple(util::tribool::indeterminate, selected_compression, begin);
 }
 
 util::tribool RequestParser::consume(http::request &current_request, const char input)
@@ -82,7 +88,8 @@ util::tribool RequestParser::consume(http::request &current_request, const char
     case internal_state::post_request:
         current_request.uri.push_back(input);
         --content_length;
-        return util::tribool::indeterminate;
+        // stop at the end of the body, anything after it is the next request
+        return content_length > 0 ? util::tribool::indeterminate : util::tribool::yes;
     case internal_state::method:
         if (input == ' ')
         {
@@ -152,6 +159,7 @@ util::tribool RequestParser::consume(http::request &current_request, const char
     case internal_state::http_version_major_start:
         if (is_digit(input))
         {
+            http_version_major = input - '0';
             state = internal_state::http_version_major;
             return util::tribool::indeterminate;
         }
@@ -164,12 +172,14 @@ util::tribool RequestParser::consume(http::request &current_request, const char
         }
         if (is_digit(input))
         {
+            http_version_major = http_version_major * 10 + input - '0';
             return util::tribool::indeterminate;
         }
         return util::tribool::no;
     case internal_state::http_version_minor_start:
         if (is_digit(input))
         {
+            http_version_minor = input - '0';
             state = internal_state::http_version_minor;
             return util::tribool::indeterminate;
         }
@@ -177,11 +187,15 @@ util::tribool RequestParser::consume(http::request &current_request, const char
     case internal_state::http_version_minor:
         if (input == '\r')
         {
+            // HTTP/1.1 connections are persistent unless the client asks otherwise
+            current_request.keep_alive =
+                http_version_major > 1 || (http_version_major == 1 && http_version_minor >= 1);
             state = internal_state::expecting_newline_1;
             return util::tribool::indeterminate;
         }
         if (is_digit(input))
         {
+            http_version_minor = http_version_minor * 10 + input - '0';
             return util::tribool::indeterminate;
         }
         return util::tribool::no;
@@ -215,6 +229,17 @@ util::tribool RequestParser::consume(http::request &current_request, const char
         {
             current_request.agent = current_header.value;
         }
+        if (boost::iequals(current_header.name, "Connection"))
+        {
+            if (boost::icontains(current_header.value, "close"))
+            {
+                current_request.keep_alive = false;
+            }
+            else if (boost::icontains(current_header.value, "keep-alive"))
+            {
+                current_request.keep_alive = true;
+            }
+        }
         if (boost::iequals(current_header.name, "Content-Length"))
         {
             try
@@ -304,12 +329,9 @@ util::tribool RequestParser::consume(http::request &current_request, const char
     case internal_state::expecting_newline_3:
         if (input == '\n')
         {
-            if (is_post_header)
+            if (is_post_header && content_length > 0)
             {
-                if (content_length > 0)
-                {
-                    current_request.uri.push_back('?');
-                }
+                current_request.uri.push_back('?');
                 state = internal_state::post_request;
                 return util::tribool::indeterminate;
             }
@@ -1,6 +1,6 @@
 #include "util/percent.hpp"
 #include "contractor/query_edge.hpp"
-#include "util/static_graph.hpp"
+#include "contractor/query_graph.hpp"
 #include "util/integer_range.hpp"
 #include "util/graph_loader.hpp"
 #include "util/simple_logger.hpp"
@@ -18,7 +18,7 @@ namespace tools
 {
 
 using EdgeData = contractor::QueryEdge::EdgeData;
-using QueryGraph = util::StaticGraph<EdgeData>;
+using QueryGraph = contractor::QueryGraph<>;
 }
 }
 
@@ -36,28 +36,30 @@ int main(int argc, char *argv[])
         boost::filesystem::path hsgr_path(argv[1]);
 
         std::vector<osrm::tools::QueryGraph::NodeArrayEntry> node_list;
-        std::vector<osrm::tools::QueryGraph::EdgeArrayEntry> edge_list;
+        std::vector<osrm::contractor::QueryEdgeSearchData> search_list;
+        std::vector<osrm::contractor::QueryEdgeUnpackData> unpack_list;
         osrm::util::SimpleLogger().Write() << "loading graph from " << hsgr_path.string();
 
         unsigned m_check_sum = 0;
-        unsigned m_number_of_nodes =
-            readHSGRFromStream(hsgr_path, node_list, edge_list, &m_check_sum);
+        unsigned m_number_of_nodes = osrm::util::readHSGRFromStream(
+            hsgr_path, node_list, search_list, unpack_list, &m_check_sum);
         osrm::util::SimpleLogger().Write() << "expecting " << m_number_of_nodes
                                            << " nodes, checksum: " << m_check_sum;
         BOOST_ASSERT_MSG(0 != node_list.size(), "node list empty");
         osrm::util::SimpleLogger().Write() << "loaded " << node_list.size() << " nodes and "
-                                           << edge_list.size() << " edges";
-        auto m_query_graph = std::make_shared<osrm::tools::QueryGraph>(node_list, edge_list);
+                                           << search_list.size() << " edges";
+        auto m_query_graph =
+            std::make_shared<osrm::tools::QueryGraph>(node_list, search_list, unpack_list);
 
         BOOST_ASSERT_MSG(0 == node_list.size(), "node list not flushed");
-        BOOST_ASSERT_MSG(0 == edge_list.size(), "edge list not flushed");
+        BOOST_ASSERT_MSG(0 == search_list.size(), "edge list not flushed");
 
         osrm::util::Percent progress(m_query_graph->GetNumberOfNodes());
         for (const auto node_u : osrm::util::irange(0u, m_query_graph->GetNumberOfNodes()))
         {
             for (const auto eid : m_query_graph->GetAdjacentEdgeRange(node_u))
             {
-                const osrm::tools::EdgeData &data = m_query_graph->GetEdgeData(eid);
+                const osrm::tools::EdgeData data = m_query_graph->GetEdgeData(eid);
                 if (!data.shortcut)
                 {
                     continue;
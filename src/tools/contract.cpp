@@ -39,6 +39,22 @@ int main(int argc, char *argv[]) try
         return EXIT_FAILURE;
     }
 
+    if (0 < contractor_config.partition_cell_size &&
+        contractor::MIN_PARTITION_CELL_SIZE > contractor_config.partition_cell_size)
+    {
+        util::SimpleLogger().Write(logWARNING) << "Partition cells must have at least "
+                                               << contractor::MIN_PARTITION_CELL_SIZE << " nodes";
+        return EXIT_FAILURE;
+    }
+
+    // the cells are only faster when they are contracted in parallel
+    if (0 < contractor_config.partition_cell_size && 1 == contractor_config.requested_num_threads)
+    {
+        util::SimpleLogger().Write(logWARNING)
+            << "Partitioned contraction needs more than one thread, contracting the whole graph";
+        contractor_config.partition_cell_size = 0;
+    }
+
     const unsigned recommended_num_threads = tbb::task_scheduler_init::default_num_threads();
 
     if (recommended_num_threads != contractor_config.requested_num_threads)
@@ -1,10 +1,10 @@
 #include "extractor/original_edge_data.hpp"
 #include "util/range_table.hpp"
 #include "contractor/query_edge.hpp"
+#include "contractor/query_graph.hpp"
 #include "extractor/query_node.hpp"
 #include "datastore/shared_memory_factory.hpp"
 #include "util/shared_memory_vector_wrapper.hpp"
-#include "util/static_graph.hpp"
 #include "util/static_rtree.hpp"
 #include "engine/datafacade/datafacade_base.hpp"
 #include "extractor/travel_mode.hpp"
@@ -13,8 +13,11 @@
 #include "engine/datafacade/shared_barriers.hpp"
 #include "util/datastore_options.hpp"
 #include "util/fingerprint.hpp"
+#include "util/graph_loader.hpp"
+#include "util/mapped_file_reader.hpp"
 #include "util/osrm_exception.hpp"
 #include "util/simple_logger.hpp"
+#include "util/timing_util.hpp"
 #include "util/typedefs.hpp"
 
 #include "osrm/coordinate.hpp"
@@ -24,11 +27,12 @@
 #endif
 
 #include <boost/filesystem/fstream.hpp>
-#include <boost/iostreams/seek.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+#include <tbb/task_group.h>
 
 #include <cstdint>
 
-#include <fstream>
 #include <new>
 #include <string>
 
@@ -42,7 +46,7 @@ using RTreeLeaf =
 using RTreeNode = util::StaticRTree<RTreeLeaf,
                                     util::ShM<util::FixedPointCoordinate, true>::vector,
                                     true>::TreeNode;
-using QueryGraph = util::StaticGraph<contractor::QueryEdge::EdgeData>;
+using QueryGraph = contractor::QueryGraph<>;
 
 namespace osrm
 {
@@ -70,6 +74,8 @@ void deleteRegion(const SharedDataType region)
                 return "DATA_2";
             case LAYOUT_NONE:
                 return "LAYOUT_NONE";
+            case QUERY_REGISTRY:
+                return "QUERY_REGISTRY";
             default: // DATA_NONE:
                 return "DATA_NONE";
             }
@@ -96,16 +102,9 @@ int main(const int argc, const char *argv[]) try
     }
 #endif
 
-    try
-    {
-        boost::interprocess::scoped_lock<boost::interprocess::named_mutex> pending_lock(
-            barrier.pending_update_mutex);
-    }
-    catch (...)
-    {
-        // hard unlock in case of any exception.
-        barrier.pending_update_mutex.unlock();
-    }
+    // only one update may pick and fill the unused data regions at a time
+    boost::interprocess::scoped_lock<boost::interprocess::named_mutex> update_lock(
+        barrier.update_mutex);
 
     util::SimpleLogger().Write(logDEBUG) << "Checking input parameters";
 
@@ -216,23 +215,20 @@ int main(const int argc, const char *argv[]) try
     // collect number of elements to store in shared memory object
     util::SimpleLogger().Write() << "load names from: " << names_data_path;
     // number of entries in name index
-    boost::filesystem::ifstream name_stream(names_data_path, std::ios::binary);
-    unsigned name_blocks = 0;
-    name_stream.read((char *)&name_blocks, sizeof(unsigned));
+    util::MappedFileReader name_reader(names_data_path);
+    const unsigned name_blocks = name_reader.Read<unsigned>();
     shared_layout_ptr->SetBlockSize<unsigned>(SharedDataLayout::NAME_OFFSETS, name_blocks);
     shared_layout_ptr->SetBlockSize<typename util::RangeTable<16, true>::BlockT>(
         SharedDataLayout::NAME_BLOCKS, name_blocks);
     util::SimpleLogger().Write() << "name offsets size: " << name_blocks;
     BOOST_ASSERT_MSG(0 != name_blocks, "name file broken");
 
-    unsigned number_of_chars = 0;
-    name_stream.read((char *)&number_of_chars, sizeof(unsigned));
+    const unsigned number_of_chars = name_reader.Read<unsigned>();
     shared_layout_ptr->SetBlockSize<char>(SharedDataLayout::NAME_CHAR_LIST, number_of_chars);
 
     // Loading information for original edges
-    boost::filesystem::ifstream edges_input_stream(edges_data_path, std::ios::binary);
-    unsigned number_of_original_edges = 0;
-    edges_input_stream.read((char *)&number_of_original_edges, sizeof(unsigned));
+    util::MappedFileReader edges_reader(edges_data_path);
+    const unsigned number_of_original_edges = edges_reader.Read<unsigned>();
 
     // note: settings this all to the same size is correct, we extract them from the same struct
     shared_layout_ptr->SetBlockSize<NodeID>(SharedDataLayout::VIA_NODE_LIST,
@@ -247,11 +243,10 @@ int main(const int argc, const char *argv[]) try
     shared_layout_ptr->SetBlockSize<unsigned>(SharedDataLayout::GEOMETRIES_INDICATORS,
                                               number_of_original_edges);
 
-    boost::filesystem::ifstream hsgr_input_stream(hsgr_path, std::ios::binary);
+    util::MappedFileReader hsgr_reader(hsgr_path);
 
     util::FingerPrint fingerprint_valid = util::FingerPrint::GetValid();
-    util::FingerPrint fingerprint_loaded;
-    hsgr_input_stream.read((char *)&fingerprint_loaded, sizeof(util::FingerPrint));
+    const auto fingerprint_loaded = hsgr_reader.Read<util::FingerPrint>();
     if (fingerprint_loaded.TestGraphUtil(fingerprint_valid))
     {
         util::SimpleLogger().Write(logDEBUG) << "Fingerprint checked out ok";
@@ -262,30 +257,36 @@ int main(const int argc, const char *argv[]) try
                                                   "Reprocess to get rid of this warning.";
     }
 
+    const unsigned format_version = hsgr_reader.Read<unsigned>();
+    if (format_version != util::HSGR_FORMAT_VERSION)
+    {
+        throw util::exception(".hsgr has format version " + std::to_string(format_version) +
+                              ", expected " + std::to_string(util::HSGR_FORMAT_VERSION) +
+                              ". Reprocess it with osrm-prepare.");
+    }
+
     // load checksum
-    unsigned checksum = 0;
-    hsgr_input_stream.read((char *)&checksum, sizeof(unsigned));
+    const unsigned checksum = hsgr_reader.Read<unsigned>();
     shared_layout_ptr->SetBlockSize<unsigned>(SharedDataLayout::HSGR_CHECKSUM, 1);
     // load graph node size
-    unsigned number_of_graph_nodes = 0;
-    hsgr_input_stream.read((char *)&number_of_graph_nodes, sizeof(unsigned));
+    const unsigned number_of_graph_nodes = hsgr_reader.Read<unsigned>();
 
     BOOST_ASSERT_MSG((0 != number_of_graph_nodes), "number of nodes is zero");
     shared_layout_ptr->SetBlockSize<QueryGraph::NodeArrayEntry>(SharedDataLayout::GRAPH_NODE_LIST,
                                                                 number_of_graph_nodes);
 
     // load graph edge size
-    unsigned number_of_graph_edges = 0;
-    hsgr_input_stream.read((char *)&number_of_graph_edges, sizeof(unsigned));
+    const unsigned number_of_graph_edges = hsgr_reader.Read<unsigned>();
     // BOOST_ASSERT_MSG(0 != number_of_graph_edges, "number of graph edges is zero");
-    shared_layout_ptr->SetBlockSize<QueryGraph::EdgeArrayEntry>(SharedDataLayout::GRAPH_EDGE_LIST,
-                                                                number_of_graph_edges);
+    shared_layout_ptr->SetBlockSize<contractor::QueryEdgeSearchData>(
+        SharedDataLayout::GRAPH_EDGE_LIST, number_of_graph_edges);
+    shared_layout_ptr->SetBlockSize<contractor::QueryEdgeUnpackData>(
+        SharedDataLayout::GRAPH_EDGE_UNPACK_LIST, number_of_graph_edges);
 
     // load rsearch tree size
-    boost::filesystem::ifstream tree_node_file(ram_index_path, std::ios::binary);
+    util::MappedFileReader tree_node_reader(ram_index_path);
 
-    uint32_t tree_size = 0;
-    tree_node_file.read((char *)&tree_size, sizeof(uint32_t));
+    const uint32_t tree_size = tree_node_reader.Read<uint32_t>();
     shared_layout_ptr->SetBlockSize<RTreeNode>(SharedDataLayout::R_SEARCH_TREE, tree_size);
 
     // load timestamp size
@@ -315,31 +316,25 @@ int main(const int argc, const char *argv[]) try
     shared_layout_ptr->SetBlockSize<char>(SharedDataLayout::TIMESTAMP, m_timestamp.length());
 
     // load core marker size
-    boost::filesystem::ifstream core_marker_file(core_marker_path, std::ios::binary);
+    util::MappedFileReader core_marker_reader(core_marker_path);
 
-    uint32_t number_of_core_markers = 0;
-    core_marker_file.read((char *)&number_of_core_markers, sizeof(uint32_t));
+    const uint32_t number_of_core_markers = core_marker_reader.Read<uint32_t>();
     shared_layout_ptr->SetBlockSize<unsigned>(SharedDataLayout::CORE_MARKER,
                                               number_of_core_markers);
 
     // load coordinate size
-    boost::filesystem::ifstream nodes_input_stream(nodes_data_path, std::ios::binary);
-    unsigned coordinate_list_size = 0;
-    nodes_input_stream.read((char *)&coordinate_list_size, sizeof(unsigned));
+    util::MappedFileReader nodes_reader(nodes_data_path);
+    const unsigned coordinate_list_size = nodes_reader.Read<unsigned>();
     shared_layout_ptr->SetBlockSize<util::FixedPointCoordinate>(SharedDataLayout::COORDINATE_LIST,
                                                                 coordinate_list_size);
 
     // load geometries sizes
-    std::ifstream geometry_input_stream(geometries_data_path.string().c_str(), std::ios::binary);
-    unsigned number_of_geometries_indices = 0;
-    unsigned number_of_compressed_geometries = 0;
-
-    geometry_input_stream.read((char *)&number_of_geometries_indices, sizeof(unsigned));
+    util::MappedFileReader geometry_reader(geometries_data_path);
+    const unsigned number_of_geometries_indices = geometry_reader.Read<unsigned>();
     shared_layout_ptr->SetBlockSize<unsigned>(SharedDataLayout::GEOMETRIES_INDEX,
                                               number_of_geometries_indices);
-    boost::iostreams::seek(geometry_input_stream, number_of_geometries_indices * sizeof(unsigned),
-                           BOOST_IOS::cur);
-    geometry_input_stream.read((char *)&number_of_compressed_geometries, sizeof(unsigned));
+    geometry_reader.Skip(number_of_geometries_indices * sizeof(unsigned));
+    const unsigned number_of_compressed_geometries = geometry_reader.Read<unsigned>();
     shared_layout_ptr->SetBlockSize<unsigned>(SharedDataLayout::GEOMETRIES_LIST,
                                               number_of_compressed_geometries);
     // allocate shared memory block
@@ -366,211 +361,219 @@ int main(const int argc, const char *argv[]) try
               0);
     std::copy(file_index_path.begin(), file_index_path.end(), file_index_path_ptr);
 
-    // Loading street names
-    unsigned *name_offsets_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
-        shared_memory_ptr, SharedDataLayout::NAME_OFFSETS);
-    if (shared_layout_ptr->GetBlockSize(SharedDataLayout::NAME_OFFSETS) > 0)
-    {
-        name_stream.read((char *)name_offsets_ptr,
-                         shared_layout_ptr->GetBlockSize(SharedDataLayout::NAME_OFFSETS));
-    }
-
-    unsigned *name_blocks_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
-        shared_memory_ptr, SharedDataLayout::NAME_BLOCKS);
-    if (shared_layout_ptr->GetBlockSize(SharedDataLayout::NAME_BLOCKS) > 0)
-    {
-        name_stream.read((char *)name_blocks_ptr,
-                         shared_layout_ptr->GetBlockSize(SharedDataLayout::NAME_BLOCKS));
-    }
-
-    char *name_char_ptr = shared_layout_ptr->GetBlockPtr<char, true>(
-        shared_memory_ptr, SharedDataLayout::NAME_CHAR_LIST);
-    unsigned temp_length;
-    name_stream.read((char *)&temp_length, sizeof(unsigned));
-
-    BOOST_ASSERT_MSG(temp_length ==
-                         shared_layout_ptr->GetBlockSize(SharedDataLayout::NAME_CHAR_LIST),
-                     "Name file corrupted!");
+    // store timestamp
+    char *timestamp_ptr =
+        shared_layout_ptr->GetBlockPtr<char, true>(shared_memory_ptr, SharedDataLayout::TIMESTAMP);
+    std::copy(m_timestamp.c_str(), m_timestamp.c_str() + m_timestamp.length(), timestamp_ptr);
 
-    if (shared_layout_ptr->GetBlockSize(SharedDataLayout::NAME_CHAR_LIST) > 0)
-    {
-        name_stream.read(name_char_ptr,
-                         shared_layout_ptr->GetBlockSize(SharedDataLayout::NAME_CHAR_LIST));
-    }
+    // Every file fills its own blocks, so they are loaded in parallel. Blocks that are stored the
+    // same way on disk are copied straight from the mapped file into shared memory.
+    TIMER_START(load_data);
+    tbb::task_group load_tasks;
 
-    name_stream.close();
+    // Loading street names
+    load_tasks.run([&]
+                   {
+                       TIMER_START(load_names);
+                       unsigned *name_offsets_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
+                           shared_memory_ptr, SharedDataLayout::NAME_OFFSETS);
+                       name_reader.Read(name_offsets_ptr, shared_layout_ptr->num_entries
+                                                              [SharedDataLayout::NAME_OFFSETS]);
+
+                       auto *name_blocks_ptr =
+                           shared_layout_ptr
+                               ->GetBlockPtr<typename util::RangeTable<16, true>::BlockT, true>(
+                                   shared_memory_ptr, SharedDataLayout::NAME_BLOCKS);
+                       name_reader.Read(name_blocks_ptr, shared_layout_ptr->num_entries
+                                                             [SharedDataLayout::NAME_BLOCKS]);
+
+                       char *name_char_ptr = shared_layout_ptr->GetBlockPtr<char, true>(
+                           shared_memory_ptr, SharedDataLayout::NAME_CHAR_LIST);
+                       const unsigned temp_length = name_reader.Read<unsigned>();
+
+                       BOOST_ASSERT_MSG(temp_length == number_of_chars, "Name file corrupted!");
+                       (void)temp_length;
+
+                       name_reader.Read(name_char_ptr, number_of_chars);
+                       TIMER_STOP(load_names);
+                       util::SimpleLogger().Write() << "loaded names in " << TIMER_SEC(load_names)
+                                                    << " sec";
+                   });
 
     // load original edge information
-    NodeID *via_node_ptr = shared_layout_ptr->GetBlockPtr<NodeID, true>(
-        shared_memory_ptr, SharedDataLayout::VIA_NODE_LIST);
+    load_tasks.run(
+        [&]
+        {
+            TIMER_START(load_edges);
+            NodeID *via_node_ptr = shared_layout_ptr->GetBlockPtr<NodeID, true>(
+                shared_memory_ptr, SharedDataLayout::VIA_NODE_LIST);
 
-    unsigned *name_id_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
-        shared_memory_ptr, SharedDataLayout::NAME_ID_LIST);
+            unsigned *name_id_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
+                shared_memory_ptr, SharedDataLayout::NAME_ID_LIST);
 
-    extractor::TravelMode *travel_mode_ptr =
-        shared_layout_ptr->GetBlockPtr<extractor::TravelMode, true>(shared_memory_ptr,
-                                                                    SharedDataLayout::TRAVEL_MODE);
+            extractor::TravelMode *travel_mode_ptr =
+                shared_layout_ptr->GetBlockPtr<extractor::TravelMode, true>(
+                    shared_memory_ptr, SharedDataLayout::TRAVEL_MODE);
 
-    extractor::TurnInstruction *turn_instructions_ptr =
-        shared_layout_ptr->GetBlockPtr<extractor::TurnInstruction, true>(
-            shared_memory_ptr, SharedDataLayout::TURN_INSTRUCTION);
+            extractor::TurnInstruction *turn_instructions_ptr =
+                shared_layout_ptr->GetBlockPtr<extractor::TurnInstruction, true>(
+                    shared_memory_ptr, SharedDataLayout::TURN_INSTRUCTION);
 
-    unsigned *geometries_indicator_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
-        shared_memory_ptr, SharedDataLayout::GEOMETRIES_INDICATORS);
+            unsigned *geometries_indicator_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
+                shared_memory_ptr, SharedDataLayout::GEOMETRIES_INDICATORS);
 
-    extractor::OriginalEdgeData current_edge_data;
-    for (unsigned i = 0; i < number_of_original_edges; ++i)
-    {
-        edges_input_stream.read((char *)&(current_edge_data), sizeof(extractor::OriginalEdgeData));
-        via_node_ptr[i] = current_edge_data.via_node;
-        name_id_ptr[i] = current_edge_data.name_id;
-        travel_mode_ptr[i] = current_edge_data.travel_mode;
-        turn_instructions_ptr[i] = current_edge_data.turn_instruction;
-
-        const unsigned bucket = i / 32;
-        const unsigned offset = i % 32;
-        const unsigned value = [&]
-        {
-            unsigned return_value = 0;
-            if (0 != offset)
+            for (unsigned i = 0; i < number_of_original_edges; ++i)
             {
-                return_value = geometries_indicator_ptr[bucket];
+                const auto current_edge_data = edges_reader.Read<extractor::OriginalEdgeData>();
+                via_node_ptr[i] = current_edge_data.via_node;
+                name_id_ptr[i] = current_edge_data.name_id;
+                travel_mode_ptr[i] = current_edge_data.travel_mode;
+                turn_instructions_ptr[i] = current_edge_data.turn_instruction;
+
+                const unsigned bucket = i / 32;
+                const unsigned offset = i % 32;
+                const unsigned value = [&]
+                {
+                    unsigned return_value = 0;
+                    if (0 != offset)
+                    {
+                        return_value = geometries_indicator_ptr[bucket];
+                    }
+                    return return_value;
+                }();
+                if (current_edge_data.compressed_geometry)
+                {
+                    geometries_indicator_ptr[bucket] = (value | (1 << offset));
+                }
             }
-            return return_value;
-        }();
-        if (current_edge_data.compressed_geometry)
-        {
-            geometries_indicator_ptr[bucket] = (value | (1 << offset));
-        }
-    }
-    edges_input_stream.close();
+            TIMER_STOP(load_edges);
+            util::SimpleLogger().Write() << "loaded edge information in " << TIMER_SEC(load_edges)
+                                         << " sec";
+        });
 
     // load compressed geometry
-    unsigned temporary_value;
-    unsigned *geometries_index_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
-        shared_memory_ptr, SharedDataLayout::GEOMETRIES_INDEX);
-    geometry_input_stream.seekg(0, geometry_input_stream.beg);
-    geometry_input_stream.read((char *)&temporary_value, sizeof(unsigned));
-    BOOST_ASSERT(temporary_value ==
-                 shared_layout_ptr->num_entries[SharedDataLayout::GEOMETRIES_INDEX]);
-
-    if (shared_layout_ptr->GetBlockSize(SharedDataLayout::GEOMETRIES_INDEX) > 0)
-    {
-        geometry_input_stream.read(
-            (char *)geometries_index_ptr,
-            shared_layout_ptr->GetBlockSize(SharedDataLayout::GEOMETRIES_INDEX));
-    }
-    unsigned *geometries_list_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
-        shared_memory_ptr, SharedDataLayout::GEOMETRIES_LIST);
-
-    geometry_input_stream.read((char *)&temporary_value, sizeof(unsigned));
-    BOOST_ASSERT(temporary_value ==
-                 shared_layout_ptr->num_entries[SharedDataLayout::GEOMETRIES_LIST]);
-
-    if (shared_layout_ptr->GetBlockSize(SharedDataLayout::GEOMETRIES_LIST) > 0)
-    {
-        geometry_input_stream.read(
-            (char *)geometries_list_ptr,
-            shared_layout_ptr->GetBlockSize(SharedDataLayout::GEOMETRIES_LIST));
-    }
+    load_tasks.run([&]
+                   {
+                       TIMER_START(load_geometries);
+                       unsigned *geometries_index_ptr =
+                           shared_layout_ptr->GetBlockPtr<unsigned, true>(
+                               shared_memory_ptr, SharedDataLayout::GEOMETRIES_INDEX);
+                       geometry_reader.Seek(sizeof(unsigned));
+                       geometry_reader.Read(geometries_index_ptr, number_of_geometries_indices);
+
+                       unsigned *geometries_list_ptr =
+                           shared_layout_ptr->GetBlockPtr<unsigned, true>(
+                               shared_memory_ptr, SharedDataLayout::GEOMETRIES_LIST);
+                       geometry_reader.Skip(sizeof(unsigned));
+                       geometry_reader.Read(geometries_list_ptr, number_of_compressed_geometries);
+                       TIMER_STOP(load_geometries);
+                       util::SimpleLogger().Write() << "loaded geometries in "
+                                                    << TIMER_SEC(load_geometries) << " sec";
+                   });
 
     // Loading list of coordinates
-    util::FixedPointCoordinate *coordinates_ptr =
-        shared_layout_ptr->GetBlockPtr<util::FixedPointCoordinate, true>(
-            shared_memory_ptr, SharedDataLayout::COORDINATE_LIST);
-
-    extractor::QueryNode current_node;
-    for (unsigned i = 0; i < coordinate_list_size; ++i)
-    {
-        nodes_input_stream.read((char *)&current_node, sizeof(extractor::QueryNode));
-        coordinates_ptr[i] = util::FixedPointCoordinate(current_node.lat, current_node.lon);
-    }
-    nodes_input_stream.close();
-
-    // store timestamp
-    char *timestamp_ptr =
-        shared_layout_ptr->GetBlockPtr<char, true>(shared_memory_ptr, SharedDataLayout::TIMESTAMP);
-    std::copy(m_timestamp.c_str(), m_timestamp.c_str() + m_timestamp.length(), timestamp_ptr);
+    load_tasks.run([&]
+                   {
+                       TIMER_START(load_coordinates);
+                       util::FixedPointCoordinate *coordinates_ptr =
+                           shared_layout_ptr->GetBlockPtr<util::FixedPointCoordinate, true>(
+                               shared_memory_ptr, SharedDataLayout::COORDINATE_LIST);
+
+                       for (unsigned i = 0; i < coordinate_list_size; ++i)
+                       {
+                           const auto current_node = nodes_reader.Read<extractor::QueryNode>();
+                           coordinates_ptr[i] =
+                               util::FixedPointCoordinate(current_node.lat, current_node.lon);
+                       }
+                       TIMER_STOP(load_coordinates);
+                       util::SimpleLogger().Write() << "loaded coordinates in "
+                                                    << TIMER_SEC(load_coordinates) << " sec";
+                   });
 
     // store search tree portion of rtree
-    char *rtree_ptr = shared_layout_ptr->GetBlockPtr<char, true>(shared_memory_ptr,
-                                                                 SharedDataLayout::R_SEARCH_TREE);
-
-    if (tree_size > 0)
-    {
-        tree_node_file.read(rtree_ptr, sizeof(RTreeNode) * tree_size);
-    }
-    tree_node_file.close();
+    load_tasks.run([&]
+                   {
+                       TIMER_START(load_rtree);
+                       RTreeNode *rtree_ptr = shared_layout_ptr->GetBlockPtr<RTreeNode, true>(
+                           shared_memory_ptr, SharedDataLayout::R_SEARCH_TREE);
+                       tree_node_reader.Read(rtree_ptr, tree_size);
+                       TIMER_STOP(load_rtree);
+                       util::SimpleLogger().Write() << "loaded r-tree in " << TIMER_SEC(load_rtree)
+                                                    << " sec";
+                   });
 
     // load core markers
-    std::vector<char> unpacked_core_markers(number_of_core_markers);
-    core_marker_file.read((char *)unpacked_core_markers.data(),
-                          sizeof(char) * number_of_core_markers);
-
-    unsigned *core_marker_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
-        shared_memory_ptr, SharedDataLayout::CORE_MARKER);
-
-    for (auto i = 0u; i < number_of_core_markers; ++i)
-    {
-        BOOST_ASSERT(unpacked_core_markers[i] == 0 || unpacked_core_markers[i] == 1);
-
-        if (unpacked_core_markers[i] == 1)
+    load_tasks.run([&]
+                   {
+                       TIMER_START(load_core);
+                       unsigned *core_marker_ptr = shared_layout_ptr->GetBlockPtr<unsigned, true>(
+                           shared_memory_ptr, SharedDataLayout::CORE_MARKER);
+
+                       for (auto i = 0u; i < number_of_core_markers; ++i)
+                       {
+                           const char is_core = core_marker_reader.Read<char>();
+                           BOOST_ASSERT(is_core == 0 || is_core == 1);
+
+                           const unsigned bucket = i / 32;
+                           const unsigned offset = i % 32;
+                           const unsigned value = [&]
+                           {
+                               unsigned return_value = 0;
+                               if (0 != offset)
+                               {
+                                   return_value = core_marker_ptr[bucket];
+                               }
+                               return return_value;
+                           }();
+                           core_marker_ptr[bucket] = is_core == 1 ? (value | (1 << offset)) : value;
+                       }
+                       TIMER_STOP(load_core);
+                       util::SimpleLogger().Write() << "loaded core markers in "
+                                                    << TIMER_SEC(load_core) << " sec";
+                   });
+
+    // load the search graph, the search data of the edges is followed by their unpack data
+    load_tasks.run(
+        [&]
         {
-            const unsigned bucket = i / 32;
-            const unsigned offset = i % 32;
-            const unsigned value = [&]
-            {
-                unsigned return_value = 0;
-                if (0 != offset)
-                {
-                    return_value = core_marker_ptr[bucket];
-                }
-                return return_value;
-            }();
-
-            core_marker_ptr[bucket] = (value | (1 << offset));
-        }
-    }
-
-    // load the nodes of the search graph
-    QueryGraph::NodeArrayEntry *graph_node_list_ptr =
-        shared_layout_ptr->GetBlockPtr<QueryGraph::NodeArrayEntry, true>(
-            shared_memory_ptr, SharedDataLayout::GRAPH_NODE_LIST);
-    if (shared_layout_ptr->GetBlockSize(SharedDataLayout::GRAPH_NODE_LIST) > 0)
-    {
-        hsgr_input_stream.read((char *)graph_node_list_ptr,
-                               shared_layout_ptr->GetBlockSize(SharedDataLayout::GRAPH_NODE_LIST));
-    }
-
-    // load the edges of the search graph
-    QueryGraph::EdgeArrayEntry *graph_edge_list_ptr =
-        shared_layout_ptr->GetBlockPtr<QueryGraph::EdgeArrayEntry, true>(
-            shared_memory_ptr, SharedDataLayout::GRAPH_EDGE_LIST);
-    if (shared_layout_ptr->GetBlockSize(SharedDataLayout::GRAPH_EDGE_LIST) > 0)
-    {
-        hsgr_input_stream.read((char *)graph_edge_list_ptr,
-                               shared_layout_ptr->GetBlockSize(SharedDataLayout::GRAPH_EDGE_LIST));
-    }
-    hsgr_input_stream.close();
-
-    // acquire lock
+            TIMER_START(load_graph);
+            QueryGraph::NodeArrayEntry *graph_node_list_ptr =
+                shared_layout_ptr->GetBlockPtr<QueryGraph::NodeArrayEntry, true>(
+                    shared_memory_ptr, SharedDataLayout::GRAPH_NODE_LIST);
+            hsgr_reader.Read(graph_node_list_ptr, number_of_graph_nodes);
+
+            contractor::QueryEdgeSearchData *graph_edge_list_ptr =
+                shared_layout_ptr->GetBlockPtr<contractor::QueryEdgeSearchData, true>(
+                    shared_memory_ptr, SharedDataLayout::GRAPH_EDGE_LIST);
+            hsgr_reader.Read(graph_edge_list_ptr, number_of_graph_edges);
+
+            contractor::QueryEdgeUnpackData *graph_unpack_list_ptr =
+                shared_layout_ptr->GetBlockPtr<contractor::QueryEdgeUnpackData, true>(
+                    shared_memory_ptr, SharedDataLayout::GRAPH_EDGE_UNPACK_LIST);
+            hsgr_reader.Read(graph_unpack_list_ptr, number_of_graph_edges);
+            TIMER_STOP(load_graph);
+            util::SimpleLogger().Write() << "loaded graph in " << TIMER_SEC(load_graph) << " sec";
+        });
+
+    load_tasks.wait();
+    TIMER_STOP(load_data);
+    util::SimpleLogger().Write() << "loaded all data in " << TIMER_SEC(load_data) << " sec";
+
+    // the pointer to the currently active regions
     SharedMemory *data_type_memory =
         SharedMemoryFactory::Get(CURRENT_REGIONS, sizeof(SharedDataTimestamp), true, false);
     SharedDataTimestamp *data_timestamp_ptr =
         static_cast<SharedDataTimestamp *>(data_type_memory->Ptr());
 
-    boost::interprocess::scoped_lock<boost::interprocess::named_mutex> query_lock(
-        barrier.query_mutex);
-
-    // notify all processes that were waiting for this condition
-    if (0 < barrier.number_of_queries)
-    {
-        barrier.no_running_queries_condition.wait(query_lock);
-    }
-
+    // publish the new regions, queries starting from now on will switch over to them. The odd
+    // timestamp in between keeps them from reading the new layout with the old data.
+    data_timestamp_ptr->timestamp += 1;
     data_timestamp_ptr->layout = layout_region;
     data_timestamp_ptr->data = data_region;
     data_timestamp_ptr->timestamp += 1;
+
+    // wait for the queries that may still run on the previous regions
+    barrier.query_registry->Synchronize();
     tools::deleteRegion(previous_data_region);
     tools::deleteRegion(previous_layout_region);
     util::SimpleLogger().Write() << "all data loaded";
@@ -47,14 +47,19 @@ int main(int argc, const char *argv[]) try
 
     bool trial_run = false;
     std::string ip_address;
-    int ip_port, requested_thread_num;
+    int ip_port, requested_thread_num, keepalive_timeout, max_keepalive_requests,
+        compression_level;
+    std::string access_log_format;
+    double access_log_sample_rate;
 
     LibOSRMConfig lib_config;
     const unsigned init_result = util::GenerateServerProgramOptions(
         argc, argv, lib_config.server_paths, ip_address, ip_port, requested_thread_num,
         lib_config.use_shared_memory, trial_run, lib_config.max_locations_trip,
         lib_config.max_locations_viaroute, lib_config.max_locations_distance_table,
-        lib_config.max_locations_map_matching);
+        lib_config.max_locations_map_matching, lib_config.mmap_file_index,
+        lib_config.prefetch_file_index, lib_config.mmap_dataset, keepalive_timeout,
+        max_keepalive_requests, access_log_format, access_log_sample_rate, compression_level);
     if (init_result == util::INIT_OK_DO_NOT_START_ENGINE)
     {
         return EXIT_SUCCESS;
@@ -93,6 +98,9 @@ int main(int argc, const char *argv[]) try
     util::SimpleLogger().Write(logDEBUG) << "Threads:\t" << requested_thread_num;
     util::SimpleLogger().Write(logDEBUG) << "IP address:\t" << ip_address;
     util::SimpleLogger().Write(logDEBUG) << "IP port:\t" << ip_port;
+    util::SimpleLogger().Write(logDEBUG) << "Keep-alive:\t" << keepalive_timeout << "s, "
+                                         << max_keepalive_requests << " requests";
+    util::SimpleLogger().Write(logDEBUG) << "Compression:\tlevel " << compression_level;
 
 #ifndef _WIN32
     int sig = 0;
@@ -103,9 +111,15 @@ int main(int argc, const char *argv[]) try
 #endif
 
     OSRM osrm_lib(lib_config);
-    auto routing_server = server::Server::CreateServer(ip_address, ip_port, requested_thread_num);
+    auto routing_server = server::Server::CreateServer(
+        ip_address, ip_port, requested_thread_num, keepalive_timeout, max_keepalive_requests,
+        compression_level);
 
     routing_server->GetRequestHandlerPtr().RegisterRoutingMachine(&osrm_lib);
+    routing_server->GetRequestHandlerPtr().EnableAccessLog(
+        "json" == access_log_format ? server::AccessLogFormat::JSON
+                                    : server::AccessLogFormat::Plain,
+        access_log_sample_rate);
 
     if (trial_run)
     {
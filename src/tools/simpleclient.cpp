@@ -15,14 +15,19 @@ int main(int argc, const char *argv[])
     try
     {
         std::string ip_address;
-        int ip_port, requested_thread_num;
+        int ip_port, requested_thread_num, keepalive_timeout, max_keepalive_requests,
+            compression_level;
+        std::string access_log_format;
+        double access_log_sample_rate;
         bool trial_run = false;
         osrm::LibOSRMConfig lib_config;
         const unsigned init_result = osrm::util::GenerateServerProgramOptions(
             argc, argv, lib_config.server_paths, ip_address, ip_port, requested_thread_num,
             lib_config.use_shared_memory, trial_run, lib_config.max_locations_trip,
             lib_config.max_locations_viaroute, lib_config.max_locations_distance_table,
-            lib_config.max_locations_map_matching);
+            lib_config.max_locations_map_matching, lib_config.mmap_file_index,
+            lib_config.prefetch_file_index, lib_config.mmap_dataset, keepalive_timeout,
+            max_keepalive_requests, access_log_format, access_log_sample_rate, compression_level);
 
         if (init_result == osrm::util::INIT_OK_DO_NOT_START_ENGINE)
         {
@@ -33,6 +33,8 @@ void deleteRegion(const SharedDataType region)
                 return "DATA_2";
             case LAYOUT_NONE:
                 return "LAYOUT_NONE";
+            case QUERY_REGISTRY:
+                return "QUERY_REGISTRY";
             default: // DATA_NONE:
                 return "DATA_NONE";
             }
@@ -51,6 +53,7 @@ void springclean()
     deleteRegion(DATA_2);
     deleteRegion(LAYOUT_2);
     deleteRegion(CURRENT_REGIONS);
+    deleteRegion(QUERY_REGISTRY);
 }
 }
 }
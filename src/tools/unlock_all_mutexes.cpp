@@ -10,8 +10,6 @@ int main()
     {
         osrm::util::SimpleLogger().Write() << "Releasing all locks";
         osrm::engine::datafacade::SharedBarriers barrier;
-        barrier.pending_update_mutex.unlock();
-        barrier.query_mutex.unlock();
         barrier.update_mutex.unlock();
     }
     catch (const std::exception &e)
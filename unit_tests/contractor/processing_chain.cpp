@@ -0,0 +1,507 @@
+#include "contractor/contractor_options.hpp"
+#include "contractor/processing_chain.hpp"
+#include "contractor/query_edge.hpp"
+#include "contractor/query_graph.hpp"
+#include "extractor/edge_based_edge.hpp"
+#include "extractor/edge_based_node.hpp"
+#include "extractor/query_node.hpp"
+#include "extractor/travel_mode.hpp"
+#include "util/fingerprint.hpp"
+#include "util/graph_loader.hpp"
+#include "util/integer_range.hpp"
+#include "util/static_rtree.hpp"
+#include "util/typedefs.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(processing_chain)
+
+using namespace osrm;
+using namespace osrm::contractor;
+
+using EdgeBasedNodeRTree = util::StaticRTree<extractor::EdgeBasedNode>;
+
+// source, target, distance, shortcut, id, forward, backward
+using HierarchyEdge = std::tuple<NodeID, NodeID, int, bool, NodeID, bool, bool>;
+
+using Adjacency = std::vector<std::vector<std::pair<NodeID, int>>>;
+
+std::vector<int> Dijkstra(const Adjacency &adjacency, const NodeID source)
+{
+    using QueueEntry = std::pair<int, NodeID>;
+    std::vector<int> distances(adjacency.size(), std::numeric_limits<int>::max());
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+    distances[source] = 0;
+    queue.emplace(0, source);
+    while (!queue.empty())
+    {
+        const auto entry = queue.top();
+        queue.pop();
+        if (entry.first > distances[entry.second])
+        {
+            continue;
+        }
+        for (const auto &edge : adjacency[entry.second])
+        {
+            if (entry.first + edge.second < distances[edge.first])
+            {
+                distances[edge.first] = entry.first + edge.second;
+                queue.emplace(distances[edge.first], edge.first);
+            }
+        }
+    }
+    return distances;
+}
+
+// What osrm-extract writes for a grid of roads: the coordinates, the edge-expanded graph and the
+// r-tree over its segments. Every segment s is driven by the edge-based nodes 2 * s and
+// 2 * s + 1, one per direction.
+struct GridDataset
+{
+    explicit GridDataset(const unsigned size)
+        : base_path(boost::filesystem::temp_directory_path() /
+                    boost::filesystem::unique_path("renumbering-%%%%-%%%%"))
+    {
+        boost::filesystem::create_directories(base_path);
+        osrm_path = (base_path / "grid.osrm").string();
+
+        std::mt19937 generator(42);
+        std::vector<extractor::QueryNode> coordinates;
+        for (const auto row : util::irange(0u, size))
+        {
+            for (const auto column : util::irange(0u, size))
+            {
+                coordinates.emplace_back(52000000 + 1000 * row, 13000000 + 1000 * column,
+                                         OSMNodeID(row * size + column));
+            }
+        }
+        boost::filesystem::ofstream nodes_output_stream(osrm_path + ".nodes", std::ios::binary);
+        const unsigned number_of_coordinates = coordinates.size();
+        nodes_output_stream.write((char *)&number_of_coordinates, sizeof(unsigned));
+        nodes_output_stream.write((char *)coordinates.data(),
+                                  sizeof(extractor::QueryNode) * coordinates.size());
+        nodes_output_stream.close();
+
+        std::vector<std::pair<NodeID, NodeID>> segments;
+        for (const auto row : util::irange(0u, size))
+        {
+            for (const auto column : util::irange(0u, size))
+            {
+                const NodeID node = row * size + column;
+                if (column + 1 < size)
+                {
+                    segments.emplace_back(node, node + 1);
+                }
+                if (row + 1 < size)
+                {
+                    segments.emplace_back(node, node + size);
+                }
+            }
+        }
+
+        std::vector<extractor::EdgeBasedNode> edge_based_nodes;
+        for (const auto segment : util::irange<NodeID>(0, segments.size()))
+        {
+            edge_based_nodes.emplace_back(2 * segment, 2 * segment + 1, segments[segment].first,
+                                          segments[segment].second, 0, 10, 10, 0, 0, segment,
+                                          false, 0, 0, TRAVEL_MODE_DEFAULT, TRAVEL_MODE_DEFAULT);
+        }
+        EdgeBasedNodeRTree rtree(edge_based_nodes, osrm_path + ".ramIndex",
+                                 osrm_path + ".fileIndex", coordinates);
+
+        // turns onto every other segment at the end of a segment
+        std::uniform_int_distribution<> weight(1, 100);
+        const auto source = [&segments](const NodeID node)
+        {
+            return node % 2 == 0 ? segments[node / 2].first : segments[node / 2].second;
+        };
+        const auto target = [&segments](const NodeID node)
+        {
+            return node % 2 == 0 ? segments[node / 2].second : segments[node / 2].first;
+        };
+        number_of_nodes = 2 * segments.size();
+        for (const auto from : util::irange(0u, number_of_nodes))
+        {
+            for (const auto to : util::irange(0u, number_of_nodes))
+            {
+                if (target(from) == source(to) && from / 2 != to / 2)
+                {
+                    edges.emplace_back(from, to, edges.size(), weight(generator), true, false);
+                }
+            }
+        }
+        WriteEdges();
+    }
+
+    ~GridDataset() { boost::filesystem::remove_all(base_path); }
+
+    void WriteEdges() const
+    {
+        boost::filesystem::ofstream edges_output_stream(osrm_path + ".ebg", std::ios::binary);
+        const util::FingerPrint fingerprint = util::FingerPrint::GetValid();
+        edges_output_stream.write((char *)&fingerprint, sizeof(util::FingerPrint));
+        const std::size_t number_of_edges = edges.size();
+        const std::size_t max_edge_id = number_of_nodes - 1;
+        edges_output_stream.write((char *)&number_of_edges, sizeof(std::size_t));
+        edges_output_stream.write((char *)&max_edge_id, sizeof(std::size_t));
+        edges_output_stream.write((char *)edges.data(),
+                                  sizeof(extractor::EdgeBasedEdge) * edges.size());
+    }
+
+    // what a new speed file does to the .ebg
+    void ChangeWeights(std::mt19937 &generator, const unsigned number_of_changes)
+    {
+        std::uniform_int_distribution<std::size_t> edge(0, edges.size() - 1);
+        std::uniform_int_distribution<> weight(1, 100);
+        for (const auto change : util::irange(0u, number_of_changes))
+        {
+            (void)change;
+            edges[edge(generator)].weight = weight(generator);
+        }
+        WriteEdges();
+    }
+
+    std::vector<std::vector<int>> ShortestDistances() const
+    {
+        Adjacency graph(number_of_nodes);
+        for (const auto &edge : edges)
+        {
+            graph[edge.source].emplace_back(edge.target, edge.weight);
+        }
+        std::vector<std::vector<int>> distances;
+        for (const auto node : util::irange(0u, number_of_nodes))
+        {
+            distances.push_back(Dijkstra(graph, node));
+        }
+        return distances;
+    }
+
+    void Contract(const std::string &node_order,
+                  const double core_factor,
+                  const unsigned partition_cell_size = 0) const
+    {
+        auto config = MakeConfig(node_order, core_factor);
+        config.partition_cell_size = partition_cell_size;
+        Run(config);
+    }
+
+    void ContractIncrementally(const double max_incremental_growth) const
+    {
+        auto config = MakeConfig("none", 1.0);
+        config.use_incremental_contraction = true;
+        config.max_incremental_growth = max_incremental_growth;
+        Run(config);
+    }
+
+    ContractorConfig MakeConfig(const std::string &node_order, const double core_factor) const
+    {
+        ContractorConfig config;
+        config.osrm_input_path = osrm_path;
+        ContractorOptions::GenerateOutputFilesNames(config);
+        config.use_cached_priority = false;
+        config.use_incremental_contraction = false;
+        config.core_factor = core_factor;
+        config.node_order = node_order;
+        return config;
+    }
+
+    static void Run(const ContractorConfig &config)
+    {
+        // the contractor breaks ties with a hash shuffled by std::rand, every run has to start
+        // from the same state to build the same hierarchy
+        std::srand(1);
+        contractor::Prepare(config).Run();
+    }
+
+    // the ids of the .hsgr indexed by the ids of the .ebg, empty if the nodes are not renumbered
+    std::vector<NodeID> ReadNodeRenumbering() const
+    {
+        std::vector<NodeID> node_ids;
+        const auto path = osrm_path + ".node_renumbering";
+        if (boost::filesystem::exists(path))
+        {
+            boost::filesystem::ifstream renumbering_input_stream(path, std::ios::binary);
+            unsigned size = 0;
+            renumbering_input_stream.read((char *)&size, sizeof(unsigned));
+            node_ids.resize(size);
+            renumbering_input_stream.read((char *)node_ids.data(), sizeof(NodeID) * size);
+        }
+        return node_ids;
+    }
+
+    // the edges of the .hsgr with the node ids given by original_id
+    template <typename OriginalIdT>
+    std::set<HierarchyEdge> ReadHierarchy(OriginalIdT original_id) const
+    {
+        std::vector<QueryGraph<>::NodeArrayEntry> node_list;
+        std::vector<QueryEdgeSearchData> search_list;
+        std::vector<QueryEdgeUnpackData> unpack_list;
+        unsigned check_sum = 0;
+        util::readHSGRFromStream(osrm_path + ".hsgr", node_list, search_list, unpack_list,
+                                 &check_sum);
+
+        std::set<HierarchyEdge> hierarchy;
+        for (const auto node : util::irange<NodeID>(0, node_list.size() - 1))
+        {
+            for (const auto edge :
+                 util::irange(node_list[node].first_edge, node_list[node + 1].first_edge))
+            {
+                const auto &search_data = search_list[edge];
+                const auto &unpack_data = unpack_list[edge];
+                hierarchy.emplace(original_id(node), original_id(search_data.target),
+                                  search_data.distance, unpack_data.shortcut,
+                                  unpack_data.shortcut ? original_id(unpack_data.id)
+                                                       : NodeID(unpack_data.id),
+                                  search_data.forward, search_data.backward);
+            }
+        }
+        return hierarchy;
+    }
+
+    std::vector<bool> ReadCoreMarkers() const
+    {
+        boost::filesystem::ifstream core_input_stream(osrm_path + ".core", std::ios::binary);
+        unsigned size = 0;
+        core_input_stream.read((char *)&size, sizeof(unsigned));
+        std::vector<char> markers(size);
+        core_input_stream.read(markers.data(), size);
+        return std::vector<bool>(markers.begin(), markers.end());
+    }
+
+    // forward and reverse node of every segment in the order of the leaves
+    std::vector<NodeID> ReadRTreeNodeIDs() const
+    {
+        std::vector<NodeID> node_ids;
+        EdgeBasedNodeRTree::VisitLeafNodeFile(osrm_path + ".fileIndex",
+                                              [&node_ids](const extractor::EdgeBasedNode &segment)
+                                              {
+                                                  node_ids.push_back(
+                                                      segment.forward_edge_based_node_id);
+                                                  node_ids.push_back(
+                                                      segment.reverse_edge_based_node_id);
+                                              });
+        return node_ids;
+    }
+
+    boost::filesystem::path base_path;
+    std::string osrm_path;
+    unsigned number_of_nodes;
+    std::vector<extractor::EdgeBasedEdge> edges;
+};
+
+NodeID SameId(const NodeID node) { return node; }
+
+// Distances between all nodes found by the upward searches of a contraction hierarchy
+std::vector<std::vector<int>> QueryDistances(const std::set<HierarchyEdge> &hierarchy,
+                                             const unsigned number_of_nodes)
+{
+    Adjacency upward(number_of_nodes);
+    Adjacency downward(number_of_nodes);
+    for (const auto &edge : hierarchy)
+    {
+        if (std::get<5>(edge))
+        {
+            upward[std::get<0>(edge)].emplace_back(std::get<1>(edge), std::get<2>(edge));
+        }
+        if (std::get<6>(edge))
+        {
+            downward[std::get<0>(edge)].emplace_back(std::get<1>(edge), std::get<2>(edge));
+        }
+    }
+
+    std::vector<std::vector<int>> forward_distances;
+    std::vector<std::vector<int>> backward_distances;
+    for (const auto node : util::irange(0u, number_of_nodes))
+    {
+        forward_distances.push_back(Dijkstra(upward, node));
+        backward_distances.push_back(Dijkstra(downward, node));
+    }
+
+    std::vector<std::vector<int>> distances(number_of_nodes);
+    for (const auto source : util::irange(0u, number_of_nodes))
+    {
+        for (const auto target : util::irange(0u, number_of_nodes))
+        {
+            int distance = std::numeric_limits<int>::max();
+            for (const auto middle : util::irange(0u, number_of_nodes))
+            {
+                if (forward_distances[source][middle] != std::numeric_limits<int>::max() &&
+                    backward_distances[target][middle] != std::numeric_limits<int>::max())
+                {
+                    distance = std::min(distance, forward_distances[source][middle] +
+                                                      backward_distances[target][middle]);
+                }
+            }
+            distances[source].push_back(distance);
+        }
+    }
+    return distances;
+}
+
+// Renumbering moves the nodes within the .hsgr, the .core and the r-tree, but all three have to
+// describe the same hierarchy as without renumbering.
+BOOST_AUTO_TEST_CASE(renumbered_files_agree)
+{
+    GridDataset dataset(5);
+    dataset.Contract("none", 0.8);
+    BOOST_REQUIRE(dataset.ReadNodeRenumbering().empty());
+    const auto hierarchy = dataset.ReadHierarchy(SameId);
+    const auto core_markers = dataset.ReadCoreMarkers();
+    const auto rtree_node_ids = dataset.ReadRTreeNodeIDs();
+    BOOST_REQUIRE_EQUAL(core_markers.size(), dataset.number_of_nodes);
+    BOOST_CHECK(std::find(core_markers.begin(), core_markers.end(), true) != core_markers.end());
+
+    for (const std::string node_order : {"hilbert", "level", "hilbert"})
+    {
+        dataset.Contract(node_order, 0.8);
+
+        const auto new_node_ids = dataset.ReadNodeRenumbering();
+        BOOST_REQUIRE_EQUAL(new_node_ids.size(), dataset.number_of_nodes);
+        std::vector<NodeID> original_node_ids(new_node_ids.size(), SPECIAL_NODEID);
+        for (const auto node : util::irange<NodeID>(0, new_node_ids.size()))
+        {
+            BOOST_REQUIRE_LT(new_node_ids[node], new_node_ids.size());
+            original_node_ids[new_node_ids[node]] = node;
+        }
+        BOOST_REQUIRE(std::find(original_node_ids.begin(), original_node_ids.end(),
+                                SPECIAL_NODEID) == original_node_ids.end());
+        BOOST_CHECK(!std::is_sorted(new_node_ids.begin(), new_node_ids.end()));
+
+        const auto renumbered_hierarchy = dataset.ReadHierarchy([&](const NodeID node)
+                                                                {
+                                                                    return original_node_ids[node];
+                                                                });
+        BOOST_CHECK(renumbered_hierarchy == hierarchy);
+
+        const auto renumbered_core_markers = dataset.ReadCoreMarkers();
+        BOOST_REQUIRE_EQUAL(renumbered_core_markers.size(), core_markers.size());
+        for (const auto node : util::irange<NodeID>(0, core_markers.size()))
+        {
+            BOOST_CHECK_EQUAL(renumbered_core_markers[new_node_ids[node]], core_markers[node]);
+        }
+
+        const auto renumbered_rtree_node_ids = dataset.ReadRTreeNodeIDs();
+        BOOST_REQUIRE_EQUAL(renumbered_rtree_node_ids.size(), rtree_node_ids.size());
+        for (const auto index : util::irange<std::size_t>(0, rtree_node_ids.size()))
+        {
+            BOOST_CHECK_EQUAL(renumbered_rtree_node_ids[index],
+                              new_node_ids[rtree_node_ids[index]]);
+        }
+    }
+
+    // going back to the order of the .ebg undoes the renumbering of the r-tree
+    dataset.Contract("none", 0.8);
+    BOOST_CHECK(dataset.ReadNodeRenumbering().empty());
+    BOOST_CHECK(dataset.ReadHierarchy(SameId) == hierarchy);
+    BOOST_CHECK(dataset.ReadCoreMarkers() == core_markers);
+    BOOST_CHECK(dataset.ReadRTreeNodeIDs() == rtree_node_ids);
+}
+
+// The next run reads the r-tree with the ids of the .node_renumbering, so the r-tree must not be
+// replaced when the .node_renumbering that goes with it can not be written.
+BOOST_AUTO_TEST_CASE(failed_renumbering_keeps_rtree)
+{
+    GridDataset dataset(5);
+    dataset.Contract("none", 1.0);
+    const auto rtree_node_ids = dataset.ReadRTreeNodeIDs();
+
+    dataset.Contract("hilbert", 1.0);
+    const auto node_ids = dataset.ReadNodeRenumbering();
+    BOOST_REQUIRE_EQUAL(node_ids.size(), dataset.number_of_nodes);
+    const auto renumbered_rtree_node_ids = dataset.ReadRTreeNodeIDs();
+
+    // a directory in the way of the new .node_renumbering
+    const auto blocked_path = dataset.osrm_path + ".node_renumbering.tmp";
+    boost::filesystem::create_directory(blocked_path);
+    BOOST_CHECK_THROW(dataset.Contract("level", 1.0), std::exception);
+    BOOST_CHECK(dataset.ReadNodeRenumbering() == node_ids);
+    BOOST_CHECK(dataset.ReadRTreeNodeIDs() == renumbered_rtree_node_ids);
+
+    boost::filesystem::remove(blocked_path);
+    dataset.Contract("none", 1.0);
+    BOOST_CHECK(dataset.ReadNodeRenumbering().empty());
+    BOOST_CHECK(dataset.ReadRTreeNodeIDs() == rtree_node_ids);
+}
+
+// Contracting the cells of a partition first builds another hierarchy, but its queries have to
+// find the same distances as the queries on the hierarchy of the whole graph.
+BOOST_AUTO_TEST_CASE(partitioned_contraction_keeps_distances)
+{
+    GridDataset dataset(5);
+    const auto shortest_distances = dataset.ShortestDistances();
+
+    dataset.Contract("none", 1.0);
+    BOOST_CHECK(QueryDistances(dataset.ReadHierarchy(SameId), dataset.number_of_nodes) ==
+                shortest_distances);
+
+    for (const unsigned partition_cell_size : {4, 16, 64})
+    {
+        dataset.Contract("none", 1.0, partition_cell_size);
+        BOOST_CHECK(QueryDistances(dataset.ReadHierarchy(SameId), dataset.number_of_nodes) ==
+                    shortest_distances);
+    }
+}
+
+// Contracting only the nodes around changed weights keeps shortcuts of the previous hierarchy,
+// but its queries have to find the same distances as a full contraction with the new weights.
+// Without a limit the hierarchy keeps growing, with a limit of 0 every run that starts from a
+// grown hierarchy contracts all nodes again and builds the hierarchy of a full contraction.
+BOOST_AUTO_TEST_CASE(incremental_contraction_keeps_distances)
+{
+    for (const double max_incremental_growth : {std::numeric_limits<double>::max(), 0.})
+    {
+        GridDataset incremental_dataset(5);
+        GridDataset full_dataset(5);
+        incremental_dataset.Contract("none", 1.0);
+        std::size_t full_hierarchy_size = incremental_dataset.ReadHierarchy(SameId).size();
+
+        std::mt19937 incremental_generator(7);
+        std::mt19937 full_generator(7);
+        unsigned number_of_full_contractions = 0;
+        for (const auto update : util::irange(0, 8))
+        {
+            (void)update;
+            incremental_dataset.ChangeWeights(incremental_generator, 10);
+            full_dataset.ChangeWeights(full_generator, 10);
+            const auto shortest_distances = full_dataset.ShortestDistances();
+
+            const auto previous_hierarchy_size = incremental_dataset.ReadHierarchy(SameId).size();
+            incremental_dataset.ContractIncrementally(max_incremental_growth);
+            full_dataset.Contract("none", 1.0);
+            const auto incremental_hierarchy = incremental_dataset.ReadHierarchy(SameId);
+            const auto full_hierarchy = full_dataset.ReadHierarchy(SameId);
+
+            BOOST_CHECK(QueryDistances(full_hierarchy, full_dataset.number_of_nodes) ==
+                        shortest_distances);
+            BOOST_CHECK(QueryDistances(incremental_hierarchy,
+                                       incremental_dataset.number_of_nodes) ==
+                        shortest_distances);
+
+            if (previous_hierarchy_size > (1. + max_incremental_growth) * full_hierarchy_size)
+            {
+                BOOST_CHECK(incremental_hierarchy == full_hierarchy);
+                full_hierarchy_size = incremental_hierarchy.size();
+                ++number_of_full_contractions;
+            }
+        }
+        if (max_incremental_growth == 0.)
+        {
+            BOOST_CHECK_GT(number_of_full_contractions, 0u);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
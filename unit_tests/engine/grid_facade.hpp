@@ -0,0 +1,232 @@
+#ifndef GRID_FACADE_HPP
+#define GRID_FACADE_HPP
+
+#include "engine/phantom_node.hpp"
+#include "contractor/query_edge.hpp"
+#include "extractor/travel_mode.hpp"
+#include "extractor/turn_instructions.hpp"
+#include "util/integer_range.hpp"
+#include "util/typedefs.hpp"
+
+#include <osrm/coordinate.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace osrm
+{
+namespace engine
+{
+
+// distance between two neighbouring nodes of a grid in fixed point coordinates
+const constexpr int GRID_NODE_SPACING = 1000;
+
+// The edge-expanded graph of grids of roads without any roads between them. It is not
+// contracted, every edge is stored as a forward edge at its source and as a backward edge at its
+// target, so the query is a plain bidirectional Dijkstra on it.
+class GridFacade
+{
+  public:
+    using EdgeData = contractor::QueryEdge::EdgeData;
+
+    GridFacade(const unsigned size, std::mt19937 &generator, const unsigned number_of_grids = 1)
+        : number_of_grids(number_of_grids)
+    {
+        std::uniform_int_distribution<> length(10, 1000);
+        std::uniform_int_distribution<> turn_penalty(0, 1000);
+        for (const auto grid : util::irange(0u, number_of_grids))
+        {
+            const auto node = [size, grid](const unsigned row, const unsigned column)
+            {
+                return (grid * size + row) * size + column;
+            };
+            for (const auto row : util::irange(0u, size))
+            {
+                for (const auto column : util::irange(0u, size))
+                {
+                    // the grids are placed next to each other
+                    coordinates.emplace_back(52000000 + GRID_NODE_SPACING * row,
+                                             13000000 +
+                                                 GRID_NODE_SPACING * ((size + 1) * grid + column));
+                    if (column + 1 < size)
+                    {
+                        segments.emplace_back(node(row, column), node(row, column + 1),
+                                              length(generator));
+                    }
+                    if (row + 1 < size)
+                    {
+                        segments.emplace_back(node(row, column), node(row + 1, column),
+                                              length(generator));
+                    }
+                }
+            }
+        }
+
+        // the edge-based node 2 * s drives segment s from its first to its second node,
+        // 2 * s + 1 the other way around
+        const auto source = [this](const NodeID edge_based_node)
+        {
+            const auto &segment = segments[edge_based_node / 2];
+            return edge_based_node % 2 == 0 ? std::get<0>(segment) : std::get<1>(segment);
+        };
+        const auto target = [this](const NodeID edge_based_node)
+        {
+            const auto &segment = segments[edge_based_node / 2];
+            return edge_based_node % 2 == 0 ? std::get<1>(segment) : std::get<0>(segment);
+        };
+
+        std::vector<std::vector<contractor::QueryEdgeSearchData>> adjacency(GetNumberOfNodes());
+        for (const auto from : util::irange(0u, GetNumberOfNodes()))
+        {
+            for (const auto to : util::irange(0u, GetNumberOfNodes()))
+            {
+                // turns onto every other segment at the end of this one, but no u-turns
+                if (target(from) != source(to) || from / 2 == to / 2)
+                {
+                    continue;
+                }
+                // a turn penalty breaks the ties between driving around a block clockwise and
+                // counter-clockwise
+                const int weight = std::get<2>(segments[from / 2]) + turn_penalty(generator);
+                contractor::QueryEdgeSearchData forward_edge = {to, weight, true, false};
+                contractor::QueryEdgeSearchData backward_edge = {from, weight, false, true};
+                adjacency[from].push_back(forward_edge);
+                adjacency[to].push_back(backward_edge);
+            }
+        }
+
+        first_edge.push_back(0);
+        for (const auto node : util::irange<NodeID>(0, adjacency.size()))
+        {
+            for (const auto &edge : adjacency[node])
+            {
+                contractor::QueryEdgeUnpackData unpack = {
+                    static_cast<NodeID>(search_data.size()), false};
+                search_data.push_back(edge);
+                unpack_data.push_back(unpack);
+                // the geometry of a turn is the node it happens at
+                turn_nodes.push_back(edge.forward ? target(node) : source(node));
+            }
+            first_edge.push_back(static_cast<EdgeID>(search_data.size()));
+        }
+    }
+
+    // a location on the given segment, position is its distance to the first node
+    PhantomNode Phantom(const std::size_t segment, const int position) const
+    {
+        const auto &first = coordinates[std::get<0>(segments[segment])];
+        const auto &second = coordinates[std::get<1>(segments[segment])];
+        const int length = std::get<2>(segments[segment]);
+        util::FixedPointCoordinate location(
+            first.lat + (second.lat - first.lat) * position / length,
+            first.lon + (second.lon - first.lon) * position / length);
+        // every grid is a connected component, the ids start at 1
+        const unsigned component_id = segment / (segments.size() / number_of_grids) + 1;
+        PhantomNode phantom(2 * segment, 2 * segment + 1, 0, position, length - position, 0, 0,
+                            SPECIAL_EDGEID, false, component_id, location, 0, TRAVEL_MODE_DEFAULT,
+                            TRAVEL_MODE_DEFAULT);
+        return phantom;
+    }
+
+    std::size_t GetNumberOfSegments() const { return segments.size(); }
+
+    int GetSegmentLength(const std::size_t segment) const
+    {
+        return std::get<2>(segments[segment]);
+    }
+
+    unsigned GetNumberOfNodes() const { return 2 * segments.size(); }
+
+    const contractor::QueryEdgeSearchData &GetSearchData(const EdgeID e) const
+    {
+        return search_data[e];
+    }
+
+    EdgeData GetEdgeData(const EdgeID e) const { return EdgeData(search_data[e], unpack_data[e]); }
+
+    util::range<EdgeID> GetAdjacentEdgeRange(const NodeID node) const
+    {
+        return util::irange(first_edge[node], first_edge[node + 1]);
+    }
+
+    bool IsCoreNode(const NodeID) const { return false; }
+
+    unsigned GetNameIndexFromEdgeID(const unsigned) const { return 0; }
+
+    std::string get_name_for_id(const unsigned) const { return ""; }
+
+    extractor::TurnInstruction GetTurnInstructionForEdgeID(const unsigned) const
+    {
+        return extractor::TurnInstruction::NoTurn;
+    }
+
+    extractor::TravelMode GetTravelModeForEdgeID(const unsigned) const
+    {
+        return TRAVEL_MODE_DEFAULT;
+    }
+
+    bool EdgeIsCompressed(const unsigned) const { return false; }
+
+    unsigned GetGeometryIndexForEdgeID(const unsigned id) const { return turn_nodes[id]; }
+
+    void GetUncompressedGeometry(const unsigned, std::vector<unsigned> &) const {}
+
+    util::FixedPointCoordinate GetCoordinateOfNode(const unsigned id) const
+    {
+        return coordinates[id];
+    }
+
+    unsigned GetCheckSum() const { return 0; }
+
+    // the closest locations on the segments, ignores the bearing
+    std::vector<PhantomNodeWithDistance>
+    NearestPhantomNodes(const util::FixedPointCoordinate &input_coordinate,
+                        const unsigned max_results,
+                        const int = 0,
+                        const int = 180) const
+    {
+        std::vector<PhantomNodeWithDistance> results;
+        for (const auto segment : util::irange<std::size_t>(0, segments.size()))
+        {
+            const auto &first = coordinates[std::get<0>(segments[segment])];
+            const auto &second = coordinates[std::get<1>(segments[segment])];
+            // the segments are either horizontal or vertical
+            const bool is_horizontal = first.lat == second.lat;
+            const int offset = is_horizontal ? input_coordinate.lon - first.lon
+                                             : input_coordinate.lat - first.lat;
+            const int clamped_offset = std::max(0, std::min(GRID_NODE_SPACING, offset));
+            const int position = std::max(
+                1, std::min(GetSegmentLength(segment) - 1,
+                            clamped_offset * GetSegmentLength(segment) / GRID_NODE_SPACING));
+            auto phantom = Phantom(segment, position);
+            const double distance = std::hypot(input_coordinate.lat - phantom.location.lat,
+                                               input_coordinate.lon - phantom.location.lon);
+            results.push_back(PhantomNodeWithDistance{std::move(phantom), distance});
+        }
+        std::stable_sort(results.begin(), results.end(),
+                         [](const PhantomNodeWithDistance &lhs, const PhantomNodeWithDistance &rhs)
+                         {
+                             return lhs.distance < rhs.distance;
+                         });
+        results.resize(std::min<std::size_t>(results.size(), max_results));
+        return results;
+    }
+
+  private:
+    unsigned number_of_grids;
+    // first node, second node and length
+    std::vector<std::tuple<unsigned, unsigned, int>> segments;
+    std::vector<util::FixedPointCoordinate> coordinates;
+    std::vector<EdgeID> first_edge;
+    std::vector<contractor::QueryEdgeSearchData> search_data;
+    std::vector<contractor::QueryEdgeUnpackData> unpack_data;
+    std::vector<unsigned> turn_nodes;
+};
+}
+}
+
+#endif // GRID_FACADE_HPP
@@ -0,0 +1,387 @@
+#include "engine/routing_algorithms/map_matching.hpp"
+#include "engine/map_matching/hidden_markov_model.hpp"
+#include "engine/phantom_node.hpp"
+#include "engine/search_engine_data.hpp"
+#include "util/coordinate_calculation.hpp"
+#include "util/integer_range.hpp"
+#include "util/json_logger.hpp"
+
+#include "grid_facade.hpp"
+
+#include <osrm/coordinate.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(map_matching_transitions)
+
+using namespace osrm;
+using namespace osrm::engine;
+
+using Matching = routing_algorithms::MapMatching<const GridFacade>;
+
+const constexpr unsigned GRID_SIZE = 8;
+const constexpr unsigned CANDIDATES_PER_COORDINATE = 6;
+const constexpr unsigned SECONDS_PER_SAMPLE = 3;
+const constexpr double MATCHING_BETA = 10.;
+const constexpr double GPS_PRECISION = 20.;
+
+struct Trace
+{
+    std::vector<util::FixedPointCoordinate> coordinates;
+    std::vector<unsigned> timestamps;
+    routing_algorithms::CandidateLists candidates;
+};
+
+// A random walk over the crossings of the grid, with every coordinate moved away from its
+// crossing. Some of the candidates are given offsets like the ones of compressed edges, so the
+// forward searches start with negative weights of different sizes.
+Trace RandomTrace(const GridFacade &facade, const std::size_t length, std::mt19937 &generator)
+{
+    std::uniform_int_distribution<unsigned> random_crossing(0, GRID_SIZE - 1);
+    std::uniform_int_distribution<unsigned> random_direction(0, 3);
+    std::uniform_int_distribution<int> noise(-GRID_NODE_SPACING / 5, GRID_NODE_SPACING / 5);
+    std::bernoulli_distribution has_offset(0.3);
+    std::uniform_int_distribution<int> offset(1, 500);
+
+    Trace trace;
+    unsigned row = random_crossing(generator);
+    unsigned column = random_crossing(generator);
+    for (const auto index : util::irange<std::size_t>(0, length))
+    {
+        const auto crossing = facade.GetCoordinateOfNode(row * GRID_SIZE + column);
+        util::FixedPointCoordinate coordinate(crossing.lat + noise(generator),
+                                              crossing.lon + noise(generator));
+        trace.coordinates.push_back(coordinate);
+        trace.timestamps.push_back(SECONDS_PER_SAMPLE * index);
+
+        trace.candidates.push_back_layer();
+        for (auto candidate : facade.NearestPhantomNodes(coordinate, CANDIDATES_PER_COORDINATE))
+        {
+            if (has_offset(generator))
+            {
+                candidate.phantom_node.forward_offset = offset(generator);
+                candidate.phantom_node.reverse_offset = offset(generator);
+            }
+            candidate.distance = util::coordinate_calculation::haversineDistance(
+                coordinate, candidate.phantom_node.location);
+            trace.candidates.push_back(candidate);
+        }
+
+        switch (random_direction(generator))
+        {
+        case 0:
+            row = row + 1 < GRID_SIZE ? row + 1 : row - 1;
+            break;
+        case 1:
+            row = row > 0 ? row - 1 : row + 1;
+            break;
+        case 2:
+            column = column + 1 < GRID_SIZE ? column + 1 : column - 1;
+            break;
+        default:
+            column = column > 0 ? column - 1 : column + 1;
+            break;
+        }
+    }
+    return trace;
+}
+
+// The transition of the previous implementation, one bidirectional query per pair of candidates
+struct PairTransition
+{
+    EdgeWeight weight;
+    double network_distance;
+    std::vector<NodeID> packed_path;
+};
+
+PairTransition SearchPair(const Matching &matching,
+                          const PhantomNode &source,
+                          const PhantomNode &target,
+                          SearchEngineData::QueryHeap &forward_heap,
+                          SearchEngineData::QueryHeap &reverse_heap)
+{
+    PairTransition transition;
+
+    forward_heap.Clear();
+    reverse_heap.Clear();
+    transition.network_distance =
+        matching.get_network_distance(forward_heap, reverse_heap, source, target);
+
+    // the same query once more, for the weight of the path it finds
+    forward_heap.Clear();
+    reverse_heap.Clear();
+    forward_heap.Insert(source.forward_node_id, -source.GetForwardWeightPlusOffset(),
+                        source.forward_node_id);
+    forward_heap.Insert(source.reverse_node_id, -source.GetReverseWeightPlusOffset(),
+                        source.reverse_node_id);
+    reverse_heap.Insert(target.forward_node_id, target.GetForwardWeightPlusOffset(),
+                        target.forward_node_id);
+    reverse_heap.Insert(target.reverse_node_id, target.GetReverseWeightPlusOffset(),
+                        target.reverse_node_id);
+    transition.weight = INVALID_EDGE_WEIGHT;
+    matching.Search(forward_heap, reverse_heap, transition.weight, transition.packed_path);
+    return transition;
+}
+
+// The transitions between two timestamps are searched for all targets of a source at once. They
+// have to be the ones of a query per pair, and the pairs the search leaves out as implausible
+// have to be pruned by the network distance the query finds.
+BOOST_AUTO_TEST_CASE(transitions_match_pairwise_queries)
+{
+    std::mt19937 generator(42);
+    const GridFacade facade(GRID_SIZE, generator);
+    SearchEngineData engine_working_data;
+    const Matching matching(&facade, engine_working_data);
+    SearchEngineData::QueryHeap forward_pair_heap(facade.GetNumberOfNodes());
+    SearchEngineData::QueryHeap reverse_pair_heap(facade.GetNumberOfNodes());
+
+    const double max_distance_delta = SECONDS_PER_SAMPLE * routing_algorithms::MAX_SPEED;
+    std::size_t number_of_transitions = 0;
+    std::size_t number_of_implausible_pairs = 0;
+    std::size_t number_of_negative_weights = 0;
+
+    for (const auto trace_index : util::irange(0, 20))
+    {
+        (void)trace_index;
+        const auto trace = RandomTrace(facade, 10, generator);
+        for (const auto t : util::irange<std::size_t>(1, trace.candidates.size()))
+        {
+            const auto sources = trace.candidates[t - 1];
+            const auto targets = trace.candidates[t];
+            const auto haversine_distance = util::coordinate_calculation::haversineDistance(
+                trace.coordinates[t - 1], trace.coordinates[t]);
+
+            engine_working_data.InitializeOrClearMapMatchingThreadLocalStorage(
+                facade.GetNumberOfNodes(), targets.size());
+            auto &forward_heap = *engine_working_data.map_matching_forward_heap;
+            auto &reverse_heaps = *engine_working_data.map_matching_reverse_heaps;
+            for (const auto s_prime : util::irange<std::size_t>(0, targets.size()))
+            {
+                const auto &phantom = targets[s_prime].phantom_node;
+                reverse_heaps[s_prime]->Insert(phantom.forward_node_id,
+                                               phantom.GetForwardWeightPlusOffset(),
+                                               phantom.forward_node_id);
+                reverse_heaps[s_prime]->Insert(phantom.reverse_node_id,
+                                               phantom.GetReverseWeightPlusOffset(),
+                                               phantom.reverse_node_id);
+            }
+
+            std::vector<EdgeWeight> target_weights(targets.size());
+            std::vector<NodeID> target_middles(targets.size());
+            for (const auto s : util::irange<std::size_t>(0, sources.size()))
+            {
+                const auto &source = sources[s].phantom_node;
+
+                // the plausibility check of the map matching
+                std::vector<std::size_t> plausible_targets;
+                for (const auto s_prime : util::irange<std::size_t>(0, targets.size()))
+                {
+                    const auto lower_bound_distance =
+                        util::coordinate_calculation::haversineDistance(
+                            source.location, targets[s_prime].phantom_node.location);
+                    if (lower_bound_distance - haversine_distance < max_distance_delta)
+                    {
+                        plausible_targets.push_back(s_prime);
+                    }
+                }
+                matching.SearchTransitions(source, plausible_targets, forward_heap, reverse_heaps,
+                                           target_weights, target_middles);
+
+                for (const auto s_prime : util::irange<std::size_t>(0, targets.size()))
+                {
+                    const auto &target = targets[s_prime].phantom_node;
+                    const auto pair_transition = SearchPair(
+                        matching, source, target, forward_pair_heap, reverse_pair_heap);
+
+                    if (std::find(plausible_targets.begin(), plausible_targets.end(), s_prime) ==
+                        plausible_targets.end())
+                    {
+                        ++number_of_implausible_pairs;
+                        BOOST_CHECK_GE(
+                            std::abs(pair_transition.network_distance - haversine_distance),
+                            max_distance_delta);
+                        continue;
+                    }
+
+                    ++number_of_transitions;
+                    if (source.forward_node_id == target.forward_node_id &&
+                        target.GetForwardWeightPlusOffset() < source.GetForwardWeightPlusOffset())
+                    {
+                        ++number_of_negative_weights;
+                    }
+
+                    BOOST_CHECK_EQUAL(target_weights[s_prime], pair_transition.weight);
+                    if (INVALID_EDGE_WEIGHT == target_weights[s_prime])
+                    {
+                        BOOST_CHECK_EQUAL(pair_transition.network_distance,
+                                          std::numeric_limits<double>::max());
+                        continue;
+                    }
+
+                    std::vector<NodeID> packed_path;
+                    matching.RetrievePackedPathFromHeap(forward_heap, *reverse_heaps[s_prime],
+                                                        target_middles[s_prime], packed_path);
+                    // paths of the same weight are equally short, but not of the same length
+                    if (packed_path == pair_transition.packed_path)
+                    {
+                        BOOST_CHECK_EQUAL(matching.get_path_distance(packed_path, source, target),
+                                          pair_transition.network_distance);
+                    }
+                }
+            }
+        }
+    }
+
+    BOOST_CHECK_GT(number_of_transitions, 0u);
+    BOOST_CHECK_GT(number_of_implausible_pairs, 0u);
+    BOOST_CHECK_GT(number_of_negative_weights, 0u);
+}
+
+// The Viterbi algorithm of the previous implementation on a trace without breakages, with a
+// query for every pair of candidates. Returns false if the trace breaks.
+bool PairwiseMatching(const Matching &matching,
+                      const Trace &trace,
+                      SearchEngineData::QueryHeap &forward_heap,
+                      SearchEngineData::QueryHeap &reverse_heap,
+                      routing_algorithms::SubMatching &sub_matching)
+{
+    const map_matching::EmissionLogProbability emission_log_probability(GPS_PRECISION);
+    const map_matching::TransitionLogProbability transition_log_probability(MATCHING_BETA);
+    const double max_distance_delta = SECONDS_PER_SAMPLE * routing_algorithms::MAX_SPEED;
+
+    std::vector<std::vector<double>> viterbi(trace.candidates.size());
+    std::vector<std::vector<std::size_t>> parents(trace.candidates.size());
+    std::vector<std::vector<float>> lengths(trace.candidates.size());
+    for (const auto &candidate : trace.candidates[0])
+    {
+        viterbi[0].push_back(emission_log_probability(candidate.distance));
+    }
+    parents[0].resize(viterbi[0].size());
+    lengths[0].resize(viterbi[0].size());
+
+    for (const auto t : util::irange<std::size_t>(1, trace.candidates.size()))
+    {
+        const auto sources = trace.candidates[t - 1];
+        const auto targets = trace.candidates[t];
+        const auto haversine_distance = util::coordinate_calculation::haversineDistance(
+            trace.coordinates[t - 1], trace.coordinates[t]);
+        viterbi[t].assign(targets.size(), map_matching::IMPOSSIBLE_LOG_PROB);
+        parents[t].assign(targets.size(), 0);
+        lengths[t].assign(targets.size(), 0);
+
+        bool is_broken = true;
+        for (const auto s : util::irange<std::size_t>(0, sources.size()))
+        {
+            if (viterbi[t - 1][s] == map_matching::IMPOSSIBLE_LOG_PROB)
+            {
+                continue;
+            }
+            for (const auto s_prime : util::irange<std::size_t>(0, targets.size()))
+            {
+                forward_heap.Clear();
+                reverse_heap.Clear();
+                const auto network_distance = matching.get_network_distance(
+                    forward_heap, reverse_heap, sources[s].phantom_node,
+                    targets[s_prime].phantom_node);
+                const auto d_t = std::abs(network_distance - haversine_distance);
+                if (d_t >= max_distance_delta)
+                {
+                    continue;
+                }
+
+                const double new_value = viterbi[t - 1][s] +
+                                         emission_log_probability(targets[s_prime].distance) +
+                                         transition_log_probability(d_t);
+                if (new_value > viterbi[t][s_prime])
+                {
+                    viterbi[t][s_prime] = new_value;
+                    parents[t][s_prime] = s;
+                    lengths[t][s_prime] = network_distance;
+                    is_broken = false;
+                }
+            }
+        }
+        if (is_broken)
+        {
+            return false;
+        }
+    }
+
+    const auto last = trace.candidates.size() - 1;
+    std::size_t candidate = std::distance(
+        viterbi[last].begin(), std::max_element(viterbi[last].begin(), viterbi[last].end()));
+    std::vector<std::size_t> chosen(trace.candidates.size());
+    for (std::size_t t = last; t > 0; --t)
+    {
+        chosen[t] = candidate;
+        candidate = parents[t][candidate];
+    }
+    chosen[0] = candidate;
+
+    sub_matching.length = 0.0;
+    for (const auto t : util::irange<std::size_t>(0, trace.candidates.size()))
+    {
+        sub_matching.indices.push_back(t);
+        sub_matching.nodes.push_back(trace.candidates[t][chosen[t]].phantom_node);
+        sub_matching.length += lengths[t][chosen[t]];
+    }
+    return true;
+}
+
+// Matching traces with transitions that are searched together and without the implausible ones
+// has to give the matchings of a query for every pair of candidates.
+BOOST_AUTO_TEST_CASE(matchings_match_pairwise_queries)
+{
+    std::mt19937 generator(7);
+    const GridFacade facade(GRID_SIZE, generator);
+    SearchEngineData engine_working_data;
+    const Matching matching(&facade, engine_working_data);
+    SearchEngineData::QueryHeap forward_heap(facade.GetNumberOfNodes());
+    SearchEngineData::QueryHeap reverse_heap(facade.GetNumberOfNodes());
+
+    // the matching adds its debug output to the logger when there is one
+    if (util::json::Logger::get())
+    {
+        util::json::Logger::get()->initialize("matching");
+    }
+
+    std::size_t number_of_compared_traces = 0;
+    for (const auto trace_index : util::irange(0, 30))
+    {
+        (void)trace_index;
+        const auto trace = RandomTrace(facade, 12, generator);
+
+        routing_algorithms::SubMatching reference;
+        if (!PairwiseMatching(matching, trace, forward_heap, reverse_heap, reference))
+        {
+            continue;
+        }
+        ++number_of_compared_traces;
+
+        routing_algorithms::SubMatchingList sub_matchings;
+        matching(trace.candidates, trace.coordinates, trace.timestamps, MATCHING_BETA,
+                 GPS_PRECISION, sub_matchings);
+
+        BOOST_REQUIRE_EQUAL(sub_matchings.size(), 1u);
+        const auto &sub_matching = sub_matchings.front();
+        BOOST_CHECK_EQUAL_COLLECTIONS(sub_matching.indices.begin(), sub_matching.indices.end(),
+                                      reference.indices.begin(), reference.indices.end());
+        BOOST_REQUIRE_EQUAL(sub_matching.nodes.size(), reference.nodes.size());
+        for (const auto index : util::irange<std::size_t>(0, reference.nodes.size()))
+        {
+            BOOST_CHECK(sub_matching.nodes[index] == reference.nodes[index]);
+        }
+        BOOST_CHECK_EQUAL(sub_matching.length, reference.length);
+    }
+
+    BOOST_CHECK_GT(number_of_compared_traces, 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
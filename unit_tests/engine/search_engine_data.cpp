@@ -0,0 +1,47 @@
+#include "engine/search_engine_data.hpp"
+#include "util/integer_range.hpp"
+#include "util/typedefs.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(search_engine_data)
+
+using namespace osrm;
+using namespace osrm::engine;
+
+// The heaps of a thread outlive a dataset, osrm-datastore may load a larger one meanwhile
+BOOST_AUTO_TEST_CASE(many_to_many_heap_grows_with_the_dataset)
+{
+    SearchEngineData engine_working_data;
+
+    engine_working_data.InitializeOrClearManyToManyThreadLocalStorage(10);
+    auto &small_heap = *engine_working_data.many_to_many_heap;
+    for (const auto node : util::irange<NodeID>(0, 10))
+    {
+        small_heap.Insert(node, node, node);
+    }
+
+    const unsigned number_of_nodes = 100000;
+    engine_working_data.InitializeOrClearManyToManyThreadLocalStorage(number_of_nodes);
+    auto &heap = *engine_working_data.many_to_many_heap;
+    BOOST_CHECK(heap.Empty());
+    for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+    {
+        BOOST_CHECK(!heap.WasInserted(node));
+        heap.Insert(node, number_of_nodes - node, node);
+    }
+    for (const auto node : util::irange<NodeID>(0, number_of_nodes))
+    {
+        BOOST_REQUIRE(heap.WasInserted(node));
+        BOOST_CHECK_EQUAL(heap.GetData(node).parent, node);
+    }
+    BOOST_CHECK_EQUAL(heap.Min(), number_of_nodes - 1);
+
+    // a smaller dataset reuses the heap
+    engine_working_data.InitializeOrClearManyToManyThreadLocalStorage(10);
+    BOOST_CHECK_EQUAL(engine_working_data.many_to_many_heap.get(), &heap);
+    BOOST_CHECK(heap.Empty());
+    BOOST_CHECK(!heap.WasInserted(5));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,96 @@
+#include "engine/routing_algorithms/shortest_path.hpp"
+#include "engine/internal_route_result.hpp"
+#include "engine/phantom_node.hpp"
+#include "engine/search_engine_data.hpp"
+#include "util/integer_range.hpp"
+
+#include "grid_facade.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <limits>
+#include <random>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(shortest_path_routing)
+
+using namespace osrm;
+using namespace osrm::engine;
+
+void CheckSameRoute(const InternalRouteResult &route, const InternalRouteResult &reference)
+{
+    BOOST_REQUIRE(reference.is_valid());
+    BOOST_CHECK_EQUAL(route.shortest_path_length, reference.shortest_path_length);
+    BOOST_REQUIRE_EQUAL(route.unpacked_path_segments.size(),
+                        reference.unpacked_path_segments.size());
+    for (const auto leg : util::irange<std::size_t>(0, reference.unpacked_path_segments.size()))
+    {
+        const auto &path = route.unpacked_path_segments[leg];
+        const auto &reference_path = reference.unpacked_path_segments[leg];
+        BOOST_REQUIRE_EQUAL(path.size(), reference_path.size());
+        for (const auto index : util::irange<std::size_t>(0, reference_path.size()))
+        {
+            BOOST_CHECK_EQUAL(path[index].node, reference_path[index].node);
+            BOOST_CHECK_EQUAL(path[index].segment_duration,
+                              reference_path[index].segment_duration);
+        }
+    }
+    BOOST_CHECK(route.source_traversed_in_reverse == reference.source_traversed_in_reverse);
+    BOOST_CHECK(route.target_traversed_in_reverse == reference.target_traversed_in_reverse);
+}
+
+// Long routes search their legs in parallel and stitch them together afterwards. The result
+// has to be the one of the sequential search, with u-turns allowed at some of the vias and
+// vias on the same segment as the one before them.
+BOOST_AUTO_TEST_CASE(parallel_legs_match_sequential_search)
+{
+    std::mt19937 generator(42);
+    const GridFacade facade(6, generator);
+    SearchEngineData engine_working_data;
+    const routing_algorithms::ShortestPathRouting<const GridFacade> parallel_routing(
+        &facade, engine_working_data);
+    const routing_algorithms::ShortestPathRouting<const GridFacade> sequential_routing(
+        &facade, engine_working_data, std::numeric_limits<std::size_t>::max());
+
+    std::uniform_int_distribution<std::size_t> random_segment(0, facade.GetNumberOfSegments() - 1);
+    std::bernoulli_distribution same_segment(0.25);
+    std::bernoulli_distribution allow_u_turn(0.5);
+
+    for (const auto route_index : util::irange(0, 200))
+    {
+        const auto number_of_legs =
+            routing_algorithms::MIN_LEGS_FOR_PARALLEL_SEARCH + route_index % 5;
+
+        std::vector<PhantomNode> waypoints;
+        std::size_t segment = random_segment(generator);
+        for (const auto waypoint_index : util::irange<std::size_t>(0, number_of_legs + 1))
+        {
+            if (waypoint_index > 0 && !same_segment(generator))
+            {
+                segment = random_segment(generator);
+            }
+            std::uniform_int_distribution<> position(1, facade.GetSegmentLength(segment) - 1);
+            waypoints.push_back(facade.Phantom(segment, position(generator)));
+        }
+
+        std::vector<PhantomNodes> legs;
+        for (const auto leg : util::irange<std::size_t>(0, number_of_legs))
+        {
+            legs.push_back(PhantomNodes{waypoints[leg], waypoints[leg + 1]});
+        }
+        std::vector<bool> uturns(number_of_legs + 1);
+        for (auto &&uturn : uturns)
+        {
+            uturn = allow_u_turn(generator);
+        }
+
+        InternalRouteResult sequential_route;
+        sequential_routing(legs, uturns, sequential_route);
+        InternalRouteResult parallel_route;
+        parallel_routing(legs, uturns, parallel_route);
+
+        CheckSameRoute(parallel_route, sequential_route);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
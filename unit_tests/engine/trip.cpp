@@ -0,0 +1,114 @@
+#include "engine/trip/trip_held_karp.hpp"
+#include "engine/trip/trip_local_search.hpp"
+#include "util/dist_table_wrapper.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(trip_solvers)
+
+using namespace osrm;
+using namespace osrm::engine;
+
+using DistTable = util::DistTableWrapper<EdgeWeight>;
+
+// asymmetric distances between random locations
+DistTable RandomTable(const std::size_t size, std::mt19937 &generator)
+{
+    std::uniform_int_distribution<> position(0, 1000);
+    std::uniform_int_distribution<> detour(0, 200);
+    std::vector<std::pair<int, int>> locations(size);
+    for (auto &location : locations)
+    {
+        location = std::make_pair(position(generator), position(generator));
+    }
+
+    std::vector<EdgeWeight> table(size * size, 0);
+    for (std::size_t from = 0; from < size; ++from)
+    {
+        for (std::size_t to = 0; to < size; ++to)
+        {
+            if (from != to)
+            {
+                table[from * size + to] = std::abs(locations[from].first - locations[to].first) +
+                                          std::abs(locations[from].second - locations[to].second) +
+                                          detour(generator);
+            }
+        }
+    }
+    return DistTable(std::move(table), size);
+}
+
+EdgeWeight TripLength(const std::vector<NodeID> &trip, const DistTable &table)
+{
+    EdgeWeight length = 0;
+    for (std::size_t index = 0; index < trip.size(); ++index)
+    {
+        length += table(trip[index], trip[(index + 1) % trip.size()]);
+    }
+    return length;
+}
+
+EdgeWeight ShortestTripLength(std::vector<NodeID> trip, const DistTable &table)
+{
+    std::sort(trip.begin(), trip.end());
+    EdgeWeight shortest = INVALID_EDGE_WEIGHT;
+    do
+    {
+        shortest = std::min(shortest, TripLength(trip, table));
+    } while (std::next_permutation(trip.begin() + 1, trip.end()));
+    return shortest;
+}
+
+void CheckPermutation(std::vector<NodeID> trip, std::vector<NodeID> locations)
+{
+    std::sort(trip.begin(), trip.end());
+    std::sort(locations.begin(), locations.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(trip.begin(), trip.end(), locations.begin(), locations.end());
+}
+
+BOOST_AUTO_TEST_CASE(held_karp_is_optimal)
+{
+    std::mt19937 generator(42);
+    for (std::size_t size = 1; size <= 9; ++size)
+    {
+        const auto table = RandomTable(size, generator);
+        // the locations of a component are not ordered
+        std::vector<NodeID> locations(size);
+        std::iota(locations.begin(), locations.end(), 0);
+        std::shuffle(locations.begin(), locations.end(), generator);
+
+        const auto trip = trip::HeldKarpTrip(locations.begin(), locations.end(), size, table);
+        CheckPermutation(trip, locations);
+        BOOST_CHECK_EQUAL(trip.front(), locations.front());
+        BOOST_CHECK_EQUAL(TripLength(trip, table), ShortestTripLength(locations, table));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(local_search_never_lengthens)
+{
+    std::mt19937 generator(42);
+    for (const std::size_t size : {2, 4, 7, 20, 60})
+    {
+        const auto table = RandomTable(size, generator);
+        std::vector<NodeID> trip(size);
+        std::iota(trip.begin(), trip.end(), 0);
+        std::shuffle(trip.begin(), trip.end(), generator);
+        const auto initial_trip = trip;
+
+        trip::LocalSearchTrip(trip, table);
+        CheckPermutation(trip, initial_trip);
+        BOOST_CHECK_LE(TripLength(trip, table), TripLength(initial_trip, table));
+        if (size == 7)
+        {
+            // close to the optimum on small trips
+            BOOST_CHECK_LE(TripLength(trip, table), ShortestTripLength(trip, table) * 11 / 10);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
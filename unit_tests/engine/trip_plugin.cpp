@@ -0,0 +1,104 @@
+#include "engine/plugins/trip.hpp"
+#include "engine/api_response_generator.hpp"
+#include "engine/phantom_node.hpp"
+#include "engine/search_engine.hpp"
+#include "util/dist_table_wrapper.hpp"
+#include "util/integer_range.hpp"
+#include "util/json_renderer.hpp"
+
+#include "grid_facade.hpp"
+
+#include <osrm/coordinate.hpp>
+#include <osrm/json_container.hpp>
+#include <osrm/route_parameters.hpp>
+
+#include <boost/fusion/container/vector.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(trip_plugin)
+
+using namespace osrm;
+using namespace osrm::engine;
+
+std::string Render(const util::json::Value &value)
+{
+    util::json::Object object;
+    object.values["value"] = value;
+    std::ostringstream out;
+    util::json::render(out, object);
+    return out.str();
+}
+
+// The components of a trip are solved, routed and described in parallel. The trips have to be
+// the ones found by going through the components one after another, in the order of the
+// components.
+BOOST_AUTO_TEST_CASE(parallel_components_match_sequential_trips)
+{
+    std::mt19937 generator(42);
+    // there are no roads between the grids, the locations on each grid form their own component
+    const unsigned number_of_grids = 4;
+    GridFacade facade(4, generator, number_of_grids);
+    plugins::RoundTripPlugin<GridFacade> plugin(&facade, 100);
+    SearchEngine<GridFacade> search_engine(&facade);
+
+    // a single location, two components for the exact solver and one for the heuristics
+    const std::vector<unsigned> locations_per_grid = {1, 5, 12, 24};
+    const auto segments_per_grid = facade.GetNumberOfSegments() / number_of_grids;
+    std::vector<util::FixedPointCoordinate> locations;
+    for (const auto grid : util::irange(0u, number_of_grids))
+    {
+        std::uniform_int_distribution<std::size_t> segment(grid * segments_per_grid,
+                                                           (grid + 1) * segments_per_grid - 1);
+        for (const auto location : util::irange(0u, locations_per_grid[grid]))
+        {
+            (void)location;
+            const auto location_segment = segment(generator);
+            std::uniform_int_distribution<> position(
+                1, facade.GetSegmentLength(location_segment) - 1);
+            locations.push_back(facade.Phantom(location_segment, position(generator)).location);
+        }
+    }
+    // the locations of a component are not next to each other in the request
+    std::shuffle(locations.begin(), locations.end(), generator);
+
+    RouteParameters parameters;
+    for (const auto &location : locations)
+    {
+        parameters.AddCoordinate(boost::fusion::vector<double, double>(
+            location.lat / COORDINATE_PRECISION, location.lon / COORDINATE_PRECISION));
+    }
+
+    util::json::Object parallel_result;
+    BOOST_REQUIRE(plugin.HandleRequest(parameters, parallel_result) ==
+                  plugins::BasePlugin::Status::Ok);
+
+    const auto phantom_nodes = plugin.GetPhantomNodes(parameters);
+    BOOST_REQUIRE_EQUAL(phantom_nodes.size(), locations.size());
+    const auto table = util::DistTableWrapper<EdgeWeight>(
+        std::move(*search_engine.distance_table(phantom_nodes, phantom_nodes)),
+        phantom_nodes.size());
+    const auto scc = plugin.SplitUnaccessibleLocations(phantom_nodes.size(), table);
+    BOOST_REQUIRE_EQUAL(scc.GetNumberOfComponents(), number_of_grids);
+
+    util::json::Array sequential_trips;
+    for (const auto k : util::irange<std::size_t>(0, scc.GetNumberOfComponents()))
+    {
+        const auto trip = plugin.ComputeTrip(scc, k, table);
+        const auto route = plugin.ComputeRoute(phantom_nodes, parameters, trip);
+        util::json::Object json_trip;
+        MakeApiResponseGenerator(&facade).DescribeRoute(parameters, route, json_trip);
+        plugin.SetLocPermutationOutput(trip, json_trip);
+        sequential_trips.values.push_back(std::move(json_trip));
+    }
+
+    BOOST_CHECK_EQUAL(Render(parallel_result.values["trips"]), Render(sequential_trips));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
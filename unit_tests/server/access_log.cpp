@@ -0,0 +1,175 @@
+#include "server/access_log.hpp"
+#include "server/http/request.hpp"
+#include "util/simple_logger.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace osrm;
+using namespace osrm::server;
+
+// the log writes nothing while the log policy is muted, which it is unless a tool unmutes it
+struct UnmutedLogPolicy
+{
+    UnmutedLogPolicy() { util::LogPolicy::GetInstance().Unmute(); }
+    ~UnmutedLogPolicy() { util::LogPolicy::GetInstance().Mute(); }
+};
+
+BOOST_FIXTURE_TEST_SUITE(access_log, UnmutedLogPolicy)
+
+std::vector<std::string> SplitLines(const std::string &text)
+{
+    std::vector<std::string> lines;
+    std::istringstream stream(text);
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+bool EndsWith(const std::string &line, const std::string &suffix)
+{
+    return line.size() >= suffix.size() &&
+           0 == line.compare(line.size() - suffix.size(), suffix.size(), suffix);
+}
+
+http::request MakeRequest()
+{
+    http::request request;
+    request.endpoint = boost::asio::ip::address::from_string("10.0.0.1");
+    request.agent = "curl";
+    return request;
+}
+
+BOOST_AUTO_TEST_CASE(plain_format)
+{
+    std::ostringstream output;
+    {
+        AccessLog log(output, AccessLogFormat::Plain, 1.);
+        const auto request = MakeRequest();
+        log.Log(request, "/viaroute?loc=1,2&loc=3,4", 200, AccessLog::Clock::now());
+        log.Log(request, "/nearest?loc=1,2", 400, AccessLog::Clock::now());
+    }
+
+    const auto lines = SplitLines(output.str());
+    BOOST_REQUIRE_EQUAL(lines.size(), 2u);
+    BOOST_CHECK_EQUAL(lines[0].find("[info] "), 0);
+    BOOST_CHECK(EndsWith(lines[0], " 10.0.0.1 - curl /viaroute?loc=1,2&loc=3,4"));
+    BOOST_CHECK(EndsWith(lines[1], " 10.0.0.1 - curl /nearest?loc=1,2"));
+}
+
+BOOST_AUTO_TEST_CASE(json_format_and_sampling)
+{
+    std::ostringstream output;
+    {
+        AccessLog log(output, AccessLogFormat::JSON, 0.25);
+        auto request = MakeRequest();
+        request.agent = "say \"hi\"";
+        for (unsigned i = 0; i < 100; ++i)
+        {
+            log.Log(request, "/locate?loc=" + std::to_string(i), 200, AccessLog::Clock::now());
+        }
+    }
+
+    const auto lines = SplitLines(output.str());
+    BOOST_REQUIRE_EQUAL(lines.size(), 25u);
+    for (const auto &line : lines)
+    {
+        BOOST_CHECK_EQUAL(line.find("{\"time\":\""), 0);
+        BOOST_CHECK(line.find("\"ip\":\"10.0.0.1\"") != std::string::npos);
+        BOOST_CHECK(line.find("\"agent\":\"say \\\"hi\\\"\"") != std::string::npos);
+        BOOST_CHECK(line.find("\"status\":200,\"duration_ms\":") != std::string::npos);
+        BOOST_CHECK_EQUAL(line.back(), '}');
+    }
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_threads)
+{
+    const unsigned number_of_threads = 4;
+    const unsigned requests_per_thread = 500;
+    std::ostringstream output;
+    {
+        AccessLog log(output, AccessLogFormat::Plain, 1.);
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < number_of_threads; ++t)
+        {
+            threads.emplace_back([&log, t, requests_per_thread]
+                                 {
+                                     const auto request = MakeRequest();
+                                     const std::string uri = "/thread" + std::to_string(t);
+                                     for (unsigned i = 0; i < requests_per_thread; ++i)
+                                     {
+                                         log.Log(request, uri, 200, AccessLog::Clock::now());
+                                     }
+                                 });
+        }
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    const auto lines = SplitLines(output.str());
+    BOOST_CHECK_EQUAL(lines.size(), number_of_threads * requests_per_thread);
+    for (unsigned t = 0; t < number_of_threads; ++t)
+    {
+        const std::string suffix = " /thread" + std::to_string(t);
+        const auto count = std::count_if(lines.begin(), lines.end(),
+                                         [&suffix](const std::string &line)
+                                         {
+                                             return EndsWith(line, suffix);
+                                         });
+        BOOST_CHECK_EQUAL(count, requests_per_thread);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(muted_log_writes_nothing)
+{
+    std::ostringstream output;
+    {
+        AccessLog log(output, AccessLogFormat::Plain, 1.);
+        const auto request = MakeRequest();
+        util::LogPolicy::GetInstance().Mute();
+        log.Log(request, "/muted", 200, AccessLog::Clock::now());
+        // give the background thread time to drain the muted entry
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        util::LogPolicy::GetInstance().Unmute();
+        log.Log(request, "/unmuted", 200, AccessLog::Clock::now());
+    }
+
+    const auto lines = SplitLines(output.str());
+    BOOST_REQUIRE_EQUAL(lines.size(), 1u);
+    BOOST_CHECK(EndsWith(lines[0], " /unmuted"));
+}
+
+// A thread that logged to a destroyed log must get a ring of the new one, even when the new log
+// is at the same address.
+BOOST_AUTO_TEST_CASE(thread_outlives_log)
+{
+    const auto request = MakeRequest();
+    std::vector<std::ostringstream> outputs(3);
+    for (auto &output : outputs)
+    {
+        AccessLog log(output, AccessLogFormat::Plain, 1.);
+        log.Log(request, "/first", 200, AccessLog::Clock::now());
+        log.Log(request, "/second", 200, AccessLog::Clock::now());
+    }
+
+    for (const auto &output : outputs)
+    {
+        const auto lines = SplitLines(output.str());
+        BOOST_REQUIRE_EQUAL(lines.size(), 2u);
+        BOOST_CHECK(EndsWith(lines[0], " /first"));
+        BOOST_CHECK(EndsWith(lines[1], " /second"));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,112 @@
+#include "server/http/compressor.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(compressor)
+
+using namespace osrm;
+using namespace osrm::server;
+
+std::vector<char> Inflate(const std::vector<char> &compressed, const int window_bits)
+{
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = Z_NULL;
+    stream.avail_in = 0;
+    BOOST_REQUIRE_EQUAL(inflateInit2(&stream, window_bits), Z_OK);
+
+    std::vector<char> output;
+    char buffer[16 * 1024];
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+    stream.avail_in = static_cast<uInt>(compressed.size());
+    int result = Z_OK;
+    while (Z_OK == result)
+    {
+        stream.next_out = reinterpret_cast<Bytef *>(buffer);
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        output.insert(output.end(), buffer, buffer + sizeof(buffer) - stream.avail_out);
+    }
+    BOOST_CHECK_EQUAL(result, Z_STREAM_END);
+    BOOST_CHECK_EQUAL(stream.avail_in, 0u);
+    inflateEnd(&stream);
+    return output;
+}
+
+// repetitive like a JSON reply, but not so much that every block is a single back reference
+std::vector<char> MakeContent(const std::size_t size)
+{
+    std::vector<char> content;
+    content.reserve(size);
+    unsigned state = 42;
+    while (content.size() < size)
+    {
+        state = state * 1103515245u + 12345u;
+        const std::string entry = "{\"location\":[" + std::to_string(state % 1000) + "," +
+                                  std::to_string((state >> 10) % 1000) + "]},";
+        content.insert(content.end(), entry.begin(), entry.end());
+    }
+    content.resize(size);
+    return content;
+}
+
+void CheckRoundTrip(const std::vector<char> &content)
+{
+    std::vector<char> output;
+
+    http::compress(content, http::gzip_rfc1952, 1, output);
+    const auto gunzipped = Inflate(output, 16 + MAX_WBITS);
+    BOOST_CHECK(gunzipped == content);
+
+    http::compress(content, http::deflate_rfc1951, 6, output);
+    const auto inflated = Inflate(output, -MAX_WBITS);
+    BOOST_CHECK(inflated == content);
+}
+
+BOOST_AUTO_TEST_CASE(single_block_round_trip)
+{
+    CheckRoundTrip({});
+    CheckRoundTrip(MakeContent(1));
+    CheckRoundTrip(MakeContent(5000));
+}
+
+BOOST_AUTO_TEST_CASE(multi_block_round_trip)
+{
+    // several blocks, the last one partial
+    const auto content = MakeContent(1000 * 1000);
+    CheckRoundTrip(content);
+
+    // the blocks share their history, so the result is not much larger than in one go
+    std::vector<char> output;
+    http::compress(content, http::deflate_rfc1951, 1, output);
+    uLongf single_size = compressBound(content.size());
+    std::vector<char> single(single_size);
+    BOOST_REQUIRE_EQUAL(compress2(reinterpret_cast<Bytef *>(single.data()), &single_size,
+                                  reinterpret_cast<const Bytef *>(content.data()),
+                                  content.size(), 1),
+                        Z_OK);
+    BOOST_CHECK_LT(output.size(), single_size * 11 / 10);
+}
+
+BOOST_AUTO_TEST_CASE(reuses_output_buffer)
+{
+    std::vector<char> output;
+    http::compress(MakeContent(300 * 1000), http::gzip_rfc1952, 1, output);
+    const auto capacity = output.capacity();
+    const auto data = output.data();
+
+    const auto content = MakeContent(2000);
+    http::compress(content, http::gzip_rfc1952, 1, output);
+    BOOST_CHECK_EQUAL(output.capacity(), capacity);
+    BOOST_CHECK(output.data() == data);
+    BOOST_CHECK(Inflate(output, 16 + MAX_WBITS) == content);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
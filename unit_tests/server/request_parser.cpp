@@ -0,0 +1,102 @@
+#include "server/request_parser.hpp"
+#include "server/http/request.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <tuple>
+
+BOOST_AUTO_TEST_SUITE(request_parser)
+
+using namespace osrm;
+using namespace osrm::server;
+
+// parses a single request from the input and returns the unparsed remainder
+util::tribool parse(RequestParser &parser, http::request &request, std::string &input)
+{
+    util::tribool result;
+    http::compression_type compression;
+    char *parsed_end;
+    std::tie(result, compression, parsed_end) =
+        parser.parse(request, &input[0], &input[0] + input.size());
+    input.erase(0, parsed_end - &input[0]);
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(keep_alive_by_version)
+{
+    RequestParser parser;
+    http::request request;
+    std::string input = "GET /viaroute?loc=1,2 HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    BOOST_CHECK(parse(parser, request, input) == util::tribool::yes);
+    BOOST_CHECK_EQUAL(request.uri, "/viaroute?loc=1,2");
+    BOOST_CHECK(request.keep_alive);
+    BOOST_CHECK(input.empty());
+
+    parser.reset();
+    request = http::request();
+    input = "GET /nearest HTTP/1.0\r\n\r\n";
+    BOOST_CHECK(parse(parser, request, input) == util::tribool::yes);
+    BOOST_CHECK(!request.keep_alive);
+}
+
+BOOST_AUTO_TEST_CASE(connection_header)
+{
+    RequestParser parser;
+    http::request request;
+    std::string input = "GET /nearest HTTP/1.1\r\nConnection: close\r\n\r\n";
+    BOOST_CHECK(parse(parser, request, input) == util::tribool::yes);
+    BOOST_CHECK(!request.keep_alive);
+
+    parser.reset();
+    request = http::request();
+    input = "GET /nearest HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n";
+    BOOST_CHECK(parse(parser, request, input) == util::tribool::yes);
+    BOOST_CHECK(request.keep_alive);
+}
+
+BOOST_AUTO_TEST_CASE(pipelined_requests)
+{
+    RequestParser parser;
+    http::request request;
+    std::string input = "GET /first HTTP/1.1\r\n\r\n"
+                        "POST /second HTTP/1.1\r\nContent-Length: 7\r\n\r\nloc=1,2"
+                        "GET /third HTTP/1.1\r\n\r\n";
+
+    BOOST_CHECK(parse(parser, request, input) == util::tribool::yes);
+    BOOST_CHECK_EQUAL(request.uri, "/first");
+
+    parser.reset();
+    request = http::request();
+    BOOST_CHECK(parse(parser, request, input) == util::tribool::yes);
+    BOOST_CHECK_EQUAL(request.uri, "/second?loc=1,2");
+
+    parser.reset();
+    request = http::request();
+    BOOST_CHECK(parse(parser, request, input) == util::tribool::yes);
+    BOOST_CHECK_EQUAL(request.uri, "/third");
+    BOOST_CHECK(input.empty());
+}
+
+BOOST_AUTO_TEST_CASE(request_split_across_reads)
+{
+    RequestParser parser;
+    http::request request;
+    std::string input = "GET /viaroute?loc=52.5,13.3&loc=52.5";
+    BOOST_CHECK(parse(parser, request, input) == util::tribool::indeterminate);
+    BOOST_CHECK(input.empty());
+
+    input = ",13.4 HTTP/1.1\r\n\r\n";
+    BOOST_CHECK(parse(parser, request, input) == util::tribool::yes);
+    BOOST_CHECK_EQUAL(request.uri, "/viaroute?loc=52.5,13.3&loc=52.5,13.4");
+}
+
+BOOST_AUTO_TEST_CASE(malformed_request)
+{
+    RequestParser parser;
+    http::request request;
+    std::string input = "GET /nearest FTP/1.1\r\n\r\n";
+    BOOST_CHECK(parse(parser, request, input) == util::tribool::no);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
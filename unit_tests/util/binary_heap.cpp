@@ -24,6 +24,8 @@ typedef NodeID TestNodeID;
 typedef int TestKey;
 typedef int TestWeight;
 typedef boost::mpl::list<ArrayStorage<TestNodeID, TestKey>,
+                         GenerationArrayStorage<TestNodeID, TestKey>,
+                         GenerationHashStorage<TestNodeID, TestKey>,
                          MapStorage<TestNodeID, TestKey>,
                          UnorderedMapStorage<TestNodeID, TestKey>> storage_types;
 
@@ -156,4 +158,97 @@ BOOST_FIXTURE_TEST_CASE_TEMPLATE(decrease_key_test, T, storage_types, RandomData
     }
 }
 
+BOOST_FIXTURE_TEST_CASE_TEMPLATE(clear_test, T, storage_types, RandomDataFixture<NUM_NODES>)
+{
+    BinaryHeap<TestNodeID, TestKey, TestWeight, TestData, T> heap(NUM_NODES);
+
+    for (unsigned round = 0; round < 3; ++round)
+    {
+        for (unsigned idx : order)
+        {
+            if (idx % 2 == round % 2)
+            {
+                BOOST_CHECK(!heap.WasInserted(ids[idx]));
+                heap.Insert(ids[idx], weights[idx], data[idx]);
+            }
+        }
+        for (auto id : ids)
+        {
+            BOOST_CHECK_EQUAL(heap.WasInserted(id), id % 2 == round % 2);
+        }
+        heap.Clear();
+        BOOST_CHECK(heap.Empty());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(four_ary_heap_test, RandomDataFixture<NUM_NODES>)
+{
+    using FourAryHeap = BinaryHeap<TestNodeID, TestKey, TestWeight, TestData,
+                                   GenerationArrayStorage<TestNodeID, TestKey>, 4>;
+    FourAryHeap heap(NUM_NODES);
+
+    for (unsigned idx : order)
+    {
+        heap.Insert(ids[idx], weights[idx] + 1000, data[idx]);
+    }
+
+    // move every other node to the front, in reverse order
+    for (auto id : ids)
+    {
+        if (id % 2 == 0)
+        {
+            heap.DecreaseKey(id, NUM_NODES - id);
+        }
+    }
+
+    TestWeight last_weight = std::numeric_limits<TestWeight>::min();
+    for (unsigned i = 0; i < NUM_NODES; ++i)
+    {
+        const TestWeight min_weight = heap.MinKey();
+        BOOST_CHECK_LE(last_weight, min_weight);
+        last_weight = min_weight;
+
+        const TestNodeID id = heap.DeleteMin();
+        BOOST_CHECK(heap.WasRemoved(id));
+        BOOST_CHECK_EQUAL(heap.GetKey(id), min_weight);
+    }
+    BOOST_CHECK(heap.Empty());
+}
+
+// The table grows past its initial capacity and keeps it when cleared. Node ids far apart and
+// ids that only differ in their high bits must not be mixed up.
+BOOST_AUTO_TEST_CASE(generation_hash_storage_grows)
+{
+    using HashHeap = BinaryHeap<TestNodeID, TestKey, TestWeight, TestData,
+                                GenerationHashStorage<TestNodeID, TestKey>>;
+    HashHeap heap(0);
+
+    const unsigned number_of_nodes = 5000;
+    const auto id = [](const unsigned index)
+    {
+        return index % 2 == 0 ? index * 7919 : (index << 16) + 1;
+    };
+    for (unsigned round = 0; round < 3; ++round)
+    {
+        for (unsigned index = round; index < number_of_nodes; ++index)
+        {
+            heap.Insert(id(index), index, TestData{index});
+        }
+        for (unsigned index = 0; index < number_of_nodes; ++index)
+        {
+            BOOST_CHECK_EQUAL(heap.WasInserted(id(index)), index >= round);
+            if (index >= round)
+            {
+                BOOST_CHECK_EQUAL(heap.GetData(id(index)).value, index);
+            }
+        }
+        for (unsigned index = round; index < number_of_nodes; ++index)
+        {
+            BOOST_CHECK_EQUAL(heap.DeleteMin(), id(index));
+        }
+        heap.Clear();
+        BOOST_CHECK(!heap.WasInserted(id(number_of_nodes - 1)));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,165 @@
+#include "util/json_writer.hpp"
+#include "util/json_renderer.hpp"
+#include "util/cast.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(json_writer)
+
+using namespace osrm::util;
+
+BOOST_AUTO_TEST_CASE(number_formatting)
+{
+    const auto check = [](const double number)
+    {
+        std::vector<char> output;
+        json::Writer writer(output);
+        writer.Number(number);
+        BOOST_CHECK_EQUAL(std::string(output.begin(), output.end()),
+                          cast::to_string_with_precision(number));
+    };
+
+    // signed zeros, values that round to zero and halfway cases of the sixth digit
+    const std::vector<double> numbers = {
+        0.,          -0.,         1e-9,         -1e-9,        5e-7,         -5e-7,
+        4.9999999e-7, 0.0000005,  0.0000015,    0.0000025,    1.0000005,    -2.5000005,
+        0.1234565,   1.,          -1.,          10.,          100.,         0.5,
+        -0.25,       52.517037,   13.388860,    -33.8688,     1e-6,         0.1,
+        1e11,        123456.7891, 1e15,         -1e15,        1e300,        -1e300,
+        4294967295., -2147483648., std::numeric_limits<double>::max(),
+        -std::numeric_limits<double>::max(), std::numeric_limits<double>::min(),
+        std::numeric_limits<double>::denorm_min(), std::numeric_limits<double>::infinity(),
+        -std::numeric_limits<double>::infinity()};
+    for (const auto number : numbers)
+    {
+        check(number);
+    }
+
+    // coordinates and durations, and values just off the middle between two outputs
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<> coordinates(-180., 180.);
+    std::uniform_int_distribution<> halfway(-100000000, 100000000);
+    for (int i = 0; i < 10000; ++i)
+    {
+        check(coordinates(generator));
+        const double middle = (halfway(generator) + 0.5) / 1e6;
+        check(middle);
+        check(std::nextafter(middle, 0.));
+        check(std::nextafter(middle, 1e9));
+    }
+
+    std::vector<char> output;
+    json::Writer writer(output);
+    writer.BeginArray();
+    writer.Number(0);
+    writer.Number(-2147483647);
+    writer.Number(4294967295u);
+    writer.EndArray();
+    BOOST_CHECK_EQUAL(std::string(output.begin(), output.end()), "[0,-2147483647,4294967295]");
+}
+
+BOOST_AUTO_TEST_CASE(separators_and_escaping)
+{
+    std::vector<char> output;
+    json::Writer writer(output);
+    writer.BeginObject();
+    writer.Key("name");
+    writer.String("Aleja \"Solidarnosci\"/1");
+    writer.Key("list");
+    writer.BeginArray();
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Bool(true);
+    writer.Null();
+    writer.EndArray();
+    writer.Key("empty");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.EndObject();
+    BOOST_CHECK_EQUAL(std::string(output.begin(), output.end()),
+                      "{\"name\":\"Aleja \\\"Solidarnosci\\\"\\/1\",\"list\":[[],true,null],"
+                      "\"empty\":{}}");
+}
+
+BOOST_AUTO_TEST_CASE(same_output_as_renderer)
+{
+    json::Array coordinate;
+    coordinate.values.push_back(52.517037);
+    coordinate.values.push_back(13.38886);
+    json::Object object;
+    object.values["status"] = 200;
+    object.values["coordinate"] = coordinate;
+    object.values["found"] = json::False();
+
+    std::vector<char> rendered;
+    json::render(rendered, object);
+
+    std::vector<char> written;
+    json::Writer writer(written);
+    writer.Value(object);
+
+    BOOST_CHECK_EQUAL(std::string(written.begin(), written.end()),
+                      std::string(rendered.begin(), rendered.end()));
+}
+
+// Objects hold their members unordered, so the ones written here have a single member each
+template <typename WriterT> void WriteDocument(WriterT &writer)
+{
+    writer.Number(200);
+    writer.String("Unter den \"Linden\"");
+    writer.BeginArray();
+    writer.Number(52.517037);
+    writer.Number(-13.38886);
+    writer.Number(4294967295u);
+    writer.EndArray();
+    writer.BeginObject();
+    writer.Key("empty");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.EndObject();
+    writer.BeginObject();
+    writer.Key("found");
+    writer.Bool(false);
+    writer.EndObject();
+    writer.Bool(true);
+    writer.Null();
+}
+
+BOOST_AUTO_TEST_CASE(tree_writer_builds_same_document)
+{
+    json::Object object;
+    json::TreeWriter tree_writer(object);
+    tree_writer.Key("document");
+    tree_writer.BeginArray();
+    WriteDocument(tree_writer);
+    tree_writer.EndArray();
+    std::vector<char> rendered;
+    json::render(rendered, object);
+
+    std::vector<char> written;
+    json::Writer writer(written);
+    writer.BeginObject();
+    writer.Key("document");
+    writer.BeginArray();
+    WriteDocument(writer);
+    writer.EndArray();
+    writer.EndObject();
+
+    BOOST_CHECK_EQUAL(std::string(written.begin(), written.end()),
+                      std::string(rendered.begin(), rendered.end()));
+
+    // later members are added next to the ones already there
+    tree_writer.Key("status");
+    tree_writer.Number(200);
+    BOOST_CHECK_EQUAL(object.values.size(), 2u);
+    BOOST_CHECK_EQUAL(object.values["status"].get<json::Number>().value, 200.);
+    BOOST_CHECK_EQUAL(object.values["document"].get<json::Array>().values.size(), 7u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
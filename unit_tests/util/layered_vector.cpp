@@ -0,0 +1,86 @@
+#include "util/layered_vector.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(layered_vector)
+
+using namespace osrm;
+using namespace osrm::util;
+
+BOOST_AUTO_TEST_CASE(push_back_layers)
+{
+    const std::vector<std::vector<int>> layers = {{1, 2, 3}, {}, {4}, {5, 6}};
+
+    LayeredVector<int> vector;
+    BOOST_CHECK(vector.empty());
+    for (const auto &layer : layers)
+    {
+        vector.push_back_layer(layer.begin(), layer.end());
+    }
+
+    BOOST_CHECK_EQUAL(vector.size(), layers.size());
+    for (std::size_t layer = 0; layer < layers.size(); ++layer)
+    {
+        BOOST_CHECK_EQUAL(vector[layer].size(), layers[layer].size());
+        BOOST_CHECK_EQUAL_COLLECTIONS(vector[layer].begin(), vector[layer].end(),
+                                      layers[layer].begin(), layers[layer].end());
+    }
+    BOOST_CHECK(vector[1].empty());
+
+    vector[3][1] = 7;
+    BOOST_CHECK_EQUAL(vector[3][1], 7);
+    BOOST_CHECK_EQUAL(vector[3][0], 5);
+}
+
+BOOST_AUTO_TEST_CASE(push_back_values)
+{
+    LayeredVector<int> vector;
+    vector.push_back_layer();
+    vector.push_back(1);
+    vector.push_back(2);
+    vector.push_back_layer();
+    vector.push_back_layer();
+    vector.push_back(3);
+
+    BOOST_CHECK_EQUAL(vector.size(), 3);
+    BOOST_CHECK_EQUAL(vector[0].size(), 2);
+    BOOST_CHECK_EQUAL(vector[0][1], 2);
+    BOOST_CHECK(vector[1].empty());
+    BOOST_CHECK_EQUAL(vector[2].size(), 1);
+    BOOST_CHECK_EQUAL(vector[2][0], 3);
+}
+
+BOOST_AUTO_TEST_CASE(reshape)
+{
+    const std::vector<char> values = {'a', 'b', 'c', 'd'};
+    LayeredVector<char> shape;
+    shape.push_back_layer(values.begin(), values.begin() + 1);
+    shape.push_back_layer(values.begin() + 1, values.end());
+
+    LayeredVector<double> vector;
+    vector.reshape(shape);
+    BOOST_CHECK_EQUAL(vector.size(), 2);
+    BOOST_CHECK_EQUAL(vector[0].size(), 1);
+    BOOST_CHECK_EQUAL(vector[1].size(), 3);
+    BOOST_CHECK(vector.layer_offsets() == shape.layer_offsets());
+}
+
+BOOST_AUTO_TEST_CASE(clear_keeps_memory)
+{
+    const std::vector<int> values(100, 1);
+    LayeredVector<int> vector;
+    vector.push_back_layer(values.begin(), values.end());
+    const int *data = vector[0].begin();
+
+    vector.clear();
+    BOOST_CHECK(vector.empty());
+    BOOST_CHECK_EQUAL(vector.size(), 0);
+
+    vector.push_back_layer(values.begin(), values.begin() + 50);
+    BOOST_CHECK_EQUAL(vector[0].size(), 50);
+    BOOST_CHECK(vector[0].begin() == data);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
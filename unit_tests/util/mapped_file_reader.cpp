@@ -0,0 +1,94 @@
+#include "util/mapped_file_reader.hpp"
+#include "util/osrm_exception.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(mapped_file_reader)
+
+using namespace osrm;
+using namespace osrm::util;
+
+constexpr char TEST_FILE[] = "test_mapped_file_reader.bin";
+
+void WriteTestFile(const std::vector<unsigned> &values)
+{
+    boost::filesystem::ofstream out(TEST_FILE, std::ios::binary);
+    const unsigned size = values.size();
+    out.write(reinterpret_cast<const char *>(&size), sizeof(unsigned));
+    out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(unsigned));
+}
+
+BOOST_AUTO_TEST_CASE(read_single_and_bulk)
+{
+    const std::vector<unsigned> values = {1, 2, 3, 5, 8, 13, 21};
+    WriteTestFile(values);
+
+    MappedFileReader reader(TEST_FILE);
+    const unsigned size = reader.Read<unsigned>();
+    BOOST_CHECK_EQUAL(size, values.size());
+
+    BOOST_CHECK_EQUAL(reader.Read<unsigned>(), 1u);
+    std::vector<unsigned> rest(size - 1);
+    reader.Read(rest.data(), rest.size());
+    BOOST_CHECK_EQUAL_COLLECTIONS(rest.begin(), rest.end(), values.begin() + 1, values.end());
+    BOOST_CHECK_EQUAL(reader.GetRemaining(), 0u);
+
+    reader.Seek(sizeof(unsigned));
+    reader.Skip(2 * sizeof(unsigned));
+    BOOST_CHECK_EQUAL(reader.Read<unsigned>(), 3u);
+
+    boost::filesystem::remove(TEST_FILE);
+}
+
+BOOST_AUTO_TEST_CASE(map_in_place)
+{
+    const std::vector<unsigned> values = {4, 8, 15, 16, 23, 42};
+    WriteTestFile(values);
+
+    MappedFileReader reader(TEST_FILE, false);
+    const unsigned size = reader.Read<unsigned>();
+    const unsigned *mapped = reader.Map<unsigned>(size);
+    BOOST_CHECK_EQUAL_COLLECTIONS(mapped, mapped + size, values.begin(), values.end());
+    BOOST_CHECK_EQUAL(reader.GetRemaining(), 0u);
+    BOOST_CHECK(reader.Map<unsigned>(0) == nullptr);
+    BOOST_CHECK_THROW(reader.Map<unsigned>(1), exception);
+
+    reader.Seek(1);
+    BOOST_CHECK_THROW(reader.Map<unsigned>(1), exception);
+
+    boost::filesystem::remove(TEST_FILE);
+}
+
+BOOST_AUTO_TEST_CASE(read_past_end)
+{
+    WriteTestFile({42});
+
+    MappedFileReader reader(TEST_FILE);
+    reader.Skip(sizeof(unsigned));
+    BOOST_CHECK_EQUAL(reader.Read<unsigned>(), 42u);
+    BOOST_CHECK_THROW(reader.Read<unsigned>(), exception);
+    BOOST_CHECK_THROW(reader.Skip(1), exception);
+
+    boost::filesystem::remove(TEST_FILE);
+}
+
+BOOST_AUTO_TEST_CASE(empty_and_missing_file)
+{
+    {
+        boost::filesystem::ofstream out(TEST_FILE, std::ios::binary);
+    }
+    MappedFileReader reader(TEST_FILE);
+    BOOST_CHECK_EQUAL(reader.GetRemaining(), 0u);
+    std::vector<unsigned> nothing;
+    reader.Read(nothing.data(), 0);
+    BOOST_CHECK_THROW(reader.Read<unsigned>(), exception);
+    boost::filesystem::remove(TEST_FILE);
+
+    BOOST_CHECK_THROW(MappedFileReader("does_not_exist.bin"), exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 #include "extractor/query_node.hpp"
 #include "extractor/edge_based_node.hpp"
 #include "util/floating_point.hpp"
+#include "util/layered_vector.hpp"
 #include "util/typedefs.hpp"
 
 #include <boost/functional/hash.hpp>
@@ -16,9 +17,12 @@
 #include <cmath>
 
 #include <algorithm>
+#include <future>
+#include <iterator>
 #include <memory>
 #include <random>
 #include <string>
+#include <thread>
 #include <utility>
 #include <unordered_set>
 #include <vector>
@@ -299,6 +303,278 @@ BOOST_FIXTURE_TEST_CASE(construct_multiple_levels_test, TestRandomGraphFixture_M
     construction_test("test_5", this);
 }
 
+BOOST_FIXTURE_TEST_CASE(memory_mapped_leaves_test, TestRandomGraphFixture_MultipleLevels)
+{
+    std::string leaves_path;
+    std::string nodes_path;
+    build_rtree<TestRandomGraphFixture_MultipleLevels>("test_mmap", this, leaves_path,
+                                                       nodes_path);
+    TestStaticRTree stream_rtree(nodes_path, leaves_path, coords);
+    TestStaticRTree mapped_rtree(nodes_path, leaves_path, coords, LeafStorage::MemoryMapped);
+    BOOST_CHECK(!stream_rtree.IsMemoryMapped());
+    BOOST_CHECK(mapped_rtree.IsMemoryMapped());
+    mapped_rtree.Prefetch();
+
+    LinearSearchNN<TestData> lsnn(coords, edges);
+    simple_verify_rtree(mapped_rtree, coords, edges);
+    sampling_verify_rtree(mapped_rtree, lsnn, *coords, 100);
+
+    std::mt19937 g(RANDOM_SEED);
+    std::uniform_int_distribution<> lat_udist(WORLD_MIN_LAT, WORLD_MAX_LAT);
+    std::uniform_int_distribution<> lon_udist(WORLD_MIN_LON, WORLD_MAX_LON);
+    for (unsigned i = 0; i < 100; i++)
+    {
+        const FixedPointCoordinate q(lat_udist(g), lon_udist(g));
+        const auto stream_result = stream_rtree.Nearest(q, 10);
+        const auto mapped_result = mapped_rtree.Nearest(q, 10);
+        BOOST_REQUIRE_EQUAL(stream_result.size(), mapped_result.size());
+        for (const auto j : irange<std::size_t>(0, stream_result.size()))
+        {
+            BOOST_CHECK_EQUAL(stream_result[j].u, mapped_result[j].u);
+            BOOST_CHECK_EQUAL(stream_result[j].v, mapped_result[j].v);
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(concurrent_stream_queries_test, TestRandomGraphFixture_MultipleLevels)
+{
+    std::string leaves_path;
+    std::string nodes_path;
+    build_rtree<TestRandomGraphFixture_MultipleLevels>("test_concurrent", this, leaves_path,
+                                                       nodes_path);
+    TestStaticRTree rtree(nodes_path, leaves_path, coords);
+    rtree.Prefetch();
+
+    std::mt19937 g(RANDOM_SEED);
+    std::uniform_int_distribution<> lat_udist(WORLD_MIN_LAT, WORLD_MAX_LAT);
+    std::uniform_int_distribution<> lon_udist(WORLD_MIN_LON, WORLD_MAX_LON);
+    std::vector<FixedPointCoordinate> queries;
+    std::vector<std::vector<TestData>> expected;
+    for (unsigned i = 0; i < 100; i++)
+    {
+        queries.emplace_back(lat_udist(g), lon_udist(g));
+        expected.push_back(rtree.Nearest(queries.back(), 10));
+    }
+
+    // the threads borrow the leaf streams of the shared tree
+    std::vector<unsigned> mismatches(4, 0);
+    std::vector<std::thread> threads;
+    for (const auto t : irange<std::size_t>(0, mismatches.size()))
+    {
+        threads.emplace_back([&, t]
+                             {
+                                 for (const auto i : irange<std::size_t>(0, queries.size()))
+                                 {
+                                     const auto result = rtree.Nearest(queries[i], 10);
+                                     if (result.size() != expected[i].size() ||
+                                         !std::equal(result.begin(), result.end(),
+                                                     expected[i].begin(),
+                                                     [](const TestData &lhs, const TestData &rhs)
+                                                     {
+                                                         return lhs.u == rhs.u && lhs.v == rhs.v;
+                                                     }))
+                                     {
+                                         ++mismatches[t];
+                                     }
+                                 }
+                             });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    for (const auto count : mismatches)
+    {
+        BOOST_CHECK_EQUAL(count, 0u);
+    }
+}
+
+#ifdef __linux__
+// A facade replaces its tree when new data is loaded, the leaf files may not stay open in the
+// long-lived threads that queried the old one.
+BOOST_FIXTURE_TEST_CASE(leaf_streams_closed_with_tree_test, TestRandomGraphFixture_MultipleLevels)
+{
+    std::string leaves_path;
+    std::string nodes_path;
+    build_rtree<TestRandomGraphFixture_MultipleLevels>("test_streams", this, leaves_path,
+                                                       nodes_path);
+    const auto count_open_files = []
+    {
+        return std::distance(boost::filesystem::directory_iterator("/proc/self/fd"),
+                             boost::filesystem::directory_iterator());
+    };
+    const auto open_files_before = count_open_files();
+
+    std::unique_ptr<TestStaticRTree> rtree(new TestStaticRTree(nodes_path, leaves_path, coords));
+    std::promise<void> tree_destroyed;
+    std::shared_future<void> tree_destroyed_future = tree_destroyed.get_future();
+    std::vector<std::promise<void>> queries_done(4);
+    std::vector<std::thread> threads;
+    for (auto &done : queries_done)
+    {
+        threads.emplace_back([&]
+                             {
+                                 std::mt19937 g(RANDOM_SEED);
+                                 std::uniform_int_distribution<> lat_udist(WORLD_MIN_LAT,
+                                                                           WORLD_MAX_LAT);
+                                 std::uniform_int_distribution<> lon_udist(WORLD_MIN_LON,
+                                                                           WORLD_MAX_LON);
+                                 for (unsigned i = 0; i < 100; i++)
+                                 {
+                                     rtree->Nearest(
+                                         FixedPointCoordinate(lat_udist(g), lon_udist(g)), 10);
+                                 }
+                                 done.set_value();
+                                 // the thread lives on like a server or TBB worker thread
+                                 tree_destroyed_future.wait();
+                             });
+    }
+    for (auto &done : queries_done)
+    {
+        done.get_future().wait();
+    }
+    rtree.reset();
+    BOOST_CHECK_EQUAL(count_open_files(), open_files_before);
+
+    tree_destroyed.set_value();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+#endif
+
+BOOST_FIXTURE_TEST_CASE(search_in_ranges_test, TestRandomGraphFixture_MultipleLevels)
+{
+    std::string leaves_path;
+    std::string nodes_path;
+    build_rtree<TestRandomGraphFixture_MultipleLevels>("test_ranges", this, leaves_path,
+                                                       nodes_path);
+    TestStaticRTree rtree(nodes_path, leaves_path, coords);
+    TestStaticRTree mapped_rtree(nodes_path, leaves_path, coords, LeafStorage::MemoryMapped);
+
+    // a random walk long enough to be searched in several batches
+    std::mt19937 g(RANDOM_SEED);
+    std::uniform_int_distribution<> step_udist(-COORDINATE_PRECISION / 2,
+                                               COORDINATE_PRECISION / 2);
+    std::uniform_real_distribution<> radius_udist(100000., 1000000.);
+    std::vector<FixedPointCoordinate> trace;
+    std::vector<double> radii;
+    FixedPointCoordinate position(0, 0);
+    for (unsigned i = 0; i < 300; i++)
+    {
+        position.lat =
+            std::max(WORLD_MIN_LAT, std::min(WORLD_MAX_LAT, position.lat + step_udist(g)));
+        position.lon =
+            std::max(WORLD_MIN_LON, std::min(WORLD_MAX_LON, position.lon + step_udist(g)));
+        trace.push_back(position);
+        radii.push_back(radius_udist(g));
+    }
+
+    // every other segment of the odd coordinates is filtered out
+    const auto filter = [](const std::size_t index, const TestData &data)
+    {
+        const bool use_segment = 0 == index % 2 || 0 == data.u % 2;
+        return std::make_pair(use_segment, use_segment);
+    };
+    LayeredVector<TestData> results;
+    LayeredVector<TestData> mapped_results;
+    rtree.SearchInRanges(trace, radii, filter, results);
+    mapped_rtree.SearchInRanges(trace, radii, filter, mapped_results);
+    BOOST_REQUIRE_EQUAL(results.size(), trace.size());
+    BOOST_REQUIRE_EQUAL(mapped_results.size(), trace.size());
+
+    const auto as_pairs = [](const TestData *segments_begin, const TestData *segments_end)
+    {
+        std::vector<std::pair<unsigned, unsigned>> pairs;
+        for (const auto *segment = segments_begin; segment != segments_end; ++segment)
+        {
+            pairs.emplace_back(segment->u, segment->v);
+        }
+        std::sort(pairs.begin(), pairs.end());
+        return pairs;
+    };
+    std::size_t number_of_results = 0;
+    for (const auto i : irange<std::size_t>(0, trace.size()))
+    {
+        const auto expected = rtree.Nearest(trace[i],
+                                            [&](const TestData &data)
+                                            {
+                                                return filter(i, data);
+                                            },
+                                            [&](const std::size_t, const double min_dist)
+                                            {
+                                                return min_dist > radii[i];
+                                            });
+        const auto expected_pairs = as_pairs(expected.data(), expected.data() + expected.size());
+        BOOST_CHECK(as_pairs(results[i].begin(), results[i].end()) == expected_pairs);
+        BOOST_CHECK(as_pairs(mapped_results[i].begin(), mapped_results[i].end()) ==
+                    expected_pairs);
+        number_of_results += expected.size();
+
+        // ordered by distance like the results of a single query
+        for (const auto j : irange<std::size_t>(1, results[i].size()))
+        {
+            const auto previous = coordinate_calculation::perpendicularDistance(
+                coords->at(results[i][j - 1].u), coords->at(results[i][j - 1].v), trace[i]);
+            const auto current = coordinate_calculation::perpendicularDistance(
+                coords->at(results[i][j].u), coords->at(results[i][j].v), trace[i]);
+            BOOST_CHECK_LE(previous, current + 0.01);
+        }
+    }
+    BOOST_CHECK_GT(number_of_results, trace.size());
+}
+
+BOOST_FIXTURE_TEST_CASE(update_leaf_node_file_test, TestRandomGraphFixture_MultipleLevels)
+{
+    for (auto &edge : edges)
+    {
+        edge.forward_edge_based_node_id = edge.u;
+    }
+    std::string leaves_path;
+    std::string nodes_path;
+    build_rtree<TestRandomGraphFixture_MultipleLevels>("test_update", this, leaves_path,
+                                                       nodes_path);
+    // a server started before the update keeps its leaves
+    TestStaticRTree mapped_rtree(nodes_path, leaves_path, coords, LeafStorage::MemoryMapped);
+
+    std::size_t number_of_updated_elements = 0;
+    TestStaticRTree::UpdateLeafNodeFile(leaves_path, [&](TestData &data)
+                                        {
+                                            BOOST_CHECK_EQUAL(data.forward_edge_based_node_id,
+                                                              data.u);
+                                            data.forward_edge_based_node_id = data.v;
+                                            ++number_of_updated_elements;
+                                        });
+    BOOST_CHECK_EQUAL(number_of_updated_elements, edges.size());
+
+    std::size_t number_of_visited_elements = 0;
+    TestStaticRTree::VisitLeafNodeFile(leaves_path, [&](const TestData &data)
+                                       {
+                                           BOOST_CHECK_EQUAL(data.forward_edge_based_node_id,
+                                                             data.v);
+                                           ++number_of_visited_elements;
+                                       });
+    BOOST_CHECK_EQUAL(number_of_visited_elements, edges.size());
+
+    TestStaticRTree rtree(nodes_path, leaves_path, coords);
+    std::mt19937 g(RANDOM_SEED);
+    std::uniform_int_distribution<> lat_udist(WORLD_MIN_LAT, WORLD_MAX_LAT);
+    std::uniform_int_distribution<> lon_udist(WORLD_MIN_LON, WORLD_MAX_LON);
+    for (unsigned i = 0; i < 100; i++)
+    {
+        const FixedPointCoordinate q(lat_udist(g), lon_udist(g));
+        for (const auto &result : rtree.Nearest(q, 10))
+        {
+            BOOST_CHECK_EQUAL(result.forward_edge_based_node_id, result.v);
+        }
+        for (const auto &result : mapped_rtree.Nearest(q, 10))
+        {
+            BOOST_CHECK_EQUAL(result.forward_edge_based_node_id, result.u);
+        }
+    }
+}
+
 // Bug: If you querry a point that lies between two BBs that have a gap,
 // one BB will be pruned, even if it could contain a nearer match.
 BOOST_AUTO_TEST_CASE(regression_test)